@@ -13,6 +13,7 @@ include(CMakeDependentOption)
 # For FETCH_*_FROM_SOURCE options, see cmake/setup.cmake which configures.
 # -------------------------------------------------------------------------
 option(NEOLITH_USE_BOOST "Use Boost libraries for JSON efuns (to_json, from_json) when available" ON)
+option(NEOLITH_USE_IO_URING "Use the io_uring async runtime instead of epoll on Linux (requires Linux 6.0 or later)" OFF)
 cmake_dependent_option(NEOLITH_BUILD_TESTS "Build Neolith unit tests (requires BUILD_TESTING and GoogleTest)" ON "BUILD_TESTING" OFF)
 
 # -------------------------------------------------------------------------
@@ -75,7 +76,7 @@ option(LAZY_RESETS "Only call reset() when an object is touched via call_other()
 set(CALLOUT_CYCLE_SIZE 32 CACHE STRING "Number of slots in the call_out list (power of 2 recommended)")
 
 set(SMALL_STRING_SIZE 100 CACHE STRING "Size threshold for small strings")
-set(MESSAGE_BUFFER_SIZE 4096 CACHE STRING "Size of the output buffer for messages sent to users")
+set(MESSAGE_BUFFER_SIZE 4096 CACHE STRING "Size of each pooled output block for messages sent to users")
 set(LARGEST_PRINTABLE_STRING 8192 CACHE STRING "Size of the vsprintf() buffer in add_message()")
 
 set(MAX_SAVE_SVALUE_DEPTH 25 CACHE STRING "Maximum nesting depth when saving LPC data structures (prevents infinite recursion)")
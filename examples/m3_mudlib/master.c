@@ -19,3 +19,7 @@ string get_bb_uid() {
 int valid_seteuid (object ob, string newuid) {
   return 1; // allow all seteuid calls for simplicity
 }
+
+int valid_checkpoint (object caller, object *obs) {
+  return file_name (caller)[0..7] == "/secure/"; // checkpoint logs expose private variables
+}
@@ -0,0 +1,198 @@
+/**
+ * @file async_pool.c
+ * @brief Worker pool implementation
+ *
+ * Each worker has its own job queue and wake event; a job goes to the worker
+ * chosen by its key. All workers share one done queue, which only the main
+ * thread drains. A worker that finds its queue empty sleeps on the wake event,
+ * which async_pool_submit() sets after queueing a job.
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include "src/std.h"
+#include "async_pool.h"
+#include "async_queue.h"
+#include "async_worker.h"
+#include "port/sync.h"
+
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#define ASYNC_POOL_IDLE_WAIT_MS   1000
+#define ASYNC_POOL_DONE_RETRY_MS  1
+
+typedef struct {
+    async_pool_job_t job;
+    void* arg;
+} pool_job_t;
+
+typedef struct {
+    async_pool_t* pool;
+    async_worker_t* thread;
+    async_queue_t* jobs;
+    platform_event_t wake;
+    bool wake_ready;
+} pool_worker_t;
+
+struct async_pool_s {
+    async_runtime_t* main_runtime;
+    uintptr_t completion_key;
+    async_queue_t* done;
+    pool_worker_t* workers;
+    int num_workers;
+    size_t pending;             /* main thread: submitted and not collected */
+};
+
+static void pool_sleep_ms (int ms) {
+#ifdef _WIN32
+    Sleep(ms);
+#else
+    usleep(ms * 1000);
+#endif
+}
+
+static void* pool_worker_main (void* context) {
+    pool_worker_t* pw = (pool_worker_t*)context;
+    async_pool_t* pool = pw->pool;
+    async_worker_t* self = async_worker_current();
+    pool_job_t job;
+    size_t size;
+
+    while (!async_worker_should_stop(self)) {
+        if (!async_queue_dequeue(pw->jobs, &job, sizeof(job), &size) || size != sizeof(job)) {
+            platform_event_wait(&pw->wake, ASYNC_POOL_IDLE_WAIT_MS);
+            continue;
+        }
+
+        job.job(job.arg);
+
+        /* the done queue holds every job that can be queued, but retry
+         * rather than lose one if the main thread falls far behind */
+        while (!async_queue_enqueue(pool->done, &job.arg, sizeof(job.arg)))
+            pool_sleep_ms(ASYNC_POOL_DONE_RETRY_MS);
+        async_runtime_post_completion(pool->main_runtime, pool->completion_key, 0);
+    }
+    return NULL;
+}
+
+static void stop_workers (async_pool_t* pool) {
+    int i;
+
+    for (i = 0; i < pool->num_workers; i++) {
+        if (pool->workers[i].thread) {
+            async_worker_signal_stop(pool->workers[i].thread);
+            platform_event_set(&pool->workers[i].wake);
+        }
+    }
+    for (i = 0; i < pool->num_workers; i++) {
+        pool_worker_t* pw = &pool->workers[i];
+        if (pw->thread) {
+            async_worker_join(pw->thread, -1);
+            async_worker_destroy(pw->thread);
+            pw->thread = NULL;
+        }
+        if (pw->jobs) {
+            async_queue_destroy(pw->jobs);
+            pw->jobs = NULL;
+        }
+        if (pw->wake_ready) {
+            platform_event_destroy(&pw->wake);
+            pw->wake_ready = false;
+        }
+    }
+}
+
+async_pool_t* async_pool_create (int num_workers, size_t queue_size,
+                                 async_runtime_t* main_runtime, uintptr_t completion_key) {
+    async_pool_t* pool;
+    int i;
+
+    if (num_workers < 1 || queue_size < 1 || !main_runtime)
+        return NULL;
+
+    pool = (async_pool_t*)calloc(1, sizeof(async_pool_t));
+    if (!pool)
+        return NULL;
+    pool->main_runtime = main_runtime;
+    pool->completion_key = completion_key;
+    pool->num_workers = num_workers;
+    pool->workers = (pool_worker_t*)calloc(num_workers, sizeof(pool_worker_t));
+    pool->done = async_queue_create(queue_size * num_workers * 2, sizeof(void*), ASYNC_QUEUE_MPSC);
+    if (!pool->workers || !pool->done)
+        goto fail;
+
+    for (i = 0; i < num_workers; i++) {
+        pool_worker_t* pw = &pool->workers[i];
+
+        pw->pool = pool;
+        pw->jobs = async_queue_create(queue_size, sizeof(pool_job_t), (async_queue_flags_t)0);
+        if (!pw->jobs)
+            goto fail;
+        if (!platform_event_init(&pw->wake, false, false))
+            goto fail;
+        pw->wake_ready = true;
+        pw->thread = async_worker_create(pool_worker_main, pw, 0);
+        if (!pw->thread)
+            goto fail;
+    }
+    return pool;
+
+fail:
+    async_pool_destroy(pool);
+    return NULL;
+}
+
+void async_pool_destroy (async_pool_t* pool) {
+    if (!pool)
+        return;
+    if (pool->workers) {
+        stop_workers(pool);
+        free(pool->workers);
+    }
+    if (pool->done)
+        async_queue_destroy(pool->done);
+    free(pool);
+}
+
+bool async_pool_submit (async_pool_t* pool, uint32_t key, async_pool_job_t job, void* arg) {
+    pool_worker_t* pw;
+    pool_job_t entry;
+
+    if (!pool || !job)
+        return false;
+
+    pw = &pool->workers[key % (uint32_t)pool->num_workers];
+    entry.job = job;
+    entry.arg = arg;
+    if (!async_queue_enqueue(pw->jobs, &entry, sizeof(entry)))
+        return false;
+    pool->pending++;
+    platform_event_set(&pw->wake);
+    return true;
+}
+
+bool async_pool_next_done (async_pool_t* pool, void** arg) {
+    size_t size;
+
+    if (!pool || !arg)
+        return false;
+    if (!async_queue_dequeue(pool->done, arg, sizeof(*arg), &size) || size != sizeof(*arg))
+        return false;
+    pool->pending--;
+    return true;
+}
+
+size_t async_pool_pending (const async_pool_t* pool) {
+    return pool ? pool->pending : 0;
+}
+
+int async_pool_size (const async_pool_t* pool) {
+    return pool ? pool->num_workers : 0;
+}
@@ -0,0 +1,98 @@
+/**
+ * @file async_pool.h
+ * @brief Pool of worker threads running blocking jobs off the main thread
+ *
+ * The main thread submits jobs, each a function and an argument. A worker
+ * thread runs the function, then hands the argument back through a done
+ * queue and posts a completion to the main runtime. The main thread collects
+ * finished jobs with async_pool_next_done() when it sees the completion key.
+ *
+ * Every job is submitted with a key, and jobs with the same key run on the
+ * same worker in submission order. Callers use this to keep operations on
+ * one resource (e.g. a file path) ordered, while unrelated ones run in
+ * parallel.
+ *
+ * All functions except the job functions themselves are called from the
+ * main thread.
+ */
+
+#ifndef ASYNC_POOL_H
+#define ASYNC_POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "async/async_runtime.h"
+
+#ifdef HAVE_STDBOOL_H
+#include <stdbool.h>
+#else
+typedef int bool;
+#define true 1
+#define false 0
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct async_pool_s async_pool_t;
+
+/**
+ * Job run on a worker thread. It must not touch LPC data or driver state.
+ * @param arg Argument given to async_pool_submit().
+ */
+typedef void (*async_pool_job_t)(void* arg);
+
+/**
+ * Start a pool of worker threads.
+ * @param num_workers Number of worker threads (at least 1).
+ * @param queue_size Maximum number of jobs waiting per worker.
+ * @param main_runtime Runtime of the main thread, for posting completions.
+ * @param completion_key Completion key posted when jobs finish.
+ * @returns The pool, or NULL on failure.
+ */
+async_pool_t* async_pool_create (int num_workers, size_t queue_size,
+                                 async_runtime_t* main_runtime, uintptr_t completion_key);
+
+/**
+ * Stop the worker threads and free the pool.
+ *
+ * Jobs already running are finished; jobs still waiting are not run. The
+ * arguments of jobs that were not collected with async_pool_next_done()
+ * are not freed, callers keep track of them.
+ */
+void async_pool_destroy (async_pool_t* pool);
+
+/**
+ * Queue a job.
+ * @param pool The pool.
+ * @param key Jobs with equal keys run in order on the same worker.
+ * @param job Function to run on the worker thread.
+ * @param arg Argument of the job, handed back by async_pool_next_done().
+ * @returns true if queued, false if the worker's queue is full.
+ */
+bool async_pool_submit (async_pool_t* pool, uint32_t key, async_pool_job_t job, void* arg);
+
+/**
+ * Collect one finished job.
+ * @param pool The pool.
+ * @param arg Receives the argument of the finished job.
+ * @returns true if a job was collected, false if none has finished.
+ */
+bool async_pool_next_done (async_pool_t* pool, void** arg);
+
+/**
+ * Get the number of submitted jobs not collected yet.
+ */
+size_t async_pool_pending (const async_pool_t* pool);
+
+/**
+ * Get the number of worker threads.
+ */
+int async_pool_size (const async_pool_t* pool);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ASYNC_POOL_H */
@@ -1,6 +1,13 @@
 /**
  * @file async_queue.c
  * @brief Thread-safe message queue implementation using circular buffer
+ *
+ * Two implementations share the API:
+ * - The default queue protects a circular buffer of fixed-size slots with a
+ *   mutex. It supports every flag and any number of producers and consumers.
+ * - ASYNC_QUEUE_MPSC is lock-free for many producers and one consumer: a
+ *   bounded ring of sequence-numbered slots (after Dmitry Vyukov's bounded
+ *   queue). Small messages are stored in the slot, larger ones out of line.
  */
 #ifdef HAVE_CONFIG_H
 #include <config.h>
@@ -11,6 +18,21 @@
 #include "async/async_queue.h"
 #include "port/sync.h"
 
+/* Header of a slot of the mutex-protected queue, followed by the message */
+typedef struct {
+    size_t size;
+    uint64_t enqueued_usec;
+} slot_header_t;
+
+/* Slot of the lock-free queue */
+typedef struct {
+    platform_atomic_t seq;     /* == position: free; == position + 1: holds a message */
+    size_t size;
+    uint64_t enqueued_usec;
+    void* payload;             /* out-of-line copy, or NULL if stored inline */
+    unsigned char inline_data[ASYNC_QUEUE_INLINE_SIZE];
+} mpsc_slot_t;
+
 /**
  * Queue implementation using circular buffer
  */
@@ -18,22 +40,35 @@ struct async_queue_s {
     platform_mutex_t mutex;        /* Protects queue state */
     platform_event_t not_full;     /* Signaled when space available (for BLOCK_WRITER) */
     platform_event_t not_empty;    /* Signaled when data available (for SIGNAL_ON_DATA) */
-    
+
     void* buffer;              /* Circular buffer storage */
     size_t capacity;           /* Maximum number of messages */
     size_t max_msg_size;       /* Maximum message size */
-    size_t msg_slot_size;      /* Actual slot size (max_msg_size + sizeof(size_t)) */
-    
+    size_t msg_slot_size;      /* Actual slot size (header + max_msg_size, aligned) */
+
     size_t head;               /* Write position */
     size_t tail;               /* Read position */
     size_t count;              /* Current message count */
-    
+
     async_queue_flags_t flags;
-    
+
+    /* ASYNC_QUEUE_MPSC */
+    mpsc_slot_t* slots;
+    size_t mask;               /* capacity - 1, capacity is a power of 2 */
+    platform_atomic_t enqueue_pos;
+    size_t dequeue_pos;        /* consumer only */
+    platform_atomic_t mpsc_enqueued;
+    platform_atomic_t mpsc_full;
+    platform_atomic_t mpsc_contended;
+
     /* Statistics */
     uint64_t enqueue_count;
     uint64_t dequeue_count;
     uint64_t dropped_count;
+    uint64_t full_count;
+    uint64_t contended_count;
+    uint64_t latency_total_usec;
+    uint64_t latency_max_usec;
 };
 
 /* Internal helper: get slot pointer */
@@ -41,22 +76,134 @@ static inline void* get_slot(async_queue_t* queue, size_t index) {
     return (char*)queue->buffer + (index * queue->msg_slot_size);
 }
 
+/* Internal helper: lock the mutex, counting the times it was already held */
+static inline void lock_queue(async_queue_t* queue) {
+    if (!platform_mutex_trylock(&queue->mutex)) {
+        platform_mutex_lock(&queue->mutex);
+        queue->contended_count++;
+    }
+}
+
+/* Internal helper: account the time a message spent in the queue */
+static inline void record_latency(async_queue_t* queue, uint64_t enqueued_usec) {
+    uint64_t waited = platform_monotonic_usec() - enqueued_usec;
+
+    queue->latency_total_usec += waited;
+    if (waited > queue->latency_max_usec)
+        queue->latency_max_usec = waited;
+}
+
+static async_queue_t* mpsc_create(async_queue_t* queue, size_t capacity) {
+    size_t size = 1, i;
+
+    while (size < capacity)
+        size <<= 1;
+    queue->slots = (mpsc_slot_t*)calloc(size, sizeof(mpsc_slot_t));
+    if (!queue->slots)
+        return NULL;
+    for (i = 0; i < size; i++)
+        platform_atomic_store(&queue->slots[i].seq, i);
+    queue->capacity = size;
+    queue->mask = size - 1;
+    return queue;
+}
+
+static bool mpsc_enqueue(async_queue_t* queue, const void* data, size_t size) {
+    size_t pos = platform_atomic_load(&queue->enqueue_pos);
+    void* payload = NULL;
+    mpsc_slot_t* slot;
+
+    if (size > ASYNC_QUEUE_INLINE_SIZE) {
+        payload = malloc(size);
+        if (!payload)
+            return false;
+        memcpy(payload, data, size);
+    }
+
+    /* claim the slot at the enqueue position */
+    for (;;) {
+        intptr_t diff;
+
+        slot = &queue->slots[pos & queue->mask];
+        diff = (intptr_t)platform_atomic_load(&slot->seq) - (intptr_t)pos;
+        if (diff == 0) {
+            if (platform_atomic_cas(&queue->enqueue_pos, &pos, pos + 1))
+                break;
+            platform_atomic_add(&queue->mpsc_contended, 1);
+        }
+        else if (diff < 0) {
+            /* the consumer has not freed this slot yet */
+            platform_atomic_add(&queue->mpsc_full, 1);
+            free(payload);
+            return false;
+        }
+        else
+            pos = platform_atomic_load(&queue->enqueue_pos);
+    }
+
+    slot->size = size;
+    slot->enqueued_usec = platform_monotonic_usec();
+    slot->payload = payload;
+    if (!payload)
+        memcpy(slot->inline_data, data, size);
+    platform_atomic_add(&queue->mpsc_enqueued, 1);
+    platform_atomic_store(&slot->seq, pos + 1);
+
+    if (queue->flags & ASYNC_QUEUE_SIGNAL_ON_DATA)
+        platform_event_set(&queue->not_empty);
+    return true;
+}
+
+/* The consumer's next message, or NULL if there is none */
+static mpsc_slot_t* mpsc_peek(async_queue_t* queue) {
+    mpsc_slot_t* slot = &queue->slots[queue->dequeue_pos & queue->mask];
+
+    if (platform_atomic_load(&slot->seq) != queue->dequeue_pos + 1)
+        return NULL;
+    return slot;
+}
+
+static void mpsc_release(async_queue_t* queue, mpsc_slot_t* slot) {
+    record_latency(queue, slot->enqueued_usec);
+    free(slot->payload);
+    slot->payload = NULL;
+    queue->dequeue_count++;
+    platform_atomic_store(&slot->seq, queue->dequeue_pos + queue->capacity);
+    queue->dequeue_pos++;
+}
+
+static bool mpsc_dequeue(async_queue_t* queue, void* buffer, size_t buffer_size, size_t* out_size) {
+    mpsc_slot_t* slot = mpsc_peek(queue);
+
+    if (!slot || slot->size > buffer_size)
+        return false;
+    memcpy(buffer, slot->payload ? slot->payload : slot->inline_data, slot->size);
+    if (out_size)
+        *out_size = slot->size;
+    mpsc_release(queue, slot);
+    return true;
+}
+
 async_queue_t* async_queue_create(size_t capacity, size_t max_msg_size, async_queue_flags_t flags) {
     if (capacity == 0 || max_msg_size == 0) {
         return NULL;
     }
-    
+    if ((flags & ASYNC_QUEUE_MPSC) && (flags & (ASYNC_QUEUE_DROP_OLDEST | ASYNC_QUEUE_BLOCK_WRITER))) {
+        /* both need a producer to wait for, or act as, the consumer */
+        return NULL;
+    }
+
     async_queue_t* queue = (async_queue_t*)calloc(1, sizeof(async_queue_t));
     if (!queue) {
         return NULL;
     }
-    
+
     /* Initialize mutex */
     if (!platform_mutex_init(&queue->mutex)) {
         free(queue);
         return NULL;
     }
-    
+
     /* Initialize events if needed */
     if (flags & ASYNC_QUEUE_BLOCK_WRITER) {
         if (!platform_event_init(&queue->not_full, false, true)) {
@@ -65,7 +212,7 @@ async_queue_t* async_queue_create(size_t capacity, size_t max_msg_size, async_qu
             return NULL;
         }
     }
-    
+
     if (flags & ASYNC_QUEUE_SIGNAL_ON_DATA) {
         if (!platform_event_init(&queue->not_empty, false, false)) {
             if (flags & ASYNC_QUEUE_BLOCK_WRITER) {
@@ -76,9 +223,24 @@ async_queue_t* async_queue_create(size_t capacity, size_t max_msg_size, async_qu
             return NULL;
         }
     }
-    
-    /* Allocate circular buffer (each slot: size_t for length + message data) */
-    queue->msg_slot_size = sizeof(size_t) + max_msg_size;
+
+    queue->max_msg_size = max_msg_size;
+    queue->flags = flags;
+
+    if (flags & ASYNC_QUEUE_MPSC) {
+        if (!mpsc_create(queue, capacity)) {
+            if (flags & ASYNC_QUEUE_SIGNAL_ON_DATA) {
+                platform_event_destroy(&queue->not_empty);
+            }
+            platform_mutex_destroy(&queue->mutex);
+            free(queue);
+            return NULL;
+        }
+        return queue;
+    }
+
+    /* Allocate circular buffer (each slot: header + message data) */
+    queue->msg_slot_size = (sizeof(slot_header_t) + max_msg_size + 7) & ~(size_t)7;
     queue->buffer = calloc(capacity, queue->msg_slot_size);
     if (!queue->buffer) {
         if (flags & ASYNC_QUEUE_SIGNAL_ON_DATA) {
@@ -91,35 +253,37 @@ async_queue_t* async_queue_create(size_t capacity, size_t max_msg_size, async_qu
         free(queue);
         return NULL;
     }
-    
+
     queue->capacity = capacity;
-    queue->max_msg_size = max_msg_size;
     queue->head = 0;
     queue->tail = 0;
     queue->count = 0;
-    queue->flags = flags;
     queue->enqueue_count = 0;
     queue->dequeue_count = 0;
     queue->dropped_count = 0;
-    
+
     return queue;
 }
 
 void async_queue_destroy(async_queue_t* queue) {
     if (!queue) return;
-    
+
     if (queue->buffer) {
         free(queue->buffer);
     }
-    
+    if (queue->slots) {
+        async_queue_clear(queue);
+        free(queue->slots);
+    }
+
     if (queue->flags & ASYNC_QUEUE_SIGNAL_ON_DATA) {
         platform_event_destroy(&queue->not_empty);
     }
-    
+
     if (queue->flags & ASYNC_QUEUE_BLOCK_WRITER) {
         platform_event_destroy(&queue->not_full);
     }
-    
+
     platform_mutex_destroy(&queue->mutex);
     free(queue);
 }
@@ -128,9 +292,12 @@ bool async_queue_enqueue(async_queue_t* queue, const void* data, size_t size) {
     if (!queue || !data || size == 0 || size > queue->max_msg_size) {
         return false;
     }
-    
-    platform_mutex_lock(&queue->mutex);
-    
+    if (queue->slots) {
+        return mpsc_enqueue(queue, data, size);
+    }
+
+    lock_queue(queue);
+
     /* Check if queue is full */
     while (queue->count >= queue->capacity) {
         if (queue->flags & ASYNC_QUEUE_DROP_OLDEST) {
@@ -147,95 +314,161 @@ bool async_queue_enqueue(async_queue_t* queue, const void* data, size_t size) {
             continue;
         } else {
             /* Queue full, fail immediately */
+            queue->full_count++;
             platform_mutex_unlock(&queue->mutex);
             return false;
         }
     }
-    
-    /* Write message to slot (length + data) */
-    void* slot = get_slot(queue, queue->head);
-    *(size_t*)slot = size;
-    memcpy((char*)slot + sizeof(size_t), data, size);
-    
+
+    /* Write message to slot (header + data) */
+    slot_header_t* slot = (slot_header_t*)get_slot(queue, queue->head);
+    slot->size = size;
+    slot->enqueued_usec = platform_monotonic_usec();
+    memcpy(slot + 1, data, size);
+
     queue->head = (queue->head + 1) % queue->capacity;
     queue->count++;
     queue->enqueue_count++;
-    
+
     /* Signal not_empty if configured */
     if (queue->flags & ASYNC_QUEUE_SIGNAL_ON_DATA) {
         platform_event_set(&queue->not_empty);
     }
-    
+
     platform_mutex_unlock(&queue->mutex);
-    
+
     return true;
 }
 
-bool async_queue_dequeue(async_queue_t* queue, void* buffer, size_t buffer_size, size_t* out_size) {
-    if (!queue || !buffer) {
-        return false;
-    }
-    
-    platform_mutex_lock(&queue->mutex);
-    
+/* Internal helper: take the message at the tail; the mutex is held */
+static bool dequeue_locked(async_queue_t* queue, void* buffer, size_t buffer_size, size_t* out_size) {
     if (queue->count == 0) {
-        platform_mutex_unlock(&queue->mutex);
         return false;
     }
-    
+
     /* Read message from slot */
-    void* slot = get_slot(queue, queue->tail);
-    size_t msg_size = *(size_t*)slot;
-    
-    if (msg_size > buffer_size) {
+    slot_header_t* slot = (slot_header_t*)get_slot(queue, queue->tail);
+
+    if (slot->size > buffer_size) {
         /* Buffer too small */
-        platform_mutex_unlock(&queue->mutex);
         return false;
     }
-    
-    memcpy(buffer, (char*)slot + sizeof(size_t), msg_size);
-    
+
+    memcpy(buffer, slot + 1, slot->size);
+
     if (out_size) {
-        *out_size = msg_size;
+        *out_size = slot->size;
     }
-    
+    record_latency(queue, slot->enqueued_usec);
+
     queue->tail = (queue->tail + 1) % queue->capacity;
     queue->count--;
     queue->dequeue_count++;
-    
+    return true;
+}
+
+bool async_queue_dequeue(async_queue_t* queue, void* buffer, size_t buffer_size, size_t* out_size) {
+    bool dequeued;
+
+    if (!queue || !buffer) {
+        return false;
+    }
+    if (queue->slots) {
+        return mpsc_dequeue(queue, buffer, buffer_size, out_size);
+    }
+
+    lock_queue(queue);
+    dequeued = dequeue_locked(queue, buffer, buffer_size, out_size);
+
     /* Signal not_full if configured */
-    if (queue->flags & ASYNC_QUEUE_BLOCK_WRITER) {
+    if (dequeued && (queue->flags & ASYNC_QUEUE_BLOCK_WRITER)) {
         platform_event_set(&queue->not_full);
     }
-    
+
     platform_mutex_unlock(&queue->mutex);
-    
+
+    return dequeued;
+}
+
+size_t async_queue_dequeue_batch(async_queue_t* queue, void* buffer, size_t stride, size_t max_count, size_t* sizes) {
+    size_t n = 0;
+
+    if (!queue || !buffer || !sizes) {
+        return 0;
+    }
+    if (queue->slots) {
+        while (n < max_count && mpsc_dequeue(queue, (char*)buffer + n * stride, stride, &sizes[n]))
+            n++;
+        return n;
+    }
+
+    lock_queue(queue);
+    while (n < max_count && dequeue_locked(queue, (char*)buffer + n * stride, stride, &sizes[n]))
+        n++;
+    if (n > 0 && (queue->flags & ASYNC_QUEUE_BLOCK_WRITER)) {
+        platform_event_set(&queue->not_full);
+    }
+    platform_mutex_unlock(&queue->mutex);
+    return n;
+}
+
+bool async_queue_batch_next(async_queue_t* queue, async_queue_batch_t* batch, void** msg, size_t* size) {
+    if (batch->next == batch->count) {
+        batch->next = 0;
+        batch->count = async_queue_dequeue_batch(queue, batch->buffer, batch->stride, batch->max_count, batch->sizes);
+        if (batch->count == 0)
+            return false;
+    }
+    *msg = (char*)batch->buffer + batch->next * batch->stride;
+    if (size)
+        *size = batch->sizes[batch->next];
+    batch->next++;
     return true;
 }
 
+void async_queue_batch_reset(async_queue_batch_t* batch) {
+    batch->count = 0;
+    batch->next = 0;
+}
+
 bool async_queue_is_empty(const async_queue_t* queue) {
     if (!queue) return true;
-    
+    if (queue->slots) {
+        return platform_atomic_load(&queue->enqueue_pos) == queue->dequeue_pos;
+    }
+
     platform_mutex_lock((platform_mutex_t*)&queue->mutex);
     bool empty = (queue->count == 0);
     platform_mutex_unlock((platform_mutex_t*)&queue->mutex);
-    
+
     return empty;
 }
 
 bool async_queue_is_full(const async_queue_t* queue) {
     if (!queue) return false;
-    
+    if (queue->slots) {
+        return platform_atomic_load(&queue->enqueue_pos) - queue->dequeue_pos >= queue->capacity;
+    }
+
     platform_mutex_lock((platform_mutex_t*)&queue->mutex);
     bool full = (queue->count >= queue->capacity);
     platform_mutex_unlock((platform_mutex_t*)&queue->mutex);
-    
+
     return full;
 }
 
 void async_queue_clear(async_queue_t* queue) {
     if (!queue) return;
-    
+    if (queue->slots) {
+        mpsc_slot_t* slot;
+
+        /* a consumer operation: release what has been published */
+        while ((slot = mpsc_peek(queue)) != NULL) {
+            mpsc_release(queue, slot);
+        }
+        return;
+    }
+
     platform_mutex_lock(&queue->mutex);
     queue->head = 0;
     queue->tail = 0;
@@ -245,7 +478,22 @@ void async_queue_clear(async_queue_t* queue) {
 
 void async_queue_get_stats(const async_queue_t* queue, async_queue_stats_t* stats) {
     if (!queue || !stats) return;
-    
+
+    if (queue->slots) {
+        /* producer counters are read without stopping the producers */
+        stats->capacity = queue->capacity;
+        stats->current_size = platform_atomic_load(&queue->enqueue_pos) - queue->dequeue_pos;
+        stats->max_msg_size = queue->max_msg_size;
+        stats->enqueue_count = platform_atomic_load(&queue->mpsc_enqueued);
+        stats->dequeue_count = queue->dequeue_count;
+        stats->dropped_count = 0;
+        stats->full_count = platform_atomic_load(&queue->mpsc_full);
+        stats->contended_count = platform_atomic_load(&queue->mpsc_contended);
+        stats->latency_total_usec = queue->latency_total_usec;
+        stats->latency_max_usec = queue->latency_max_usec;
+        return;
+    }
+
     platform_mutex_lock((platform_mutex_t*)&queue->mutex);
     stats->capacity = queue->capacity;
     stats->current_size = queue->count;
@@ -253,5 +501,9 @@ void async_queue_get_stats(const async_queue_t* queue, async_queue_stats_t* stat
     stats->enqueue_count = queue->enqueue_count;
     stats->dequeue_count = queue->dequeue_count;
     stats->dropped_count = queue->dropped_count;
+    stats->full_count = queue->full_count;
+    stats->contended_count = queue->contended_count;
+    stats->latency_total_usec = queue->latency_total_usec;
+    stats->latency_max_usec = queue->latency_max_usec;
     platform_mutex_unlock((platform_mutex_t*)&queue->mutex);
 }
@@ -1,12 +1,19 @@
 /**
  * @file async_queue.h
  * @brief Thread-safe FIFO message queue for async communication
+ *
+ * By default the queue is protected by a mutex and serves any number of
+ * producers and consumers. With ASYNC_QUEUE_MPSC it is lock-free for any
+ * number of producers and exactly one consumer, which suits result queues
+ * that worker threads fill and the main thread drains.
  */
 
 #ifndef ASYNC_QUEUE_H
 #define ASYNC_QUEUE_H
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -20,9 +27,16 @@ typedef struct async_queue_s async_queue_t;
 typedef enum {
     ASYNC_QUEUE_DROP_OLDEST = 0x01,    /**< Drop oldest message when full */
     ASYNC_QUEUE_BLOCK_WRITER = 0x02,   /**< Block enqueue until space available */
-    ASYNC_QUEUE_SIGNAL_ON_DATA = 0x04  /**< Signal event when data enqueued */
+    ASYNC_QUEUE_SIGNAL_ON_DATA = 0x04, /**< Signal event when data enqueued */
+    ASYNC_QUEUE_MPSC = 0x08            /**< Lock-free, many producers and a single consumer */
 } async_queue_flags_t;
 
+/**
+ * Messages up to this size are stored inside an ASYNC_QUEUE_MPSC slot;
+ * larger ones are allocated by the producer and freed by the consumer.
+ */
+#define ASYNC_QUEUE_INLINE_SIZE 64
+
 /**
  * Queue statistics
  */
@@ -33,14 +47,20 @@ typedef struct {
     uint64_t enqueue_count;    /**< Total messages enqueued */
     uint64_t dequeue_count;    /**< Total messages dequeued */
     uint64_t dropped_count;    /**< Messages dropped (when DROP_OLDEST) */
+    uint64_t full_count;       /**< Enqueues refused because the queue was full */
+    uint64_t contended_count;  /**< Enqueues or dequeues that found another thread in the way */
+    uint64_t latency_total_usec; /**< Sum of the times dequeued messages spent queued */
+    uint64_t latency_max_usec; /**< Longest time a dequeued message spent queued */
 } async_queue_stats_t;
 
 /**
  * Create a new message queue
  * 
- * @param capacity Maximum number of messages (should be power of 2 for best performance)
+ * @param capacity Maximum number of messages (should be power of 2 for best performance;
+ *   ASYNC_QUEUE_MPSC rounds it up to one)
  * @param max_msg_size Maximum size of each message in bytes
- * @param flags Queue behavior flags
+ * @param flags Queue behavior flags. ASYNC_QUEUE_MPSC cannot be combined with
+ *   ASYNC_QUEUE_DROP_OLDEST or ASYNC_QUEUE_BLOCK_WRITER.
  * @returns Pointer to queue, or NULL on failure
  */
 async_queue_t* async_queue_create(size_t capacity, size_t max_msg_size, async_queue_flags_t flags);
@@ -73,6 +93,59 @@ bool async_queue_enqueue(async_queue_t* queue, const void* data, size_t size);
  */
 bool async_queue_dequeue(async_queue_t* queue, void* buffer, size_t buffer_size, size_t* out_size);
 
+/**
+ * Dequeue up to @p max_count messages at once (non-blocking)
+ *
+ * The mutex-protected queue is locked once for the whole batch. Message i
+ * is copied to @p buffer + i * @p stride. The batch ends early at a message
+ * larger than @p stride, which stays queued.
+ *
+ * @param queue Queue to dequeue from
+ * @param buffer Array of @p max_count buffers of @p stride bytes each
+ * @param stride Size of each buffer
+ * @param max_count Maximum number of messages to dequeue
+ * @param sizes Output: array of @p max_count message sizes
+ * @returns Number of messages dequeued
+ */
+size_t async_queue_dequeue_batch(async_queue_t* queue, void* buffer, size_t stride, size_t max_count, size_t* sizes);
+
+/**
+ * Consumer-side cursor that dequeues messages a batch at a time
+ *
+ * Messages are handed out one by one. A message handed out is no longer
+ * held by the cursor, so a consumer interrupted by an error goes on with the
+ * next one, as it would with async_queue_dequeue(). Set it up with
+ * ASYNC_QUEUE_BATCH_INIT.
+ */
+typedef struct {
+    void* buffer;              /**< @ref max_count buffers of @ref stride bytes */
+    size_t* sizes;             /**< @ref max_count message sizes */
+    size_t stride;
+    size_t max_count;
+    size_t count;              /**< Messages in the buffer */
+    size_t next;               /**< Next message to hand out */
+} async_queue_batch_t;
+
+/** Initializer of a cursor over an array of buffers and an array of sizes */
+#define ASYNC_QUEUE_BATCH_INIT(buffers, sizes, max_count) \
+    { (buffers), (sizes), sizeof((buffers)[0]), (max_count), 0, 0 }
+
+/**
+ * Take the next message, dequeuing a new batch when the cursor is empty
+ *
+ * @param queue Queue to dequeue from
+ * @param batch Cursor used only with this queue
+ * @param msg Output: the message, valid until the next call
+ * @param size Output (may be NULL): size of the message
+ * @returns false if there are no messages
+ */
+bool async_queue_batch_next(async_queue_t* queue, async_queue_batch_t* batch, void** msg, size_t* size);
+
+/**
+ * Drop the messages left in a cursor, when its queue is destroyed or cleared
+ */
+void async_queue_batch_reset(async_queue_batch_t* batch);
+
 /**
  * Check if queue is empty
  * 
@@ -91,6 +164,8 @@ bool async_queue_is_full(const async_queue_t* queue);
 
 /**
  * Clear all messages from queue
+ *
+ * For ASYNC_QUEUE_MPSC this is a consumer operation.
  * 
  * @param queue Queue to clear
  */
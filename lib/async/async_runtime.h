@@ -11,6 +11,10 @@
  *   - Worker calls accept() and posts completed FD to IOCP
  * - Linux: async_runtime_epoll.c (using epoll + eventfd for completions)
  *   - Traditional readiness notification for listening sockets
+ * - Linux with NEOLITH_USE_IO_URING: async_runtime_uring.c (using io_uring)
+ *   - Multishot accept for sockets registered with EVENT_ACCEPT
+ *   - Multishot recv into provided buffers for sockets registered with
+ *     EVENT_RECV_DATA
  * - Fallback: async_runtime_poll.c (using poll + pipe for completions)
  *   - Traditional readiness notification for listening sockets
  *
@@ -31,6 +35,12 @@ extern "C" {
 #define EVENT_WRITE  0x02  /**< Socket/fd is writable */
 #define EVENT_ERROR  0x04  /**< Error occurred on socket/fd */
 #define EVENT_CLOSE  0x08  /**< Connection closed (EOF or remote shutdown) */
+#define EVENT_ACCEPTED 0x10  /**< fd is a connection already accepted on the listening socket */
+
+/* Registration hints for async_runtime_add(), ignored by backends that do
+ * not support them. */
+#define EVENT_ACCEPT    0x100  /**< Listening socket: accept in the runtime, report EVENT_ACCEPTED */
+#define EVENT_RECV_DATA 0x200  /**< Connected socket: read in the runtime, report data in buffer */
 
 /**
  * Event structure returned by async_runtime_wait()
@@ -42,6 +52,12 @@ extern "C" {
  * - fd contains the ACCEPTED socket FD (not the listening socket)
  * - context points to the listening port_def_t structure
  * - Accept worker has already called accept() before posting completion
+ *
+ * With io_uring, EVENT_ACCEPTED marks the same case for listening sockets
+ * registered with EVENT_ACCEPT. A read event of a socket registered with
+ * EVENT_RECV_DATA carries the received data in buffer, which stays valid
+ * until the next async_runtime_wait() call; a read event without a buffer
+ * means the caller should recv() itself (end of stream).
  */
 typedef struct {
     socket_fd_t fd;              /**< File descriptor; on Windows may be accepted socket from accept worker */
@@ -111,7 +127,8 @@ void async_runtime_deinit(async_runtime_t* runtime);
  * 
  * @param runtime Runtime instance
  * @param fd File descriptor or socket to monitor
- * @param events Bitmask of EVENT_READ and/or EVENT_WRITE
+ * @param events Bitmask of EVENT_READ and/or EVENT_WRITE, plus the optional
+ *        EVENT_ACCEPT or EVENT_RECV_DATA hint
  * @param context User-supplied context pointer (returned in io_event_t.context)
  * @returns 0 on success, -1 on failure
  */
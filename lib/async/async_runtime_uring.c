@@ -0,0 +1,730 @@
+/**
+ * @file async_runtime_uring.c
+ * @brief Linux io_uring-based async runtime implementation
+ *
+ * Uses one io_uring instance for all I/O sources (requires Linux 6.0 or
+ * later). The ring is driven through the raw system calls, so liburing is
+ * not needed.
+ *
+ * - Plain registrations use one-shot poll requests that are re-armed at the
+ *   next async_runtime_wait(), which gives the same level-triggered
+ *   semantics as the epoll backend.
+ * - Listening sockets registered with EVENT_ACCEPT use a multishot accept;
+ *   each accepted connection is reported with EVENT_ACCEPTED.
+ * - Sockets registered with EVENT_RECV_DATA use a multishot recv that picks
+ *   its buffers from a ring of provided buffers; each completion is
+ *   reported with the data in io_event_t.buffer.
+ * - Worker completions are written to an eventfd polled through the ring,
+ *   and decoded exactly like the epoll backend does.
+ *
+ * All requests queued between two waits are submitted by the single
+ * io_uring_enter() call that also waits for completions.
+ */
+
+#if defined(__linux__)
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#define NO_STEM
+#include "src/std.h"
+
+#include <linux/io_uring.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+
+#include "async/async_runtime.h"
+
+#define RING_ENTRIES        256
+#define RECV_BUFFER_COUNT   256     /* power of two, required by the buffer ring */
+#define RECV_BUFFER_SIZE    2048    /* MAX_TEXT: one read of get_user_data() */
+#define RECV_BUFFER_GROUP   1
+
+/* user_data layout: generation (32 bits) | fd (28 bits) | op (4 bits) */
+#define OP_INTERNAL     0   /* cancel requests; completions are ignored */
+#define OP_POLL_IN      1
+#define OP_POLL_OUT     2
+#define OP_RECV         3
+#define OP_ACCEPT       4
+#define OP_WAKE         5
+
+#define MAKE_USER_DATA(gen, fd, op) \
+    (((uint64_t)(gen) << 32) | ((uint64_t)(uint32_t)(fd) << 4) | (uint64_t)(op))
+#define USER_DATA_GEN(ud)   ((uint32_t)((ud) >> 32))
+#define USER_DATA_FD(ud)    ((int)(((ud) >> 4) & 0x0FFFFFFF))
+#define USER_DATA_OP(ud)    ((int)((ud) & 0x0F))
+
+/* How the read side of a registration is served */
+#define KIND_POLL       0
+#define KIND_RECV       1
+#define KIND_ACCEPT     2
+
+typedef struct {
+    void* context;
+    uint32_t interest;          /* EVENT_READ / EVENT_WRITE */
+    uint32_t generation;        /* bumped on every add/remove */
+    unsigned char registered;
+    unsigned char kind;
+    unsigned char read_armed;
+    unsigned char write_armed;
+    unsigned char read_done;    /* multishot recv saw EOF or an error */
+    unsigned char pending;      /* queued in arm_list */
+} uring_fd_t;
+
+struct async_runtime_s {
+    int ring_fd;
+    int event_fd;  /* For worker completions */
+    console_type_t console_type;  /* Detected console type */
+
+    /* submission queue */
+    void* sq_ptr;
+    size_t sq_map_size;
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned* sq_mask;
+    unsigned* sq_array;
+    struct io_uring_sqe* sqes;
+    size_t sqes_map_size;
+    unsigned sq_entries;
+    unsigned sqe_tail;          /* local tail, published on submit */
+
+    /* completion queue */
+    void* cq_ptr;
+    size_t cq_map_size;
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned* cq_mask;
+    struct io_uring_cqe* cqes;
+
+    /* provided receive buffers */
+    struct io_uring_buf_ring* buf_ring;
+    size_t buf_ring_size;
+    char* buffers;
+    unsigned short buf_tail;
+    unsigned short* lent;       /* buffer ids handed out by the last wait */
+    int num_lent;
+
+    /* registrations, indexed by fd */
+    uring_fd_t* fds;
+    int max_fds;
+    int* arm_list;              /* fds whose requests need (re)arming */
+    int num_arm;
+    int wake_armed;
+};
+
+/* Raw system calls */
+
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params* p) {
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete,
+                              unsigned flags, const void* arg, size_t argsz) {
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, argsz);
+}
+
+static int sys_io_uring_register(int fd, unsigned opcode, const void* arg, unsigned nr_args) {
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+/* Helper functions */
+
+static unsigned sq_pending(async_runtime_t* runtime) {
+    return runtime->sqe_tail - __atomic_load_n(runtime->sq_head, __ATOMIC_ACQUIRE);
+}
+
+static int submit_pending(async_runtime_t* runtime, unsigned min_complete,
+                          unsigned flags, const void* arg, size_t argsz) {
+    __atomic_store_n(runtime->sq_tail, runtime->sqe_tail, __ATOMIC_RELEASE);
+    return sys_io_uring_enter(runtime->ring_fd, sq_pending(runtime), min_complete,
+                              flags, arg, argsz);
+}
+
+/* Get a cleared SQE, submitting what is queued when the queue is full. */
+static struct io_uring_sqe* get_sqe(async_runtime_t* runtime) {
+    struct io_uring_sqe* sqe;
+    unsigned idx;
+
+    if (sq_pending(runtime) >= runtime->sq_entries) {
+        submit_pending(runtime, 0, 0, NULL, 0);
+        if (sq_pending(runtime) >= runtime->sq_entries)
+            return NULL;
+    }
+    idx = runtime->sqe_tail & *runtime->sq_mask;
+    sqe = &runtime->sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    runtime->sq_array[idx] = idx;
+    runtime->sqe_tail++;
+    return sqe;
+}
+
+static int reserve_fd(async_runtime_t* runtime, int fd) {
+    if (fd >= 0x0FFFFFFF) return -1;
+    if (fd >= runtime->max_fds) {
+        int n = runtime->max_fds ? runtime->max_fds : 64;
+        uring_fd_t* fds;
+        int* arm_list;
+
+        while (n <= fd) n *= 2;
+        fds = realloc(runtime->fds, n * sizeof(uring_fd_t));
+        if (!fds) return -1;
+        memset(fds + runtime->max_fds, 0, (n - runtime->max_fds) * sizeof(uring_fd_t));
+        runtime->fds = fds;
+        runtime->max_fds = n;
+
+        arm_list = realloc(runtime->arm_list, n * sizeof(int));
+        if (!arm_list) return -1;
+        runtime->arm_list = arm_list;
+    }
+    return 0;
+}
+
+static void queue_arm(async_runtime_t* runtime, int fd) {
+    uring_fd_t* f = &runtime->fds[fd];
+
+    if (f->pending) return;
+    f->pending = 1;
+    runtime->arm_list[runtime->num_arm++] = fd;
+}
+
+static void recycle_buffer(async_runtime_t* runtime, unsigned short bid) {
+    struct io_uring_buf* buf;
+
+    buf = &runtime->buf_ring->bufs[runtime->buf_tail & (RECV_BUFFER_COUNT - 1)];
+    /* the ring tail overlays bufs[0].resv, so only these fields are written */
+    buf->addr = (uint64_t)(uintptr_t)(runtime->buffers + (size_t)bid * RECV_BUFFER_SIZE);
+    buf->len = RECV_BUFFER_SIZE;
+    buf->bid = bid;
+    runtime->buf_tail++;
+}
+
+static void publish_buffers(async_runtime_t* runtime) {
+    __atomic_store_n(&runtime->buf_ring->tail, runtime->buf_tail, __ATOMIC_RELEASE);
+}
+
+static int cancel_request(async_runtime_t* runtime, uint64_t user_data) {
+    struct io_uring_sqe* sqe = get_sqe(runtime);
+
+    if (!sqe) return -1;
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = user_data;
+    sqe->user_data = MAKE_USER_DATA(0, 0, OP_INTERNAL);
+    return 0;
+}
+
+static int arm_poll(async_runtime_t* runtime, int fd, int op, unsigned mask) {
+    struct io_uring_sqe* sqe = get_sqe(runtime);
+
+    if (!sqe) return -1;
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = mask;
+    sqe->user_data = MAKE_USER_DATA(runtime->fds[fd].generation, fd, op);
+    return 0;
+}
+
+static int arm_recv(async_runtime_t* runtime, int fd) {
+    struct io_uring_sqe* sqe = get_sqe(runtime);
+
+    if (!sqe) return -1;
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = RECV_BUFFER_GROUP;
+    sqe->user_data = MAKE_USER_DATA(runtime->fds[fd].generation, fd, OP_RECV);
+    return 0;
+}
+
+static int arm_accept(async_runtime_t* runtime, int fd) {
+    struct io_uring_sqe* sqe = get_sqe(runtime);
+
+    if (!sqe) return -1;
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    sqe->user_data = MAKE_USER_DATA(runtime->fds[fd].generation, fd, OP_ACCEPT);
+    return 0;
+}
+
+/* Queue the requests missing for one registration. Returns -1 when the
+ * submission queue is full. */
+static int arm_fd(async_runtime_t* runtime, int fd) {
+    uring_fd_t* f = &runtime->fds[fd];
+
+    if (!f->registered) return 0;
+    if ((f->interest & EVENT_READ) && !f->read_armed && !f->read_done) {
+        int r;
+        switch (f->kind) {
+        case KIND_RECV:   r = arm_recv(runtime, fd); break;
+        case KIND_ACCEPT: r = arm_accept(runtime, fd); break;
+        default:          r = arm_poll(runtime, fd, OP_POLL_IN, POLLIN); break;
+        }
+        if (r < 0) return -1;
+        f->read_armed = 1;
+    }
+    if ((f->interest & EVENT_WRITE) && !f->write_armed) {
+        if (arm_poll(runtime, fd, OP_POLL_OUT, POLLOUT) < 0) return -1;
+        f->write_armed = 1;
+    }
+    return 0;
+}
+
+/* Return the buffers lent by the previous wait and queue pending requests. */
+static void prepare_wait(async_runtime_t* runtime) {
+    int i;
+
+    if (runtime->num_lent > 0) {
+        for (i = 0; i < runtime->num_lent; i++)
+            recycle_buffer(runtime, runtime->lent[i]);
+        runtime->num_lent = 0;
+        publish_buffers(runtime);
+    }
+
+    if (!runtime->wake_armed) {
+        struct io_uring_sqe* sqe = get_sqe(runtime);
+        if (sqe) {
+            sqe->opcode = IORING_OP_POLL_ADD;
+            sqe->fd = runtime->event_fd;
+            sqe->poll32_events = POLLIN;
+            sqe->user_data = MAKE_USER_DATA(0, 0, OP_WAKE);
+            runtime->wake_armed = 1;
+        }
+    }
+
+    for (i = 0; i < runtime->num_arm; i++) {
+        int fd = runtime->arm_list[i];
+        if (arm_fd(runtime, fd) < 0)
+            break;
+        runtime->fds[fd].pending = 0;
+    }
+    if (i > 0) {
+        runtime->num_arm -= i;
+        memmove(runtime->arm_list, runtime->arm_list + i, runtime->num_arm * sizeof(int));
+    }
+}
+
+static uint32_t poll_to_events(int revents) {
+    uint32_t events = 0;
+    if (revents & POLLIN) events |= EVENT_READ;
+    if (revents & POLLOUT) events |= EVENT_WRITE;
+    if (revents & POLLERR) events |= EVENT_ERROR;
+    if (revents & POLLHUP) events |= EVENT_CLOSE;
+    return events;
+}
+
+static void set_event(io_event_t* evt, int fd, void* context, uint32_t event_type) {
+    evt->fd = fd;
+    evt->completion_key = 0;
+    evt->context = context;
+    evt->event_type = event_type;
+    evt->bytes_transferred = 0;
+    evt->buffer = NULL;
+}
+
+/* Turn one completion into at most max_events events. */
+static int handle_cqe(async_runtime_t* runtime, const struct io_uring_cqe* cqe,
+                      io_event_t* events, int max_events) {
+    uint64_t ud = cqe->user_data;
+    int op = USER_DATA_OP(ud);
+    int fd = USER_DATA_FD(ud);
+    int more = (cqe->flags & IORING_CQE_F_MORE) != 0;
+    uring_fd_t* f;
+
+    if (op == OP_WAKE) {
+        /* Drain eventfd and decode worker completions; what does not fit
+         * stays in the eventfd and wakes the next wait at once. */
+        int event_count = 0;
+        uint64_t val;
+
+        runtime->wake_armed = 0;
+        while (event_count < max_events
+               && read(runtime->event_fd, &val, sizeof(val)) == sizeof(val)) {
+            events[event_count].fd = -1;
+            events[event_count].completion_key = (uintptr_t)(val >> 32);
+            events[event_count].context = NULL;
+            events[event_count].event_type = EVENT_READ;
+            events[event_count].bytes_transferred = (int)(val & 0xFFFFFFFF);
+            events[event_count].buffer = NULL;
+            event_count++;
+        }
+        return event_count;
+    }
+    if (op == OP_INTERNAL)
+        return 0;
+
+    if (fd >= runtime->max_fds || !runtime->fds[fd].registered
+        || runtime->fds[fd].generation != USER_DATA_GEN(ud)) {
+        /* completion of a removed registration */
+        if (cqe->flags & IORING_CQE_F_BUFFER)
+            runtime->lent[runtime->num_lent++] = (unsigned short)(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+        if (op == OP_ACCEPT && cqe->res >= 0)
+            close(cqe->res);
+        return 0;
+    }
+    f = &runtime->fds[fd];
+
+    switch (op) {
+    case OP_POLL_IN:
+    case OP_POLL_OUT:
+        if (op == OP_POLL_IN) f->read_armed = 0; else f->write_armed = 0;
+        queue_arm(runtime, fd);
+        if (cqe->res < 0) {
+            if (cqe->res == -ECANCELED) return 0;
+            set_event(&events[0], fd, f->context, EVENT_ERROR);
+            return 1;
+        }
+        /* interest may have been dropped while the poll was armed */
+        if (!(f->interest & (op == OP_POLL_IN ? EVENT_READ : EVENT_WRITE))
+            && !(cqe->res & (POLLERR | POLLHUP)))
+            return 0;
+        set_event(&events[0], fd, f->context, poll_to_events(cqe->res));
+        return 1;
+
+    case OP_ACCEPT:
+        if (!more) {
+            f->read_armed = 0;
+            queue_arm(runtime, fd);
+        }
+        if (cqe->res < 0) {
+            if (cqe->res == -ECANCELED || cqe->res == -EAGAIN) return 0;
+            set_event(&events[0], fd, f->context, EVENT_ERROR);
+            return 1;
+        }
+        set_event(&events[0], cqe->res, f->context, EVENT_READ | EVENT_ACCEPTED);
+        return 1;
+
+    case OP_RECV:
+        if (!more) {
+            f->read_armed = 0;
+            queue_arm(runtime, fd);
+        }
+        if (cqe->res > 0) {
+            unsigned short bid = (unsigned short)(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+
+            runtime->lent[runtime->num_lent++] = bid;
+            set_event(&events[0], fd, f->context, EVENT_READ);
+            events[0].buffer = runtime->buffers + (size_t)bid * RECV_BUFFER_SIZE;
+            events[0].bytes_transferred = (size_t)cqe->res;
+            return 1;
+        }
+        if (cqe->res == -ENOBUFS || cqe->res == -ECANCELED)
+            return 0;  /* re-armed once buffers are returned */
+        /* EOF (no buffer): the consumer's own recv() sees the end of stream */
+        f->read_done = 1;
+        set_event(&events[0], fd, f->context, cqe->res == 0 ? EVENT_READ : EVENT_ERROR);
+        return 1;
+    }
+    return 0;
+}
+
+/* Public API */
+
+async_runtime_t* async_runtime_init(void) {
+    struct io_uring_params params;
+    struct io_uring_buf_reg reg;
+    async_runtime_t* runtime = calloc(1, sizeof(async_runtime_t));
+    int i;
+
+    if (!runtime) return NULL;
+    runtime->ring_fd = -1;
+    runtime->event_fd = -1;
+
+    memset(&params, 0, sizeof(params));
+    runtime->ring_fd = sys_io_uring_setup(RING_ENTRIES, &params);
+    if (runtime->ring_fd < 0)
+        goto fail;
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_EXT_ARG))
+        goto fail;
+
+    /* SQ and CQ rings share one mapping */
+    runtime->sq_map_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    runtime->cq_map_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (runtime->cq_map_size > runtime->sq_map_size)
+        runtime->sq_map_size = runtime->cq_map_size;
+    runtime->sq_ptr = mmap(NULL, runtime->sq_map_size, PROT_READ | PROT_WRITE,
+                           MAP_SHARED | MAP_POPULATE, runtime->ring_fd, IORING_OFF_SQ_RING);
+    if (runtime->sq_ptr == MAP_FAILED) {
+        runtime->sq_ptr = NULL;
+        goto fail;
+    }
+    runtime->cq_ptr = runtime->sq_ptr;
+    runtime->sqes_map_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    runtime->sqes = mmap(NULL, runtime->sqes_map_size, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, runtime->ring_fd, IORING_OFF_SQES);
+    if (runtime->sqes == MAP_FAILED) {
+        runtime->sqes = NULL;
+        goto fail;
+    }
+
+    runtime->sq_head = (unsigned*)((char*)runtime->sq_ptr + params.sq_off.head);
+    runtime->sq_tail = (unsigned*)((char*)runtime->sq_ptr + params.sq_off.tail);
+    runtime->sq_mask = (unsigned*)((char*)runtime->sq_ptr + params.sq_off.ring_mask);
+    runtime->sq_array = (unsigned*)((char*)runtime->sq_ptr + params.sq_off.array);
+    runtime->sq_entries = params.sq_entries;
+    runtime->sqe_tail = *runtime->sq_tail;
+    runtime->cq_head = (unsigned*)((char*)runtime->cq_ptr + params.cq_off.head);
+    runtime->cq_tail = (unsigned*)((char*)runtime->cq_ptr + params.cq_off.tail);
+    runtime->cq_mask = (unsigned*)((char*)runtime->cq_ptr + params.cq_off.ring_mask);
+    runtime->cqes = (struct io_uring_cqe*)((char*)runtime->cq_ptr + params.cq_off.cqes);
+
+    /* Register the provided buffer ring for multishot recv */
+    runtime->buf_ring_size = RECV_BUFFER_COUNT * sizeof(struct io_uring_buf);
+    runtime->buf_ring = mmap(NULL, runtime->buf_ring_size, PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (runtime->buf_ring == MAP_FAILED) {
+        runtime->buf_ring = NULL;
+        goto fail;
+    }
+    runtime->buffers = malloc((size_t)RECV_BUFFER_COUNT * RECV_BUFFER_SIZE);
+    runtime->lent = malloc(RECV_BUFFER_COUNT * sizeof(unsigned short));
+    if (!runtime->buffers || !runtime->lent)
+        goto fail;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)runtime->buf_ring;
+    reg.ring_entries = RECV_BUFFER_COUNT;
+    reg.bgid = RECV_BUFFER_GROUP;
+    if (sys_io_uring_register(runtime->ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+        goto fail;
+    for (i = 0; i < RECV_BUFFER_COUNT; i++)
+        recycle_buffer(runtime, (unsigned short)i);
+    publish_buffers(runtime);
+
+    /* Create eventfd for worker notifications */
+    runtime->event_fd = eventfd(0, EFD_NONBLOCK);
+    if (runtime->event_fd < 0)
+        goto fail;
+
+    return runtime;
+
+fail:
+    async_runtime_deinit(runtime);
+    return NULL;
+}
+
+void async_runtime_deinit(async_runtime_t* runtime) {
+    if (!runtime) return;
+
+    /* Close connections accepted but never picked up by async_runtime_wait() */
+    if (runtime->cqes) {
+        unsigned head = *runtime->cq_head;
+        unsigned tail = __atomic_load_n(runtime->cq_tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++) {
+            const struct io_uring_cqe* cqe = &runtime->cqes[head & *runtime->cq_mask];
+            if (USER_DATA_OP(cqe->user_data) == OP_ACCEPT && cqe->res >= 0)
+                close(cqe->res);
+        }
+    }
+
+    if (runtime->event_fd >= 0) {
+        close(runtime->event_fd);
+    }
+
+    if (runtime->ring_fd >= 0) {
+        close(runtime->ring_fd);
+    }
+    if (runtime->sqes) munmap(runtime->sqes, runtime->sqes_map_size);
+    if (runtime->sq_ptr) munmap(runtime->sq_ptr, runtime->sq_map_size);
+    if (runtime->buf_ring) munmap(runtime->buf_ring, runtime->buf_ring_size);
+
+    free(runtime->buffers);
+    free(runtime->lent);
+    free(runtime->fds);
+    free(runtime->arm_list);
+    free(runtime);
+}
+
+int async_runtime_add(async_runtime_t* runtime, socket_fd_t fd, uint32_t events, void* context) {
+    uring_fd_t* f;
+
+    if (!runtime || fd < 0) return -1;
+    if (reserve_fd(runtime, fd) < 0) return -1;
+
+    f = &runtime->fds[fd];
+    if (f->registered) {
+        errno = EEXIST;
+        return -1;
+    }
+    f->context = context;
+    f->interest = events & (EVENT_READ | EVENT_WRITE);
+    f->registered = 1;
+    f->read_armed = f->write_armed = f->read_done = 0;
+    if (events & EVENT_ACCEPT)
+        f->kind = KIND_ACCEPT;
+    else if (events & EVENT_RECV_DATA)
+        f->kind = KIND_RECV;
+    else
+        f->kind = KIND_POLL;
+    queue_arm(runtime, fd);
+    return 0;
+}
+
+int async_runtime_modify(async_runtime_t* runtime, socket_fd_t fd, uint32_t events, void* context) {
+    uring_fd_t* f;
+
+    if (!runtime || fd < 0) return -1;
+    if (fd >= runtime->max_fds || !runtime->fds[fd].registered) {
+        errno = ENOENT;
+        return -1;
+    }
+
+    f = &runtime->fds[fd];
+    f->context = context;  /* Preserve context pointer when modifying events */
+    f->interest = events & (EVENT_READ | EVENT_WRITE);
+    /* A multishot request keeps delivering until canceled; armed polls are
+     * left to complete and their events dropped if no longer wanted. */
+    if (!(f->interest & EVENT_READ) && f->read_armed && f->kind != KIND_POLL) {
+        if (cancel_request(runtime, MAKE_USER_DATA(f->generation, fd,
+                                                   f->kind == KIND_RECV ? OP_RECV : OP_ACCEPT)) == 0)
+            f->read_armed = 0;
+    }
+    queue_arm(runtime, fd);
+    return 0;
+}
+
+int async_runtime_remove(async_runtime_t* runtime, socket_fd_t fd) {
+    uring_fd_t* f;
+
+    if (!runtime || fd < 0) return -1;
+    if (fd >= runtime->max_fds || !runtime->fds[fd].registered) {
+        errno = ENOENT;
+        return -1;
+    }
+
+    /* Armed requests hold a reference to the socket, so they are canceled
+     * for the socket to be really closed. */
+    f = &runtime->fds[fd];
+    if (f->read_armed) {
+        int op = f->kind == KIND_RECV ? OP_RECV : f->kind == KIND_ACCEPT ? OP_ACCEPT : OP_POLL_IN;
+        cancel_request(runtime, MAKE_USER_DATA(f->generation, fd, op));
+    }
+    if (f->write_armed)
+        cancel_request(runtime, MAKE_USER_DATA(f->generation, fd, OP_POLL_OUT));
+    f->registered = 0;
+    f->read_armed = f->write_armed = 0;
+    f->interest = 0;
+    f->context = NULL;
+    f->generation++;
+    return 0;
+}
+
+int async_runtime_wakeup(async_runtime_t* runtime) {
+    if (!runtime || runtime->event_fd < 0) return -1;
+
+    uint64_t val = 1;
+    ssize_t n = write(runtime->event_fd, &val, sizeof(val));
+    return (n == sizeof(val)) ? 0 : -1;
+}
+
+int async_runtime_wait(async_runtime_t* runtime, io_event_t* events,
+                       int max_events, struct timeval* timeout) {
+    if (!runtime || !events || max_events <= 0) return -1;
+
+    prepare_wait(runtime);
+
+    unsigned head = *runtime->cq_head;
+    int result;
+
+    if (head != __atomic_load_n(runtime->cq_tail, __ATOMIC_ACQUIRE)) {
+        /* Completions left over from the last call: only submit */
+        result = sq_pending(runtime) ? submit_pending(runtime, 0, 0, NULL, 0) : 0;
+    } else {
+        struct __kernel_timespec ts;
+        struct io_uring_getevents_arg arg;
+
+        memset(&arg, 0, sizeof(arg));
+        arg.sigmask_sz = _NSIG / 8;
+        if (timeout) {
+            ts.tv_sec = timeout->tv_sec;
+            ts.tv_nsec = (long long)timeout->tv_usec * 1000;
+            arg.ts = (uint64_t)(uintptr_t)&ts;
+        }
+        result = submit_pending(runtime, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG,
+                                &arg, sizeof(arg));
+    }
+    if (result < 0) {
+        /* EINTR (signal interruption) is used to wake up the event loop.
+         * Treat it as timeout so backend can check heartbeat/shutdown flags. */
+        if (errno == EINTR || errno == ETIME) return 0;
+        if (errno != EBUSY && errno != EAGAIN) return -1;
+    }
+
+    /* Completions beyond max_events stay in the ring for the next call */
+    int event_count = 0;
+    unsigned tail = __atomic_load_n(runtime->cq_tail, __ATOMIC_ACQUIRE);
+    while (head != tail && event_count < max_events) {
+        const struct io_uring_cqe* cqe = &runtime->cqes[head & *runtime->cq_mask];
+        event_count += handle_cqe(runtime, cqe, events + event_count, max_events - event_count);
+        head++;
+    }
+    __atomic_store_n(runtime->cq_head, head, __ATOMIC_RELEASE);
+
+    return event_count;
+}
+
+int async_runtime_post_completion(async_runtime_t* runtime, uintptr_t completion_key, uintptr_t data) {
+    if (!runtime || runtime->event_fd < 0) return -1;
+
+    /* Write to eventfd to complete the poll armed on the ring */
+    uint64_t val = (((uint64_t)completion_key) << 32) | (data & 0xFFFFFFFF);
+    ssize_t n = write(runtime->event_fd, &val, sizeof(val));
+
+    return (n == sizeof(val)) ? 0 : -1;
+}
+
+int async_runtime_post_read(async_runtime_t* runtime, socket_fd_t fd, void* buffer, size_t len) {
+    /* No-op: multishot recv stays armed, and event buffers are returned to
+     * the ring by the next async_runtime_wait() */
+    (void)runtime; (void)fd; (void)buffer; (void)len;
+    return 0;
+}
+
+int async_runtime_post_write(async_runtime_t* runtime, socket_fd_t fd, void* buffer, size_t len) {
+    /* No-op: output is sent by the caller on write readiness */
+    (void)runtime; (void)fd; (void)buffer; (void)len;
+    return 0;
+}
+
+int async_runtime_get_event_loop_handle(async_runtime_t* runtime) {
+    return runtime ? runtime->event_fd : -1;
+}
+
+int async_runtime_add_console(async_runtime_t* runtime, void* context) {
+    if (!runtime) return -1;
+
+    (void)context;  /* Console context not used on POSIX */
+
+    /* Detect console type using isatty() and fstat() */
+    if (isatty(STDIN_FILENO)) {
+        runtime->console_type = CONSOLE_TYPE_REAL;
+    } else {
+        struct stat st;
+        if (fstat(STDIN_FILENO, &st) == 0) {
+            if (S_ISFIFO(st.st_mode)) {
+                runtime->console_type = CONSOLE_TYPE_PIPE;
+            } else if (S_ISREG(st.st_mode)) {
+                runtime->console_type = CONSOLE_TYPE_FILE;
+            } else {
+                runtime->console_type = CONSOLE_TYPE_NONE;
+            }
+        } else {
+            runtime->console_type = CONSOLE_TYPE_NONE;
+        }
+    }
+
+    return 0;
+}
+
+console_type_t async_runtime_get_console_type(async_runtime_t* runtime) {
+    return runtime ? runtime->console_type : CONSOLE_TYPE_NONE;
+}
+
+#endif /* __linux__ */
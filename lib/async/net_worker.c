@@ -0,0 +1,732 @@
+/**
+ * @file net_worker.c
+ * @brief Network I/O thread implementation
+ *
+ * The worker thread waits on its own async runtime for socket events and for
+ * wake-ups posted by the main thread when commands are queued. Output that
+ * the socket does not take at once is kept per connection until EVENT_WRITE;
+ * the end of out-of-band output in it is remembered, so it is still sent with
+ * MSG_OOB after the output queued before it.
+ *
+ * The worker never blocks on the event queue. Input that does not fit is held
+ * by the connection, which stops reading until the main thread catches up;
+ * byte counts and close reports that do not fit wait the same way. Such
+ * connections are on the notify list, and the worker polls with a short
+ * timeout while the list is not empty. The main thread does not wait for the
+ * worker either: commands that do not fit are kept and queued later.
+ *
+ * Events are too large to be stored in the queue without an allocation each,
+ * so the worker fills them in a ring of preallocated slots and queues pointers
+ * to them. The main thread frees the slots in the same order it takes them.
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#define NO_STEM
+#include "src/std.h"
+#include "net_worker.h"
+#include "port/debug.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NET_WORKER_MAX_EVENTS   64
+#define NET_WORKER_WAKE_KEY     0x4E3702
+#define NET_COMMAND_QUEUE_SIZE  4096
+#define NET_EVENT_QUEUE_SIZE    1024
+#define NET_EVENT_BATCH_SIZE    32
+#define NET_NOTIFY_RETRY_USEC   1000
+
+typedef enum {
+    NET_CMD_ADD = 1,
+    NET_CMD_SEND,
+    NET_CMD_CLOSE
+} net_command_op_t;
+
+typedef struct {
+    net_command_op_t op;
+    net_conn_t* conn;
+    char* data;                 /* NET_CMD_SEND: malloc'd output, owned by the worker */
+    size_t length;
+    bool oob;
+} net_command_t;
+
+struct net_conn_s {
+    net_worker_t* worker;
+    void* context;
+    uint32_t serial;
+    socket_fd_t fd;
+    uint32_t interest;          /* events registered with the worker runtime, 0 if none */
+    int index;                  /* position in worker->conns */
+    bool dead;                  /* end of stream or error seen */
+    bool closed;                /* closed by the main thread, freed at the end of the cycle */
+    bool notify;                /* on worker->notify */
+    char* out;                  /* output the socket did not take yet */
+    size_t out_off;
+    size_t out_len;
+    size_t out_oob;             /* bytes of out through the end of the last out-of-band send, 0 if none */
+    char* held;                 /* input the event queue had no room for */
+    size_t held_len;
+    size_t sent_unreported;     /* bytes written but not reported yet */
+    bool close_unreported;
+    int close_error;
+};
+
+struct net_worker_s {
+    async_runtime_t* runtime;       /* the worker's own runtime */
+    async_runtime_t* main_runtime;
+    uintptr_t completion_key;
+    async_worker_t* thread;
+    async_queue_t* commands;
+    async_queue_t* events;          /* pointers into event_slots */
+    net_event_t* event_slots;
+    size_t events_posted;           /* worker: slots filled so far */
+    platform_atomic_t events_freed; /* main thread: slots given back so far */
+    net_event_t* batch_events[NET_EVENT_BATCH_SIZE]; /* main thread: dequeued, not taken yet */
+    size_t batch_sizes[NET_EVENT_BATCH_SIZE];
+    async_queue_batch_t batch;
+    platform_mutex_t wake_mutex;
+    bool wake_posted;               /* a wake-up for queued commands is pending */
+    bool main_notified;             /* a completion for queued events is pending */
+    bool events_added;              /* events were queued during this cycle */
+    net_conn_t** conns;
+    int num_conns;
+    int max_conns;
+    net_conn_t** notify;
+    int num_notify;
+    int max_notify;
+    net_conn_t** closed;
+    int num_closed;
+    int max_closed;
+    net_command_t* overflow;        /* main thread: commands the full queue did not take */
+    int num_overflow;
+    int max_overflow;
+};
+
+static uint32_t next_serial = 0;
+
+static void retry_overflow (net_worker_t* w);
+
+static bool conn_list_append (net_conn_t*** list, int* count, int* capacity, net_conn_t* conn) {
+    if (*count >= *capacity) {
+        int new_capacity = *capacity ? *capacity * 2 : 64;
+        net_conn_t** grown = (net_conn_t**)realloc(*list, new_capacity * sizeof(net_conn_t*));
+        if (!grown)
+            return false;
+        *list = grown;
+        *capacity = new_capacity;
+    }
+    (*list)[(*count)++] = conn;
+    return true;
+}
+
+static bool post_event (net_worker_t* w, net_conn_t* conn, net_event_type_t type,
+                        const char* data, size_t length, int error) {
+    net_event_t* evt;
+
+    /* every slot holds an event the main thread has not taken yet */
+    if (w->events_posted - platform_atomic_load(&w->events_freed) >= NET_EVENT_QUEUE_SIZE)
+        return false;
+    evt = &w->event_slots[w->events_posted % NET_EVENT_QUEUE_SIZE];
+    evt->context = conn->context;
+    evt->serial = conn->serial;
+    evt->type = type;
+    evt->error = error;
+    evt->length = length;
+    if (data)
+        memcpy(evt->data, data, length);
+    if (!async_queue_enqueue(w->events, &evt, sizeof(evt)))
+        return false;
+    w->events_posted++;
+    w->events_added = true;
+    return true;
+}
+
+/**
+ * Report what a connection owes the main thread, in order: held input,
+ * written bytes, then the close. Returns false if the event queue is full.
+ */
+static bool flush_reports (net_worker_t* w, net_conn_t* conn) {
+    while (conn->held_len > 0) {
+        size_t n = conn->held_len > NET_WORKER_CHUNK_SIZE ? NET_WORKER_CHUNK_SIZE : conn->held_len;
+        if (!post_event(w, conn, NET_EVENT_INPUT, conn->held, n, 0))
+            return false;
+        conn->held_len -= n;
+        memmove(conn->held, conn->held + n, conn->held_len);
+    }
+    free(conn->held);
+    conn->held = NULL;
+
+    if (conn->sent_unreported > 0) {
+        if (!post_event(w, conn, NET_EVENT_SENT, NULL, conn->sent_unreported, 0))
+            return false;
+        conn->sent_unreported = 0;
+    }
+    if (conn->close_unreported) {
+        if (!post_event(w, conn, NET_EVENT_CLOSED, NULL, 0, conn->close_error))
+            return false;
+        conn->close_unreported = false;
+    }
+    return true;
+}
+
+static void mark_notify (net_worker_t* w, net_conn_t* conn) {
+    if (conn->notify)
+        return;
+    if (conn_list_append(&w->notify, &w->num_notify, &w->max_notify, conn))
+        conn->notify = true;
+}
+
+/**
+ * Register the events a connection currently waits for: input unless it
+ * is dead or holding input back, EVENT_WRITE while output is left.
+ */
+static void update_interest (net_worker_t* w, net_conn_t* conn) {
+    uint32_t interest = 0;
+
+    if (!conn->dead && !conn->held)
+        interest |= EVENT_READ | EVENT_RECV_DATA;
+    if (!conn->dead && conn->out_len > 0)
+        interest |= EVENT_WRITE;
+    if (interest == conn->interest)
+        return;
+
+    if (!interest)
+        async_runtime_remove(w->runtime, conn->fd);
+    else if (!conn->interest) {
+        if (async_runtime_add(w->runtime, conn->fd, interest, conn) != 0) {
+            debug_message("net_worker: failed to register fd %d\n", (int)conn->fd);
+            interest = 0;
+        }
+#ifdef _WIN32
+        else if (interest & EVENT_READ)
+            async_runtime_post_read(w->runtime, conn->fd, NULL, 0);
+#endif
+    }
+    else
+        async_runtime_modify(w->runtime, conn->fd, interest, conn);
+    conn->interest = interest;
+}
+
+static void set_dead (net_worker_t* w, net_conn_t* conn, int error) {
+    if (conn->dead)
+        return;
+    conn->dead = true;
+    conn->close_error = error;
+    conn->close_unreported = true;
+    free(conn->out);
+    conn->out = NULL;
+    conn->out_off = conn->out_len = conn->out_oob = 0;
+    update_interest(w, conn);
+    mark_notify(w, conn);
+}
+
+static void deliver_input (net_worker_t* w, net_conn_t* conn, const char* data, size_t length) {
+    while (!conn->held && length > 0) {
+        size_t n = length > NET_WORKER_CHUNK_SIZE ? NET_WORKER_CHUNK_SIZE : length;
+        if (!post_event(w, conn, NET_EVENT_INPUT, data, n, 0))
+            break;
+        data += n;
+        length -= n;
+    }
+    if (length == 0)
+        return;
+
+    /* no room in the event queue: hold the rest and stop reading */
+    {
+        char* held = (char*)realloc(conn->held, conn->held_len + length);
+        if (!held) {
+            debug_message("net_worker: out of memory holding input for fd %d\n", (int)conn->fd);
+            set_dead(w, conn, ENOMEM);
+            return;
+        }
+        memcpy(held + conn->held_len, data, length);
+        conn->held = held;
+        conn->held_len += length;
+    }
+    update_interest(w, conn);
+    mark_notify(w, conn);
+}
+
+static void read_input (net_worker_t* w, net_conn_t* conn, io_event_t* evt) {
+    char buf[NET_WORKER_CHUNK_SIZE];
+    long n;
+
+    if (evt->buffer && evt->bytes_transferred > 0) {
+        /* completion notification: the runtime has read the data */
+        deliver_input(w, conn, (const char*)evt->buffer, evt->bytes_transferred);
+#ifdef _WIN32
+        if (!conn->dead && !conn->held)
+            async_runtime_post_read(w->runtime, conn->fd, NULL, 0);
+#endif
+        return;
+    }
+
+    n = SOCKET_RECV(conn->fd, buf, sizeof(buf), 0);
+    if (n > 0)
+        deliver_input(w, conn, buf, (size_t)n);
+    else if (n == 0)
+        set_dead(w, conn, 0);
+    else if (SOCKET_ERRNO != EWOULDBLOCK && SOCKET_ERRNO != EINTR)
+        set_dead(w, conn, SOCKET_ERRNO);
+}
+
+/**
+ * Send as much of a connection's left-over output as the socket takes.
+ */
+static void write_output (net_worker_t* w, net_conn_t* conn) {
+    while (conn->out_len > 0) {
+        /* only the last byte of an out-of-band send is urgent, so the
+         * bytes before the mark go out as normal data first */
+        long n = conn->out_oob == 1
+            ? SOCKET_SEND(conn->fd, conn->out + conn->out_off, 1, MSG_OOB)
+            : SOCKET_SEND(conn->fd, conn->out + conn->out_off,
+                          conn->out_oob > 1 ? conn->out_oob - 1 : conn->out_len, 0);
+        if (n < 0) {
+            if (SOCKET_ERRNO != EWOULDBLOCK && SOCKET_ERRNO != EINTR)
+                set_dead(w, conn, SOCKET_ERRNO);
+            break;
+        }
+        conn->out_off += (size_t)n;
+        conn->out_len -= (size_t)n;
+        conn->out_oob = conn->out_oob > (size_t)n ? conn->out_oob - (size_t)n : 0;
+        conn->sent_unreported += (size_t)n;
+        mark_notify(w, conn);
+    }
+    if (conn->out_len == 0 && conn->out) {
+        free(conn->out);
+        conn->out = NULL;
+        conn->out_off = 0;
+    }
+    update_interest(w, conn);
+}
+
+static void queue_output (net_worker_t* w, net_conn_t* conn, char* data, size_t length, bool oob) {
+    size_t done = 0;
+
+    if (conn->dead) {
+        free(data);
+        return;
+    }
+
+    if (conn->out_len == 0) {
+        long n = SOCKET_SEND(conn->fd, data, length, oob ? MSG_OOB : 0);
+        if (n < 0) {
+            if (SOCKET_ERRNO != EWOULDBLOCK && SOCKET_ERRNO != EINTR) {
+                free(data);
+                set_dead(w, conn, SOCKET_ERRNO);
+                return;
+            }
+            n = 0;
+        }
+        done = (size_t)n;
+        conn->sent_unreported += done;
+        mark_notify(w, conn);
+        if (done == length) {
+            free(data);
+            return;
+        }
+        /* the rest waits for EVENT_WRITE */
+        free(conn->out);
+        conn->out = data;
+        conn->out_off = done;
+        conn->out_len = length - done;
+        conn->out_oob = oob ? conn->out_len : 0;
+    }
+    else {
+        char* out;
+
+        memmove(conn->out, conn->out + conn->out_off, conn->out_len);
+        conn->out_off = 0;
+        out = (char*)realloc(conn->out, conn->out_len + length);
+        if (!out) {
+            free(data);
+            debug_message("net_worker: out of memory queueing output for fd %d\n", (int)conn->fd);
+            set_dead(w, conn, ENOMEM);
+            return;
+        }
+        memcpy(out + conn->out_len, data, length);
+        conn->out = out;
+        conn->out_len += length;
+        if (oob)
+            conn->out_oob = conn->out_len;
+        free(data);
+    }
+    update_interest(w, conn);
+}
+
+static void close_conn (net_worker_t* w, net_conn_t* conn) {
+    /* one last try for output that is still left */
+    if (!conn->dead && conn->out_len > 0)
+        write_output(w, conn);
+
+    if (conn->interest)
+        async_runtime_remove(w->runtime, conn->fd);
+    conn->interest = 0;
+    if (SOCKET_CLOSE(conn->fd) == SOCKET_ERROR)
+        debug_message("net_worker: close failed on fd %d\n", (int)conn->fd);
+    conn->closed = true;
+
+    /* off the connection list; freed at the end of the cycle, after events
+     * already returned by the runtime for it have been skipped */
+    w->conns[conn->index] = w->conns[--w->num_conns];
+    w->conns[conn->index]->index = conn->index;
+    if (!conn_list_append(&w->closed, &w->num_closed, &w->max_closed, conn))
+        debug_message("net_worker: leaking a closed connection\n");
+}
+
+static void free_conn (net_conn_t* conn) {
+    free(conn->out);
+    free(conn->held);
+    free(conn);
+}
+
+static void run_commands (net_worker_t* w) {
+    net_command_t cmd;
+
+    platform_mutex_lock(&w->wake_mutex);
+    w->wake_posted = false;
+    platform_mutex_unlock(&w->wake_mutex);
+
+    while (async_queue_dequeue(w->commands, &cmd, sizeof(cmd), NULL)) {
+        net_conn_t* conn = cmd.conn;
+
+        switch (cmd.op) {
+        case NET_CMD_ADD:
+            if (!conn_list_append(&w->conns, &w->num_conns, &w->max_conns, conn)) {
+                /* reported as a dead connection, the main thread closes it */
+                conn->index = -1;
+                conn->dead = true;
+                conn->close_error = ENOMEM;
+                conn->close_unreported = true;
+                mark_notify(w, conn);
+                break;
+            }
+            conn->index = w->num_conns - 1;
+            update_interest(w, conn);
+            break;
+
+        case NET_CMD_SEND:
+            queue_output(w, conn, cmd.data, cmd.length, cmd.oob);
+            break;
+
+        case NET_CMD_CLOSE:
+            if (conn->index < 0) {
+                SOCKET_CLOSE(conn->fd);
+                conn->closed = true;
+                conn_list_append(&w->closed, &w->num_closed, &w->max_closed, conn);
+            }
+            else
+                close_conn(w, conn);
+            break;
+        }
+    }
+}
+
+/**
+ * Deliver what is owed to the main thread. Connections that still owe
+ * something stay on the notify list.
+ */
+static void run_notify (net_worker_t* w) {
+    int i, kept = 0;
+
+    for (i = 0; i < w->num_notify; i++) {
+        net_conn_t* conn = w->notify[i];
+        bool was_holding = conn->held != NULL;
+
+        if (conn->closed || flush_reports(w, conn)) {
+            conn->notify = false;
+            if (was_holding && !conn->closed)
+                update_interest(w, conn); /* reading again */
+            continue;
+        }
+        w->notify[kept++] = conn;
+    }
+    w->num_notify = kept;
+}
+
+static void free_closed (net_worker_t* w) {
+    int i;
+
+    for (i = 0; i < w->num_closed; i++)
+        free_conn(w->closed[i]);
+    w->num_closed = 0;
+}
+
+static void notify_main (net_worker_t* w) {
+    bool post;
+
+    if (!w->events_added)
+        return;
+    w->events_added = false;
+
+    platform_mutex_lock(&w->wake_mutex);
+    post = !w->main_notified;
+    w->main_notified = true;
+    platform_mutex_unlock(&w->wake_mutex);
+    if (post)
+        async_runtime_post_completion(w->main_runtime, w->completion_key, 0);
+}
+
+static void* net_worker_proc (void* arg) {
+    net_worker_t* w = (net_worker_t*)arg;
+    io_event_t events[NET_WORKER_MAX_EVENTS];
+    int i, n;
+
+    while (!async_worker_should_stop(async_worker_current())) {
+        struct timeval retry = { 0, NET_NOTIFY_RETRY_USEC };
+
+        n = async_runtime_wait(w->runtime, events, NET_WORKER_MAX_EVENTS,
+                               w->num_notify ? &retry : NULL);
+        for (i = 0; i < n; i++) {
+            net_conn_t* conn = (net_conn_t*)events[i].context;
+
+            if (!conn)
+                continue; /* wake-up from the main thread */
+            if (conn->closed || conn->dead)
+                continue;
+            if (events[i].event_type & (EVENT_ERROR | EVENT_CLOSE)) {
+                set_dead(w, conn, 0);
+                continue;
+            }
+            if ((events[i].event_type & EVENT_READ) && !conn->held)
+                read_input(w, conn, &events[i]);
+            if ((events[i].event_type & EVENT_WRITE) && !conn->dead)
+                write_output(w, conn);
+        }
+
+        run_commands(w);
+        run_notify(w);
+        free_closed(w);
+        notify_main(w);
+    }
+    return NULL;
+}
+
+net_worker_t* net_worker_create (async_runtime_t* main_runtime, uintptr_t completion_key) {
+    net_worker_t* w;
+
+    if (!main_runtime) {
+        debug_error("net_worker_create: invalid arguments\n");
+        return NULL;
+    }
+    w = (net_worker_t*)calloc(1, sizeof(*w));
+    if (!w) {
+        debug_error("net_worker_create: out of memory\n");
+        return NULL;
+    }
+    w->main_runtime = main_runtime;
+    w->completion_key = completion_key;
+    {
+        async_queue_batch_t batch = ASYNC_QUEUE_BATCH_INIT(w->batch_events, w->batch_sizes, NET_EVENT_BATCH_SIZE);
+        w->batch = batch;
+    }
+    if (!platform_mutex_init(&w->wake_mutex)) {
+        free(w);
+        return NULL;
+    }
+    w->runtime = async_runtime_init();
+    /* each queue has one producer and one consumer */
+    w->commands = async_queue_create(NET_COMMAND_QUEUE_SIZE, sizeof(net_command_t), ASYNC_QUEUE_MPSC);
+    w->events = async_queue_create(NET_EVENT_QUEUE_SIZE, sizeof(net_event_t*), ASYNC_QUEUE_MPSC);
+    w->event_slots = (net_event_t*)malloc(NET_EVENT_QUEUE_SIZE * sizeof(net_event_t));
+    if (w->runtime && w->commands && w->events && w->event_slots)
+        w->thread = async_worker_create(net_worker_proc, w, 0);
+    if (!w->thread) {
+        debug_error("net_worker_create: failed to start the worker\n");
+        free(w->event_slots);
+        if (w->events)
+            async_queue_destroy(w->events);
+        if (w->commands)
+            async_queue_destroy(w->commands);
+        if (w->runtime)
+            async_runtime_deinit(w->runtime);
+        platform_mutex_destroy(&w->wake_mutex);
+        free(w);
+        return NULL;
+    }
+    return w;
+}
+
+void net_worker_destroy (net_worker_t* w) {
+    int i;
+
+    if (!w)
+        return;
+
+    async_worker_signal_stop(w->thread);
+    async_runtime_post_completion(w->runtime, NET_WORKER_WAKE_KEY, 0);
+    if (!async_worker_join(w->thread, 5000))
+        debug_warn("net worker did not stop within timeout\n");
+    async_worker_destroy(w->thread);
+
+    /* the thread is gone: finish what the main thread asked for */
+    run_commands(w);
+    while (w->num_overflow) {
+        retry_overflow(w);
+        run_commands(w);
+    }
+    for (i = w->num_conns - 1; i >= 0; i--)
+        close_conn(w, w->conns[i]);
+    for (i = 0; i < w->num_notify; i++)
+        if (!w->notify[i]->closed) {
+            SOCKET_CLOSE(w->notify[i]->fd); /* added, but never registered */
+            free_conn(w->notify[i]);
+        }
+    free_closed(w);
+
+    free(w->conns);
+    free(w->notify);
+    free(w->closed);
+    free(w->overflow);
+    async_queue_destroy(w->events);
+    async_queue_destroy(w->commands);
+    free(w->event_slots);
+    async_runtime_deinit(w->runtime);
+    platform_mutex_destroy(&w->wake_mutex);
+    free(w);
+}
+
+static void wake_worker (net_worker_t* w) {
+    bool post;
+
+    platform_mutex_lock(&w->wake_mutex);
+    post = !w->wake_posted;
+    w->wake_posted = true;
+    platform_mutex_unlock(&w->wake_mutex);
+    if (post)
+        async_runtime_post_completion(w->runtime, NET_WORKER_WAKE_KEY, 0);
+}
+
+/**
+ * Move overflowed commands into the command queue, oldest first.
+ */
+static void retry_overflow (net_worker_t* w) {
+    int i = 0;
+
+    while (i < w->num_overflow && async_queue_enqueue(w->commands, &w->overflow[i], sizeof(net_command_t)))
+        i++;
+    if (i == 0)
+        return;
+    w->num_overflow -= i;
+    memmove(w->overflow, w->overflow + i, w->num_overflow * sizeof(net_command_t));
+    wake_worker(w);
+}
+
+/**
+ * Queue a command for the worker. The main thread never waits for the
+ * worker: when the queue is full, the command is kept aside and queued
+ * later, still in order.
+ */
+static void send_command (net_worker_t* w, const net_command_t* cmd) {
+    if (w->num_overflow == 0 && async_queue_enqueue(w->commands, cmd, sizeof(*cmd))) {
+        wake_worker(w);
+        return;
+    }
+    if (w->num_overflow >= w->max_overflow) {
+        int new_capacity = w->max_overflow ? w->max_overflow * 2 : 256;
+        net_command_t* grown = (net_command_t*)realloc(w->overflow, new_capacity * sizeof(net_command_t));
+        if (!grown) {
+            debug_message("net_worker: out of memory, command lost\n");
+            if (cmd->op == NET_CMD_SEND)
+                free(cmd->data);
+            return;
+        }
+        w->overflow = grown;
+        w->max_overflow = new_capacity;
+    }
+    w->overflow[w->num_overflow++] = *cmd;
+    retry_overflow(w);
+}
+
+net_conn_t* net_worker_add (net_worker_t* w, socket_fd_t fd, void* context) {
+    net_command_t cmd;
+    net_conn_t* conn;
+
+    if (!w || fd == INVALID_SOCKET_FD)
+        return NULL;
+    conn = (net_conn_t*)calloc(1, sizeof(*conn));
+    if (!conn)
+        return NULL;
+    conn->worker = w;
+    conn->context = context;
+    conn->serial = ++next_serial;
+    conn->fd = fd;
+    conn->index = -1;
+
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.op = NET_CMD_ADD;
+    cmd.conn = conn;
+    send_command(w, &cmd);
+    return conn;
+}
+
+uint32_t net_conn_serial (const net_conn_t* conn) {
+    return conn ? conn->serial : 0;
+}
+
+int net_worker_sendv (net_conn_t* conn, const socket_iovec_t* iov, int count, bool oob) {
+    net_command_t cmd;
+    size_t length = 0;
+    int i;
+
+    for (i = 0; i < count; i++)
+        length += SOCKET_IOV_LEN(iov[i]);
+    if (length == 0)
+        return 0;
+
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.op = NET_CMD_SEND;
+    cmd.conn = conn;
+    cmd.oob = oob;
+    cmd.length = length;
+    cmd.data = (char*)malloc(length);
+    if (!cmd.data)
+        return -1;
+    length = 0;
+    for (i = 0; i < count; i++) {
+        memcpy(cmd.data + length, SOCKET_IOV_BASE(iov[i]), SOCKET_IOV_LEN(iov[i]));
+        length += SOCKET_IOV_LEN(iov[i]);
+    }
+    send_command(conn->worker, &cmd);
+    return 0;
+}
+
+void net_worker_close (net_conn_t* conn) {
+    net_command_t cmd;
+
+    if (!conn)
+        return;
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.op = NET_CMD_CLOSE;
+    cmd.conn = conn;
+    send_command(conn->worker, &cmd);
+}
+
+bool net_worker_next_event (net_worker_t* w, net_event_t* evt) {
+    net_event_t* slot;
+    void* msg;
+
+    if (!w)
+        return false;
+    if (w->num_overflow)
+        retry_overflow(w);
+
+    if (w->batch.next == w->batch.count) {
+        /* cleared first: events queued from now on post a new completion */
+        platform_mutex_lock(&w->wake_mutex);
+        w->main_notified = false;
+        platform_mutex_unlock(&w->wake_mutex);
+    }
+    if (!async_queue_batch_next(w->events, &w->batch, &msg, NULL))
+        return false;
+    slot = *(net_event_t**)msg;
+    memcpy(evt, slot, offsetof(net_event_t, data) + (slot->type == NET_EVENT_INPUT ? slot->length : 0));
+    /* the only writer, so a plain store gives the slot back in order */
+    platform_atomic_store(&w->events_freed, platform_atomic_load(&w->events_freed) + 1);
+    if (evt->type == NET_EVENT_INPUT)
+        evt->data[evt->length] = '\0';
+    return true;
+}
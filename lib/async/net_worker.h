@@ -0,0 +1,130 @@
+/**
+ * @file net_worker.h
+ * @brief Network I/O threads for user connections
+ *
+ * A net worker performs the socket I/O of the connections assigned to it on
+ * its own thread, with its own async runtime. The main thread never touches
+ * those sockets: it sends commands (add, send, close) to the worker and
+ * receives events (input, sent, closed) back. Both directions go through an
+ * async_queue. The worker posts a completion to the main runtime when new
+ * events are waiting.
+ *
+ * Input events carry raw bytes. Telnet parsing and line assembly are not done
+ * by the worker: the telnet state machine in comm.c replies with add_message(),
+ * calls LPC applies on subnegotiation and follows per-user modes changed by
+ * LPC (single-char input, echo, MCCP), so it runs on the main thread.
+ *
+ * All functions except the worker thread itself are called from the main
+ * thread.
+ */
+
+#ifndef NET_WORKER_H
+#define NET_WORKER_H
+
+#include "async/async_queue.h"
+#include "async/async_runtime.h"
+#include "async/async_worker.h"
+
+#ifdef HAVE_STDBOOL_H
+#include <stdbool.h>
+#else
+typedef int bool;
+#define true 1
+#define false 0
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct net_worker_s net_worker_t;
+typedef struct net_conn_s net_conn_t;
+
+/**
+ * Completion key for net worker events
+ */
+#define NET_WORKER_COMPLETION_KEY 0x4E3701
+
+/**
+ * Largest piece of input delivered in one event
+ */
+#define NET_WORKER_CHUNK_SIZE 2048
+
+typedef enum {
+    NET_EVENT_INPUT = 1,   /**< Data was received */
+    NET_EVENT_SENT,        /**< Output was written to the socket */
+    NET_EVENT_CLOSED       /**< End of stream or socket error; no more events follow */
+} net_event_type_t;
+
+/**
+ * Event from a net worker to the main thread
+ */
+typedef struct net_event_s {
+    void* context;            /**< Context given to net_worker_add() */
+    uint32_t serial;          /**< Serial of the connection, see net_conn_serial() */
+    net_event_type_t type;
+    int error;                /**< NET_EVENT_CLOSED: socket error, or 0 at end of stream */
+    size_t length;            /**< Bytes of input (INPUT) or bytes written (SENT) */
+    char data[NET_WORKER_CHUNK_SIZE + 1]; /**< Input, followed by a NUL byte */
+} net_event_t;
+
+/**
+ * Start a net worker thread.
+ * @param main_runtime Runtime of the main thread, for posting completions.
+ * @param completion_key Completion key (typically NET_WORKER_COMPLETION_KEY).
+ * @returns The worker, or NULL on failure.
+ */
+net_worker_t* net_worker_create (async_runtime_t* main_runtime, uintptr_t completion_key);
+
+/**
+ * Stop a net worker thread and free it.
+ *
+ * Commands still queued are carried out first, so output handed to the
+ * worker gets its last chance to be sent. Connections that were not closed
+ * are closed.
+ */
+void net_worker_destroy (net_worker_t* worker);
+
+/**
+ * Hand a connected, non-blocking socket over to a net worker.
+ * @param context Returned in every event of this connection.
+ * @returns The connection, or NULL on failure. The socket belongs to the
+ *   worker from now on, and is closed by net_worker_close().
+ */
+net_conn_t* net_worker_add (net_worker_t* worker, socket_fd_t fd, void* context);
+
+/**
+ * Serial number of a connection, unique among all connections ever added.
+ *
+ * Events carry it so that an event of a closed connection is never taken
+ * for one of a new connection with the same context.
+ */
+uint32_t net_conn_serial (const net_conn_t* conn);
+
+/**
+ * Queue output for a connection. The data is copied.
+ * @param iov Pieces of the output.
+ * @param count Number of pieces.
+ * @param oob Send the first piece as out-of-band data.
+ * @returns 0 on success, -1 if out of memory.
+ */
+int net_worker_sendv (net_conn_t* conn, const socket_iovec_t* iov, int count, bool oob);
+
+/**
+ * Close a connection. Queued output is sent as far as the socket takes it
+ * without blocking, then the socket is closed. The connection must not be
+ * used after this call, and no more events are reported for it.
+ */
+void net_worker_close (net_conn_t* conn);
+
+/**
+ * Take the next event from a net worker.
+ * @returns true if an event was stored in @p evt, false if there are none.
+ */
+bool net_worker_next_event (net_worker_t* worker, net_event_t* evt);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NET_WORKER_H */
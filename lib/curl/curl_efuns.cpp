@@ -39,6 +39,7 @@ static size_t curl_response_write_callback(void *ptr, size_t size, size_t nmemb,
 namespace {
 
 static const int CURL_QUEUE_SIZE = 256;
+static const int CURL_COMPLETION_BATCH_SIZE = 16;
 /* s_curl_handles is allocated once at init and never resized while the worker
  * thread is running.  Keeping the array pointer stable eliminates a data race
  * where the worker holds a derived pointer (including CURLOPT_WRITEDATA) into
@@ -59,6 +60,11 @@ static int s_num_curl_handles = 0;
 static CURLM *s_curl_multi = nullptr;
 static async_queue_t *s_task_queue = nullptr;
 static async_queue_t *s_result_queue = nullptr;
+/* main thread: completions dequeued together, handed out one at a time */
+static curl_completion_t s_completion_batch_items[CURL_COMPLETION_BATCH_SIZE];
+static size_t s_completion_batch_sizes[CURL_COMPLETION_BATCH_SIZE];
+static async_queue_batch_t s_completion_batch =
+    ASYNC_QUEUE_BATCH_INIT(s_completion_batch_items, s_completion_batch_sizes, CURL_COMPLETION_BATCH_SIZE);
 static async_worker_t *s_worker = nullptr;
 static async_runtime_t *s_runtime = nullptr;
 
@@ -850,7 +856,7 @@ void init_curl_subsystem(void) {
   }
 
   s_task_queue = async_queue_create(CURL_QUEUE_SIZE, sizeof(curl_task_t), static_cast<async_queue_flags_t>(0));
-  s_result_queue = async_queue_create(CURL_QUEUE_SIZE, sizeof(curl_completion_t), static_cast<async_queue_flags_t>(0));
+  s_result_queue = async_queue_create(CURL_QUEUE_SIZE, sizeof(curl_completion_t), ASYNC_QUEUE_MPSC);
   if (!s_task_queue || !s_result_queue) {
     if (s_task_queue) {
       async_queue_destroy(s_task_queue);
@@ -922,6 +928,7 @@ void deinit_curl_subsystem(void) {
     async_queue_destroy(s_result_queue);
     s_result_queue = nullptr;
   }
+  async_queue_batch_reset(&s_completion_batch);
 
   if (s_curl_multi) {
     curl_multi_cleanup(s_curl_multi);
@@ -969,13 +976,18 @@ void close_curl_handles(object_t *ob) {
 void drain_curl_completions(void) {
   curl_completion_t completion;
   size_t completion_size = 0;
+  void *msg;
 
-  while (s_result_queue && async_queue_dequeue(s_result_queue, &completion, sizeof(completion), &completion_size)) {
+  while (s_result_queue && async_queue_batch_next(s_result_queue, &s_completion_batch, &msg, &completion_size)) {
     curl_http_t *handle;
     object_t *owner;
     int arg_count;
 
-    if (completion_size != sizeof(completion) || completion.handle_id >= static_cast<uint32_t>(s_num_curl_handles)) {
+    if (completion_size != sizeof(completion)) {
+      continue;
+    }
+    std::memcpy(&completion, msg, sizeof(completion));
+    if (completion.handle_id >= static_cast<uint32_t>(s_num_curl_handles)) {
       continue;
     }
 
@@ -17,6 +17,7 @@
 #include "lpc/include/function.h"
 
 #include "src/call_out.h"
+#include "src/driver_stats.h"
 #include "file_utils.h"
 #include "dumpstat.h"
 
@@ -319,11 +320,72 @@ void f_mud_status (void) {
       outbuf_add (&ob, "\t\t\t\t\t --------\n");
       outbuf_addv (&ob, "Total:\t\t\t\t\t %8ld\n", tot);
     }
+  outbuf_addv (&ob, "\nUnchanged saves skipped:\t%8d\n", saves_skipped);
   outbuf_push (&ob);
 }
 #endif
 
 
+#ifdef F_DRIVER_STATS
+/**
+ * @brief Report driver loop stage timings as a mapping of stage name to
+ * ([ "count", "last", "p50", "p99", "max" ]) in microseconds.  The
+ * heart beat lag entry also carries the number of timer overruns.
+ *
+ * A non-zero argument discards the recorded samples after reporting.
+ */
+void f_driver_stats (void) {
+  mapping_t *m, *stage_map;
+  driver_stage_summary_t sum;
+  int reset = (int)(sp--)->u.number;
+
+  m = allocate_mapping (DS_NUM_STAGES);
+  for (int i = 0; i < DS_NUM_STAGES; i++)
+    {
+      driver_stats_summary ((driver_stage_t) i, &sum);
+      stage_map = allocate_mapping (6);
+      add_mapping_pair (stage_map, "count", (int) sum.count);
+      add_mapping_pair (stage_map, "last", (int) sum.last);
+      add_mapping_pair (stage_map, "p50", (int) sum.p50);
+      add_mapping_pair (stage_map, "p99", (int) sum.p99);
+      add_mapping_pair (stage_map, "max", (int) sum.max);
+      if (i == DS_HEART_BEAT_LAG)
+        add_mapping_pair (stage_map, "overruns", (int) driver_stats_heart_beat_overruns ());
+      add_mapping_mapping (m, driver_stats_stage_name ((driver_stage_t) i), stage_map);
+      free_mapping (stage_map);
+    }
+  if (reset)
+    driver_stats_reset ();
+  push_refed_mapping (m);
+}
+#endif
+
+
+#ifdef F_OUTPUT_POOL_STATS
+/**
+ * @brief Report the usage of the pooled output blocks that hold the pending
+ * output of all interactive connections.
+ */
+void f_output_pool_stats (void) {
+  output_pool_stats_t stats;
+  mapping_t *m;
+
+  output_pool_get_stats (&stats);
+  m = allocate_mapping (9);
+  add_mapping_pair (m, "block_size", OUTPUT_BLOCK_SIZE);
+  add_mapping_pair (m, "blocks_allocated", (int) stats.blocks_allocated);
+  add_mapping_pair (m, "blocks_in_use", (int) stats.blocks_in_use);
+  add_mapping_pair (m, "blocks_free", (int) stats.blocks_free);
+  add_mapping_pair (m, "peak_in_use", (int) stats.peak_in_use);
+  add_mapping_pair (m, "total_allocs", (int) stats.total_allocs);
+  add_mapping_pair (m, "bytes_dropped", (int) stats.bytes_dropped);
+  add_mapping_pair (m, "segments", (int) stats.segments);
+  add_mapping_pair (m, "segment_refs", (int) stats.segment_refs);
+  push_refed_mapping (m);
+}
+#endif
+
+
 #ifdef F_DUMP_FILE_DESCRIPTORS
 void
 f_dump_file_descriptors (void)
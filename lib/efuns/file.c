@@ -8,6 +8,10 @@
 #include "lpc/array.h"
 #include "lpc/buffer.h"
 #include "lpc/object.h"
+#include "lpc/include/runtime_config.h"
+#include "lpc/include/save_object.h"
+#include "rc/rc.h"
+#include "file_async.h"
 
 #include <sys/stat.h>
 #include <fcntl.h>
@@ -464,23 +468,125 @@ void f_write_buffer (void) {
 
 #ifdef F_RESTORE_OBJECT
 void f_restore_object (void) {
+  int num_arg = st_num_arg;
+  svalue_t *arg = sp - num_arg + 1;
   int flag;
 
-  flag = (st_num_arg > 1) ? (int)(sp--)->u.number : 0;
-  flag = restore_object (current_object, SVALUE_STRPTR(sp), flag);
-  free_string_svalue (sp);
-  put_number (flag);
+  flag = (num_arg >= 2) ? (int) arg[1].u.number : 0;
+  flag = restore_saved_object (current_object, SVALUE_STRPTR(arg), flag,
+                               (num_arg >= 3) ? SVALUE_STRPTR(&arg[2]) : NULL);
+  pop_n_elems (num_arg);
+  push_number (flag);
 }
 #endif
 
 
 #ifdef F_SAVE_OBJECT
 void f_save_object (void) {
+  int num_arg = st_num_arg;
+  svalue_t *arg = sp - num_arg + 1;
   int flag;
 
-  flag = (st_num_arg == 2) && (sp--)->u.number;
-  flag = save_object (current_object, SVALUE_STRPTR(sp), flag);
+  flag = (num_arg >= 2) ? (int) arg[1].u.number : 0;
+  if (CONFIG_INT (__ENABLE_ASYNC_SAVE_OBJECT__))
+    flag = save_object_async (current_object, SVALUE_STRPTR(arg), flag,
+                              (num_arg >= 3) ? &arg[2] : NULL, num_arg - 3);
+  else
+    flag = save_object (current_object, SVALUE_STRPTR(arg), flag);
+  pop_n_elems (num_arg);
+  push_number (flag);
+}
+#endif
+
+
+#ifdef F_CONVERT_SAVE_FILE
+void f_convert_save_file (void) {
+  char host_path[PATH_MAX];
+  save_buffer_t out;
+  char *data;
+  size_t len;
+  int binary = (sp->u.number & SAVE_BINARY) != 0;
+  int err, result = 0;
+
+  if (!save_object_path (current_object, SVALUE_STRPTR(sp - 1), "convert_save_file", 0, host_path)
+      || !save_object_path (current_object, SVALUE_STRPTR(sp - 1), "convert_save_file", 1, host_path))
+    error ("Denied permission in convert_save_file().\n");
+
+  /* convert what the queued save_object() calls leave behind */
+  flush_pending_save (host_path, 0);
+  data = read_save_file (host_path, &len);
+  if (data)
+    {
+      convert_save_data (data, len, binary, &out);
+      FREE (data);
+      err = write_save_file (host_path, out.data, out.len, (int) CONFIG_INT (__ENABLE_SAVE_OBJECT_FSYNC__));
+      FREE (out.data);
+      if (err)
+        {
+          errno = err;
+          debug_perror ("convert_save_file()", host_path);
+        }
+      else
+        save_object_written (NULL, host_path, 0);
+      result = (err == 0);
+    }
+  sp--;
+  free_string_svalue (sp);
+  put_number (result);
+}
+#endif
+
+
+#ifdef F_CHECKPOINT_OBJECTS
+void f_checkpoint_objects (void) {
+  int num_arg = st_num_arg;
+  svalue_t *arg = sp - num_arg + 1;
+  char host_path[PATH_MAX];
+  array_t *keys = NULL;
+  svalue_t *ret;
+  int i, result;
+
+  if (num_arg >= 3 && arg[2].type == T_ARRAY)
+    {
+      keys = arg[2].u.arr;
+      if (keys->size != arg[0].u.arr->size)
+        error ("checkpoint_objects(): Need one key for each object.\n");
+      for (i = 0; i < keys->size; i++)
+        if (keys->item[i].type != T_STRING)
+          error ("checkpoint_objects(): Keys must be strings.\n");
+    }
+  /* the log holds every variable of the objects, so deny unless the master
+   * object says otherwise */
+  push_object (current_object);
+  push_svalue (&arg[0]);
+  ret = APPLY_SLOT_MASTER_CALL (APPLY_VALID_CHECKPOINT, 2);
+  if (ret == (svalue_t *)-1 || IS_ZERO (ret))
+    {
+      APPLY_SLOT_FINISH_CALL();
+      error ("Permission of checkpoint_objects() denied by master object.\n");
+    }
+  APPLY_SLOT_FINISH_CALL();
+  if (!save_object_path (current_object, SVALUE_STRPTR(&arg[1]), "checkpoint_objects", 1, host_path))
+    error ("Denied write permission in checkpoint_objects().\n");
+  flush_pending_save (host_path, 0);
+  result = checkpoint_objects (arg[0].u.arr, keys, host_path);
+  pop_n_elems (num_arg);
+  push_number (result);
+}
+#endif
+
+
+#ifdef F_COMPACT_CHECKPOINT_LOG
+void f_compact_checkpoint_log (void) {
+  char host_path[PATH_MAX];
+  int result;
+
+  if (!save_object_path (current_object, SVALUE_STRPTR(sp), "compact_checkpoint_log", 0, host_path)
+      || !save_object_path (current_object, SVALUE_STRPTR(sp), "compact_checkpoint_log", 1, host_path))
+    error ("Denied permission in compact_checkpoint_log().\n");
+  flush_pending_save (host_path, 0);
+  result = compact_checkpoint_log (host_path);
   free_string_svalue (sp);
-  put_number (flag);
+  put_number (result);
 }
 #endif
@@ -0,0 +1,793 @@
+#ifdef	HAVE_CONFIG_H
+#include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+/**
+ * @file file_async.c
+ * @brief File I/O threads and the *_async() file efuns
+ *
+ * The efuns do everything that touches LPC data on the main thread: the
+ * valid_read/valid_write check, path resolution and copying the data to
+ * write. A file I/O thread then does the blocking system calls and leaves
+ * its results in C heap buffers, which drain_file_async_completions() turns
+ * into LPC values before calling the callback.
+ */
+
+#include "src/std.h"
+#include "src/apply.h"
+#include "src/comm.h"
+#include "src/interpret.h"
+#include "lpc/array.h"
+#include "lpc/functional.h"
+#include "lpc/object.h"
+#include "lpc/include/origin.h"
+#include "lpc/include/runtime_config.h"
+#include "rc/rc.h"
+#include "port/sync.h"
+#include "file_utils.h"
+#include "file_async.h"
+
+#include <sys/stat.h>
+#include <fcntl.h>
+
+static async_pool_t *file_pool = NULL;
+static platform_mutex_t save_lock;    /* queued save_object() data */
+
+void init_file_async (int num_threads) {
+  async_runtime_t *runtime;
+
+  if (file_pool || num_threads < 1)
+    return;
+  runtime = get_async_runtime ();
+  if (!runtime)
+    return;
+  if (!platform_mutex_init (&save_lock))
+    return;
+  file_pool = async_pool_create (num_threads, FILE_ASYNC_QUEUE_SIZE, runtime, FILE_ASYNC_COMPLETION_KEY);
+  if (!file_pool)
+    {
+      platform_mutex_destroy (&save_lock);
+      debug_message ("Warning: failed to start file I/O threads.\n");
+    }
+}
+
+/* give the file I/O threads time to work while the main thread waits */
+static void file_async_pause (void) {
+#ifdef _WIN32
+  Sleep (1);
+#else
+  usleep (1000);
+#endif
+}
+
+void deinit_file_async (void) {
+  void *arg;
+
+  if (!file_pool)
+    return;
+  /* let queued writes reach the disk before the threads go away */
+  while (async_pool_pending (file_pool) > 0)
+    {
+      if (async_pool_next_done (file_pool, &arg))
+        ((file_async_req_t *) arg)->done ((file_async_req_t *) arg, 0);
+      else
+        file_async_pause ();
+    }
+  async_pool_destroy (file_pool);
+  file_pool = NULL;
+  platform_mutex_destroy (&save_lock);
+}
+
+void drain_file_async_completions (void) {
+  void *arg;
+
+  while (file_pool && async_pool_next_done (file_pool, &arg))
+    ((file_async_req_t *) arg)->done ((file_async_req_t *) arg, 1);
+}
+
+/* FNV-1a */
+static uint32_t file_async_path_key (const char *path) {
+  uint32_t h = 2166136261u;
+
+  while (*path)
+    {
+      h ^= (unsigned char) *path++;
+      h *= 16777619u;
+    }
+  return h;
+}
+
+int file_async_submit (const char *path, file_async_req_t *req) {
+  if (!file_pool)
+    return 0;
+  return async_pool_submit (file_pool, file_async_path_key (path), req->work, req) ? 1 : 0;
+}
+
+#if defined(F_READ_FILE_ASYNC) || defined(F_WRITE_FILE_ASYNC) || defined(F_GET_DIR_ASYNC) || defined(F_FILE_SIZE_ASYNC) || defined(F_SAVE_OBJECT)
+/* LPC callback of a request, main thread only */
+typedef struct file_callback_s {
+  object_t *owner;
+  string_or_func_t callback;
+  int callback_is_fp;
+  array_t *callback_args;
+  struct file_callback_s *next;         /* saves coalesced into one write */
+} file_callback_t;
+
+/**
+ * Create a callback from the svalue at callback, followed by num_extra
+ * arguments to pass on to it.
+ */
+static file_callback_t *new_file_callback (svalue_t *callback, int num_extra) {
+  file_callback_t *cb;
+  int i;
+
+  if (callback->type == T_STRING && SVALUE_STRPTR (callback)[0] == APPLY___INIT_SPECIAL_CHAR)
+    error ("Illegal function name.\n");
+
+  cb = (file_callback_t *) DCALLOC (1, sizeof (file_callback_t), TAG_TEMPORARY, "file_async");
+  if (callback->type == T_FUNCTION)
+    {
+      cb->callback_is_fp = 1;
+      cb->callback.f = callback->u.fp;
+      cb->callback.f->hdr.ref++;
+    }
+  else
+    cb->callback.s = make_shared_string (SVALUE_STRPTR (callback), NULL);
+  if (num_extra > 0)
+    {
+      cb->callback_args = allocate_empty_array (num_extra);
+      for (i = 0; i < num_extra; i++)
+        assign_svalue_no_free (&cb->callback_args->item[i], callback + 1 + i);
+    }
+  cb->owner = current_object;
+  add_ref (cb->owner, "file_async");
+  return cb;
+}
+
+static void free_file_callback (file_callback_t *cb) {
+  if (cb->callback_is_fp)
+    free_funp (cb->callback.f);
+  else if (cb->callback.s)
+    free_string (to_shared_str (cb->callback.s));
+  if (cb->callback_args)
+    free_array (cb->callback_args);
+  free_object (cb->owner, "file_async");
+  FREE (cb);
+}
+
+static int file_callback_alive (const file_callback_t *cb) {
+  return !(cb->owner->flags & O_DESTRUCTED);
+}
+
+/* call the callback with the result already pushed on the stack */
+static void call_file_callback (file_callback_t *cb) {
+  int num_arg = 1;
+
+  if (cb->callback_args)
+    {
+      push_some_svalues (cb->callback_args->item, cb->callback_args->size);
+      num_arg += cb->callback_args->size;
+    }
+  if (cb->callback_is_fp)
+    SAFE_CALL_FUNCTION_POINTER_CALL (cb->callback.f, num_arg);
+  else
+    APPLY_SAFE_CALL (cb->callback.s, cb->owner, num_arg, ORIGIN_DRIVER);
+}
+#endif
+
+#if defined(F_READ_FILE_ASYNC) || defined(F_WRITE_FILE_ASYNC) || defined(F_GET_DIR_ASYNC) || defined(F_FILE_SIZE_ASYNC)
+enum file_op {
+  FILE_OP_READ,
+  FILE_OP_WRITE,
+  FILE_OP_SIZE,
+  FILE_OP_DIR
+};
+
+typedef struct {
+  file_async_req_t hdr;
+  int op;
+  char *path;                   /* host path */
+  /* input */
+  char *data;                   /* FILE_OP_WRITE: bytes to write */
+  size_t len;
+  int flags;                    /* FILE_OP_WRITE: 1 to overwrite */
+  size_t max_size;              /* FILE_OP_READ: largest file to read */
+  dir_query_t *query;           /* FILE_OP_DIR */
+  /* output, written by the file I/O thread */
+  long result;
+  int err;
+  char *buf;
+  size_t buf_len;
+  dir_listing_t listing;
+  file_callback_t *callback;
+} file_efun_req_t;
+
+static int next_request_id = 0;
+
+static void read_work (void *arg) {
+  file_efun_req_t *req = (file_efun_req_t *) arg;
+  struct stat st;
+  size_t size;
+  int fd;
+
+#ifdef _WIN32
+  fd = open (req->path, O_RDONLY | O_TEXT);
+#else
+  fd = open (req->path, O_RDONLY);
+#endif
+  if (fd == -1)
+    return;
+  /* like read_file(): missing, directory, empty and too large all give 0 */
+  if (fstat (fd, &st) == -1 || (st.st_mode & S_IFDIR) || st.st_size <= 0 || (size_t) st.st_size > req->max_size)
+    {
+      close (fd);
+      return;
+    }
+  size = (size_t) st.st_size;
+  req->buf = (char *) DMALLOC (size + 1, TAG_TEMPORARY, "read_file_async");
+  if (req->buf)
+    {
+      ssize_t n;
+
+      /* text mode on Windows may give back fewer bytes than st_size */
+      while (req->buf_len < size && (n = read (fd, req->buf + req->buf_len, size - req->buf_len)) > 0)
+        req->buf_len += (size_t) n;
+      req->result = (req->buf_len > 0);
+    }
+  close (fd);
+}
+
+static void write_work (void *arg) {
+  file_efun_req_t *req = (file_efun_req_t *) arg;
+  FILE *f;
+  size_t n_written;
+
+  f = fopen (req->path, (req->flags & 1) ? "w" : "a");
+  if (!f)
+    {
+      req->err = errno;
+      return;
+    }
+  n_written = fwrite (req->data, 1, req->len, f);
+  if (fclose (f) != 0)
+    req->err = errno;
+  req->result = (n_written == req->len && !req->err);
+}
+
+static void size_work (void *arg) {
+  file_efun_req_t *req = (file_efun_req_t *) arg;
+  struct stat st;
+
+  if (stat (req->path, &st) == -1)
+    req->result = -1;
+  else if (S_IFDIR & st.st_mode)
+    req->result = -2;
+  else
+    req->result = (long) st.st_size;
+}
+
+static void dir_work (void *arg) {
+  file_efun_req_t *req = (file_efun_req_t *) arg;
+
+  req->result = scan_dir (req->query, &req->listing);
+}
+
+static void free_file_efun_req (file_efun_req_t *req) {
+  free_file_callback (req->callback);
+  if (req->listing.entries)
+    free_dir_listing (&req->listing);
+  if (req->query)
+    FREE (req->query);
+  if (req->buf)
+    FREE (req->buf);
+  if (req->data)
+    FREE (req->data);
+  FREE (req->path);
+  FREE (req);
+}
+
+/* push the result of a finished request as the first callback argument */
+static void push_file_result (file_efun_req_t *req) {
+  switch (req->op)
+    {
+    case FILE_OP_READ:
+      if (req->result)
+        {
+          malloc_str_t str = new_string (req->buf_len, "read_file_async");
+
+          memcpy (str, req->buf, req->buf_len);
+          str[req->buf_len] = '\0';
+          push_malloced_string (str);
+        }
+      else
+        push_number (0);
+      break;
+    case FILE_OP_DIR:
+      if (req->result)
+        push_refed_array (dir_listing_to_array (&req->listing, req->query->with_stat));
+      else
+        push_number (0);
+      break;
+    default:
+      push_number (req->result);
+      break;
+    }
+}
+
+static void file_efun_done (file_async_req_t *base, int deliver) {
+  file_efun_req_t *req = (file_efun_req_t *) base;
+
+  if (req->op == FILE_OP_WRITE)
+    {
+      if (req->err)
+        {
+          errno = req->err;
+          debug_perror ("write_file_async()", req->path);
+        }
+      /* a save_object() made while the write was queued may be gone */
+      save_object_written (NULL, req->path, 0);
+    }
+
+  if (deliver && file_callback_alive (req->callback))
+    {
+      push_file_result (req);
+      call_file_callback (req->callback);
+    }
+  free_file_efun_req (req);
+}
+
+/**
+ * Create a request whose callback is the svalue at callback, followed by
+ * num_extra arguments to pass on to it.
+ */
+static file_efun_req_t *new_file_efun_req (int op, const char *host_path, svalue_t *callback, int num_extra) {
+  file_efun_req_t *req;
+  file_callback_t *cb;
+
+  cb = new_file_callback (callback, num_extra);
+  req = (file_efun_req_t *) DCALLOC (1, sizeof (file_efun_req_t), TAG_TEMPORARY, "file_async");
+  req->hdr.done = file_efun_done;
+  req->op = op;
+  req->path = (char *) DMALLOC (strlen (host_path) + 1, TAG_TEMPORARY, "file_async");
+  strcpy (req->path, host_path);
+  req->callback = cb;
+  return req;
+}
+
+/* queue the request and return its id, or 0 if it could not be queued */
+static int submit_file_efun_req (file_efun_req_t *req, async_pool_job_t work) {
+  req->hdr.work = work;
+  if (!file_async_submit (req->path, &req->hdr))
+    {
+      free_file_efun_req (req);
+      return 0;
+    }
+  if (++next_request_id <= 0)
+    next_request_id = 1;
+  return next_request_id;
+}
+
+/* resolve and check an LPC path, copying the host path into host_path */
+static int resolve_async_path (const char *path, const char *call_fun, int writeflg, char *host_path) {
+  if (!push_resolved_valid_path (path, current_object, call_fun, writeflg))
+    return 0;
+  strncpy (host_path, SVALUE_STRPTR (sp), PATH_MAX + 1);
+  host_path[PATH_MAX + 1] = '\0';
+  pop_stack ();
+  return 1;
+}
+#endif
+
+#ifdef F_READ_FILE_ASYNC
+/**
+ * int read_file_async(string file, string | function callback, ...)
+ *
+ * Reads the whole file on a file I/O thread and calls callback(contents, ...)
+ * with the contents or 0, as read_file(file) would return.
+ */
+void f_read_file_async (void) {
+  int num_arg = st_num_arg;
+  svalue_t *arg = sp - num_arg + 1;
+  char host_path[PATH_MAX + 2];
+  file_efun_req_t *req;
+  int id = 0;
+
+  if (file_pool && resolve_async_path (SVALUE_STRPTR (arg), "read_file", 0, host_path))
+    {
+      req = new_file_efun_req (FILE_OP_READ, host_path, arg + 1, num_arg - 2);
+      req->max_size = (size_t) CONFIG_INT (__MAX_READ_FILE_SIZE__);
+      id = submit_file_efun_req (req, read_work);
+    }
+  pop_n_elems (num_arg);
+  push_number (id);
+}
+#endif
+
+#ifdef F_WRITE_FILE_ASYNC
+/**
+ * int write_file_async(string file, string str, int flags, string | function callback, ...)
+ *
+ * Appends (or with flags & 1, overwrites) on a file I/O thread and calls
+ * callback(success, ...).
+ */
+void f_write_file_async (void) {
+  int num_arg = st_num_arg;
+  svalue_t *arg = sp - num_arg + 1;
+  char host_path[PATH_MAX + 2];
+  file_efun_req_t *req;
+  int id = 0;
+
+  if (file_pool && resolve_async_path (SVALUE_STRPTR (arg), "write_file", 1, host_path))
+    {
+      req = new_file_efun_req (FILE_OP_WRITE, host_path, arg + 3, num_arg - 4);
+      req->len = SVALUE_STRLEN (arg + 1);
+      req->data = (char *) DMALLOC (req->len + 1, TAG_TEMPORARY, "write_file_async");
+      memcpy (req->data, SVALUE_STRPTR (arg + 1), req->len);
+      req->flags = (int) arg[2].u.number;
+      id = submit_file_efun_req (req, write_work);
+      if (id)
+        save_object_written (NULL, host_path, 0);
+    }
+  pop_n_elems (num_arg);
+  push_number (id);
+}
+#endif
+
+#ifdef F_FILE_SIZE_ASYNC
+/**
+ * int file_size_async(string file, string | function callback, ...)
+ *
+ * Calls callback(size, ...) with what file_size(file) would return.
+ */
+void f_file_size_async (void) {
+  int num_arg = st_num_arg;
+  svalue_t *arg = sp - num_arg + 1;
+  char host_path[PATH_MAX + 2];
+  file_efun_req_t *req;
+  int id = 0;
+
+  if (file_pool && resolve_async_path (SVALUE_STRPTR (arg), "file_size", 0, host_path))
+    {
+      req = new_file_efun_req (FILE_OP_SIZE, host_path, arg + 1, num_arg - 2);
+      id = submit_file_efun_req (req, size_work);
+    }
+  pop_n_elems (num_arg);
+  push_number (id);
+}
+#endif
+
+#ifdef F_GET_DIR_ASYNC
+/**
+ * int get_dir_async(string dir, int flags, string | function callback, ...)
+ *
+ * Calls callback(list, ...) with what get_dir(dir, flags) would return.
+ */
+void f_get_dir_async (void) {
+  int num_arg = st_num_arg;
+  svalue_t *arg = sp - num_arg + 1;
+  dir_query_t query;
+  file_efun_req_t *req;
+  int id = 0;
+
+  if (file_pool && get_dir_query (SVALUE_STRPTR (arg), (int) arg[1].u.number, &query))
+    {
+      req = new_file_efun_req (FILE_OP_DIR, query.fs_path, arg + 2, num_arg - 3);
+      req->query = (dir_query_t *) DMALLOC (sizeof (dir_query_t), TAG_TEMPORARY, "get_dir_async");
+      memcpy (req->query, &query, sizeof (query));
+      id = submit_file_efun_req (req, dir_work);
+    }
+  pop_n_elems (num_arg);
+  push_number (id);
+}
+#endif
+
+#ifdef F_SAVE_OBJECT
+/*
+ * save_object() on the file I/O threads
+ *
+ * The object is serialized on the main thread, and the data is kept in a
+ * table by host path until it is on the disk. A path has at most one save
+ * waiting for a thread: saving again before a thread picks it up replaces
+ * its data and adds the callback to it. restore_object() looks here first,
+ * so it sees the newest data even before it is written, and the other file
+ * efuns call flush_pending_save() before they touch the file.
+ */
+#define SAVE_TABLE_SIZE 1024
+
+typedef struct pending_save_s {
+  struct pending_save_s *next;
+  char *path;                           /* host path */
+  int active;                           /* save jobs submitted and not done */
+  /* guarded by save_lock */
+  int job_waiting;                      /* a job has not taken the queued data yet */
+  save_buffer_t queued;
+  file_callback_t *queued_callbacks;
+  save_buffer_t writing;                /* data a thread is writing */
+} pending_save_t;
+
+typedef struct {
+  file_async_req_t hdr;
+  pending_save_t *save;
+  int do_fsync;
+  /* taken from the pending save by the file I/O thread */
+  save_buffer_t data;
+  file_callback_t *callbacks;
+  int err;
+} save_req_t;
+
+static pending_save_t *save_table[SAVE_TABLE_SIZE];
+
+static pending_save_t *find_pending_save (const char *path, int create) {
+  pending_save_t **bucket = &save_table[file_async_path_key (path) % SAVE_TABLE_SIZE];
+  pending_save_t *save;
+
+  for (save = *bucket; save; save = save->next)
+    if (strcmp (save->path, path) == 0)
+      return save;
+  if (!create)
+    return NULL;
+  save = (pending_save_t *) DCALLOC (1, sizeof (pending_save_t), TAG_TEMPORARY, "save_object_async");
+  save->path = (char *) DMALLOC (strlen (path) + 1, TAG_TEMPORARY, "save_object_async");
+  strcpy (save->path, path);
+  save->next = *bucket;
+  *bucket = save;
+  return save;
+}
+
+static void remove_pending_save (pending_save_t *save) {
+  pending_save_t **link = &save_table[file_async_path_key (save->path) % SAVE_TABLE_SIZE];
+
+  while (*link != save)
+    link = &(*link)->next;
+  *link = save->next;
+  FREE (save->path);
+  FREE (save);
+}
+
+static void free_file_callbacks (file_callback_t *cb) {
+  file_callback_t *next;
+
+  for (; cb; cb = next)
+    {
+      next = cb->next;
+      free_file_callback (cb);
+    }
+}
+
+static void save_work (void *arg) {
+  save_req_t *req = (save_req_t *) arg;
+  pending_save_t *save = req->save;
+
+  platform_mutex_lock (&save_lock);
+  req->data = save->queued;
+  req->callbacks = save->queued_callbacks;
+  memset (&save->queued, 0, sizeof (save->queued));
+  save->queued_callbacks = NULL;
+  save->job_waiting = 0;
+  save->writing = req->data;
+  platform_mutex_unlock (&save_lock);
+
+  if (!req->data.data)
+    {
+      /* dropped by flush_pending_save() */
+      req->err = ECANCELED;
+      return;
+    }
+  req->err = write_save_file (save->path, req->data.data, req->data.len, req->do_fsync);
+
+  platform_mutex_lock (&save_lock);
+  memset (&save->writing, 0, sizeof (save->writing));
+  platform_mutex_unlock (&save_lock);
+}
+
+static void save_done (file_async_req_t *base, int deliver) {
+  save_req_t *req = (save_req_t *) base;
+  pending_save_t *save = req->save;
+  file_callback_t *cb;
+
+  if (req->data.data)
+    FREE (req->data.data);
+
+  if (req->err && req->err != ECANCELED)
+    {
+      errno = req->err;
+      debug_perror ("save_object()", save->path);
+      /* the skipped saves would leave the file behind */
+      forget_saved_objects ();
+    }
+  /* a callback may save to the same path again, which reuses the entry */
+  for (cb = req->callbacks; deliver && cb; cb = cb->next)
+    {
+      if (!file_callback_alive (cb))
+        continue;
+      push_number (req->err ? 0 : 1);
+      call_file_callback (cb);
+    }
+  free_file_callbacks (req->callbacks);
+
+  if (--save->active == 0)
+    remove_pending_save (save);
+  FREE (req);
+}
+
+/* wait until no data of the save is queued or being written */
+static void wait_for_pending_save (pending_save_t *save) {
+  int busy;
+
+  for (;;)
+    {
+      platform_mutex_lock (&save_lock);
+      busy = save->queued.data || save->writing.data;
+      platform_mutex_unlock (&save_lock);
+      if (!busy)
+        break;
+      file_async_pause ();
+    }
+}
+
+/**
+ * @brief Save an object on a file I/O thread.
+ *
+ * Like save_object(), but only the serialization happens now. The save file
+ * is replaced on a file I/O thread, and callback (if not NULL) is called with
+ * 1 or 0 for success or failure, followed by num_extra arguments. Without
+ * file I/O threads, the object is saved right away and callback is unused.
+ * If their queue is full, the file is written right away after any write of
+ * it in progress, and callback is called before this returns.
+ *
+ * @returns 1 if the save was queued or done, 0 on failure.
+ */
+int save_object_async (object_t *ob, const char *file, int flags, svalue_t *callback, int num_extra) {
+  char host_path[PATH_MAX];
+  save_buffer_t buf, old;
+  pending_save_t *save;
+  file_callback_t *cb = NULL, **tail;
+  save_req_t *req;
+  int err;
+
+  if (!file_pool)
+    return save_object (ob, file, flags);
+  if (ob->flags & O_DESTRUCTED)
+    return 0;
+  if (!save_object_path (ob, file, "save_object", 1, host_path))
+    return 0;
+  if (save_object_unchanged (ob, host_path, flags))
+    return 1;
+  if (callback)
+    cb = new_file_callback (callback, num_extra);
+  save_object_to_buffer (ob, flags, &buf);
+  save_object_written (ob, host_path, flags);
+
+  save = find_pending_save (host_path, 1);
+  platform_mutex_lock (&save_lock);
+  if (save->job_waiting)
+    {
+      /* coalesce with the save no thread has picked up yet */
+      old = save->queued;
+      save->queued = buf;
+      for (tail = &save->queued_callbacks; *tail; tail = &(*tail)->next)
+        ;
+      *tail = cb;
+      platform_mutex_unlock (&save_lock);
+      if (old.data)
+        FREE (old.data);
+      return 1;
+    }
+  save->queued = buf;
+  save->queued_callbacks = cb;
+  save->job_waiting = 1;
+  platform_mutex_unlock (&save_lock);
+
+  req = (save_req_t *) DCALLOC (1, sizeof (save_req_t), TAG_TEMPORARY, "save_object_async");
+  req->hdr.work = save_work;
+  req->hdr.done = save_done;
+  req->save = save;
+  req->do_fsync = (int) CONFIG_INT (__ENABLE_SAVE_OBJECT_FSYNC__);
+  if (file_async_submit (save->path, &req->hdr))
+    {
+      save->active++;
+      return 1;
+    }
+
+  /* the queue is full: take the data back and write it here */
+  FREE (req);
+  platform_mutex_lock (&save_lock);
+  buf = save->queued;
+  memset (&save->queued, 0, sizeof (save->queued));
+  save->queued_callbacks = NULL;
+  save->job_waiting = 0;
+  platform_mutex_unlock (&save_lock);
+
+  /* an older write of the file in progress must not land after this one */
+  wait_for_pending_save (save);
+  if (!save->active)
+    remove_pending_save (save);
+  err = write_save_file (host_path, buf.data, buf.len, (int) CONFIG_INT (__ENABLE_SAVE_OBJECT_FSYNC__));
+  FREE (buf.data);
+  if (err)
+    {
+      errno = err;
+      debug_perror ("save_object()", host_path);
+      forget_saved_objects ();
+    }
+  if (cb)
+    {
+      if (file_callback_alive (cb))
+        {
+          push_number (err ? 0 : 1);
+          call_file_callback (cb);
+        }
+      free_file_callback (cb);
+    }
+  return err ? 0 : 1;
+}
+
+/**
+ * @brief Settle the queued saves of a file before another file efun uses it.
+ *
+ * Waits until the newest data saved to host_path with save_object_async() is
+ * on the disk. With discard set, the data no thread has taken yet is dropped
+ * instead, and its callbacks get 0; only a write in progress is waited for.
+ * The callbacks of finished saves are still called from process_io().
+ */
+void flush_pending_save (const char *host_path, int discard) {
+  pending_save_t *save;
+
+  if (!file_pool || !(save = find_pending_save (host_path, 0)))
+    return;
+  /* save_done() runs on this thread, so the entry stays while waiting */
+  platform_mutex_lock (&save_lock);
+  if (discard && save->queued.data)
+    {
+      FREE (save->queued.data);
+      memset (&save->queued, 0, sizeof (save->queued));
+    }
+  platform_mutex_unlock (&save_lock);
+  wait_for_pending_save (save);
+}
+
+/**
+ * @brief Restore an object from the newest data saved for it.
+ *
+ * Like restore_object(), but uses the data of a save_object_async() that is
+ * not on the disk yet, if there is one.
+ */
+int restore_saved_object (object_t *ob, const char *file, int noclear, const char *key) {
+  char host_path[PATH_MAX];
+  pending_save_t *save;
+  char *data = NULL;
+  size_t len = 0;
+
+  if (!file_pool)
+    return restore_object (ob, file, noclear, key);
+  if (ob->flags & O_DESTRUCTED)
+    return 0;
+  if (!save_object_path (ob, file, "restore_object", 0, host_path))
+    error ("Denied read permission in restore_object().\n");
+
+  save = find_pending_save (host_path, 0);
+  if (save)
+    {
+      platform_mutex_lock (&save_lock);
+      {
+        const save_buffer_t *newest = save->queued.data ? &save->queued : &save->writing;
+
+        if (newest->data)
+          {
+            data = (char *) DMALLOC (newest->len + 1, TAG_TEMPORARY, "restore_object: queued");
+            memcpy (data, newest->data, newest->len);
+            data[newest->len] = '\0';
+            len = newest->len;
+          }
+      }
+      platform_mutex_unlock (&save_lock);
+    }
+  if (!data)
+    return restore_object_file (ob, host_path, noclear, key);
+
+  opt_trace (TT_EVAL|1, "restoring object from queued save: %s", host_path);
+  restore_object_from_data (ob, data, len, noclear);
+  FREE (data);
+  return 1;
+}
+#endif /* F_SAVE_OBJECT */
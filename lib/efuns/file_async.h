@@ -0,0 +1,97 @@
+#pragma once
+
+/**
+ * @file file_async.h
+ * @brief File I/O on worker threads for the *_async() file efuns
+ *
+ * The efuns check the path with the master object on the main thread, then
+ * queue the blocking part (open, read, write, stat, readdir) on a pool of
+ * file I/O threads. When a request is done, its callback is called from
+ * process_io() on the main thread with the result.
+ *
+ * Requests on the same file run in the order they were made, on the same
+ * thread, so an append followed by a read sees the appended data. Other
+ * parts of the driver queue their own file jobs with file_async_submit().
+ *
+ * All functions are called from the main thread.
+ */
+
+#include "async/async_pool.h"
+#include "lpc/types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Completion key posted by the file I/O threads. */
+#define FILE_ASYNC_COMPLETION_KEY 0x46494C00u
+
+/** Maximum number of requests waiting per file I/O thread. */
+#define FILE_ASYNC_QUEUE_SIZE 1024
+
+/**
+ * @brief Start the file I/O threads.
+ * @param num_threads Number of threads; the efuns fail if it is below 1.
+ */
+void init_file_async (int num_threads);
+
+/**
+ * @brief Stop the file I/O threads.
+ *
+ * Waits until every queued request has been worked on, so no write is lost,
+ * but drops the callbacks of all requests not delivered yet.
+ */
+void deinit_file_async (void);
+
+/**
+ * @brief Call the callbacks of finished requests.
+ *
+ * Called from process_io() on every pass, since completion keys posted close
+ * together may be coalesced.
+ */
+void drain_file_async_completions (void);
+
+typedef struct file_async_req_s file_async_req_t;
+
+/**
+ * Called on the main thread when a request is done. It frees the request.
+ * @param req The request.
+ * @param deliver Zero when the driver is shutting down; do not call LPC code.
+ */
+typedef void (*file_async_done_t) (file_async_req_t *req, int deliver);
+
+/**
+ * Header of a file I/O request; embed it as the first member of the
+ * caller's own request structure.
+ */
+struct file_async_req_s {
+  async_pool_job_t work;        /* runs on a file I/O thread */
+  file_async_done_t done;       /* runs on the main thread afterwards */
+};
+
+/**
+ * @brief Queue a request on the file I/O threads.
+ *
+ * Requests given the same host path run in the order they were queued.
+ *
+ * @param path Host path the request works on.
+ * @param req The request; owned by the file I/O threads until done is called.
+ * @returns 1 if queued, 0 if the threads are not running or their queue is full.
+ */
+int file_async_submit (const char *path, file_async_req_t *req);
+
+/** save_object() with the write on a file I/O thread. */
+int save_object_async (object_t *ob, const char *file, int flags, svalue_t *callback, int num_extra);
+
+/** restore_object() that sees save_object_async() data not written yet. */
+int restore_saved_object (object_t *ob, const char *file, int noclear, const char *key);
+
+/**
+ * Wait for the save_object_async() data of a host path to be written, or
+ * with discard set, drop the data not taken by a thread yet.
+ */
+void flush_pending_save (const char *host_path, int discard);
+
+#ifdef __cplusplus
+}
+#endif
@@ -11,6 +11,7 @@
 #include "misc/filepath.h"
 
 #include "file_utils.h"
+#include "file_async.h"
 
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -22,9 +23,21 @@
 static int match_string (const char *, const char *);
 static int copy (const char *from, const char *to, const char *from_log);
 static int do_move_file (const char *from, const char *to, const char *from_log, const char *to_log, int flag);
-static int pstrcmp (const void *, const void *);
-static int parrcmp (const void *, const void *);
-static void encode_stat (svalue_t *, int, const char *, struct stat *);
+static int entrycmp (const void *, const void *);
+
+/*
+ * Let the queued save_object() writes of a host path settle before it is
+ * used: wait for them, or with discard set, drop those not started yet since
+ * the file is about to be replaced or removed.
+ */
+static void settle_saves (const char *host_path, int discard) {
+#ifdef F_SAVE_OBJECT
+  flush_pending_save (host_path, discard);
+#else
+  (void) host_path;
+  (void) discard;
+#endif
+}
 
 static const char *path_basename (const char *path) {
   const char *base = strrchr (path, '/');
@@ -34,45 +47,15 @@ static const char *path_basename (const char *path) {
 #define MAX_LINES 50
 
 /*
- * These are used by qsort in get_dir().
+ * Used by qsort in get_dir().
  */
 static int
-pstrcmp (const void *p1, const void *p2)
+entrycmp (const void *p1, const void *p2)
 {
-  svalue_t *x = (svalue_t *) p1;
-  svalue_t *y = (svalue_t *) p2;
+  const dir_entry_t *x = (const dir_entry_t *) p1;
+  const dir_entry_t *y = (const dir_entry_t *) p2;
 
-  return strcmp (SVALUE_STRPTR(x), SVALUE_STRPTR(y));
-}
-
-static int
-parrcmp (const void *p1, const void *p2)
-{
-  svalue_t *x = (svalue_t *) p1;
-  svalue_t *y = (svalue_t *) p2;
-
-  return strcmp (SVALUE_STRPTR(&x->u.arr->item[0]), SVALUE_STRPTR(&y->u.arr->item[0]));
-}
-
-static void
-encode_stat (svalue_t * vp, int flags, const char *str, struct stat *st)
-{
-  if (flags == -1)
-    {
-      array_t *v = allocate_empty_array (3);
-
-      SET_SVALUE_MALLOC_STRING(&v->item[0], string_copy (str, "encode_stat"));
-      v->item[1].type = T_NUMBER;
-      v->item[1].u.number = ((st->st_mode & S_IFDIR) ? -2 : st->st_size);
-      v->item[2].type = T_NUMBER;
-      v->item[2].u.number = st->st_mtime;
-      vp->type = T_ARRAY;
-      vp->u.arr = v;
-    }
-  else
-    {
-      SET_SVALUE_MALLOC_STRING(vp, string_copy (str, "encode_stat"));
-    }
+  return strcmp (x->name, y->name);
 }
 
 static int
@@ -117,54 +100,24 @@ again:
     }
 }
 
-#if defined(F_GET_DIR) || defined(F_STAT)
+#if defined(F_GET_DIR) || defined(F_STAT) || defined(F_GET_DIR_ASYNC)
 /**
- * List files in directory. This function do same as standard list_files did,
- * but instead writing files right away to user this returns an array
- * containing those files. Actually most of code is copied from list_files()
- * function.
- * Behavior details:
+ * @brief Check and resolve the path of a get_dir() call.
  *
- *   - get_dir("/w"); get_dir("/w/"); and get_dir("/w/."); all return
- *     contents of directory "/w"
+ * Runs the master valid_read check (with "stat" as the caller, as MudOS
+ * does) and works out what scan_dir() has to look at. Does no file system
+ * access, so the scan itself can run on another thread.
  *
- *   - get_dir("/");, get_dir("."); and get_dir("/."); return contents
- *     of directory "/"
- *
- * With second argument equal to non-zero, instead of returning an array
- * of strings, the function will return an array of arrays about files.
- * The information in each array is supplied in the order:
- *    name of file,
- *    size of file,
- *    last update of file.
- * 
- * @param path The directory to list, or a file to stat.
- * @param flags If 0, return an array of file names. If -1, return an array of
- *       arrays with file information. Other values are reserved for future use.
- * @see docs/efuns/get_dir.md
+ * @param path The LPC path given to get_dir().
+ * @param flags The flags given to get_dir().
+ * @param q Receives the query.
+ * @returns 1 on success, 0 if the path is not allowed or cannot be resolved.
  */
-array_t* get_dir (const char *path, int flags) {
-  array_t *v;
-  int i, count = 0;
-#ifdef HAVE_DIRENT_H
-  DIR *dirp;
-  struct dirent *de;
-#elif _WIN32
-  HANDLE dirp;
-  WIN32_FIND_DATA findFileData;
-  char searchPath[PATH_MAX + 2];
-#endif
-  size_t namelen;
-  int do_match = 0;
-
-  struct stat st;
-  char *endtemp;
+int get_dir_query (const char *path, int flags, dir_query_t *q) {
   char temppath[PATH_MAX + 2];
-  char fs_path[PATH_MAX + 2];
-  char regexppath[PATH_MAX + 2];
-  char *p;
   const char *mudlib_dir;
   char *resolved_path;
+  char *p;
 
   if (!path)
     return 0;
@@ -186,9 +139,11 @@ array_t* get_dir (const char *path, int flags) {
   if (!resolved_path)
     return 0;
 
-  strncpy (fs_path, resolved_path, sizeof (fs_path) - 1);
-  fs_path[sizeof (fs_path) - 1] = '\0';
+  memset (q, 0, sizeof (*q));
+  strncpy (q->fs_path, resolved_path, sizeof (q->fs_path) - 1);
   FREE_MSTR (resolved_path);
+  q->with_stat = (flags == -1);
+  q->max_entries = (int) CONFIG_INT (__MAX_ARRAY_SIZE__);
 
   if (strlen (temppath) < 2)
     {
@@ -207,18 +162,82 @@ array_t* get_dir (const char *path, int flags) {
         *p = '\0';
     }
 
+  /* pattern to match in the parent if the path does not exist */
+  if (*p != '\0')
+    strcpy (q->pattern, (p != temppath) ? p + 1 : p);
+  /* name reported if the path is a file */
+  if (*p != '\0' && strcmp (temppath, "."))
+    {
+      q->may_be_file = 1;
+      strcpy (q->file_name, (*p == '/' && *(p + 1) != '\0') ? p + 1 : p);
+    }
+  return 1;
+}
+
+static int
+add_dir_entry (dir_listing_t *out, int *capacity, const char *name, int with_stat, struct stat *st)
+{
+  dir_entry_t *e;
+
+  if (out->count >= *capacity)
+    {
+      int new_capacity = *capacity ? *capacity * 2 : 32;
+      dir_entry_t *grown = (dir_entry_t *) DREALLOC (out->entries, new_capacity * sizeof (dir_entry_t),
+                                                  TAG_TEMPORARY, "scan_dir");
+      if (!grown)
+        return 0;
+      out->entries = grown;
+      *capacity = new_capacity;
+    }
+  e = &out->entries[out->count];
+  e->name = (char *) DMALLOC (strlen (name) + 1, TAG_TEMPORARY, "scan_dir");
+  if (!e->name)
+    return 0;
+  strcpy (e->name, name);
+  e->size = 0;
+  e->mtime = 0;
+  if (with_stat)
+    {
+      e->size = (st->st_mode & S_IFDIR) ? -2 : (long) st->st_size;
+      e->mtime = (long) st->st_mtime;
+    }
+  out->count++;
+  return 1;
+}
+
+/**
+ * @brief List the files a get_dir() query refers to.
+ *
+ * Touches only the file system and the C heap, so it is safe to call from
+ * a worker thread. The entries are sorted by name.
+ *
+ * @param q The query prepared by get_dir_query().
+ * @param out Receives the entries; release them with free_dir_listing().
+ * @returns 1 on success, 0 if there is nothing to list.
+ */
+int scan_dir (const dir_query_t *q, dir_listing_t *out) {
+#ifdef HAVE_DIRENT_H
+  DIR *dirp;
+  struct dirent *de;
+#elif _WIN32
+  HANDLE dirp;
+  WIN32_FIND_DATA findFileData;
+  char searchPath[PATH_MAX + 2];
+#endif
+  int do_match = 0;
+  int capacity = 0;
+  struct stat st;
+  char *endtemp;
+  char fs_path[PATH_MAX + 2];
+  const char *name;
+
+  memset (out, 0, sizeof (*out));
+  strcpy (fs_path, q->fs_path);
+
   if (stat (fs_path, &st) < 0)
     {
-      if (*p == '\0')
+      if (!q->pattern[0])
         return 0;
-      if (p != temppath)
-        {
-          strcpy (regexppath, p + 1);
-        }
-      else
-        {
-          strcpy (regexppath, p);
-        }
       {
         char *fs_parent = strrchr (fs_path, '/');
 
@@ -232,13 +251,15 @@ array_t* get_dir (const char *path, int flags) {
       }
       do_match = 1;
     }
-  else if (*p != '\0' && strcmp (temppath, ".") && !(st.st_mode & S_IFDIR))
+  else if (q->may_be_file && !(st.st_mode & S_IFDIR))
     {
-      if (*p == '/' && *(p + 1) != '\0')
-        p++;
-      v = allocate_empty_array (1);
-      encode_stat (&v->item[0], flags, p, &st);
-      return v;
+      out->found = 1;
+      if (!add_dir_entry (out, &capacity, q->file_name, q->with_stat, &st))
+        {
+          free_dir_listing (out);
+          return 0;
+        }
+      return 1;
     }
 #ifdef HAVE_DIRENT_H
   if ((dirp = opendir (fs_path)) == 0)
@@ -250,124 +271,138 @@ array_t* get_dir (const char *path, int flags) {
     return 0;
 #endif
 
-  /*
-   * Count files
-   */
+  out->found = 1;
+  endtemp = fs_path + strlen (fs_path);
+  strcat (endtemp++, "/");
+
 #ifdef HAVE_DIRENT_H
-  for (de = readdir (dirp); de; de = readdir (dirp))
+  for (de = readdir (dirp); de && out->count < q->max_entries; de = readdir (dirp))
     {
-      namelen = strlen (de->d_name);
-      if (!do_match && (strcmp (de->d_name, ".") == 0 ||
-                        strcmp (de->d_name, "..") == 0))
-        continue;
-      if (do_match && !match_string (regexppath, de->d_name))
-        continue;
-      count++;
-      if (count >= CONFIG_INT (__MAX_ARRAY_SIZE__))
-        break;
-    }
+      name = de->d_name;
 #elif _WIN32
   do
     {
-      namelen = strlen (findFileData.cFileName);
-      if (!do_match && (strcmp (findFileData.cFileName, ".") == 0 ||
-                        strcmp (findFileData.cFileName, "..") == 0))
-        continue;
-      if (do_match && !match_string (regexppath, findFileData.cFileName))
-        continue;
-      count++;
-      if (count >= CONFIG_INT (__MAX_ARRAY_SIZE__))
+      if (out->count >= q->max_entries)
         break;
-    } while (FindNextFile(dirp, &findFileData) != 0);
-#endif
-
-  /*
-   * Make array and put files on it.
-   */
-  v = allocate_empty_array (count);
-  if (count == 0)
-    {
-      /* This is the easy case :-) */
-#ifdef HAVE_DIRENT_H
-      closedir (dirp);
-#elif _WIN32
-      FindClose(dirp);
-#endif
-      return v;
-    }
-
-#ifdef HAVE_DIRENT_H
-  rewinddir (dirp);
-#elif _WIN32
-  FindClose(dirp);
-  dirp = FindFirstFile(searchPath, &findFileData);
+      name = findFileData.cFileName;
 #endif
-  endtemp = fs_path + strlen (fs_path);
-  strcat (endtemp++, "/");
-
-#ifdef HAVE_DIRENT_H
-  for (i = 0, de = readdir (dirp); i < count; de = readdir (dirp))
-    {
-      namelen = strlen (de->d_name);
-      if (!do_match && (strcmp (de->d_name, ".") == 0 ||
-                        strcmp (de->d_name, "..") == 0))
+      if (!do_match && (strcmp (name, ".") == 0 ||
+                        strcmp (name, "..") == 0))
         continue;
-      if (do_match && !match_string (regexppath, de->d_name))
+      if (do_match && !match_string (q->pattern, name))
         continue;
-      de->d_name[namelen] = '\0';
-      if (flags == -1)
+      if (q->with_stat)
         {
           /*
            * We'll have to .... sigh.... stat() the file to get some add'tl
            * info.
            */
-              strcpy (endtemp, de->d_name);
-              stat (fs_path, &st); /* We assume it works. */
+          strcpy (endtemp, name);
+          stat (fs_path, &st); /* We assume it works. */
         }
-      encode_stat (&v->item[i], flags, de->d_name, &st);
-      i++;
+      if (!add_dir_entry (out, &capacity, name, q->with_stat, &st))
+        break;
     }
+#ifdef HAVE_DIRENT_H
   closedir (dirp);
 #elif _WIN32
-  if (FindFirstFile(searchPath, &findFileData) != INVALID_HANDLE_VALUE)
+  while (FindNextFile(dirp, &findFileData) != 0);
+  FindClose(dirp);
+#endif
+
+  /* Sort the names. */
+  if (out->count > 1)
+    qsort ((void *) out->entries, out->count, sizeof out->entries[0], entrycmp);
+  return 1;
+}
+
+/**
+ * @brief Release the entries of a directory listing.
+ */
+void free_dir_listing (dir_listing_t *listing) {
+  int i;
+
+  for (i = 0; i < listing->count; i++)
+    FREE (listing->entries[i].name);
+  if (listing->entries)
+    FREE (listing->entries);
+  listing->entries = NULL;
+  listing->count = 0;
+}
+
+/**
+ * @brief Build the get_dir() result from a directory listing.
+ * @param listing The entries from scan_dir(), in order.
+ * @param with_stat Non-zero to return ({ name, size, mtime }) arrays.
+ * @returns A new array.
+ */
+array_t *dir_listing_to_array (const dir_listing_t *listing, int with_stat) {
+  array_t *v;
+  int i;
+
+  v = allocate_empty_array (listing->count);
+  for (i = 0; i < listing->count; i++)
     {
-      for (i = 0; i < count; )
+      const dir_entry_t *e = &listing->entries[i];
+
+      if (with_stat)
         {
-          namelen = strlen (findFileData.cFileName);
-          if (!do_match && (strcmp (findFileData.cFileName, ".") == 0 ||
-                            strcmp (findFileData.cFileName, "..") == 0))
-            {
-              if (FindNextFile(dirp, &findFileData) == 0)
-                break;
-              continue;
-            }
-          if (do_match && !match_string (regexppath, findFileData.cFileName))
-            {
-              if (FindNextFile(dirp, &findFileData) == 0)
-                break;
-              continue;
-            }
-          findFileData.cFileName[namelen] = '\0';
-          if (flags == -1)
-            {
-              /*
-               * We'll have to .... sigh.... stat() the file to get some add'tl
-               * info.
-               */
-              strcpy (endtemp, findFileData.cFileName);
-              stat (fs_path, &st); /* We assume it works. */
-            }
-          encode_stat (&v->item[i], flags, findFileData.cFileName, &st);
-          i++;
-          if (FindNextFile(dirp, &findFileData) == 0)
-            break;
+          array_t *info = allocate_empty_array (3);
+
+          SET_SVALUE_MALLOC_STRING(&info->item[0], string_copy (e->name, "get_dir"));
+          info->item[1].type = T_NUMBER;
+          info->item[1].u.number = e->size;
+          info->item[2].type = T_NUMBER;
+          info->item[2].u.number = e->mtime;
+          v->item[i].type = T_ARRAY;
+          v->item[i].u.arr = info;
+        }
+      else
+        {
+          SET_SVALUE_MALLOC_STRING(&v->item[i], string_copy (e->name, "get_dir"));
         }
-      FindClose(dirp);
     }
-#endif
+  return v;
+}
+#endif /* F_GET_DIR || F_STAT || F_GET_DIR_ASYNC */
 
-  /* Sort the names. */
-  qsort ((void *) v->item, count, sizeof v->item[0], (flags == -1) ? parrcmp : pstrcmp);
+#if defined(F_GET_DIR) || defined(F_STAT)
+/**
+ * List files in directory. This function do same as standard list_files did,
+ * but instead writing files right away to user this returns an array
+ * containing those files. Actually most of code is copied from list_files()
+ * function.
+ * Behavior details:
+ *
+ *   - get_dir("/w"); get_dir("/w/"); and get_dir("/w/."); all return
+ *     contents of directory "/w"
+ *
+ *   - get_dir("/");, get_dir("."); and get_dir("/."); return contents
+ *     of directory "/"
+ *
+ * With second argument equal to non-zero, instead of returning an array
+ * of strings, the function will return an array of arrays about files.
+ * The information in each array is supplied in the order:
+ *    name of file,
+ *    size of file,
+ *    last update of file.
+ * 
+ * @param path The directory to list, or a file to stat.
+ * @param flags If 0, return an array of file names. If -1, return an array of
+ *       arrays with file information. Other values are reserved for future use.
+ * @see docs/efuns/get_dir.md
+ */
+array_t* get_dir (const char *path, int flags) {
+  dir_query_t q;
+  dir_listing_t listing;
+  array_t *v;
+
+  if (!get_dir_query (path, flags, &q))
+    return 0;
+  if (!scan_dir (&q, &listing))
+    return 0;
+  v = dir_listing_to_array (&listing, q.with_stat);
+  free_dir_listing (&listing);
   return v;
 }
 #endif /* F_GET_DIR || F_STAT */
@@ -459,7 +494,10 @@ int do_tail_file (const char *path) {
 int do_remove_file (const char *path) {
   if (!push_resolved_valid_path (path, current_object, "rm", 1))
     return 0;
+  settle_saves (SVALUE_STRPTR (sp), 1);
   int rc = (unlink (SVALUE_STRPTR (sp)) != -1);
+  if (rc)
+    save_object_written (NULL, SVALUE_STRPTR (sp), 0);
   pop_stack ();
   return rc;
 }
@@ -489,6 +527,8 @@ int do_write_file (const char *file, const char *str, size_t len, int flags) {
     return 0;
   strncpy (resolved_path, SVALUE_STRPTR (sp), sizeof (resolved_path) - 1);
   resolved_path[sizeof (resolved_path) - 1] = '\0';
+  /* an overwrite replaces a queued save, an append goes after it */
+  settle_saves (resolved_path, flags & 1);
   f = fopen (SVALUE_STRPTR (sp), (flags & 1) ? "w" : "a");
   pop_stack ();
   if (f == 0)
@@ -499,6 +539,7 @@ int do_write_file (const char *file, const char *str, size_t len, int flags) {
     }
   n_written = fwrite (str, 1, len, f);
   fclose (f);
+  save_object_written (NULL, resolved_path, 0);
   return (n_written == len);
 }
 #endif /* F_WRITE_FILE */
@@ -527,6 +568,7 @@ malloc_str_t do_read_file (const char *path, long start, size_t len) {
   path_copy[PATH_MAX - 1] = '\0';
   if (!push_resolved_valid_path (path_copy, current_object, "read_file", 0))
     return 0;
+  settle_saves (SVALUE_STRPTR (sp), 0);
 
 #ifdef _WIN32
   fd = open (SVALUE_STRPTR (sp), O_RDONLY | O_TEXT);
@@ -713,6 +755,7 @@ malloc_str_t do_read_bytes (const char *file, long start, size_t len, size_t *rl
   resolved_path[sizeof (resolved_path) - 1] = '\0';
   FREE_MSTR (resolved);
 
+  settle_saves (resolved_path, 0);
   f = fopen (resolved_path, "rb");
   if (f == NULL)
     {
@@ -806,6 +849,7 @@ int do_write_bytes (const char *file, long start, const char *str, size_t theLen
   strncpy (resolved_path, SVALUE_STRPTR (sp), sizeof (resolved_path) - 1);
   resolved_path[sizeof (resolved_path) - 1] = '\0';
 
+  settle_saves (resolved_path, 0);
   fd = open (SVALUE_STRPTR (sp), O_CREAT | O_RDWR
 #ifndef _WIN32
     , S_IRUSR | S_IWUSR
@@ -819,6 +863,7 @@ int do_write_bytes (const char *file, long start, const char *str, size_t theLen
     }
 
   pop_stack (); /* done with path; fd is open */
+  save_object_written (NULL, resolved_path, 0);
   f = fdopen (fd, "r+");
   if (!f) {
     debug_perror ("fdopen()", file);
@@ -868,6 +913,7 @@ int get_file_size (const char *file) {
 
   if (!push_resolved_valid_path (file, current_object, "file_size", 0))
     return -1;
+  settle_saves (SVALUE_STRPTR (sp), 0);
 
   if (stat (SVALUE_STRPTR (sp), &st) == -1)
     ret = -1;
@@ -1002,6 +1048,10 @@ copy (const char *from, const char *to, const char *from_log)
 static int do_move_file (const char *from, const char *to, const char *from_log, const char *to_log, int flag) {
   if (flag == F_RENAME)
     {
+      settle_saves (from, 0);
+      settle_saves (to, 1);
+      save_object_written (NULL, from, 0);
+      save_object_written (NULL, to, 0);
       if (0 == rename (from, to))
         return 0;
 
@@ -1190,6 +1240,7 @@ int do_copy_file (const char *from, const char *to) {
   mudlib_dir = MAIN_OPTION (mudlib_dir_absolute);
   from_base = path_basename (from);
 
+  settle_saves (from, 0);
   from_fd = open (from, O_RDONLY);
   if (from_fd < 0)
     {
@@ -1213,6 +1264,8 @@ int do_copy_file (const char *from, const char *to) {
       to = newto;
     }
 
+  settle_saves (to, 1);
+  save_object_written (NULL, to, 0);
   to_fd = open (to, O_WRONLY | O_CREAT | O_TRUNC, 0666);
   if (to_fd < 0)
     {
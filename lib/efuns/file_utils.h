@@ -21,6 +21,28 @@
 extern "C" {
 #endif
 
+/* What get_dir() lists, worked out on the main thread by get_dir_query() */
+typedef struct {
+  char fs_path[PATH_MAX + 2];   /* host path of the directory or file */
+  char pattern[PATH_MAX + 2];   /* matched in the parent if fs_path does not exist */
+  char file_name[PATH_MAX + 2]; /* reported if fs_path is a file */
+  int may_be_file;
+  int with_stat;                /* flags == -1: also report size and mtime */
+  int max_entries;
+} dir_query_t;
+
+typedef struct {
+  char *name;
+  long size;                    /* -2 for directories */
+  long mtime;
+} dir_entry_t;
+
+typedef struct {
+  dir_entry_t *entries;
+  int count;
+  int found;
+} dir_listing_t;
+
 void dump_file_descriptors(outbuffer_t *);
 
 malloc_str_t do_read_file(const char *file, long start, size_t len);
@@ -28,6 +50,10 @@ malloc_str_t do_read_bytes(const char *file, long start, size_t len, size_t *rle
 int do_write_file(const char *file, const char *str, size_t len, int flags);
 int do_write_bytes(const char *file, long start, const char *buf, size_t len);
 array_t *get_dir(const char *path, int flag);
+int get_dir_query(const char *path, int flags, dir_query_t *q);
+int scan_dir(const dir_query_t *q, dir_listing_t *out);
+void free_dir_listing(dir_listing_t *listing);
+array_t *dir_listing_to_array(const dir_listing_t *listing, int with_stat);
 int do_tail_file(const char *file);
 int get_file_size(const char *file);
 int do_copy_file(const char *from, const char *to);
@@ -6,6 +6,7 @@
 #include "src/comm.h"
 #include "src/command.h"
 #include "lpc/array.h"
+#include "lpc/mapping.h"
 #include "lpc/object.h"
 
 #ifdef F_EXEC
@@ -201,6 +202,52 @@ f_query_idle (void)
 #endif
 
 
+#ifdef F_QUERY_COMMAND_STATS
+/**
+ * @brief Report command scheduling statistics of an interactive object.
+ *
+ * Returns 0 for non-interactive objects. Wait times are in microseconds,
+ * except wait_total which is in milliseconds.
+ */
+void
+f_query_command_stats (void)
+{
+  interactive_t *ip = sp->u.ob->interactive;
+  mapping_t *m;
+
+  if (!ip)
+    {
+      free_object (sp->u.ob, "f_query_command_stats");
+      *sp = const0;
+      return;
+    }
+
+  m = allocate_mapping (5);
+  add_mapping_pair (m, "commands", (int) ip->cmd_count);
+  add_mapping_pair (m, "wait_total", (int) (ip->cmd_wait_total / 1000));
+  add_mapping_pair (m, "wait_avg", ip->cmd_count ? (int) (ip->cmd_wait_total / ip->cmd_count) : 0);
+  add_mapping_pair (m, "wait_max", (int) ip->cmd_wait_max);
+  add_mapping_pair (m, "credit", (int) ip->cmd_deficit);
+  free_object (sp->u.ob, "f_query_command_stats");
+  sp--;
+  push_refed_mapping (m);
+}
+#endif
+
+
+#ifdef F_DUMP_USER_STATUS
+void
+f_dump_user_status (void)
+{
+  outbuffer_t out;
+
+  outbuf_zero (&out);
+  dump_user_status (&out);
+  outbuf_push (&out);
+}
+#endif
+
+
 /* Zakk - August 23 1995
  * return the port number the interactive object used to connect to the
  * mud.
@@ -57,16 +57,35 @@ f_socket_bind (void)
 
   fd = (int)(sp - 1)->u.number;
   get_socket_address (fd, addr, &port);
-
-  if (VALID_SOCKET ("bind"))
+  if (sp->type == T_STRING)
     {
-      i = socket_bind (fd, (int)sp->u.number);
-      (--sp)->u.number = i;
+      /*
+       * let the master see the address to be bound
+       */
+      const char *name = SVALUE_STRPTR (sp), *s;
+      size_t len = strlen (name);
+
+      port = 0;
+      if (strncmp (name, LOCAL_ADDR_PREFIX, sizeof (LOCAL_ADDR_PREFIX) - 1) != 0 &&
+          (s = strchr (name, ' ')))
+        {
+          len = (size_t) (s - name);
+          port = atoi (s + 1);
+        }
+      if (len > ADDR_BUF_SIZE - 1)
+        len = ADDR_BUF_SIZE - 1;
+      memcpy (addr, name, len);
+      addr[len] = '\0';
     }
+
+  if (!VALID_SOCKET ("bind"))
+    i = EESECURITY;
+  else if (sp->type == T_STRING)
+    i = socket_bind_address (fd, SVALUE_STRPTR (sp));
   else
-    {
-      (--sp)->u.number = EESECURITY;
-    }
+    i = socket_bind (fd, (int)sp->u.number);
+  pop_stack ();
+  sp->u.number = i;
 }
 #endif
 
@@ -140,7 +159,14 @@ f_socket_connect (void)
       int start = 0;
 
       addr[0] = '\0';
-      if ((s = strchr (SVALUE_STRPTR(sp - 2), ' ')))
+      if (strncmp (SVALUE_STRPTR(sp - 2), LOCAL_ADDR_PREFIX, sizeof (LOCAL_ADDR_PREFIX) - 1) == 0)
+        {
+          /*
+           * local socket path
+           */
+          strncat (addr, SVALUE_STRPTR(sp - 2), ADDR_BUF_SIZE - 1);
+        }
+      else if ((s = strchr (SVALUE_STRPTR(sp - 2), ' ')))
         {
           /*
            * use specified address and port
@@ -194,6 +220,38 @@ f_socket_write (void)
 }
 #endif
 
+#ifdef F_SOCKET_WRITE_BATCH
+void
+f_socket_write_batch (void)
+{
+  int i, fd, port;
+  char addr[ADDR_BUF_SIZE];
+
+  fd = (int)(sp - 1)->u.number;
+  get_socket_address (fd, addr, &port);
+
+  i = VALID_SOCKET ("write") ? socket_write_batch (fd, sp->u.arr) : EESECURITY;
+  pop_stack ();
+  sp->u.number = i;
+}
+#endif
+
+#ifdef F_SOCKET_SET_OPTION
+void
+f_socket_set_option (void)
+{
+  int fd, port;
+  char addr[ADDR_BUF_SIZE];
+
+  fd = (int)(sp - 2)->u.number;
+  get_socket_address (fd, addr, &port);
+
+  (sp - 2)->u.number = VALID_SOCKET ("set_option") ?
+    socket_set_option (fd, (int)(sp - 1)->u.number, sp->u.number) : EESECURITY;
+  sp -= 2;
+}
+#endif
+
 #ifdef F_SOCKET_CLOSE
 void
 f_socket_close (void)
@@ -296,7 +354,10 @@ void f_socket_address (void) {
       return;
     }
   get_socket_address ((int)sp->u.number, addr, &port);
-  snprintf (buf, sizeof (buf), "%s %d", addr, port);
+  if (strncmp (addr, LOCAL_ADDR_PREFIX, sizeof (LOCAL_ADDR_PREFIX) - 1) == 0)
+    snprintf (buf, sizeof (buf), "%s", addr);
+  else
+    snprintf (buf, sizeof (buf), "%s %d", addr, port);
   str = string_copy (buf, "f_socket_address");
   put_malloced_string (str);
 }				/* f_socket_address() */
@@ -923,10 +923,10 @@ f_flush_messages (void)
     {
       int i;
 
-      for (i = 0; i < max_users; i++)
+      for (i = 0; i < num_active_users; i++)
         {
-          if (all_users[i] && !(all_users[i]->iflags & CLOSING))
-            flush_message (all_users[i]);
+          if (!(active_users[i]->iflags & CLOSING))
+            flush_message (active_users[i]);
         }
     }
 }
@@ -22,6 +22,7 @@ f_store_variable (void)
   if (idx == -1)
     error ("No variable named '%s'!\n", SVALUE_STRPTR(sp - 1));
   sv = &current_object->variables[idx];
+  MARK_CHANGED (current_object);
   free_svalue (sv, "f_store_variable");
   *sv = *sp--;
   free_string_svalue (sp--);
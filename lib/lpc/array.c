@@ -64,6 +64,7 @@ array_t* allocate_array (size_t n) {
 #endif
   p = ALLOC_ARRAY (n);
   p->ref = 1;
+  p->changed = 0;
   p->size = (unsigned short)n;
   while (n--)
     p->item[n] = const0;
@@ -84,6 +85,7 @@ array_t* allocate_empty_array (size_t n) {
 #endif
   p = ALLOC_ARRAY (n);
   p->ref = 1;
+  p->changed = 0;
   p->size = (unsigned short)n;
   while (n--)
     p->item[n] = const0;
@@ -1600,6 +1602,7 @@ array_t* subtract_array (array_t * minuend, array_t * subtrahend) {
   difference = RESIZE_ARRAY (difference, msize);
   difference->size = (unsigned short)msize;
   difference->ref = 1;
+  difference->changed = 0;
 #ifdef ARRAY_STATS
   total_array_size += sizeof (array_t) + sizeof (svalue_t[1]) * (msize - 1);
   num_arrays++;
@@ -1788,6 +1791,7 @@ settle_business:
     }
   a3 = RESIZE_ARRAY (a3, l);
   a3->ref = 1;
+  a3->changed = 0;
   a3->size = (unsigned short)l;
 #ifdef ARRAY_STATS
   total_array_size += sizeof (array_t) + (l - 1) * sizeof (svalue_t);
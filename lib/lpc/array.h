@@ -12,6 +12,7 @@ struct array_s {
     int extra_ref;
 #endif
     unsigned short size;
+    unsigned int changed;       /* change_clock when an element was last assigned */
     svalue_t item[1];
 };
 
@@ -0,0 +1,328 @@
+#ifdef	HAVE_CONFIG_H
+#include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include "src/std.h"
+#include "misc/crc32.h"
+#include "array.h"
+#include "object.h"
+#include "rc/rc.h"
+#include "lpc/include/runtime_config.h"
+
+/*
+ * Checkpoint log
+ *
+ *   magic      CHECKPOINT_MAGIC followed by the version byte
+ *   records    until the end of the file
+ *
+ * A record is
+ *
+ *   mark       CHECKPOINT_RECORD_MARK
+ *   crc        CRC-32 of the rest of the record, 4 bytes little endian
+ *   key_len    4 bytes little endian
+ *   data_len   4 bytes little endian
+ *   key        the key of the object, "/" followed by its name by default
+ *   data       the object as save_object() would save it
+ *
+ * Records are only appended; the newest record with a key wins. A record
+ * torn by a crash or damaged later fails its CRC and is skipped, and the
+ * reader looks for the mark of the next record.
+ */
+#define CHECKPOINT_MAGIC	"\177NCK"
+#define CHECKPOINT_MAGIC_LEN	4
+#define CHECKPOINT_VERSION	1
+#define CHECKPOINT_HEADER_LEN	(CHECKPOINT_MAGIC_LEN + 1)
+
+#define CHECKPOINT_RECORD_MARK	"\177CKR"
+#define CHECKPOINT_RECORD_HEADER_LEN	16
+
+typedef struct {
+  size_t offset;		/* of the record in the log */
+  size_t size;			/* of the whole record */
+  const char *key;
+  size_t key_len;
+  const char *data;
+  size_t data_len;
+} checkpoint_record_t;
+
+int checkpoint_data_is_log (const char *data, size_t len) {
+  return len >= CHECKPOINT_HEADER_LEN && memcmp (data, CHECKPOINT_MAGIC, CHECKPOINT_MAGIC_LEN) == 0;
+}
+
+static void put_uint32 (unsigned char *p, uint32_t n) {
+  p[0] = (unsigned char) n;
+  p[1] = (unsigned char) (n >> 8);
+  p[2] = (unsigned char) (n >> 16);
+  p[3] = (unsigned char) (n >> 24);
+}
+
+static uint32_t get_uint32 (const unsigned char *p) {
+  return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+/* append a record for the object with the key to out */
+static void put_record (save_buffer_t * out, object_t * ob, const char *key, size_t key_len) {
+  save_buffer_t data;
+  unsigned char *rec;
+
+  save_object_to_buffer (ob, 0, &data);
+  save_buffer_reserve (out, CHECKPOINT_RECORD_HEADER_LEN + key_len + data.len);
+  rec = (unsigned char *) out->data + out->len;
+  memcpy (rec, CHECKPOINT_RECORD_MARK, 4);
+  put_uint32 (rec + 8, (uint32_t) key_len);
+  put_uint32 (rec + 12, (uint32_t) data.len);
+  memcpy (rec + CHECKPOINT_RECORD_HEADER_LEN, key, key_len);
+  memcpy (rec + CHECKPOINT_RECORD_HEADER_LEN + key_len, data.data, data.len);
+  put_uint32 (rec + 4, compute_crc32 (rec + 8, 8 + key_len + data.len));
+  out->len += CHECKPOINT_RECORD_HEADER_LEN + key_len + data.len;
+  FREE (data.data);
+}
+
+/*
+ * Find the next intact record at or after *pos in a log. Damaged bytes are
+ * skipped up to the next record mark.
+ */
+static int next_record (const char *buf, size_t len, size_t *pos, checkpoint_record_t * rec) {
+  const unsigned char *p;
+  const char *mark;
+  size_t key_len, data_len, room;
+
+  while (*pos + CHECKPOINT_RECORD_HEADER_LEN <= len)
+    {
+      p = (const unsigned char *) buf + *pos;
+      if (memcmp (p, CHECKPOINT_RECORD_MARK, 4) != 0)
+        {
+          if (!(mark = memchr (buf + *pos + 1, CHECKPOINT_RECORD_MARK[0], len - *pos - 1)))
+            break;
+          *pos = mark - buf;
+          continue;
+        }
+      key_len = get_uint32 (p + 8);
+      data_len = get_uint32 (p + 12);
+      room = len - *pos - CHECKPOINT_RECORD_HEADER_LEN;
+      if (key_len > room || data_len > room - key_len
+          || compute_crc32 ((unsigned char *) p + 8, 8 + key_len + data_len) != get_uint32 (p + 4))
+        {
+          opt_trace (TT_EVAL|1, "skipping damaged checkpoint record at offset %zu", *pos);
+          (*pos)++;
+          continue;
+        }
+      rec->offset = *pos;
+      rec->size = CHECKPOINT_RECORD_HEADER_LEN + key_len + data_len;
+      rec->key = (const char *) p + CHECKPOINT_RECORD_HEADER_LEN;
+      rec->key_len = key_len;
+      rec->data = rec->key + key_len;
+      rec->data_len = data_len;
+      *pos += rec->size;
+      return 1;
+    }
+  *pos = len;
+  return 0;
+}
+
+/**
+ * @brief Append the objects to a checkpoint log.
+ *
+ * All the records are written with one write and, if SaveObjectFsync is
+ * enabled, flushed to the disk with one fsync(). The log is created if it
+ * does not exist. Destructed objects are skipped.
+ *
+ * @param obs The objects.
+ * @param keys The keys of the objects, or NULL for "/" followed by their names.
+ * @param host_path The log.
+ * @returns The number of records written, or -1 if the log could not be written.
+ */
+int checkpoint_objects (array_t * obs, array_t * keys, const char *host_path) {
+  static save_buffer_t batch;	/* kept if an object cannot be saved */
+  char header[CHECKPOINT_HEADER_LEN];
+  const char *key;
+  size_t key_len, got;
+  int i, count = 0, err = 0;
+  FILE *f;
+
+  batch.len = 0;
+  for (i = 0; i < obs->size; i++)
+    {
+      object_t *ob;
+
+      if (obs->item[i].type != T_OBJECT || (obs->item[i].u.ob->flags & O_DESTRUCTED))
+        continue;
+      ob = obs->item[i].u.ob;
+      if (keys)
+        {
+          key = SVALUE_STRPTR (&keys->item[i]);
+          key_len = SVALUE_STRLEN (&keys->item[i]);
+          put_record (&batch, ob, key, key_len);
+        }
+      else
+        {
+          char *name = (char *) DMALLOC (strlen (ob->name) + 2, TAG_TEMPORARY, "checkpoint_objects");
+
+          key_len = sprintf (name, "/%s", ob->name);
+          put_record (&batch, ob, name, key_len);
+          FREE (name);
+        }
+      count++;
+    }
+  if (!count)
+    return 0;
+
+  f = fopen (host_path, "a+b");
+  if (!f)
+    err = errno;
+  else
+    {
+      got = fread (header, 1, sizeof (header), f);
+      if (got && !checkpoint_data_is_log (header, got))
+        {
+          fclose (f);
+          FREE (batch.data);
+          memset (&batch, 0, sizeof (batch));
+          error ("checkpoint_objects(): %s is not a checkpoint log.\n", host_path);
+        }
+      fseek (f, 0, SEEK_END);
+      if (!got)
+        {
+          memcpy (header, CHECKPOINT_MAGIC, CHECKPOINT_MAGIC_LEN);
+          header[CHECKPOINT_MAGIC_LEN] = CHECKPOINT_VERSION;
+          if (fwrite (header, 1, sizeof (header), f) != sizeof (header))
+            err = errno ? errno : EIO;
+        }
+      if (!err && (fwrite (batch.data, 1, batch.len, f) != batch.len || fflush (f) != 0))
+        err = errno ? errno : EIO;
+#ifdef _WIN32
+      else if (!err && CONFIG_INT (__ENABLE_SAVE_OBJECT_FSYNC__) && _commit (_fileno (f)) != 0)
+#else
+      else if (!err && CONFIG_INT (__ENABLE_SAVE_OBJECT_FSYNC__) && fsync (fileno (f)) != 0)
+#endif
+        err = errno;
+      if (fclose (f) != 0 && !err)
+        err = errno;
+    }
+  FREE (batch.data);
+  memset (&batch, 0, sizeof (batch));
+  /* even a failed append may have added a torn record */
+  save_object_written (NULL, host_path, 0);
+  if (err)
+    {
+      errno = err;
+      debug_perror ("checkpoint_objects()", host_path);
+      return -1;
+    }
+  return count;
+}
+
+/**
+ * @brief Restore an object from the newest record with its key in a log.
+ *
+ * @param ob The object.
+ * @param key The key, or NULL for "/" followed by the object name.
+ * @param buf The log, DMALLOC'd; it is modified, and freed if an error is raised.
+ * @param len Length of the log.
+ * @param noclear As for restore_object_from_data().
+ * @returns 1 if restored, 0 if no record has the key.
+ */
+int restore_object_checkpoint (object_t * ob, const char *key, char *buf, size_t len, int noclear) {
+  checkpoint_record_t rec, newest;
+  size_t pos = CHECKPOINT_HEADER_LEN;
+  size_t name_len = strlen (ob->name);
+  int found = 0;
+
+  while (next_record (buf, len, &pos, &rec))
+    {
+      if (key ? (rec.key_len == strlen (key) && memcmp (rec.key, key, rec.key_len) == 0)
+              : (rec.key_len == name_len + 1 && rec.key[0] == '/' && memcmp (rec.key + 1, ob->name, name_len) == 0))
+        {
+          newest = rec;
+          found = 1;
+        }
+    }
+  if (!found)
+    return 0;
+
+  opt_trace (TT_EVAL|1, "restoring %zu bytes from checkpoint record at offset %zu", newest.data_len, newest.offset);
+  memmove (buf, newest.data, newest.data_len);
+  buf[newest.data_len] = '\0';
+  restore_object_from_data (ob, buf, newest.data_len, noclear);
+  return 1;
+}
+
+static int compare_records (const void *a, const void *b) {
+  const checkpoint_record_t *r1 = *(const checkpoint_record_t * const *) a;
+  const checkpoint_record_t *r2 = *(const checkpoint_record_t * const *) b;
+  int d = memcmp (r1->key, r2->key, r1->key_len < r2->key_len ? r1->key_len : r2->key_len);
+
+  if (d)
+    return d;
+  if (r1->key_len != r2->key_len)
+    return r1->key_len < r2->key_len ? -1 : 1;
+  return r1->offset < r2->offset ? -1 : (r1->offset > r2->offset);
+}
+
+/**
+ * @brief Rewrite a checkpoint log with only the newest record of each key.
+ *
+ * Damaged records are dropped. The records kept stay in their order, and
+ * the log is replaced like a save file, so a crash leaves the old log.
+ *
+ * @param host_path The log.
+ * @returns The number of records kept, or -1 if the log could not be
+ *          written. Raises an error if the file is not a checkpoint log.
+ */
+int compact_checkpoint_log (const char *host_path) {
+  checkpoint_record_t rec, *recs, **sorted;
+  save_buffer_t out;
+  char *buf;
+  size_t len, pos, num = 0, i, kept = 0;
+  int err;
+
+  if (!(buf = read_save_file (host_path, &len)))
+    return 0;
+  if (!checkpoint_data_is_log (buf, len))
+    {
+      FREE (buf);
+      error ("compact_checkpoint_log(): %s is not a checkpoint log.\n", host_path);
+    }
+
+  for (pos = CHECKPOINT_HEADER_LEN; next_record (buf, len, &pos, &rec); )
+    num++;
+  recs = (checkpoint_record_t *) DCALLOC (num + 1, sizeof (checkpoint_record_t), TAG_TEMPORARY, "compact_checkpoint_log");
+  sorted = (checkpoint_record_t **) DCALLOC (num + 1, sizeof (checkpoint_record_t *), TAG_TEMPORARY, "compact_checkpoint_log");
+  for (pos = CHECKPOINT_HEADER_LEN, i = 0; i < num && next_record (buf, len, &pos, &recs[i]); i++)
+    sorted[i] = &recs[i];
+
+  /* keep the last record of each key, marked by clearing its key */
+  qsort (sorted, num, sizeof (checkpoint_record_t *), compare_records);
+  for (i = 0; i < num; i++)
+    if (i + 1 == num || sorted[i]->key_len != sorted[i + 1]->key_len
+        || memcmp (sorted[i]->key, sorted[i + 1]->key, sorted[i]->key_len) != 0)
+      {
+        sorted[i]->key = NULL;
+        kept++;
+      }
+
+  memset (&out, 0, sizeof (out));
+  save_buffer_reserve (&out, len);
+  memcpy (out.data, buf, CHECKPOINT_HEADER_LEN);
+  out.len = CHECKPOINT_HEADER_LEN;
+  for (i = 0; i < num; i++)
+    if (!recs[i].key)
+      {
+        memcpy (out.data + out.len, buf + recs[i].offset, recs[i].size);
+        out.len += recs[i].size;
+      }
+  FREE (sorted);
+  FREE (recs);
+  FREE (buf);
+
+  err = write_save_file (host_path, out.data, out.len, (int) CONFIG_INT (__ENABLE_SAVE_OBJECT_FSYNC__));
+  FREE (out.data);
+  save_object_written (NULL, host_path, 0);
+  if (err)
+    {
+      errno = err;
+      debug_perror ("compact_checkpoint_log()", host_path);
+      return -1;
+    }
+  return (int) kept;
+}
@@ -61,6 +61,22 @@ extern "C" {
 #define __RESOLVER_FORWARD_QUOTA__	CFG_INT(28)
 #define __RESOLVER_REVERSE_QUOTA__	CFG_INT(29)
 #define __RESOLVER_REFRESH_QUOTA__	CFG_INT(30)
+#define __DRIVER_STATS_LOG_INTERVAL__	CFG_INT(31)
+#define __COMMAND_QUANTUM__		CFG_INT(32)
+#define __COMMAND_CYCLE_BUDGET__	CFG_INT(33)
+#define __OUTPUT_HIGH_WATER__		CFG_INT(34)
+#define __OUTPUT_LOW_WATER__		CFG_INT(35)
+#define __OUTPUT_BUFFER_LIMIT__		CFG_INT(36)
+#define __MCCP_COMPRESSION_LEVEL__	CFG_INT(37)
+#define __INPUT_BUFFER_LIMIT__		CFG_INT(38)
+#define __CONNECTIONS_PER_CYCLE__	CFG_INT(39)
+#define __NETWORK_IO_THREADS__		CFG_INT(40)
+#define __SOCKET_SEND_QUEUE_LIMIT__	CFG_INT(41)
+#define __SOCKET_READ_BUDGET__		CFG_INT(42)
+#define __FILE_IO_THREADS__		CFG_INT(43)
+#define __ENABLE_SAVE_OBJECT_FSYNC__	CFG_INT(44)
+#define __ENABLE_ASYNC_SAVE_OBJECT__	CFG_INT(45)
+#define __ENABLE_BINARY_SAVE_OBJECT__	CFG_INT(46)
 
 #define RUNTIME_CONFIG_NEXT	CFG_INT(54)
 
@@ -0,0 +1,13 @@
+/*
+ * save_object.h -- flags of the save_object() efun.
+ */
+
+#ifndef	LPC_SAVE_OBJECT_H
+#define	LPC_SAVE_OBJECT_H
+
+#define SAVE_ZEROS	1	/* also save variables that are 0 */
+#define SAVE_BINARY	2	/* save in the binary format */
+#define SAVE_TEXT	4	/* save in the text format */
+#define SAVE_IF_CHANGED	8	/* skip the save if nothing changed since the last one */
+
+#endif	/* ! LPC_SAVE_OBJECT_H */
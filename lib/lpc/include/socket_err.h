@@ -45,8 +45,9 @@ extern "C" {
 #define EESOCKNOTRLSD   -31	/* Socket not released */
 #define EEBADDATA       -32	/* sending data with too many nested levels */
 #define EERESOLVERBUSY  -33	/* Name resolver admission control at capacity */
+#define EEQUEUEFULL     -34	/* Send queue is full */
 
-#define	ERROR_STRINGS	 34	/* sizeof (error_strings) */
+#define	ERROR_STRINGS	 35	/* sizeof (error_strings) */
 
 
 #ifdef __cplusplus
@@ -0,0 +1,12 @@
+/*
+ * socket_opt.h -- options of the socket_set_option() efun.
+ */
+
+#ifndef	LPC_SOCKET_OPT_H
+#define	LPC_SOCKET_OPT_H
+
+#define SOCKOPT_READ_BUDGET	 1	/* bytes read per read event (STREAM) */
+#define SOCKOPT_SEND_QUEUE_LIMIT 2	/* bytes queued by socket_write() */
+#define SOCKOPT_RECV_BATCH	 3	/* datagrams per read callback (DATAGRAM) */
+
+#endif	/* ! LPC_SOCKET_OPT_H */
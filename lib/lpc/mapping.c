@@ -225,6 +225,7 @@ mapping_t *allocate_mapping (size_t n) {
   memset (a, 0, n);
   total_mapping_size += (int)(sizeof (mapping_t) + n);
   newmap->ref = 1;
+  newmap->changed = 0;
   newmap->count = 0;
   num_mappings++;
   return newmap;
@@ -246,6 +247,7 @@ mapping_t* copyMapping (mapping_t * m) {
   newmap->table_size = (unsigned short)k++;
   newmap->unfilled = m->unfilled;
   newmap->ref = 1;
+  newmap->changed = 0;
   c = newmap->table = CALLOCATE (k, mapping_node_t *, TAG_MAP_TBL, "copy_mapping: 2");
   if (!c)
     {
@@ -347,6 +349,7 @@ void mapping_delete (mapping_t * m, svalue_t * lv) {
                   m->unfilled++;
                 }
               m->count--;
+              MARK_CHANGED (m);
               total_mapping_nodes--;
               total_mapping_size -= sizeof (mapping_node_t);
               free_svalue (elt->values + 1, "mapping_delete");
@@ -374,6 +377,7 @@ svalue_t* find_for_insert (mapping_t * m, svalue_t * lv, int doTheFree) {
   unsigned short i = oi & m->table_size;
   mapping_node_t *n, *newnode, **a = m->table + i;
 
+  MARK_CHANGED (m);
   if ((n = *a))
     {
       do
@@ -914,6 +918,7 @@ static void unique_add_to_mapping (mapping_t * m1, mapping_t * m2, int free_flag
 }
 
 void absorb_mapping (mapping_t * m1, mapping_t * m2) {
+  MARK_CHANGED (m1);
   if (m2->count)
     add_to_mapping (m1, m2, 0);
 }
@@ -1241,6 +1246,16 @@ void add_mapping_array (mapping_t * m, const char *key, array_t * value) {
   value->ref++;
 }
 
+void add_mapping_mapping (mapping_t * m, const char *key, mapping_t * value) {
+  svalue_t *s;
+
+  s = insert_in_mapping (m, key);
+  s->type = T_MAPPING;
+  s->subtype = 0;
+  s->u.map = value;
+  value->ref++;
+}
+
 void add_mapping_shared_string (mapping_t * m, char *key, char *value) {
   svalue_t *s;
 
@@ -27,6 +27,7 @@ typedef struct mapping_node_block_s {
 
 struct mapping_s {
     unsigned short ref;         /* how many times this map has been referenced */
+    unsigned int changed;       /* change_clock when an entry was last added, assigned or deleted */
 #ifdef DEBUG
     int extra_ref;
 #endif
@@ -74,6 +75,7 @@ void add_mapping_pair(mapping_t *, const char *, int);
 void add_mapping_string(mapping_t *, const char *, const char *);
 void add_mapping_object(mapping_t *, const char *, object_t *);
 void add_mapping_array(mapping_t *, const char *, array_t *);
+void add_mapping_mapping(mapping_t *, const char *, mapping_t *);
 void add_mapping_shared_string(mapping_t *, char *, char *);
 
 int growMap (mapping_t * m);
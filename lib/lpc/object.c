@@ -17,6 +17,7 @@
 #include "src/simul_efun.h"
 #include "lpc/include/origin.h"
 #include "lpc/include/runtime_config.h"
+#include "lpc/include/save_object.h"
 #include "src/call_out.h"
 #include "socket/socket_efuns.h"
 #ifdef HAVE_CURL
@@ -31,6 +32,14 @@
 
 size_t tot_alloc_object = 0, tot_alloc_object_size = 0;
 
+unsigned int change_clock = 1;	/* 0 is the stamp of new arrays and mappings */
+static unsigned int save_epoch;	/* save records of an older epoch are void */
+int saves_skipped = 0;		/* save_object() calls skipped by SAVE_IF_CHANGED */
+
+/* save_object() writes per save file, hashed by path */
+#define SAVE_SERIAL_TABLE_SIZE 1024
+static unsigned int save_serial[SAVE_SERIAL_TABLE_SIZE];
+
 static int restore_array (const char **str, svalue_t *);
 static int restore_class (const char **str, svalue_t *);
 static int restore_interior_string (const char **val, svalue_t * sv);
@@ -1456,28 +1465,52 @@ void restore_object_from_buff (object_t * ob, char *theBuff, int noclear) {
     }
 }
 
+/* make room for at least more bytes (and a terminating NUL) in a save buffer */
+void save_buffer_reserve (save_buffer_t * out, size_t more) {
+  size_t size;
+
+  if (out->len + more + 1 <= out->size)
+    return;
+  size = out->size ? out->size : 1024;
+  while (size < out->len + more + 1)
+    size *= 2;
+  out->data = (char *) DREALLOC (out->data, size, TAG_TEMPORARY, "save_object: buffer");
+  out->size = size;
+}
+
+/**
+ * @brief Append a variable to text save data, as a "name value" line.
+ */
+void save_text_variable (save_buffer_t * out, const char *name, const svalue_t * v) {
+  size_t theSize, name_len;
+  char *p;
+
+  save_svalue_depth = 0;
+  theSize = svalue_save_size (v);
+  name_len = strlen (name);
+  save_buffer_reserve (out, name_len + 1 + theSize + 1);
+  memcpy (out->data + out->len, name, name_len);
+  out->data[out->len + name_len] = ' ';
+  p = out->data + out->len + name_len + 1;
+  save_svalue (v, &p);
+  *p++ = '\n';
+  out->len = p - out->data;
+}
+
 /*
- * Save an object to a file.
- * The routine checks with the function "valid_write()" in /obj/master.c
- * to assertain that the write is legal.
- * If 'save_zeros' is set, 0 valued variables will be saved
+ * Save the variables of an object.
+ * If SAVE_ZEROS is set, 0 valued variables will be saved
  */
-static int save_object_recurse (program_t * prog, svalue_t ** svp, int type, int save_zeros, FILE * f) {
+static void save_object_recurse (program_t * prog, svalue_t ** svp, int type, int flags, save_buffer_t * out) {
   int i;
-  size_t theSize;
-  char *new_str, *p;
+  size_t start;
 
   for (i = 0; i < prog->num_inherited; i++)
-    {
-      if (!save_object_recurse (prog->inherit[i].prog, svp,
-                                prog->inherit[i].type_mod | type,
-                                save_zeros, f))
-        return 0;
-    }
+    save_object_recurse (prog->inherit[i].prog, svp, prog->inherit[i].type_mod | type, flags, out);
   if (type & NAME_STATIC)
     {
       (*svp) += prog->num_variables_defined;
-      return 1;
+      return;
     }
   for (i = 0; i < prog->num_variables_defined; i++)
     {
@@ -1486,127 +1519,321 @@ static int save_object_recurse (program_t * prog, svalue_t ** svp, int type, int
           (*svp)++;
           continue;
         }
-      save_svalue_depth = 0;
-      theSize = svalue_save_size (*svp);
-      new_str = (char *) DXALLOC (theSize, TAG_TEMPORARY, "save_object: 2");
-      *new_str = '\0';
-      p = new_str;
-      save_svalue ((*svp)++, &p);
-      /* FIXME: shouldn't use fprintf() */
-      if (save_zeros || new_str[0] != '0' || new_str[1] != 0)	/* Armidale */
-        if (fprintf (f, "%s %s\n", prog->variable_table[i], new_str) < 0)
-          {
-            debug_perror ("save_object: fprintf", 0);
-            return 0;
-          }
-      FREE (new_str);
+      if (flags & SAVE_BINARY)
+        {
+          if ((flags & SAVE_ZEROS) || (*svp)->type != T_NUMBER || (*svp)->u.number)
+            save_binary_variable (out, prog->variable_table[i], *svp);
+          (*svp)++;
+          continue;
+        }
+      start = out->len;
+      save_text_variable (out, prog->variable_table[i], (*svp)++);
+      if (!(flags & SAVE_ZEROS) && out->len - start == strlen (prog->variable_table[i]) + 3
+          && out->data[out->len - 2] == '0')	/* Armidale */
+        out->len = start;	/* drop "name 0" */
     }
-  return 1;
+}
+
+/**
+ * @brief Serialize the non-static variables of an object as save_object() writes them.
+ *
+ * The format is binary if flags has SAVE_BINARY, text if it has SAVE_TEXT,
+ * and otherwise chosen by the BinarySaveObject setting.
+ *
+ * @param ob The object.
+ * @param flags SAVE_* flags of save_object().
+ * @param out Receives the data, NUL terminated; release out->data with FREE().
+ */
+void save_object_to_buffer (object_t * ob, int flags, save_buffer_t * out) {
+  svalue_t *v = ob->variables;
+  size_t header_len = strlen (ob->prog->name) + 3;
+
+  if (!(flags & (SAVE_BINARY | SAVE_TEXT)) && CONFIG_INT (__ENABLE_BINARY_SAVE_OBJECT__))
+    flags |= SAVE_BINARY;
+  memset (out, 0, sizeof (*out));
+  if (flags & SAVE_BINARY)
+    save_binary_header (out, ob->prog->name);
+  else
+    {
+      save_buffer_reserve (out, header_len);
+      out->len = snprintf (out->data, header_len + 1, "#/%s\n", ob->prog->name);
+    }
+  save_object_recurse (ob->prog, &v, 0, flags, out);
+  out->data[out->len] = '\0';
 }
 
 static size_t sel = (size_t)-1; /* save extension length */
 
 /**
- * @brief Save an object to a file.
- * @returns 1 on success, 0 on failure.
+ * @brief Find the save file of an object and check that it may be used.
+ *
+ * Adds SAVE_EXTENSION to the file name, in place of a ".c" suffix, and asks
+ * the master object for permission.
+ *
+ * @param ob The object saving or restoring.
+ * @param file The file name given to save_object() or restore_object().
+ * @param call_fun "save_object" or "restore_object".
+ * @param writeflg Non-zero when writing.
+ * @param host_path Receives the absolute path, at least PATH_MAX bytes.
+ * @returns 1 if allowed, 0 otherwise.
  */
-int save_object (object_t * ob, const char *file, int save_zeros) {
-
+int save_object_path (object_t * ob, const char *file, const char *call_fun, int writeflg, char *host_path) {
   char *name;
-  static char tmp_name[PATH_MAX];
   size_t len;
-  FILE *f;
-  int success;
-  svalue_t *v;
-
-  if (ob->flags & O_DESTRUCTED)
-    return 0;
+  int ok;
 
   len = strlen (file);
-  if (file[len - 2] == '.' && file[len - 1] == 'c')
+  if (len >= 2 && file[len - 2] == '.' && file[len - 1] == 'c')
     len -= 2; /* strip .c */
 
   if (sel == (size_t)-1)
     sel = strlen (SAVE_EXTENSION);
-  if (strcmp (file + len - sel, SAVE_EXTENSION) == 0)
+  if (len >= sel && strncmp (file + len - sel, SAVE_EXTENSION, sel) == 0)
     len -= sel; /* strip SAVE_EXTENSION if already present */
 
-  name = new_string (len + strlen (SAVE_EXTENSION), "save_object");
-  strcpy (name, file);
+  name = new_string (len + strlen (SAVE_EXTENSION), "save_object_path");
+  strncpy (name, file, len);
   strcpy (name + len, SAVE_EXTENSION);
   push_malloced_string (name);	/* errors: sp -> name */
 
-  if (!push_resolved_valid_path (name, ob, "save_object", 1))
+  ok = push_resolved_valid_path (name, ob, call_fun, writeflg);
+  if (ok)
     {
-      /* sp -> name only; push_resolved_valid_path didn't push */
-      free_string_svalue (sp--);
-      return 0;
+      /* sp -> absolute file path, sp-1 -> name */
+      if (snprintf (host_path, PATH_MAX, "%s", SVALUE_STRPTR (sp)) >= PATH_MAX)
+        ok = 0;
+      pop_stack ();
     }
-  /* sp -> absolute file path, sp-1 -> name */
-  file = SVALUE_STRPTR (sp);
+  free_string_svalue (sp--);
+  return ok;
+}
+
+/**
+ * @brief Replace a save file with new contents.
+ *
+ * Writes a temporary file next to it, optionally flushes it to the disk,
+ * and renames it over the save file. Does not touch LPC data, so it may be
+ * called from a file I/O thread.
+ *
+ * @returns 0 on success, or the errno of the failed step.
+ */
+int write_save_file (const char *host_path, const char *data, size_t len, int do_fsync) {
+  char tmp_name[PATH_MAX + 8];
+  FILE *f;
+  int err = 0;
 
   /*
    * Write the save-files to different directories, just in case
    * they are on different file systems.
    */
-  if (snprintf (tmp_name, sizeof(tmp_name), "%s.tmp", file) >= (int)sizeof(tmp_name))
-    {
-      pop_stack ();
-      free_string_svalue (sp--);
-      return 0;
-    }
+  if (snprintf (tmp_name, sizeof (tmp_name), "%s.tmp", host_path) >= (int) sizeof (tmp_name))
+    return ENAMETOOLONG;
 
-  opt_trace (TT_EVAL|1, "creating tmp file: %s", tmp_name);
-  f = fopen (tmp_name, "w");
+  f = fopen (tmp_name, save_data_is_binary (data, len) || checkpoint_data_is_log (data, len) ? "wb" : "w");
   if (!f)
+    return errno;
+  if (fwrite (data, 1, len, f) != len || fflush (f) != 0)
+    err = errno ? errno : EIO;
+#ifdef _WIN32
+  else if (do_fsync && _commit (_fileno (f)) != 0)
+#else
+  else if (do_fsync && fsync (fileno (f)) != 0)
+#endif
+    err = errno;
+  if (fclose (f) != 0 && !err)
+    err = errno;
+  if (err)
     {
-      debug_perror ("fopen()", tmp_name);
-      pop_stack ();
-      free_string_svalue (sp--);
-      return 0;  
+      FILE_UNLINK (tmp_name);
+      return err;
+    }
+#ifdef _WIN32
+  /* Need to erase it to write over it. */
+  FILE_UNLINK (host_path);
+#endif
+  if (rename (tmp_name, host_path) < 0)
+    {
+      err = errno;
+      FILE_UNLINK (tmp_name);
     }
+  return err;
+}
+
+/* the SAVE_* flags that decide the contents of a save file */
+static int save_format (int flags) {
+  if (!(flags & (SAVE_BINARY | SAVE_TEXT)) && CONFIG_INT (__ENABLE_BINARY_SAVE_OBJECT__))
+    flags |= SAVE_BINARY;
+  return (flags & SAVE_ZEROS) | ((flags & SAVE_BINARY) ? SAVE_BINARY : SAVE_TEXT);
+}
+
+/* has an array, class or mapping in v been written after the clock was at since? */
+static int svalue_changed_since (const svalue_t * v, unsigned int since, int depth) {
+  mapping_node_t *node;
+  int i;
 
-  if (fprintf (f, "#/%s\n", ob->prog->name) < 0)
+  switch (v->type)
     {
-      debug_perror ("Could not write save_object() header", tmp_name);
-      pop_stack ();
-      free_string_svalue (sp--);
+    case T_ARRAY:
+    case T_CLASS:
+      if (v->u.arr->changed > since || depth >= MAX_SAVE_SVALUE_DEPTH)
+        return 1;
+      for (i = 0; i < v->u.arr->size; i++)
+        if (svalue_changed_since (&v->u.arr->item[i], since, depth + 1))
+          return 1;
+      return 0;
+    case T_MAPPING:
+      if (v->u.map->changed > since || depth >= MAX_SAVE_SVALUE_DEPTH)
+        return 1;
+      for (i = 0; i <= v->u.map->table_size; i++)
+        for (node = v->u.map->table[i]; node; node = node->next)
+          if (svalue_changed_since (&node->values[0], since, depth + 1)
+              || svalue_changed_since (&node->values[1], since, depth + 1))
+            return 1;
+      return 0;
+    default:
       return 0;
     }
+}
 
-  v = ob->variables;
-  success = save_object_recurse (ob->prog, &v, 0, save_zeros, f);
+static int variables_changed_since (program_t * prog, svalue_t ** svp, int type, unsigned int since) {
+  int i;
 
-  if (fclose (f) < 0)
+  for (i = 0; i < prog->num_inherited; i++)
+    if (variables_changed_since (prog->inherit[i].prog, svp, prog->inherit[i].type_mod | type, since))
+      return 1;
+  if (type & NAME_STATIC)
     {
-      debug_perror ("fclose()", tmp_name);
-      success = 0;
+      (*svp) += prog->num_variables_defined;
+      return 0;
     }
+  for (i = 0; i < prog->num_variables_defined; i++, (*svp)++)
+    if (!(prog->variable_types[i] & NAME_STATIC) && svalue_changed_since (*svp, since, 0))
+      return 1;
+  return 0;
+}
+
+static save_record_t *find_save_record (object_t * ob, const char *host_path) {
+  save_record_t *rec;
+
+  for (rec = ob->save_records; rec; rec = rec->next)
+    if (strcmp (rec->path, host_path) == 0)
+      break;
+  return rec;
+}
+
+/**
+ * @brief Check whether a save_object() may be skipped.
+ *
+ * With SAVE_IF_CHANGED in flags, the save is skipped if the object saved
+ * itself to host_path in the same format before, nothing else wrote the file
+ * through the driver since, and neither the object's variables nor the arrays
+ * and mappings in its non-static variables were written since. Counts the
+ * skipped saves in saves_skipped.
+ *
+ * @returns 1 if the save may be skipped, 0 otherwise.
+ */
+int save_object_unchanged (object_t * ob, const char *host_path, int flags) {
+  save_record_t *rec;
+  svalue_t *v = ob->variables;
+
+  if (!(flags & SAVE_IF_CHANGED))
+    return 0;
+  rec = find_save_record (ob, host_path);
+  if (!rec || rec->epoch != save_epoch || rec->format != save_format (flags)
+      || rec->serial != save_serial[hashstr (host_path, PATH_MAX, SAVE_SERIAL_TABLE_SIZE)]
+      || ob->changed > rec->saved_at
+      || variables_changed_since (ob->prog, &v, 0, rec->saved_at))
+    return 0;
+  saves_skipped++;
+  return 1;
+}
 
-  if (!success)
+/**
+ * @brief Note that a save file was written, or queued to be written.
+ *
+ * Remembers the save for save_object_unchanged() if flags has
+ * SAVE_IF_CHANGED or the object saved to the file with it before, and makes
+ * the saves of other objects to the same file count as changed.
+ *
+ * @param ob The object saved, or NULL if the file was written otherwise.
+ * @param host_path The save file.
+ * @param flags SAVE_* flags of the save.
+ */
+void save_object_written (object_t * ob, const char *host_path, int flags) {
+  unsigned int serial = ++save_serial[hashstr (host_path, PATH_MAX, SAVE_SERIAL_TABLE_SIZE)];
+  save_record_t *rec = NULL;
+
+  if (ob && !(rec = find_save_record (ob, host_path)) && (flags & SAVE_IF_CHANGED))
     {
-      debug_message ("Failed to completely save file. Disk could be full.\n");
-      FILE_UNLINK (tmp_name);
+      rec = (save_record_t *) DMALLOC (sizeof (save_record_t) + strlen (host_path), TAG_TEMPORARY, "save_object_written");
+      strcpy (rec->path, host_path);
+      rec->next = ob->save_records;
+      ob->save_records = rec;
     }
-  else
+  if (rec)
     {
-#ifdef WIN32
-      /* Need to erase it to write over it. */
-      FILE_UNLINK (file);
-#endif
-      opt_trace (TT_EVAL|1, "renaming %s to %s", tmp_name, file);
-      if (rename (tmp_name, file) < 0)
-        {
-          debug_perror ("rename()", file);
-          debug_message ("save_obecjt(): Failed to rename /%s to /%s", tmp_name, file);
-          FILE_UNLINK (tmp_name);
-          success = 0;
-        }
+      rec->saved_at = change_clock;
+      rec->epoch = save_epoch;
+      rec->serial = serial;
+      rec->format = save_format (flags);
     }
+  /* later writes get newer stamps than the save */
+  if (++change_clock == 0)
+    {
+      change_clock = 1;
+      forget_saved_objects ();
+    }
+}
 
-  pop_stack ();			/* absolute file path; done */
-  free_string_svalue (sp--);
-  return success ? 1 : 0;
+/**
+ * @brief Make the next SAVE_IF_CHANGED save of every object write its file.
+ *
+ * Called when a queued save could not be written.
+ */
+void forget_saved_objects (void) {
+  save_epoch++;
+}
+
+void free_save_records (object_t * ob) {
+  save_record_t *rec;
+
+  while ((rec = ob->save_records))
+    {
+      ob->save_records = rec->next;
+      FREE (rec);
+    }
+}
+
+/**
+ * @brief Save an object to a file.
+ * The routine checks with the function "valid_write()" in the master object
+ * to assertain that the write is legal.
+ * @returns 1 on success, 0 on failure.
+ */
+int save_object (object_t * ob, const char *file, int flags) {
+  char host_path[PATH_MAX];
+  save_buffer_t buf;
+  int err;
+
+  if (ob->flags & O_DESTRUCTED)
+    return 0;
+  if (!save_object_path (ob, file, "save_object", 1, host_path))
+    return 0;
+  if (save_object_unchanged (ob, host_path, flags))
+    return 1;
+
+  save_object_to_buffer (ob, flags, &buf);
+  opt_trace (TT_EVAL|1, "saving %zu bytes to: %s", buf.len, host_path);
+  err = write_save_file (host_path, buf.data, buf.len, (int) CONFIG_INT (__ENABLE_SAVE_OBJECT_FSYNC__));
+  FREE (buf.data);
+  if (err)
+    {
+      errno = err;
+      debug_perror ("save_object()", host_path);
+      return 0;
+    }
+  save_object_written (ob, host_path, flags);
+  return 1;
 }
 
 
@@ -1661,96 +1888,139 @@ static void clear_non_statics (object_t * ob) {
   cns_recurse (ob, &idx, ob->prog);
 }
 
-int restore_object (object_t * ob, const char *file, int noclear) {
-
-  char *name, *theBuff;
-  size_t len;
-  int i;
-  FILE *f;
+/**
+ * @brief Restore the variables of an object from save_object() data.
+ *
+ * The data may be in the text or the binary format.
+ *
+ * @param ob The object.
+ * @param buf The data, DMALLOC'd and NUL terminated; it is modified, and freed
+ *        if an error is raised.
+ * @param len Length of the data.
+ * @param noclear Non-zero to keep the values of variables not in the data.
+ */
+void restore_object_from_data (object_t * ob, char *buf, size_t len, int noclear) {
   object_t *save = current_object;
-  struct stat st;
-  size_t n_read;
-
-  if (ob->flags & O_DESTRUCTED)
-    return 0;
 
-  len = strlen (file);
-  if (file[len - 2] == '.' && file[len - 1] == 'c')
-    len -= 2;
-
-  if (sel == (size_t)-1)
-    sel = strlen (SAVE_EXTENSION);
-  if (strcmp (file + len - sel, SAVE_EXTENSION) == 0)
-    len -= sel;
+  current_object = ob;
+  MARK_CHANGED (ob);
 
-  name = new_string (len + strlen (SAVE_EXTENSION), "restore_object");
-  strncpy (name, file, len);
-  strcpy (name + len, SAVE_EXTENSION);
+  /* This next bit added by Armidale@Cyberworld 1/1/93
+   * If 'noclear' flag is not set, all non-static variables will be
+   * initialized to 0 when restored.
+   */
+  if (!noclear)
+    clear_non_statics (ob);
 
-  push_malloced_string (name);	/* errors: sp -> name */
+  if (save_data_is_binary (buf, len))
+    restore_object_binary (ob, buf, len);
+  else
+    restore_object_from_buff (ob, buf, noclear);
+  current_object = save;
+}
 
-  if (!push_resolved_valid_path (name, ob, "restore_object", 0))
-    {
-      free_string_svalue (sp--);
-      error ("Denied read permission in restore_object().\n");
-    }
-  /* sp -> absolute file path, sp-1 -> name */
-  file = SVALUE_STRPTR (sp);
+/**
+ * @brief Read a save file into memory.
+ * @param host_path The file.
+ * @param len Receives the length of the data.
+ * @returns The data, DMALLOC'd and NUL terminated, or NULL if the file is
+ *          missing or empty. Raises an error if it cannot be read.
+ */
+char *read_save_file (const char *host_path, size_t *len) {
+  char *theBuff;
+  int i;
+  FILE *f;
+  struct stat st;
+  size_t n_read;
 
-  opt_trace (TT_EVAL|1, "restoring object from file: %s", file);
-  f = fopen (file, "r");
+  f = fopen (host_path, "rb");
   if (!f || fstat (FILENO(f), &st) == -1)
     {
       if (f)
         (void) fclose (f);
-      pop_stack ();
-      free_string_svalue (sp--);
-      return 0;
+      return NULL;
     }
 
   if (!(i = st.st_size))
     {
       (void) fclose (f);
-      pop_stack ();
-      free_string_svalue (sp--);
-      return 0;
+      return NULL;
     }
   theBuff = DXALLOC (i + 1, TAG_TEMPORARY, "restore_object: 4");
   opt_trace (TT_EVAL|1, "reading %d bytes of saved data", i);
   n_read = fread (theBuff, 1, i, f);
-  fclose (f);
-#ifdef _WIN32
-  /* On Windows, fread may read less than requested even at EOF */
-  if (n_read > 0 && feof(f))
-#else
   if (n_read != (size_t)i)
-#endif
     {
+      fclose (f);
       FREE (theBuff);
-      debug_perror ("restore_object()", SVALUE_STRPTR (sp));
-      pop_stack ();
-      free_string_svalue (sp--);
+      debug_perror ("restore_object()", host_path);
       error ("restore_object(): Read error.\n");
     }
-  pop_stack ();			/* absolute file path; done */
-  free_string_svalue (sp--);	/* name */
+  fclose (f);
   theBuff[n_read] = '\0';
-  current_object = ob;
+#ifdef _WIN32
+  /* text save files are written with CRLF line ends */
+  if (!save_data_is_binary (theBuff, n_read) && !checkpoint_data_is_log (theBuff, n_read))
+    {
+      char *in, *out;
 
-  /* This next bit added by Armidale@Cyberworld 1/1/93
-   * If 'noclear' flag is not set, all non-static variables will be
-   * initialized to 0 when restored.
-   */
-  if (!noclear)
-    clear_non_statics (ob);
+      for (in = out = theBuff; *in; in++)
+        if (!(in[0] == '\r' && in[1] == '\n'))
+          *out++ = *in;
+      *out = '\0';
+      n_read = out - theBuff;
+    }
+#endif
+  *len = n_read;
+  return theBuff;
+}
 
-  restore_object_from_buff (ob, theBuff, noclear);
-  current_object = save;
+/**
+ * @brief Restore an object from a save file already checked with save_object_path().
+ *
+ * If the file is a checkpoint log, the newest record with the key is used.
+ *
+ * @param key Key of the record in a checkpoint log, or NULL for "/" followed
+ *        by the object name.
+ * @returns 1 on success, 0 if the file is missing or empty, or the log has
+ *          no record with the key.
+ */
+int restore_object_file (object_t * ob, const char *host_path, int noclear, const char *key) {
+  char *theBuff;
+  size_t len;
+
+  if (ob->flags & O_DESTRUCTED)
+    return 0;
+
+  opt_trace (TT_EVAL|1, "restoring object from file: %s", host_path);
+  if (!(theBuff = read_save_file (host_path, &len)))
+    return 0;
+
+  if (checkpoint_data_is_log (theBuff, len))
+    {
+      if (!restore_object_checkpoint (ob, key, theBuff, len, noclear))
+        {
+          FREE (theBuff);
+          return 0;
+        }
+    }
+  else
+    restore_object_from_data (ob, theBuff, len, noclear);
 
   FREE (theBuff);
   return 1;
 }
 
+int restore_object (object_t * ob, const char *file, int noclear, const char *key) {
+  char host_path[PATH_MAX];
+
+  if (ob->flags & O_DESTRUCTED)
+    return 0;
+  if (!save_object_path (ob, file, "restore_object", 0, host_path))
+    error ("Denied read permission in restore_object().\n");
+  return restore_object_file (ob, host_path, noclear, key);
+}
+
 void restore_variable (svalue_t * var, const char *str) {
   int rc;
 
@@ -1793,6 +2063,9 @@ sentence_t* alloc_sentence () {
   p->flags = 0;
   p->next = 0;
   p->args = NULL;  /* initialize carryover args */
+  p->next_verb = 0;
+  p->verb_link = 0;
+  p->seq = 0;
   return p;
 }
 
@@ -1835,6 +2108,149 @@ void free_sentence (sentence_t * p) {
   sent_free = p;
 }
 
+#define SENTENCE_INDEX_MIN_SIZE 16
+
+static uint64_t sentence_seq = 0;
+
+static inline unsigned int verb_hash (const char *verb, unsigned int size) {
+  uintptr_t h = (uintptr_t) verb;
+  return (unsigned int) ((h >> 4) ^ (h >> 12)) & (size - 1);
+}
+
+static inline int is_prefix_sentence (const sentence_t *p) {
+  return (p->flags & (V_NOSPACE | V_SHORT)) || !*p->verb || strchr (p->verb, ' ');
+}
+
+static void push_verb_link (sentence_t **head, sentence_t *p) {
+  p->next_verb = *head;
+  if (*head)
+    (*head)->verb_link = &p->next_verb;
+  *head = p;
+  p->verb_link = head;
+}
+
+/*
+ * Double the bucket table. Chains are rebuilt from the object's sent list
+ * so that each one stays ordered newest first.
+ */
+static void grow_sentence_index (object_t *user) {
+  sentence_index_t *idx = user->sent_index;
+  unsigned int new_size = idx->size * 2;
+  sentence_t **tails, *s;
+
+  FREE (idx->table);
+  idx->table = CALLOCATE (new_size, sentence_t *, TAG_SENTENCE, "grow_sentence_index");
+  tails = CALLOCATE (new_size, sentence_t *, TAG_TEMPORARY, "grow_sentence_index");
+  memset (idx->table, 0, new_size * sizeof (sentence_t *));
+  memset (tails, 0, new_size * sizeof (sentence_t *));
+  idx->size = new_size;
+  for (s = user->sent; s; s = s->next)
+    {
+      unsigned int h;
+
+      if (is_prefix_sentence (s))
+        continue;
+      h = verb_hash (s->verb, new_size);
+      s->next_verb = NULL;
+      if (tails[h])
+        {
+          tails[h]->next_verb = s;
+          s->verb_link = &tails[h]->next_verb;
+        }
+      else
+        {
+          idx->table[h] = s;
+          s->verb_link = &idx->table[h];
+        }
+      tails[h] = s;
+    }
+  FREE (tails);
+}
+
+/**
+ * @brief Add a sentence to the head of an object's sent list and verb index.
+ * @param user The command-enabled object the sentence is added to.
+ * @param p The sentence. Its verb and flags must already be set.
+ */
+void link_sentence (object_t *user, sentence_t *p) {
+  sentence_index_t *idx = user->sent_index;
+
+  if (!idx)
+    {
+      idx = user->sent_index = ALLOCATE (sentence_index_t, TAG_SENTENCE, "link_sentence");
+      idx->size = SENTENCE_INDEX_MIN_SIZE;
+      idx->count = 0;
+      idx->prefix = NULL;
+      idx->table = CALLOCATE (idx->size, sentence_t *, TAG_SENTENCE, "link_sentence");
+      memset (idx->table, 0, idx->size * sizeof (sentence_t *));
+    }
+
+  p->seq = ++sentence_seq;
+  p->next = user->sent;
+  user->sent = p;
+
+  if (is_prefix_sentence (p))
+    {
+      push_verb_link (&idx->prefix, p);
+      return;
+    }
+  if (idx->count >= idx->size)
+    grow_sentence_index (user); /* links p too, it is already on the sent list */
+  else
+    push_verb_link (&idx->table[verb_hash (p->verb, idx->size)], p);
+  idx->count++;
+}
+
+/**
+ * @brief Remove a sentence from an object's sent list and verb index.
+ *
+ * The sentence is not freed.
+ * @param user The object the sentence was added to.
+ * @param link The sent list link pointing at the sentence.
+ */
+void unlink_sentence (object_t *user, sentence_t **link) {
+  sentence_t *p = *link;
+
+  *link = p->next;
+  p->next = NULL;
+  if (!p->verb_link)
+    return;
+  *p->verb_link = p->next_verb;
+  if (p->next_verb)
+    p->next_verb->verb_link = p->verb_link;
+  p->next_verb = NULL;
+  p->verb_link = NULL;
+  if (user->sent_index && !is_prefix_sentence (p))
+    user->sent_index->count--;
+}
+
+/**
+ * @brief Get the newest sentence that may have a plain verb equal to @p verb.
+ *
+ * Follow next_verb to continue; the chain may hold other verbs whose
+ * shared strings hash to the same bucket, so callers compare the verb.
+ * @param user The command-enabled object.
+ * @param verb A shared string.
+ */
+sentence_t* find_verb_sentence (object_t *user, const char *verb) {
+  sentence_index_t *idx = user->sent_index;
+
+  if (!idx)
+    return NULL;
+  return idx->table[verb_hash (verb, idx->size)];
+}
+
+/**
+ * @brief Free the verb index of an object. The sentences are not freed.
+ */
+void free_sentence_index (object_t *ob) {
+  if (!ob->sent_index)
+    return;
+  FREE (ob->sent_index->table);
+  FREE (ob->sent_index);
+  ob->sent_index = NULL;
+}
+
 /**
  * @brief Deallocate an object structure.
  * 
@@ -1877,6 +2293,8 @@ void dealloc_object (object_t * ob, const char *from) {
         }
       ob->sent = NULL;
     }
+  free_sentence_index (ob);
+  free_save_records (ob);
 #ifdef PRIVS
   if (ob->privs)
     free_string(to_shared_str(ob->privs));
@@ -2137,6 +2555,7 @@ void reload_object (object_t * obj) {
 
   if (!obj->prog)
     return;
+  MARK_CHANGED (obj);
   for (i = 0; i < (int) obj->prog->num_variables_total; i++)
     {
       free_svalue (&obj->variables[i], "reload_object");
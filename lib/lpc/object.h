@@ -33,6 +33,7 @@ extern "C" {
 #define O_HIDDEN                0x0400	/* We're hidden from nonprived objs  */
 #define O_EFUN_SOCKET           0x0800	/* efun socket references object     */
 #define O_WILL_RESET            0x1000	/* reset will be called next time    */
+#define O_HAS_ACTIONS           0x2000	/* Has it ever called add_action() ? */
 #define O_UNUSED                0x8000
 
 /*
@@ -46,13 +47,34 @@ struct sentence_s {
     string_or_func_t function;
     int flags;
     array_t *args;  /* carryover arguments for input_to() and add_action() */
+    /* verb index links (see sentence_index_t) */
+    struct sentence_s *next_verb;
+    struct sentence_s **verb_link;
+    uint64_t seq;   /* insertion order; newer sentences have larger values */
 };
 
+/*
+ * Verb index of the sentences added to a command-enabled object.
+ *
+ * Sentences with a plain verb are hashed by the address of the verb's shared
+ * string, so a command only visits the sentences whose verb it can match.
+ * Sentences matched by prefix (xverbs, short verbs, multi-word and empty
+ * verbs) are kept in a separate list. Both are ordered newest first, like
+ * the object's sent list, and user_parser() merges them by seq.
+ */
+typedef struct sentence_index_s {
+    sentence_t **table;
+    unsigned int size;      /* number of buckets, a power of 2 */
+    unsigned int count;     /* sentences in table */
+    sentence_t *prefix;
+} sentence_index_t;
+
 extern int tot_alloc_sentence;
 
 struct object_s {
     unsigned short ref;		/* Reference count. */
     unsigned short flags;	/* Bits or'ed together from above */
+    unsigned int changed;	/* change_clock when a variable was last assigned */
     char *name;
     struct object_s *next_hash;
     time_t load_time;		/* time when this object was created */
@@ -61,14 +83,17 @@ struct object_s {
     program_t *prog;
     struct object_s *next_all;
     struct object_s *next_inv;
+    struct object_s *prev_inv;	/* NULL if first in super->contains */
     struct object_s *contains;
     struct object_s *super;	/* Which object surround us ? */
     struct interactive_s *interactive;	/* Data about an interactive user */
     sentence_t *sent;
+    sentence_index_t *sent_index;
     struct object_s *next_hashed_living;
     shared_str_t living_name;		/* Name of living object if in hash */
     userid_t *uid;		/* the "owner" of this object */
     userid_t *euid;		/* the effective "owner" */
+    struct save_record_s *save_records;	/* saves made with SAVE_IF_CHANGED */
     svalue_t variables[1];	/* All variables to this program */
     /* The variables MUST come last in the struct */
 };
@@ -84,20 +109,67 @@ struct object_s {
 #define ROB_ERROR 63
 
 extern object_t **hashed_living;
+/* save_object() data built in memory */
+typedef struct save_buffer_s {
+  char *data;
+  size_t len;
+  size_t size;
+} save_buffer_t;
+
+/* a save_object() with SAVE_IF_CHANGED, to skip the next one if nothing changed */
+typedef struct save_record_s {
+  struct save_record_s *next;
+  unsigned int saved_at;	/* change_clock of the save */
+  unsigned int epoch;		/* save_epoch of the save */
+  unsigned int serial;		/* write serial of the file after the save */
+  int format;			/* SAVE_ZEROS and SAVE_BINARY or SAVE_TEXT */
+  char path[1];			/* host path of the save file */
+} save_record_t;
+
 extern size_t tot_alloc_object;
 extern size_t tot_alloc_object_size;
 extern int save_svalue_depth;
+extern int saves_skipped;
 
 void init_objects();
 void deinit_objects();
 sentence_t* alloc_sentence ();
 void free_sentence(sentence_t *);
+void link_sentence(object_t *, sentence_t *);
+void unlink_sentence(object_t *, sentence_t **);
+sentence_t* find_verb_sentence(object_t *, const char *);
+void free_sentence_index(object_t *);
 size_t svalue_save_size(const svalue_t *);
 void save_svalue(const svalue_t *, char **);
 int restore_svalue(const char *, svalue_t *);
 int save_object(object_t *, const char *, int);
+int save_object_path(object_t *, const char *, const char *, int, char *);
+void save_object_to_buffer(object_t *, int, save_buffer_t *);
+void save_buffer_reserve(save_buffer_t *, size_t);
+void save_text_variable(save_buffer_t *, const char *, const svalue_t *);
+int write_save_file(const char *, const char *, size_t, int);
+int save_object_unchanged(object_t *, const char *, int);
+void save_object_written(object_t *, const char *, int);
+void forget_saved_objects(void);
+void free_save_records(object_t *);
 malloc_str_t save_variable(const svalue_t *);
-int restore_object(object_t *, const char *, int);
+int restore_object(object_t *, const char *, int, const char *);
+int restore_object_file(object_t *, const char *, int, const char *);
+char *read_save_file(const char *, size_t *);
+void restore_object_from_data(object_t *, char *, size_t, int);
+
+/* save_binary.c */
+int save_data_is_binary(const char *, size_t);
+void save_binary_header(save_buffer_t *, const char *);
+void save_binary_variable(save_buffer_t *, const char *, const svalue_t *);
+void restore_object_binary(object_t *, char *, size_t);
+void convert_save_data(char *, size_t, int, save_buffer_t *);
+
+/* checkpoint.c */
+int checkpoint_data_is_log(const char *, size_t);
+int checkpoint_objects(array_t *, array_t *, const char *);
+int restore_object_checkpoint(object_t *, const char *, char *, size_t, int);
+int compact_checkpoint_log(const char *);
 void restore_variable(svalue_t *, const char *);
 object_t *get_empty_object(int);
 void reset_object(object_t *);
@@ -1,7 +1,7 @@
 #pragma once
 
 #define LPCBIN_MAGIC "NEOL"
-#define LPCBIN_DRIVER_ID 0x20260602
+#define LPCBIN_DRIVER_ID 0x20261019
 
 #define BIN_IGNORE_SOURCE_FILE 0x1 /* ignore source file when checking binary validity */
 #define BIN_IGNORE_INCLUDE_FILES 0x2 /* ignore included files when checking binary validity */
@@ -0,0 +1,523 @@
+#ifdef	HAVE_CONFIG_H
+#include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include "src/std.h"
+#include "array.h"
+#include "class.h"
+#include "mapping.h"
+#include "object.h"
+#include "program.h"
+#include "rc/rc.h"
+#include "lpc/include/runtime_config.h"
+
+/*
+ * Binary save_object() format
+ *
+ *   magic      SAVE_BINARY_MAGIC followed by the version byte
+ *   program    string: name of the program that saved the data
+ *   variables  until the end of the data: the name of a variable as a
+ *              string, followed by its value
+ *
+ * A string is a varint byte count followed by the bytes. A value is a tag
+ * byte followed by:
+ *
+ *   SB_INT      the number, zigzag encoded, as a varint
+ *   SB_REAL     the IEEE 754 double, 8 bytes little endian
+ *   SB_STRING   a string
+ *   SB_ARRAY    varint element count, then the elements
+ *   SB_CLASS    varint member count, then the members
+ *   SB_MAPPING  varint pair count, then each key followed by its value
+ *
+ * Varints are unsigned LEB128. Values save_object() cannot save (objects,
+ * functions, buffers) are saved as 0, as in the text format.
+ */
+#define SAVE_BINARY_MAGIC	"\177NSO"
+#define SAVE_BINARY_MAGIC_LEN	4
+#define SAVE_BINARY_VERSION	1
+
+#define SB_INT		0
+#define SB_REAL		1
+#define SB_STRING	2
+#define SB_ARRAY	3
+#define SB_CLASS	4
+#define SB_MAPPING	5
+
+typedef struct {
+  const unsigned char *p;
+  const unsigned char *end;
+} save_reader_t;
+
+int save_data_is_binary (const char *data, size_t len) {
+  return len > SAVE_BINARY_MAGIC_LEN && memcmp (data, SAVE_BINARY_MAGIC, SAVE_BINARY_MAGIC_LEN) == 0;
+}
+
+static void put_varint (save_buffer_t * out, uint64_t n) {
+  save_buffer_reserve (out, 10);
+  while (n >= 0x80)
+    {
+      out->data[out->len++] = (char) (n | 0x80);
+      n >>= 7;
+    }
+  out->data[out->len++] = (char) n;
+}
+
+static void put_tag (save_buffer_t * out, int tag) {
+  save_buffer_reserve (out, 1);
+  out->data[out->len++] = (char) tag;
+}
+
+static void put_string (save_buffer_t * out, const char *str, size_t len) {
+  put_varint (out, len);
+  save_buffer_reserve (out, len);
+  memcpy (out->data + out->len, str, len);
+  out->len += len;
+}
+
+static void save_binary_svalue (const svalue_t * v, save_buffer_t * out, int depth) {
+  int i;
+
+  switch (v->type)
+    {
+    case T_STRING:
+      put_tag (out, SB_STRING);
+      put_string (out, SVALUE_STRPTR (v), SVALUE_STRLEN (v));
+      return;
+
+    case T_NUMBER:
+      put_tag (out, SB_INT);
+      put_varint (out, ((uint64_t) v->u.number << 1) ^ (uint64_t) (v->u.number >> 63));
+      return;
+
+    case T_REAL:
+      {
+        uint64_t bits;
+
+        memcpy (&bits, &v->u.real, sizeof (bits));
+        save_buffer_reserve (out, 9);
+        out->data[out->len++] = SB_REAL;
+        for (i = 0; i < 8; i++)
+          out->data[out->len++] = (char) (bits >> (i * 8));
+        return;
+      }
+
+    case T_ARRAY:
+    case T_CLASS:
+      if (depth >= MAX_SAVE_SVALUE_DEPTH)
+        {
+          FREE (out->data);
+          memset (out, 0, sizeof (*out));
+          error ("Mappings and/or arrays nested too deep (%d) for save_object\n", MAX_SAVE_SVALUE_DEPTH);
+        }
+      put_tag (out, v->type == T_ARRAY ? SB_ARRAY : SB_CLASS);
+      put_varint (out, v->u.arr->size);
+      for (i = 0; i < v->u.arr->size; i++)
+        save_binary_svalue (&v->u.arr->item[i], out, depth + 1);
+      return;
+
+    case T_MAPPING:
+      {
+        mapping_node_t *elt;
+
+        if (depth >= MAX_SAVE_SVALUE_DEPTH)
+          {
+            FREE (out->data);
+            memset (out, 0, sizeof (*out));
+            error ("Mappings and/or arrays nested too deep (%d) for save_object\n", MAX_SAVE_SVALUE_DEPTH);
+          }
+        put_tag (out, SB_MAPPING);
+        put_varint (out, v->u.map->count);
+        for (i = v->u.map->table_size; i >= 0; i--)
+          for (elt = v->u.map->table[i]; elt; elt = elt->next)
+            {
+              save_binary_svalue (elt->values, out, depth + 1);
+              save_binary_svalue (elt->values + 1, out, depth + 1);
+            }
+        return;
+      }
+
+    default:
+      put_tag (out, SB_INT);
+      put_varint (out, 0);
+    }
+}
+
+static void put_header (save_buffer_t * out, const char *prog_name, size_t len) {
+  save_buffer_reserve (out, SAVE_BINARY_MAGIC_LEN + 1);
+  memcpy (out->data + out->len, SAVE_BINARY_MAGIC, SAVE_BINARY_MAGIC_LEN);
+  out->len += SAVE_BINARY_MAGIC_LEN;
+  out->data[out->len++] = SAVE_BINARY_VERSION;
+  put_string (out, prog_name, len);
+}
+
+/**
+ * @brief Start binary save data with the magic and the program name.
+ */
+void save_binary_header (save_buffer_t * out, const char *prog_name) {
+  put_header (out, prog_name, strlen (prog_name));
+}
+
+/**
+ * @brief Append a variable to binary save data.
+ *
+ * Raises an error if the value is nested too deep; out->data is freed first.
+ */
+void save_binary_variable (save_buffer_t * out, const char *name, const svalue_t * v) {
+  put_string (out, name, strlen (name));
+  save_binary_svalue (v, out, 0);
+}
+
+static int get_varint (save_reader_t * r, uint64_t * n) {
+  uint64_t v = 0;
+  int shift;
+
+  for (shift = 0; r->p < r->end && shift < 64; shift += 7)
+    {
+      unsigned char c = *r->p++;
+
+      v |= (uint64_t) (c & 0x7f) << shift;
+      if (!(c & 0x80))
+        {
+          *n = v;
+          return 1;
+        }
+    }
+  return 0;
+}
+
+/* read a count of items that take at least min_bytes each */
+static int get_count (save_reader_t * r, size_t limit, size_t min_bytes, size_t * count) {
+  uint64_t n;
+
+  if (!get_varint (r, &n) || n > limit || n > (uint64_t) (r->end - r->p) / min_bytes)
+    return 0;
+  *count = (size_t) n;
+  return 1;
+}
+
+static int get_string (save_reader_t * r, const char **str, size_t * len) {
+  uint64_t n;
+
+  if (!get_varint (r, &n) || n > (uint64_t) (r->end - r->p))
+    return 0;
+  *str = (const char *) r->p;
+  *len = (size_t) n;
+  r->p += n;
+  /* LPC strings cannot hold NUL characters */
+  return memchr (*str, '\0', *len) == NULL;
+}
+
+/*
+ * Restore a value. On success sv holds a referenced value; on an error it
+ * is 0 and the ROB_* error is returned. Mapping keys are made shared
+ * strings, as in the text format.
+ */
+static int restore_binary_svalue (save_reader_t * r, svalue_t * sv, int depth, int is_key) {
+  size_t count, i;
+  int err;
+
+  *sv = const0;
+  if (r->p >= r->end)
+    return ROB_GENERAL_ERROR;
+
+  switch (*r->p++)
+    {
+    case SB_INT:
+      {
+        uint64_t n;
+
+        if (!get_varint (r, &n))
+          return ROB_NUMERAL_ERROR;
+        sv->u.number = (int64_t) (n >> 1) ^ -(int64_t) (n & 1);
+        return 0;
+      }
+
+    case SB_REAL:
+      {
+        uint64_t bits = 0;
+
+        if (r->end - r->p < 8)
+          return ROB_NUMERAL_ERROR;
+        for (i = 0; i < 8; i++)
+          bits |= (uint64_t) r->p[i] << (i * 8);
+        r->p += 8;
+        sv->type = T_REAL;
+        memcpy (&sv->u.real, &bits, sizeof (bits));
+        return 0;
+      }
+
+    case SB_STRING:
+      {
+        const char *str;
+        size_t len;
+
+        if (!get_string (r, &str, &len))
+          return ROB_STRING_ERROR;
+        if (is_key)
+          SET_SVALUE_SHARED_STRING (sv, make_shared_string (str, str + len));
+        else
+          {
+            malloc_str_t s = new_string (len, "restore_binary_svalue");
+
+            memcpy (s, str, len);
+            s[len] = '\0';
+            SET_SVALUE_MALLOC_STRING (sv, s);
+          }
+        return 0;
+      }
+
+    case SB_ARRAY:
+    case SB_CLASS:
+      {
+        int is_class = r->p[-1] == SB_CLASS;
+        array_t *v;
+
+        if (depth >= MAX_SAVE_SVALUE_DEPTH)
+          return is_class ? ROB_CLASS_ERROR : ROB_ARRAY_ERROR;
+        if (!get_count (r, is_class ? USHRT_MAX : (size_t) CONFIG_INT (__MAX_ARRAY_SIZE__), 2, &count))
+          return is_class ? ROB_CLASS_ERROR : ROB_ARRAY_ERROR;
+        v = is_class ? allocate_class_by_size ((int) count) : allocate_array (count);
+        for (i = 0; i < count; i++)
+          {
+            if ((err = restore_binary_svalue (r, &v->item[i], depth + 1, 0)))
+              {
+                if (is_class)
+                  free_class (v);
+                else
+                  free_array (v);
+                return err;
+              }
+          }
+        sv->type = is_class ? T_CLASS : T_ARRAY;
+        sv->u.arr = v;
+        return 0;
+      }
+
+    case SB_MAPPING:
+      {
+        mapping_t *m;
+        svalue_t key, value;
+
+        if (depth >= MAX_SAVE_SVALUE_DEPTH)
+          return ROB_MAPPING_ERROR;
+        if (!get_count (r, (size_t) CONFIG_INT (__MAX_MAPPING_SIZE__), 4, &count))
+          return ROB_MAPPING_ERROR;
+        m = allocate_mapping (count);
+        for (i = 0; i < count; i++)
+          {
+            if ((err = restore_binary_svalue (r, &key, depth + 1, 1)))
+              {
+                free_mapping (m);
+                return err;
+              }
+            if ((err = restore_binary_svalue (r, &value, depth + 1, 0)))
+              {
+                free_svalue (&key, "restore_binary_svalue");
+                free_mapping (m);
+                return err;
+              }
+            /* a repeated key keeps the last value */
+            *find_for_insert (m, &key, 1) = value;
+            free_svalue (&key, "restore_binary_svalue");
+          }
+        sv->type = T_MAPPING;
+        sv->u.map = m;
+        return 0;
+      }
+
+    default:
+      return ROB_GENERAL_ERROR;
+    }
+}
+
+static const char *restore_error_kind (int err) {
+  if (err & ROB_NUMERAL_ERROR)
+    return "numeric";
+  if (err & ROB_ARRAY_ERROR)
+    return "array";
+  if (err & ROB_MAPPING_ERROR)
+    return "mapping";
+  if (err & ROB_STRING_ERROR)
+    return "string";
+  if (err & ROB_CLASS_ERROR)
+    return "class";
+  return "general";
+}
+
+/* check the version and read the program name */
+static void open_binary_data (save_reader_t * r, char *buf, size_t len, const char **prog_name, size_t *name_len) {
+  r->p = (const unsigned char *) buf + SAVE_BINARY_MAGIC_LEN;
+  r->end = (const unsigned char *) buf + len;
+  if (*r->p++ != SAVE_BINARY_VERSION)
+    {
+      FREE (buf);
+      error ("restore_object(): Unsupported binary format version.\n");
+    }
+  if (!get_string (r, prog_name, name_len))
+    {
+      FREE (buf);
+      error ("restore_object(): Illegal file format.\n");
+    }
+}
+
+/* read the name of the next variable into var */
+static void get_variable_name (save_reader_t * r, char *buf, char *var, size_t var_size) {
+  const char *name;
+  size_t len;
+
+  if (!get_string (r, &name, &len) || len >= var_size)
+    {
+      FREE (buf);
+      error ("restore_object(): Illegal file format.\n");
+    }
+  memcpy (var, name, len);
+  var[len] = '\0';
+}
+
+/**
+ * @brief Restore the variables of current_object from binary save data.
+ *
+ * Variables not in the object are skipped. A variable is only assigned
+ * once its value is complete; on an error buf is freed, the variables
+ * restored so far keep their new values and an error is raised.
+ */
+void restore_object_binary (object_t * ob, char *buf, size_t len) {
+  save_reader_t r;
+  const char *prog_name;
+  size_t name_len;
+  char var[100];
+  svalue_t value;
+  unsigned short t;
+  int idx, err;
+
+  open_binary_data (&r, buf, len, &prog_name, &name_len);
+  while (r.p < r.end)
+    {
+      get_variable_name (&r, buf, var, sizeof (var));
+      if ((err = restore_binary_svalue (&r, &value, 0, 0)))
+        {
+          FREE (buf);
+          error ("restore_object(): Illegal %s format while restoring %s.\n", restore_error_kind (err), var);
+        }
+      idx = find_global_variable (ob->prog, var, &t);
+      if (idx == -1 || t & NAME_STATIC)
+        {
+          free_svalue (&value, "restore_object_binary");
+          continue;
+        }
+      free_svalue (&ob->variables[idx], "restore_object_binary");
+      ob->variables[idx] = value;
+    }
+}
+
+/**
+ * @brief Convert save_object() data to the text or the binary format.
+ *
+ * The values are decoded and encoded again, so it does not need the
+ * program that saved them. On an error data is freed and an error raised.
+ *
+ * @param data The data, NUL terminated; it is modified.
+ * @param len Length of the data.
+ * @param binary Non-zero to convert to the binary format, zero for text.
+ * @param out Receives the converted data, NUL terminated; release out->data
+ *        with FREE().
+ */
+void convert_save_data (char *data, size_t len, int binary, save_buffer_t * out) {
+  char var[100];
+  char *line, *next, *space;
+  svalue_t value;
+  int err;
+
+  memset (out, 0, sizeof (*out));
+  if (save_data_is_binary (data, len))
+    {
+      save_reader_t r;
+      const char *prog_name;
+      size_t name_len;
+
+      open_binary_data (&r, data, len, &prog_name, &name_len);
+      if (binary)
+        put_header (out, prog_name, name_len);
+      else
+        {
+          save_buffer_reserve (out, name_len + 3);
+          out->len = snprintf (out->data, name_len + 4, "#/%.*s\n", (int) name_len, prog_name);
+        }
+      while (r.p < r.end)
+        {
+          get_variable_name (&r, data, var, sizeof (var));
+          if ((err = restore_binary_svalue (&r, &value, 0, 0)))
+            {
+              FREE (out->data);
+              FREE (data);
+              error ("restore_object(): Illegal %s format while restoring %s.\n", restore_error_kind (err), var);
+            }
+          if (binary)
+            save_binary_variable (out, var, &value);
+          else
+            save_text_variable (out, var, &value);
+          free_svalue (&value, "convert_save_data");
+        }
+      out->data[out->len] = '\0';
+      return;
+    }
+
+  for (next = data; (line = next) && *line; )
+    {
+      if ((next = strchr (line, '\n')))
+        *next++ = '\0';
+      if (line[0] == '#')
+        {
+          /* the first comment names the program, as in "#/std/user.c" */
+          if (out->data == NULL)
+            {
+              const char *prog_name = line[1] == '/' ? line + 2 : line + 1;
+
+              if (binary)
+                save_binary_header (out, prog_name);
+              else
+                {
+                  save_buffer_reserve (out, strlen (line) + 1);
+                  out->len = sprintf (out->data, "%s\n", line);
+                }
+            }
+          continue;
+        }
+      space = strchr (line, ' ');
+      if (!space || (space - line) >= (int) sizeof (var))
+        {
+          FREE (out->data);
+          FREE (data);
+          error ("restore_object(): Illegal file format.\n");
+        }
+      memcpy (var, line, space - line);
+      var[space - line] = '\0';
+      value = const0;
+      if ((err = restore_svalue (space + 1, &value)) & ROB_ERROR)
+        {
+          FREE (out->data);
+          FREE (data);
+          error ("restore_object(): Illegal %s format while restoring %s.\n", restore_error_kind (err), var);
+        }
+      if (out->data == NULL)
+        {
+          if (binary)
+            save_binary_header (out, "");
+          else
+            save_buffer_reserve (out, 0);
+        }
+      if (binary)
+        save_binary_variable (out, var, &value);
+      else
+        save_text_variable (out, var, &value);
+      free_svalue (&value, "convert_save_data");
+    }
+  if (out->data == NULL)
+    {
+      if (binary)
+        save_binary_header (out, "");
+      else
+        save_buffer_reserve (out, 0);
+    }
+  out->data[out->len] = '\0';
+}
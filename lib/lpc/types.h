@@ -41,6 +41,14 @@ typedef struct {
     unsigned short ref;
 } refed_t;
 
+/*
+ * Objects, arrays, classes and mappings carry a "changed" stamp, set from
+ * change_clock when they are written. save_object() advances the clock, so a
+ * stamp newer than the clock value of the last save means a change since.
+ */
+extern unsigned int change_clock;
+#define MARK_CHANGED(x) ((x)->changed = change_clock)
+
 union svalue_u {
     /* Explicit string-subtype semantics */
     const char *const_string;
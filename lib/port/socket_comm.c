@@ -180,3 +180,20 @@ int set_socket_nonblocking(socket_fd_t fd, int which) {
 #endif
 #endif
 }
+
+long socket_sendv(socket_fd_t fd, socket_iovec_t *iov, int iovcnt, int flags) {
+#ifdef _WIN32
+    DWORD sent = 0;
+
+    if (WSASend(fd, iov, (DWORD)iovcnt, &sent, (DWORD)flags, NULL, NULL) == SOCKET_ERROR)
+        return -1;
+    return (long)sent;
+#else
+    struct msghdr msg;
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = iovcnt;
+    return (long)sendmsg(fd, &msg, flags);
+#endif
+}
@@ -12,12 +12,17 @@
     #define SOCKET_CLOSE(s)             closesocket(s)
     #define SOCKET_ERRNO                WSAGetLastError()
     /* SOCKET_ERROR defined in winsock2.h */
+    typedef WSABUF socket_iovec_t;
+    #define SOCKET_IOV_SET(v, p, l)     ((v).buf = (char *)(p), (v).len = (ULONG)(l))
+    #define SOCKET_IOV_BASE(v)          ((v).buf)
+    #define SOCKET_IOV_LEN(v)           ((size_t)(v).len)
     #pragma comment(lib, "ws2_32.lib")
 #else
     /* POSIX Sockets */
     #include <sys/socket.h>
     #include <netinet/in.h>
     #include <arpa/inet.h>
+    #include <sys/uio.h>
     typedef int socket_fd_t;
     #define INVALID_SOCKET_FD           -1
     #define SOCKET_RECV(s, b, l, f)     recv(s, b, l, f)
@@ -25,6 +30,10 @@
     #define SOCKET_CLOSE(s)             close(s)
     #define SOCKET_ERRNO                errno
     #define SOCKET_ERROR               -1
+    typedef struct iovec socket_iovec_t;
+    #define SOCKET_IOV_SET(v, p, l)     ((v).iov_base = (void *)(p), (v).iov_len = (l))
+    #define SOCKET_IOV_BASE(v)          ((char *)(v).iov_base)
+    #define SOCKET_IOV_LEN(v)           ((v).iov_len)
 #endif
 
 #ifdef HAVE_NETDB_H
@@ -63,6 +72,18 @@ int create_test_socket_pair(socket_fd_t fds[2]);
  */
 int set_socket_nonblocking(socket_fd_t fd, int which);
 
+/**
+ * @brief Send several buffers on a socket with a single system call.
+ *
+ * Uses sendmsg() on POSIX systems and WSASend() on Windows.
+ * @param fd Socket file descriptor.
+ * @param iov Buffers to send, in order.
+ * @param iovcnt Number of buffers.
+ * @param flags Send flags such as MSG_OOB.
+ * @return Number of bytes sent, or -1 on error (check SOCKET_ERRNO).
+ */
+long socket_sendv(socket_fd_t fd, socket_iovec_t *iov, int iovcnt, int flags);
+
 /**
  * @brief Set process receiving SIGIO/SIGURG signals.
  * @param fd Socket file descriptor.
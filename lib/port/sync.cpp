@@ -9,12 +9,13 @@
 #define NO_STEM
 #include "src/std.h"
 #include "sync.h"
+#include <atomic>
+#include <chrono>
 #include <mutex>
 #include <new>
 
 #ifndef _WIN32
 #include <condition_variable>
-#include <chrono>
 #endif
 
 /* Internal C++ wrapper types */
@@ -42,6 +43,9 @@ static_assert(sizeof(MutexImpl) <= sizeof(platform_mutex_t),
               "platform_mutex_t storage too small for std::mutex");
 static_assert(sizeof(EventImpl) <= sizeof(platform_event_t),
               "platform_event_t storage too small for EventImpl");
+static_assert(sizeof(std::atomic<size_t>) == sizeof(platform_atomic_t) &&
+              std::atomic<size_t>::is_always_lock_free,
+              "platform_atomic_t must be a lock-free std::atomic<size_t>");
 
 /* Helper to get MutexImpl pointer from opaque storage */
 static inline MutexImpl* get_mutex(platform_mutex_t* mutex) {
@@ -53,6 +57,11 @@ static inline EventImpl* get_event(platform_event_t* event) {
     return reinterpret_cast<EventImpl*>(event);
 }
 
+/* Helper to get std::atomic pointer from opaque storage */
+static inline std::atomic<size_t>* get_atomic(const platform_atomic_t* atomic) {
+    return reinterpret_cast<std::atomic<size_t>*>(const_cast<platform_atomic_t*>(atomic));
+}
+
 extern "C" {
 
 /* Mutex API */
@@ -220,6 +229,31 @@ bool platform_event_wait(platform_event_t* event, int timeout_ms) {
 #endif
 }
 
+/* Atomic API */
+
+size_t platform_atomic_load(const platform_atomic_t* atomic) {
+    return get_atomic(atomic)->load(std::memory_order_acquire);
+}
+
+void platform_atomic_store(platform_atomic_t* atomic, size_t value) {
+    get_atomic(atomic)->store(value, std::memory_order_release);
+}
+
+bool platform_atomic_cas(platform_atomic_t* atomic, size_t* expected, size_t desired) {
+    return get_atomic(atomic)->compare_exchange_weak(*expected, desired,
+                                                     std::memory_order_acq_rel,
+                                                     std::memory_order_acquire);
+}
+
+size_t platform_atomic_add(platform_atomic_t* atomic, size_t value) {
+    return get_atomic(atomic)->fetch_add(value, std::memory_order_relaxed);
+}
+
+uint64_t platform_monotonic_usec(void) {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
 #ifdef _WIN32
 void* platform_event_get_native_handle(platform_event_t* event) {
     if (!event) return NULL;
@@ -1,6 +1,6 @@
 /**
  * @file sync.h
- * @brief Platform-agnostic synchronization primitives (mutexes, events)
+ * @brief Platform-agnostic synchronization primitives (mutexes, events, atomics)
  * 
  * C++11-based implementation providing C-compatible API.
  * Internal use only - encapsulated within async library implementations.
@@ -87,6 +87,43 @@ void platform_event_reset(platform_event_t* event);
  */
 bool platform_event_wait(platform_event_t* event, int timeout_ms);
 
+/**
+ * Platform-agnostic atomic counter
+ * Opaque storage - accessed as std::atomic<size_t>
+ */
+typedef struct platform_atomic_s {
+    size_t _opaque;
+} platform_atomic_t;
+
+/**
+ * Load an atomic value (acquire)
+ */
+size_t platform_atomic_load(const platform_atomic_t* atomic);
+
+/**
+ * Store an atomic value (release)
+ */
+void platform_atomic_store(platform_atomic_t* atomic, size_t value);
+
+/**
+ * Compare and swap (acquire-release)
+ * @param expected In: the value expected. Out: the value found, on failure.
+ * @returns true if @p desired was stored
+ */
+bool platform_atomic_cas(platform_atomic_t* atomic, size_t* expected, size_t desired);
+
+/**
+ * Add to an atomic value (relaxed)
+ * @returns The previous value
+ */
+size_t platform_atomic_add(platform_atomic_t* atomic, size_t value);
+
+/**
+ * Monotonic clock for measuring intervals
+ * @returns Microseconds since an unspecified starting point
+ */
+uint64_t platform_monotonic_usec(void);
+
 #ifdef _WIN32
 /**
  * Get native Windows HANDLE for event (for WaitForMultipleObjects usage)
@@ -17,6 +17,13 @@
 #include <chrono>
 #include <atomic>
 
+#ifdef HAVE_SYS_TIMERFD_H
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdint.h>
+#endif
+
 /**
  * @brief Internal timer state structure
  * 
@@ -32,8 +39,9 @@ struct platform_timer_internal {
     timer_callback_t callback;
     std::atomic<bool> active;
     std::atomic<bool> stop_requested;
+    int fd;     /* timer descriptor, -1 unless started by platform_timer_start_fd() */
     
-    platform_timer_internal() : callback(nullptr), active(false), stop_requested(false) {}
+    platform_timer_internal() : callback(nullptr), active(false), stop_requested(false), fd(-1) {}
 };
 
 /**
@@ -131,6 +139,93 @@ extern "C" timer_error_t platform_timer_start(platform_timer_t* timer, unsigned
     }
 }
 
+/**
+ * @brief Start the periodic timer on a timer descriptor
+ */
+extern "C" timer_error_t platform_timer_start_fd(platform_timer_t* timer, unsigned long interval_us, int* fd) {
+    if (!timer || !timer->internal || !fd) {
+        return TIMER_ERR_NULL_PARAM;
+    }
+
+    if (interval_us == 0) {
+        return TIMER_ERR_INVALID_INTERVAL;
+    }
+
+    platform_timer_internal* internal = static_cast<platform_timer_internal*>(timer->internal);
+
+    if (internal->active.load()) {
+        return TIMER_ERR_ALREADY_ACTIVE;
+    }
+
+#ifdef HAVE_SYS_TIMERFD_H
+    int tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (tfd == -1) {
+        return TIMER_ERR_SYSTEM;
+    }
+
+    struct itimerspec spec;
+    spec.it_interval.tv_sec = interval_us / 1000000;
+    spec.it_interval.tv_nsec = (interval_us % 1000000) * 1000;
+    spec.it_value = spec.it_interval;
+    if (timerfd_settime(tfd, 0, &spec, NULL) == -1) {
+        close(tfd);
+        return TIMER_ERR_SYSTEM;
+    }
+
+    internal->interval = std::chrono::microseconds(interval_us);
+    internal->fd = tfd;
+    internal->active.store(true);
+    *fd = tfd;
+    return TIMER_OK;
+#else
+    return TIMER_ERR_SYSTEM;
+#endif
+}
+
+/**
+ * @brief Consume the expirations of a descriptor timer
+ */
+extern "C" unsigned long long platform_timer_read(platform_timer_t* timer, unsigned long* late_us) {
+    if (late_us) {
+        *late_us = 0;
+    }
+    if (!timer || !timer->internal) {
+        return 0;
+    }
+
+    platform_timer_internal* internal = static_cast<platform_timer_internal*>(timer->internal);
+    if (internal->fd == -1) {
+        return 0;
+    }
+
+#ifdef HAVE_SYS_TIMERFD_H
+    uint64_t expirations = 0;
+    ssize_t n;
+    do {
+        n = read(internal->fd, &expirations, sizeof(expirations));
+    } while (n == -1 && errno == EINTR);
+    if (n != (ssize_t)sizeof(expirations)) {
+        return 0;   /* EAGAIN: not expired since the last read */
+    }
+
+    if (late_us) {
+        /* The time until the next expiration tells how long ago the
+         * last one was. */
+        struct itimerspec spec;
+        if (timerfd_gettime(internal->fd, &spec) == 0) {
+            long long remaining = (long long)spec.it_value.tv_sec * 1000000 + spec.it_value.tv_nsec / 1000;
+            long long interval = internal->interval.count();
+            if (remaining >= 0 && remaining <= interval) {
+                *late_us = (unsigned long)(interval - remaining);
+            }
+        }
+    }
+    return expirations;
+#else
+    return 0;
+#endif
+}
+
 /**
  * @brief Stop the timer
  */
@@ -145,6 +240,15 @@ extern "C" timer_error_t platform_timer_stop(platform_timer_t* timer) {
         return TIMER_OK;  // Already stopped
     }
     
+#ifdef HAVE_SYS_TIMERFD_H
+    if (internal->fd != -1) {
+        close(internal->fd);
+        internal->fd = -1;
+        internal->active.store(false);
+        return TIMER_OK;
+    }
+#endif
+
     // Signal thread to stop
     internal->active.store(false);
     internal->stop_requested.store(true);
@@ -49,6 +49,31 @@ timer_error_t platform_timer_init(platform_timer_t *timer);
  */
 timer_error_t platform_timer_start(platform_timer_t *timer, unsigned long interval_us, timer_callback_t callback);
 
+/**
+ * @brief Start a periodic timer that signals a file descriptor
+ *
+ * Instead of running a callback on a timer thread, the timer makes the
+ * returned descriptor readable on each expiration, so it can be added
+ * to the event loop like any other event source. Call
+ * platform_timer_read() when it becomes readable.
+ *
+ * @param timer Pointer to initialized timer handle
+ * @param interval_us Timer interval in microseconds
+ * @param fd Receives the descriptor, owned by the timer
+ * @return TIMER_OK on success, TIMER_ERR_SYSTEM if the platform has no
+ *         timer descriptors (use platform_timer_start() instead)
+ */
+timer_error_t platform_timer_start_fd(platform_timer_t *timer, unsigned long interval_us, int *fd);
+
+/**
+ * @brief Consume the expirations of a descriptor timer
+ * @param timer Pointer to a timer started with platform_timer_start_fd()
+ * @param late_us If not NULL, receives the microseconds elapsed since
+ *        the most recent expiration
+ * @return Number of expirations since the last read, 0 if none
+ */
+unsigned long long platform_timer_read(platform_timer_t *timer, unsigned long *late_us);
+
 /**
  * @brief Stop the timer
  * @param timer Pointer to timer handle
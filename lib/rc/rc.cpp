@@ -286,6 +286,42 @@ void init_config (const char *config_file) {
   CONFIG_INT (__EVALUATOR_STACK_SIZE__) = scan_config_int (config, "StackSize", false, 1000);
   CONFIG_INT (__MAX_LOCAL_VARIABLES__) = scan_config_int (config, "MaxLocalVariables", false, 25);
   CONFIG_INT (__MAX_CALL_DEPTH__) = scan_config_int (config, "MaxCallDepth", false, 50);
+  CONFIG_INT (__DRIVER_STATS_LOG_INTERVAL__) = scan_config_int (config, "DriverStatsLogInterval", false, 0);
+  CONFIG_INT (__COMMAND_QUANTUM__) = scan_config_int (config, "CommandQuantum", false, 50000);
+  CONFIG_INT (__COMMAND_CYCLE_BUDGET__) = scan_config_int (config, "CommandCycleBudget", false, 20);
+  CONFIG_INT (__OUTPUT_HIGH_WATER__) = scan_config_int (config, "OutputHighWater", false, 65536);
+  CONFIG_INT (__OUTPUT_LOW_WATER__) = scan_config_int (config, "OutputLowWater", false, 16384);
+  CONFIG_INT (__OUTPUT_BUFFER_LIMIT__) = scan_config_int (config, "OutputBufferLimit", false, 1048576);
+  CONFIG_INT (__MCCP_COMPRESSION_LEVEL__) = scan_config_int (config, "MccpCompressionLevel", false, 0);
+  if (CONFIG_INT (__MCCP_COMPRESSION_LEVEL__) < 0 || CONFIG_INT (__MCCP_COMPRESSION_LEVEL__) > 9)
+    {
+      debug_message ("warning: MccpCompressionLevel must be 0-9, compression disabled [got: %d]\n",
+                     (int) CONFIG_INT (__MCCP_COMPRESSION_LEVEL__));
+      CONFIG_INT (__MCCP_COMPRESSION_LEVEL__) = 0;
+    }
+  CONFIG_INT (__INPUT_BUFFER_LIMIT__) = scan_config_int (config, "InputBufferLimit", false, 65536);
+  CONFIG_INT (__CONNECTIONS_PER_CYCLE__) = scan_config_int (config, "ConnectionsPerCycle", false, 10);
+  CONFIG_INT (__NETWORK_IO_THREADS__) = scan_config_int (config, "NetworkIoThreads", false, 0);
+  if (CONFIG_INT (__NETWORK_IO_THREADS__) < 0 || CONFIG_INT (__NETWORK_IO_THREADS__) > 64)
+    {
+      debug_message ("warning: NetworkIoThreads must be 0-64, using 0 [got: %d]\n",
+                     (int) CONFIG_INT (__NETWORK_IO_THREADS__));
+      CONFIG_INT (__NETWORK_IO_THREADS__) = 0;
+    }
+  CONFIG_INT (__SOCKET_SEND_QUEUE_LIMIT__) = scan_config_int (config, "SocketSendQueueLimit", false, 262144);
+  if (CONFIG_INT (__SOCKET_SEND_QUEUE_LIMIT__) < 0)
+    CONFIG_INT (__SOCKET_SEND_QUEUE_LIMIT__) = 0;
+  CONFIG_INT (__SOCKET_READ_BUDGET__) = scan_config_int (config, "SocketReadBudget", false, 65536);
+  CONFIG_INT (__FILE_IO_THREADS__) = scan_config_int (config, "FileIoThreads", false, 2);
+  if (CONFIG_INT (__FILE_IO_THREADS__) < 1 || CONFIG_INT (__FILE_IO_THREADS__) > 64)
+    {
+      debug_message ("warning: FileIoThreads must be 1-64, using 2 [got: %d]\n",
+                     (int) CONFIG_INT (__FILE_IO_THREADS__));
+      CONFIG_INT (__FILE_IO_THREADS__) = 2;
+    }
+  CONFIG_INT (__ENABLE_ASYNC_SAVE_OBJECT__) = scan_config_bool (config, "AsyncSaveObject", false, true);
+  CONFIG_INT (__ENABLE_SAVE_OBJECT_FSYNC__) = scan_config_bool (config, "SaveObjectFsync", false, true);
+  CONFIG_INT (__ENABLE_BINARY_SAVE_OBJECT__) = scan_config_bool (config, "BinarySaveObject", false, false);
 
   if (scan_config_bool (config, "ArgumentsInTrace", false, false))
     g_trace_flag |= DUMP_WITH_ARGS;
@@ -6,6 +6,10 @@
         [2001-06-27] by Annihilator <annihilator@muds.net>, see CVS log.
  */
 
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE	/* recvmmsg(), sendmmsg() */
+#endif
+
 #ifdef	HAVE_CONFIG_H
 #include <config.h>
 #endif /* HAVE_CONFIG_H */
@@ -26,6 +30,7 @@
 #include "lpc/include/origin.h"
 #include "lpc/include/runtime_config.h"
 #include "lpc/include/socket_err.h"
+#include "lpc/include/socket_opt.h"
 
 #define socket_perror(x,y)	debug_perror(x,y)
 
@@ -90,7 +95,11 @@ static int next_socket_op_id = 1;
 static socket_release_test_hook_t socket_release_test_hook = NULL;
 
 static int socket_name_to_sin (const char *, struct sockaddr_in *);
-static char *inet_address (struct sockaddr_in *);
+static socklen_t socket_name_to_addr (const char *, socket_addr_t *);
+static socklen_t socket_addr_len (const socket_addr_t *);
+static void socket_addr_to_name (const socket_addr_t *, char *, size_t);
+static int use_address_family (int, const char *);
+static char *inet_address (socket_addr_t *);
 static const char *lookup_socket_operation_phase_name (enum socket_operation_phase phase);
 static int is_socket_operation_terminal_phase (enum socket_operation_phase phase);
 static int can_transition_socket_operation_phase (enum socket_operation_phase from, enum socket_operation_phase to);
@@ -406,9 +415,15 @@ int more_lpc_sockets () {
       lpc_socks[i].r_buf = NULL;
       lpc_socks[i].r_off = 0;
       lpc_socks[i].r_len = 0;
-      lpc_socks[i].w_buf = NULL;
-      lpc_socks[i].w_off = 0;
-      lpc_socks[i].w_len = 0;
+      lpc_socks[i].w_head = NULL;
+      lpc_socks[i].w_tail = NULL;
+      lpc_socks[i].w_queued = 0;
+      lpc_socks[i].w_count = 0;
+      lpc_socks[i].rb_buf = NULL;
+      lpc_socks[i].rb_size = 0;
+      lpc_socks[i].r_budget = -1;
+      lpc_socks[i].w_limit = -1;
+      lpc_socks[i].r_batch = 0;
 
       socket_ops[i].active = 0;
       socket_ops[i].terminal = 0;
@@ -801,9 +816,15 @@ int socket_create (enum socket_mode mode, svalue_t * read_callback, svalue_t * c
       lpc_socks[i].r_buf = NULL;
       lpc_socks[i].r_off = 0;
       lpc_socks[i].r_len = 0;
-      lpc_socks[i].w_buf = NULL;
-      lpc_socks[i].w_off = 0;
-      lpc_socks[i].w_len = 0;
+      lpc_socks[i].w_head = NULL;
+      lpc_socks[i].w_tail = NULL;
+      lpc_socks[i].w_queued = 0;
+      lpc_socks[i].w_count = 0;
+      lpc_socks[i].rb_buf = NULL;
+      lpc_socks[i].rb_size = 0;
+      lpc_socks[i].r_budget = -1;
+      lpc_socks[i].w_limit = -1;
+      lpc_socks[i].r_batch = 0;
 
       if (!register_socket_runtime (i))
         {
@@ -824,28 +845,12 @@ int socket_create (enum socket_mode mode, svalue_t * read_callback, svalue_t * c
   return i;
 }
 
-/*
- * Bind an address to an LPC efun socket
- */
-int socket_bind (int i, int port) {
-
+static int
+bind_socket (int i, const socket_addr_t * addr, socklen_t addrlen)
+{
   socklen_t len;
-  struct sockaddr_in sin;
-
-  if (i < 0 || i >= max_lpc_socks)
-    return EEFDRANGE;
-  if (lpc_socks[i].state == CLOSED || lpc_socks[i].state == FLUSHING)
-    return EEBADF;
-  if (lpc_socks[i].owner_ob != current_object)
-    return EESECURITY;
-  if (lpc_socks[i].state != UNBOUND)
-    return EEISBOUND;
 
-  sin.sin_family = AF_INET;
-  sin.sin_addr.s_addr = INADDR_ANY;
-  sin.sin_port = htons ((u_short) port);
-
-  if (bind (lpc_socks[i].fd, (struct sockaddr *) &sin, sizeof (sin)) == SOCKET_ERROR)
+  if (bind (lpc_socks[i].fd, &addr->sa, addrlen) == SOCKET_ERROR)
     {
       switch (SOCKET_ERRNO)
         {
@@ -861,8 +866,10 @@ int socket_bind (int i, int port) {
           return EEBIND;
         }
     }
-  len = sizeof (sin);
-  if (getsockname (lpc_socks[i].fd, (struct sockaddr *) &lpc_socks[i].l_addr, &len) == SOCKET_ERROR)
+  if (lpc_socks[i].flags & S_LOCAL)
+    lpc_socks[i].flags |= S_UNLINK;
+  len = sizeof (lpc_socks[i].l_addr);
+  if (getsockname (lpc_socks[i].fd, &lpc_socks[i].l_addr.sa, &len) == SOCKET_ERROR)
     {
       socket_perror ("socket_bind: getsockname", 0);
       return EEGETSOCKNAME;
@@ -872,6 +879,60 @@ int socket_bind (int i, int port) {
   return EESUCCESS;
 }
 
+/*
+ * Bind a port on all interfaces to an LPC efun socket
+ */
+int socket_bind (int i, int port) {
+
+  socket_addr_t addr;
+
+  if (i < 0 || i >= max_lpc_socks)
+    return EEFDRANGE;
+  if (lpc_socks[i].state == CLOSED || lpc_socks[i].state == FLUSHING)
+    return EEBADF;
+  if (lpc_socks[i].owner_ob != current_object)
+    return EESECURITY;
+  if (lpc_socks[i].state != UNBOUND)
+    return EEISBOUND;
+  if (lpc_socks[i].flags & S_LOCAL)
+    return EEBADADDR;
+
+  memset (&addr, 0, sizeof (addr));
+  addr.sin.sin_family = AF_INET;
+  addr.sin.sin_addr.s_addr = INADDR_ANY;
+  addr.sin.sin_port = htons ((u_short) port);
+
+  return bind_socket (i, &addr, sizeof (addr.sin));
+}
+
+/**
+ * Bind an address to an LPC efun socket
+ * @param i the socket index
+ * @param name "a.b.c.d port", or "unix:<path>" to make it a local socket
+ * @return error code
+ */
+int socket_bind_address (int i, const char *name) {
+
+  socket_addr_t addr;
+  socklen_t addrlen;
+  int err;
+
+  if (i < 0 || i >= max_lpc_socks)
+    return EEFDRANGE;
+  if (lpc_socks[i].state == CLOSED || lpc_socks[i].state == FLUSHING)
+    return EEBADF;
+  if (lpc_socks[i].owner_ob != current_object)
+    return EESECURITY;
+  if (lpc_socks[i].state != UNBOUND)
+    return EEISBOUND;
+  if ((addrlen = socket_name_to_addr (name, &addr)) == 0)
+    return EEBADADDR;
+  if ((err = use_address_family (i, name)) != EESUCCESS)
+    return err;
+
+  return bind_socket (i, &addr, addrlen);
+}
+
 /*
  * Listen for connections on an LPC efun socket
  */
@@ -911,7 +972,7 @@ int socket_accept (int s, svalue_t * read_callback, svalue_t * write_callback) {
   socklen_t len;
   socket_fd_t accept_fd;
   int i;
-  struct sockaddr_in sin;
+  socket_addr_t sin;
 #if 0
   struct hostent *hp;
 #endif
@@ -930,7 +991,8 @@ int socket_accept (int s, svalue_t * read_callback, svalue_t * write_callback) {
   lpc_socks[s].flags &= ~S_WACCEPT;
 
   len = sizeof (sin);
-  accept_fd = accept (lpc_socks[s].fd, (struct sockaddr *) &sin, &len);
+  memset (&sin, 0, sizeof (sin));
+  accept_fd = accept (lpc_socks[s].fd, &sin.sa, &len);
   if (accept_fd == INVALID_SOCKET_FD)
     {
       switch (SOCKET_ERRNO)
@@ -952,7 +1014,7 @@ int socket_accept (int s, svalue_t * read_callback, svalue_t * write_callback) {
       int nb;
 
       lpc_socks[i].fd = accept_fd;
-      lpc_socks[i].flags = S_HEADER | (lpc_socks[s].flags & S_BINARY);
+      lpc_socks[i].flags = S_HEADER | (lpc_socks[s].flags & (S_BINARY | S_LOCAL));
 
       FD_ZERO (&wmask);
       FD_SET (accept_fd, &wmask);
@@ -971,13 +1033,20 @@ int socket_accept (int s, svalue_t * read_callback, svalue_t * write_callback) {
       lpc_socks[i].r_buf = NULL;
       lpc_socks[i].r_off = 0;
       lpc_socks[i].r_len = 0;
-      lpc_socks[i].w_buf = NULL;
-      lpc_socks[i].w_off = 0;
-      lpc_socks[i].w_len = 0;
+      lpc_socks[i].w_head = NULL;
+      lpc_socks[i].w_tail = NULL;
+      lpc_socks[i].w_queued = 0;
+      lpc_socks[i].w_count = 0;
+      lpc_socks[i].rb_buf = NULL;
+      lpc_socks[i].rb_size = 0;
+      /* options set on the listening socket carry over */
+      lpc_socks[i].r_budget = lpc_socks[s].r_budget;
+      lpc_socks[i].w_limit = lpc_socks[s].w_limit;
+      lpc_socks[i].r_batch = 0;
 
       /* FIXME: name resolution should be optional, to prevent DDoS attack */
 #if 0
-      hp = gethostbyaddr ((char *) &sin.sin_addr.s_addr, (int) sizeof (sin.sin_addr.s_addr), AF_INET);
+      hp = gethostbyaddr ((char *) &sin.sin.sin_addr.s_addr, (int) sizeof (sin.sin.sin_addr.s_addr), AF_INET);
       if (hp != NULL)
         {
           strncpy (lpc_socks[i].name, hp->h_name, ADDR_BUF_SIZE);
@@ -1038,6 +1107,13 @@ int socket_connect (int i, const char *name, svalue_t * read_callback, svalue_t
     case DATA_XFER:
       return EEISCONN;
     }
+  if (name != NULL)
+    {
+      int err = use_address_family (i, name);
+
+      if (err != EESUCCESS)
+        return err;
+    }
 
   {
     int is_hostname = 0;
@@ -1047,8 +1123,9 @@ int socket_connect (int i, const char *name, svalue_t * read_callback, svalue_t
     char *cp, *port_end;
 
     /* Check if the address looks like a hostname (non-numeric IP) by attempting
-     * to extract and parse the address component as IPv4. Also extract port. */
-    if (name != NULL)
+     * to extract and parse the address component as IPv4. Also extract port.
+     * Local socket paths have nothing to resolve. */
+    if (name != NULL && !(lpc_socks[i].flags & S_LOCAL))
       {
         strncpy (addr, name, ADDR_BUF_SIZE);
         addr[ADDR_BUF_SIZE - 1] = '\0';
@@ -1075,9 +1152,9 @@ int socket_connect (int i, const char *name, svalue_t * read_callback, svalue_t
         if (addr_resolver_forward_cache_get (addr, &cached_ip))
           {
             opt_trace (TT_COMM|3, "socket_connect: fwd cache hit hostname=%s port=%ld", addr, port_num);
-            lpc_socks[i].r_addr.sin_family = AF_INET;
-            lpc_socks[i].r_addr.sin_addr.s_addr = cached_ip;
-            lpc_socks[i].r_addr.sin_port = htons ((uint16_t)port_num);
+            lpc_socks[i].r_addr.sin.sin_family = AF_INET;
+            lpc_socks[i].r_addr.sin.sin_addr.s_addr = cached_ip;
+            lpc_socks[i].r_addr.sin.sin_port = htons ((uint16_t)port_num);
             is_hostname = 0; /* resolved from cache; fall through to numeric connect */
           }
         else
@@ -1120,8 +1197,13 @@ int socket_connect (int i, const char *name, svalue_t * read_callback, svalue_t
 
   /* Non-hostname path: resolve address synchronously (numeric IPv4 only).
    * Skip if r_addr was already populated from the forward DNS cache. */
-  if (lpc_socks[i].r_addr.sin_family == 0 &&
-      !socket_name_to_sin (name, &lpc_socks[i].r_addr))
+  if (lpc_socks[i].flags & S_LOCAL)
+    {
+      if (socket_name_to_addr (name, &lpc_socks[i].r_addr) == 0)
+        return EEBADADDR;
+    }
+  else if (lpc_socks[i].r_addr.sa.sa_family == 0 &&
+           !socket_name_to_sin (name, &lpc_socks[i].r_addr.sin))
     return EEBADADDR;
 
   set_read_callback (i, read_callback);
@@ -1137,7 +1219,7 @@ int socket_connect (int i, const char *name, svalue_t * read_callback, svalue_t
 
   current_object->flags |= O_EFUN_SOCKET;
 
-  if (connect (lpc_socks[i].fd, (struct sockaddr *) &lpc_socks[i].r_addr, sizeof (struct sockaddr_in)) == SOCKET_ERROR)
+  if (connect (lpc_socks[i].fd, &lpc_socks[i].r_addr.sa, socket_addr_len (&lpc_socks[i].r_addr)) == SOCKET_ERROR)
     {
       switch (SOCKET_ERRNO)
         {
@@ -1191,8 +1273,127 @@ int socket_connect (int i, const char *name, svalue_t * read_callback, svalue_t
   return EESUCCESS;
 }
 
+static size_t
+send_queue_limit (int i)
+{
+  if (lpc_socks[i].w_limit >= 0)
+    return (size_t) lpc_socks[i].w_limit;
+  return (size_t) CONFIG_INT (__SOCKET_SEND_QUEUE_LIMIT__);
+}
+
+/*
+ * Queue a message on the send queue of a stream socket. A string is
+ * referenced, anything else is taken over from buf.
+ */
+static void
+queue_message (int i, svalue_t * str, char *buf, const char *data, size_t len, size_t off)
+{
+  socket_wbuf_t *wb;
+
+  wb = CALLOCATE (1, socket_wbuf_t, TAG_SOCKETS, "queue_message");
+  if (wb == NULL)
+    fatal ("Out of memory");
+  wb->next = NULL;
+  if (str != NULL)
+    assign_svalue_no_free (&wb->ref, str);
+  else
+    wb->ref = const0;
+  wb->buf = buf;
+  wb->data = data;
+  wb->len = len;
+  wb->off = off;
+
+  if (lpc_socks[i].w_tail != NULL)
+    lpc_socks[i].w_tail->next = wb;
+  else
+    lpc_socks[i].w_head = wb;
+  lpc_socks[i].w_tail = wb;
+  lpc_socks[i].w_queued += len - off;
+  lpc_socks[i].w_count++;
+}
+
+static void
+free_message (socket_wbuf_t * wb)
+{
+  if (wb->buf != NULL)
+    FREE (wb->buf);
+  free_svalue (&wb->ref, "free_message");
+  FREE (wb);
+}
+
+static void
+clear_send_queue (int i)
+{
+  socket_wbuf_t *wb;
+
+  while ((wb = lpc_socks[i].w_head) != NULL)
+    {
+      lpc_socks[i].w_head = wb->next;
+      free_message (wb);
+    }
+  lpc_socks[i].w_tail = NULL;
+  lpc_socks[i].w_queued = 0;
+  lpc_socks[i].w_count = 0;
+}
+
+/*
+ * Send as much of the send queue as the socket takes, up to SOCKET_MAX_IOV
+ * messages per system call.
+ * @return bytes sent, or -1 on error (errno is left as set by the send)
+ */
+static long
+flush_send_queue (int i)
+{
+  socket_iovec_t iov[SOCKET_MAX_IOV];
+  socket_wbuf_t *wb;
+  long total = 0;
+
+  while (lpc_socks[i].w_head != NULL)
+    {
+      size_t want = 0, left;
+      long cc;
+      int n = 0;
+
+      for (wb = lpc_socks[i].w_head; wb != NULL && n < SOCKET_MAX_IOV; wb = wb->next)
+        {
+          SOCKET_IOV_SET (iov[n], wb->data + wb->off, wb->len - wb->off);
+          want += wb->len - wb->off;
+          n++;
+        }
+      cc = socket_sendv (lpc_socks[i].fd, iov, n, 0);
+      if (cc == -1)
+        return total ? total : -1;
+
+      lpc_socks[i].w_queued -= cc;
+      total += cc;
+      for (left = (size_t) cc; left > 0;)
+        {
+          wb = lpc_socks[i].w_head;
+          if (left < wb->len - wb->off)
+            {
+              wb->off += left;
+              break;
+            }
+          left -= wb->len - wb->off;
+          lpc_socks[i].w_head = wb->next;
+          if (lpc_socks[i].w_head == NULL)
+            lpc_socks[i].w_tail = NULL;
+          lpc_socks[i].w_count--;
+          free_message (wb);
+        }
+      if ((size_t) cc < want)
+        break;
+    }
+  return total;
+}
+
 /**
  * Write a message on an LPC efun socket
+ *
+ * A stream socket that still has output pending queues the message, up to
+ * SocketSendQueueLimit bytes, and the write callback is called once the
+ * whole queue has been sent.
+ *
  * @param i the socket index
  * @param message the message to send
  * @param name the address to send to (for datagram sockets)
@@ -1201,9 +1402,12 @@ int socket_connect (int i, const char *name, svalue_t * read_callback, svalue_t
 int socket_write (int i, svalue_t * message, const char *name) {
 
   size_t len;
-  int off;
-  char *buf, *p;
-  struct sockaddr_in sin;
+  long off;
+  char *buf = NULL, *p;
+  const char *data;
+  svalue_t *str = NULL;
+  socket_addr_t to;
+  socklen_t tolen = 0;
 
   if (i < 0 || i >= max_lpc_socks)
     return EEFDRANGE;
@@ -1213,10 +1417,14 @@ int socket_write (int i, svalue_t * message, const char *name) {
     return EESECURITY;
   if (lpc_socks[i].mode == DATAGRAM)
     {
+      int err;
+
       if (name == NULL)
         return EENOADDR;
-      if (!socket_name_to_sin (name, &sin))
+      if ((tolen = socket_name_to_addr (name, &to)) == 0)
         return EEBADADDR;
+      if ((err = use_address_family (i, name)) != EESUCCESS)
+        return err;
     }
   else
     {
@@ -1224,7 +1432,9 @@ int socket_write (int i, svalue_t * message, const char *name) {
         return EENOTCONN;
       if (name != NULL)
         return EEBADADDR;
-      if (lpc_socks[i].flags & S_BLOCKED)
+      /* blocked with nothing queued: the connection is still being set up */
+      if ((lpc_socks[i].flags & S_BLOCKED) &&
+          (lpc_socks[i].w_head == NULL || send_queue_limit (i) == 0))
         return EEALREADY;
     }
 
@@ -1268,10 +1478,16 @@ int socket_write (int i, svalue_t * message, const char *name) {
           break;
         case T_STRING:
           len = SVALUE_STRLEN (message);
+          if (message->subtype & STRING_COUNTED)
+            {
+              /* counted strings are immutable while referenced */
+              str = message;
+              break;
+            }
           buf = (char *) DMALLOC (len + 1, TAG_TEMPORARY, "socket_write: T_STRING");
           if (buf == NULL)
             fatal ("Out of memory");
-          strcpy (buf, SVALUE_STRPTR (message));
+          memcpy (buf, SVALUE_STRPTR (message), len + 1);
           break;
         case T_ARRAY:
           {
@@ -1312,7 +1528,7 @@ int socket_write (int i, svalue_t * message, const char *name) {
         case T_STRING:
           if (sendto (lpc_socks[i].fd, (char *) SVALUE_STRPTR (message),
                       (int)strlen (SVALUE_STRPTR (message)) + 1, 0,
-                      (struct sockaddr *) &sin, sizeof (sin)) == -1)
+                      &to.sa, tolen) == -1)
             {
               debug_error ("sendto() failed: %d", SOCKET_ERRNO);
               return EESENDTO;
@@ -1323,7 +1539,7 @@ int socket_write (int i, svalue_t * message, const char *name) {
         case T_BUFFER:
           if (sendto (lpc_socks[i].fd, (char *) message->u.buf->item,
                       message->u.buf->size, 0,
-                      (struct sockaddr *) &sin, sizeof (sin)) == -1)
+                      &to.sa, tolen) == -1)
             {
               debug_error ("sendto() failed: %d", SOCKET_ERRNO);
               return EESENDTO;
@@ -1338,10 +1554,29 @@ int socket_write (int i, svalue_t * message, const char *name) {
       return EEMODENOTSUPP;
     }
 
-  off = SOCKET_SEND (lpc_socks[i].fd, buf, len, 0);
+  data = buf ? buf : SVALUE_STRPTR (str);
+
+  if (lpc_socks[i].w_head != NULL)
+    {
+      /* output is pending: keep the order and queue behind it */
+      if (lpc_socks[i].w_queued + len > send_queue_limit (i))
+        {
+          if (buf)
+            FREE (buf);
+          return EEQUEUEFULL;
+        }
+      if (len > 0)
+        queue_message (i, str, buf, data, len, 0);
+      else if (buf)
+        FREE (buf);
+      return EECALLBACK;
+    }
+
+  off = len ? SOCKET_SEND (lpc_socks[i].fd, data, len, 0) : 0;
   if (off == -1)
     {
-      FREE (buf);
+      if (buf)
+        FREE (buf);
       switch (SOCKET_ERRNO)
         {
 #ifdef WINSOCK
@@ -1357,12 +1592,10 @@ int socket_write (int i, svalue_t * message, const char *name) {
           return EESEND;
         }
     }
-  if (off < (int)len)
+  if ((size_t) off < len)
     {
       lpc_socks[i].flags |= S_BLOCKED;
-      lpc_socks[i].w_buf = buf;
-      lpc_socks[i].w_off = off;
-      lpc_socks[i].w_len = (int)(len - off);
+      queue_message (i, str, buf, data, len, (size_t) off);
 
       if (!modify_socket_runtime (i))
         {
@@ -1372,11 +1605,179 @@ int socket_write (int i, svalue_t * message, const char *name) {
 
       return EECALLBACK;
     }
-  FREE (buf);
+  if (buf)
+    FREE (buf);
 
   return EESUCCESS;
 }
 
+/*
+ * Send datagrams, with one system call where the platform has sendmmsg().
+ * @return number of datagrams sent, or -1 if none could be sent (errno is
+ *   left as set by the send)
+ */
+static int
+send_datagrams (socket_fd_t fd, const char **data, const size_t *len, socket_addr_t *to, int n)
+{
+#ifdef HAVE_SENDMMSG
+  struct mmsghdr msgs[SOCKET_MAX_DGRAM_BATCH];
+  struct iovec iov[SOCKET_MAX_DGRAM_BATCH];
+  int k;
+
+  memset (msgs, 0, sizeof (msgs[0]) * n);
+  for (k = 0; k < n; k++)
+    {
+      iov[k].iov_base = (void *) data[k];
+      iov[k].iov_len = len[k];
+      msgs[k].msg_hdr.msg_name = &to[k];
+      msgs[k].msg_hdr.msg_namelen = socket_addr_len (&to[k]);
+      msgs[k].msg_hdr.msg_iov = &iov[k];
+      msgs[k].msg_hdr.msg_iovlen = 1;
+    }
+  return sendmmsg (fd, msgs, n, 0);
+#else
+  int k;
+
+  for (k = 0; k < n; k++)
+    {
+      if (sendto (fd, (char *) data[k], (int) len[k], 0, &to[k].sa, socket_addr_len (&to[k])) == -1)
+        return k ? k : -1;
+    }
+  return n;
+#endif
+}
+
+/**
+ * Write several datagrams on an LPC efun socket
+ *
+ * Every pair is checked before anything is sent. Messages are sent the same
+ * way as by socket_write(): strings with their terminating NUL byte, buffers
+ * as they are.
+ *
+ * @param i the socket index
+ * @param packets array of ({ message, address }) pairs
+ * @return the number of datagrams sent, which is less than the size of
+ *   packets if the socket ran out of buffer space, or an error code
+ */
+int socket_write_batch (int i, array_t * packets) {
+  const char *data[SOCKET_MAX_DGRAM_BATCH];
+  size_t len[SOCKET_MAX_DGRAM_BATCH];
+  socket_addr_t to[SOCKET_MAX_DGRAM_BATCH];
+  int sent = 0, cc = 0, n, k, err;
+
+  if (i < 0 || i >= max_lpc_socks)
+    return EEFDRANGE;
+  if (lpc_socks[i].state == CLOSED || lpc_socks[i].state == FLUSHING)
+    return EEBADF;
+  if (lpc_socks[i].owner_ob != current_object)
+    return EESECURITY;
+  if (lpc_socks[i].mode != DATAGRAM)
+    return EEMODENOTSUPP;
+
+  for (k = 0; k < packets->size; k++)
+    {
+      svalue_t *pair;
+
+      if (packets->item[k].type != T_ARRAY || packets->item[k].u.arr->size != 2)
+        return EETYPENOTSUPP;
+      pair = packets->item[k].u.arr->item;
+      if (pair[0].type != T_STRING && pair[0].type != T_BUFFER)
+        return EETYPENOTSUPP;
+      if (pair[1].type != T_STRING)
+        return EENOADDR;
+      if (socket_name_to_addr (SVALUE_STRPTR (&pair[1]), &to[0]) == 0)
+        return EEBADADDR;
+    }
+  for (k = 0; k < packets->size; k++)
+    {
+      /* the first address picks the family of an unbound socket */
+      if ((err = use_address_family (i, SVALUE_STRPTR (&packets->item[k].u.arr->item[1]))) != EESUCCESS)
+        return err;
+    }
+
+  while (sent < packets->size)
+    {
+      n = packets->size - sent;
+      if (n > SOCKET_MAX_DGRAM_BATCH)
+        n = SOCKET_MAX_DGRAM_BATCH;
+      for (k = 0; k < n; k++)
+        {
+          svalue_t *pair = packets->item[sent + k].u.arr->item;
+
+          if (pair[0].type == T_STRING)
+            {
+              data[k] = SVALUE_STRPTR (&pair[0]);
+              len[k] = SVALUE_STRLEN (&pair[0]) + 1;
+            }
+          else
+            {
+              data[k] = (const char *) pair[0].u.buf->item;
+              len[k] = pair[0].u.buf->size;
+            }
+          socket_name_to_addr (SVALUE_STRPTR (&pair[1]), &to[k]);
+        }
+      cc = send_datagrams (lpc_socks[i].fd, data, len, to, n);
+      if (cc < 0)
+        break;
+      sent += cc;
+      if (cc < n)
+        break;
+    }
+
+  if (sent == 0 && cc < 0)
+    {
+      switch (SOCKET_ERRNO)
+        {
+#ifdef WINSOCK
+        case WSAEWOULDBLOCK:
+#else
+        case EWOULDBLOCK:
+#endif
+          return EEWOULDBLOCK;
+        default:
+          debug_error ("sendmmsg() failed: %d", SOCKET_ERRNO);
+          return EESENDTO;
+        }
+    }
+  return sent;
+}
+
+/**
+ * Tune an LPC efun socket
+ * @param i the socket index
+ * @param option one of the SOCKOPT_* options in socket_opt.h
+ * @param value the new value; a negative value restores the default from
+ *   the runtime configuration
+ * @return error code
+ */
+int socket_set_option (int i, int option, int64_t value) {
+  if (i < 0 || i >= max_lpc_socks)
+    return EEFDRANGE;
+  if (lpc_socks[i].state == CLOSED || lpc_socks[i].state == FLUSHING)
+    return EEBADF;
+  if (lpc_socks[i].owner_ob != current_object)
+    return EESECURITY;
+  if (value > LONG_MAX)
+    return EESETSOCKOPT;
+
+  switch (option)
+    {
+    case SOCKOPT_READ_BUDGET:
+      lpc_socks[i].r_budget = value < 0 ? -1 : (long) value;
+      return EESUCCESS;
+    case SOCKOPT_SEND_QUEUE_LIMIT:
+      lpc_socks[i].w_limit = value < 0 ? -1 : (long) value;
+      return EESUCCESS;
+    case SOCKOPT_RECV_BATCH:
+      if (lpc_socks[i].mode != DATAGRAM)
+        return EEMODENOTSUPP;
+      lpc_socks[i].r_batch = value <= 0 ? 0 : value > SOCKET_MAX_DGRAM_BATCH ? SOCKET_MAX_DGRAM_BATCH : (int) value;
+      return EESUCCESS;
+    default:
+      return EESETSOCKOPT;
+    }
+}
+
 static void
 call_callback (int i, int what, int num_arg)
 {
@@ -1409,6 +1810,247 @@ call_callback (int i, int what, int num_arg)
     }
 }
 
+static size_t
+read_budget (int i)
+{
+  long budget = lpc_socks[i].r_budget;
+
+  if (budget < 0)
+    budget = CONFIG_INT (__SOCKET_READ_BUDGET__);
+  return budget < BUF_SIZE ? BUF_SIZE : (size_t) budget;
+}
+
+/*
+ * Read from a stream socket until it has nothing more, or the read budget
+ * of the socket is used up. The data is left NUL-terminated in rb_buf,
+ * which grows as needed up to the budget.
+ * @param closed set when the peer closed the connection or it failed
+ * @return bytes read
+ */
+static size_t
+read_stream_socket (int i, int *closed)
+{
+  size_t budget = read_budget (i);
+  size_t total = 0;
+
+  while (total < budget)
+    {
+      size_t want;
+      long cc;
+
+      if (lpc_socks[i].rb_size < budget + 1 && lpc_socks[i].rb_size - total <= BUF_SIZE)
+        {
+          size_t size = lpc_socks[i].rb_size ? lpc_socks[i].rb_size * 2 : BUF_SIZE + 1;
+
+          if (size > budget + 1)
+            size = budget + 1;
+          lpc_socks[i].rb_buf = (char *) DREALLOC (lpc_socks[i].rb_buf, size, TAG_SOCKETS, "read_stream_socket");
+          if (lpc_socks[i].rb_buf == NULL)
+            fatal ("Out of memory");
+          lpc_socks[i].rb_size = size;
+        }
+      want = lpc_socks[i].rb_size - 1 - total;
+      if (want > budget - total)
+        want = budget - total;
+
+      cc = SOCKET_RECV (lpc_socks[i].fd, lpc_socks[i].rb_buf + total, want, 0);
+      if (cc > 0)
+        {
+          total += (size_t) cc;
+          /* a short read means the socket is drained, skip the EAGAIN round trip */
+          if ((size_t) cc < want)
+            break;
+          continue;
+        }
+      if (cc == -1)
+        {
+          switch (SOCKET_ERRNO)
+            {
+            case EINTR:
+#ifdef WINSOCK
+            case WSAEWOULDBLOCK:
+#else
+            case EWOULDBLOCK:
+#endif
+              break;
+            default:
+              *closed = 1;
+              break;
+            }
+        }
+      else
+        *closed = 1;
+      break;
+    }
+  if (lpc_socks[i].rb_buf != NULL)
+    lpc_socks[i].rb_buf[total] = '\0';
+  return total;
+}
+
+/*
+ * Address strings of recent datagram peers, so that a burst of datagrams
+ * from the same peer formats its address once and shares the string.
+ */
+#define ADDR_CACHE_SIZE 64	/* a power of 2 */
+
+static struct {
+  struct in_addr addr;
+  unsigned short port;
+  shared_str_t name;
+} addr_cache[ADDR_CACHE_SIZE];
+
+static shared_str_t
+sin_to_address (const struct sockaddr_in *sin)
+{
+  uint32_t h;
+  char addr[ADDR_BUF_SIZE];
+
+  h = ((uint32_t) sin->sin_addr.s_addr ^ ((uint32_t) sin->sin_port << 16)) * 2654435761u;
+  h >>= 26;	/* log2 (ADDR_CACHE_SIZE) top bits */
+  if (addr_cache[h].name != NULL &&
+      addr_cache[h].addr.s_addr == sin->sin_addr.s_addr && addr_cache[h].port == sin->sin_port)
+    return addr_cache[h].name;
+
+  inet_ntop (AF_INET, &sin->sin_addr, addr, ADDR_BUF_SIZE);
+  snprintf (addr + strlen (addr), sizeof (addr) - strlen (addr), " %d", (int) ntohs (sin->sin_port));
+  if (addr_cache[h].name != NULL)
+    free_string (to_shared_str (addr_cache[h].name));
+  addr_cache[h].addr = sin->sin_addr;
+  addr_cache[h].port = sin->sin_port;
+  addr_cache[h].name = make_shared_string (addr, NULL);
+  return addr_cache[h].name;
+}
+
+/**
+ * Release the cached datagram peer addresses (called before the string
+ * table goes away)
+ */
+void clear_socket_address_cache (void) {
+  int h;
+
+  for (h = 0; h < ADDR_CACHE_SIZE; h++)
+    {
+      if (addr_cache[h].name != NULL)
+        free_string (to_shared_str (addr_cache[h].name));
+      addr_cache[h].name = NULL;
+    }
+}
+
+/*
+ * Store the address of a datagram peer in sv, as a new reference.
+ */
+static void
+set_peer_name (svalue_t * sv, const socket_addr_t * from)
+{
+  char name[ADDR_BUF_SIZE];
+
+  if (from->sa.sa_family == AF_INET)
+    {
+      SET_SVALUE_SHARED_STRING (sv, ref_string (to_shared_str (sin_to_address (&from->sin))));
+      return;
+    }
+  socket_addr_to_name (from, name, sizeof (name));
+  SET_SVALUE_MALLOC_STRING (sv, string_copy (name, "set_peer_name"));
+}
+
+/*
+ * Receive up to r_batch waiting datagrams, with one system call where the
+ * platform has recvmmsg(), and deliver them in one read callback as an array
+ * of ({ message, address }) pairs.
+ * @return number of datagrams, or -1 on error (errno is left as set by the
+ *   receive)
+ */
+static int
+read_datagram_batch (int i)
+{
+  socket_addr_t from[SOCKET_MAX_DGRAM_BATCH];
+  size_t len[SOCKET_MAX_DGRAM_BATCH];
+  size_t size = (size_t) lpc_socks[i].r_batch * BUF_SIZE;
+  array_t *packets;
+  int n, k;
+
+  if (lpc_socks[i].rb_size < size)
+    {
+      lpc_socks[i].rb_buf = (char *) DREALLOC (lpc_socks[i].rb_buf, size, TAG_SOCKETS, "read_datagram_batch");
+      if (lpc_socks[i].rb_buf == NULL)
+        fatal ("Out of memory");
+      lpc_socks[i].rb_size = size;
+    }
+  memset (from, 0, sizeof (from[0]) * lpc_socks[i].r_batch);
+
+#ifdef HAVE_RECVMMSG
+  {
+    struct mmsghdr msgs[SOCKET_MAX_DGRAM_BATCH];
+    struct iovec iov[SOCKET_MAX_DGRAM_BATCH];
+
+    memset (msgs, 0, sizeof (msgs[0]) * lpc_socks[i].r_batch);
+    for (k = 0; k < lpc_socks[i].r_batch; k++)
+      {
+        iov[k].iov_base = lpc_socks[i].rb_buf + (size_t) k * BUF_SIZE;
+        iov[k].iov_len = BUF_SIZE - 1;
+        msgs[k].msg_hdr.msg_name = &from[k];
+        msgs[k].msg_hdr.msg_namelen = sizeof (from[k]);
+        msgs[k].msg_hdr.msg_iov = &iov[k];
+        msgs[k].msg_hdr.msg_iovlen = 1;
+      }
+    n = recvmmsg (lpc_socks[i].fd, msgs, lpc_socks[i].r_batch, 0, NULL);
+    if (n <= 0)
+      return -1;
+    for (k = 0; k < n; k++)
+      len[k] = msgs[k].msg_len;
+  }
+#else
+  for (n = 0; n < lpc_socks[i].r_batch; n++)
+    {
+      socklen_t addrlen = sizeof (from[n]);
+      long cc;
+
+      cc = recvfrom (lpc_socks[i].fd, lpc_socks[i].rb_buf + (size_t) n * BUF_SIZE, BUF_SIZE - 1, 0,
+                     &from[n].sa, &addrlen);
+      if (cc < 0)
+        {
+          if (n == 0)
+            return -1;
+          break;
+        }
+      len[n] = (size_t) cc;
+    }
+#endif
+
+  packets = allocate_empty_array (n);
+  for (k = 0; k < n; k++)
+    {
+      char *data = lpc_socks[i].rb_buf + (size_t) k * BUF_SIZE;
+      array_t *pair = allocate_empty_array (2);
+
+      data[len[k]] = '\0';
+      if (lpc_socks[i].flags & S_BINARY)
+        {
+          buffer_t *b = allocate_buffer (len[k]);
+
+          if (b)
+            {
+              memcpy (b->item, data, len[k]);
+              pair->item[0].type = T_BUFFER;
+              pair->item[0].u.buf = b;
+            }
+          else
+            pair->item[0] = const0;
+        }
+      else
+        {
+          SET_SVALUE_MALLOC_STRING (&pair->item[0], string_copy (data, "read_datagram_batch"));
+        }
+      set_peer_name (&pair->item[1], &from[k]);
+      packets->item[k].type = T_ARRAY;
+      packets->item[k].u.arr = pair;
+    }
+  push_number (i);
+  push_refed_array (packets);
+  call_callback (i, S_READ_FP, 2);
+  return n;
+}
+
 /*
  * Handle LPC efun socket read select events
  */
@@ -1417,9 +2059,9 @@ socket_read_select_handler (int i)
 {
   socklen_t addrlen;
   int cc = 0;
-  char buf[BUF_SIZE], addr[ADDR_BUF_SIZE];
+  char buf[BUF_SIZE];
   svalue_t value;
-  struct sockaddr_in sin;
+  socket_addr_t from;
 
   switch (lpc_socks[i].state)
     {
@@ -1441,13 +2083,19 @@ socket_read_select_handler (int i)
           break;
 
         case DATAGRAM:
-          addrlen = sizeof (sin);
-          cc = recvfrom (lpc_socks[i].fd, buf, sizeof (buf) - 1, 0, (struct sockaddr *) &sin, &addrlen);
+          if (lpc_socks[i].r_batch > 0)
+            {
+              cc = read_datagram_batch (i);
+              if (cc <= 0)
+                break;
+              return;
+            }
+          addrlen = sizeof (from);
+          memset (&from, 0, sizeof (from));
+          cc = recvfrom (lpc_socks[i].fd, buf, sizeof (buf) - 1, 0, &from.sa, &addrlen);
           if (cc <= 0)
             break;
           buf[cc] = '\0';
-          inet_ntop (AF_INET, &sin.sin_addr, addr, ADDR_BUF_SIZE);
-          snprintf (addr + strlen(addr), sizeof(addr) - strlen(addr), " %d", (int) ntohs (sin.sin_port));
           push_number (i);
           if (lpc_socks[i].flags & S_BINARY)
             {
@@ -1468,7 +2116,8 @@ socket_read_select_handler (int i)
             {
               copy_and_push_string (buf);
             }
-          copy_and_push_string (addr);
+          push_undefined ();
+          set_peer_name (sp, &from);
           call_callback (i, S_READ_FP, 3);
           return;
         case STREAM_BINARY:
@@ -1533,33 +2182,42 @@ socket_read_select_handler (int i)
           return;
 
         case STREAM:
-          cc = SOCKET_RECV (lpc_socks[i].fd, buf, sizeof (buf) - 1, 0);
-          if (cc <= 0)
-            break;
-          buf[cc] = '\0';
-          push_number (i);
-          if (lpc_socks[i].flags & S_BINARY)
-            {
-              buffer_t *b;
+          {
+            socket_fd_t fd = lpc_socks[i].fd;
+            int closed = 0;
+            size_t got = read_stream_socket (i, &closed);
 
-              b = allocate_buffer (cc);
-              if (b)
-                {
-                  b->ref--;
-                  memcpy (b->item, buf, cc);
-                  push_buffer (b);
-                }
-              else
-                {
-                  push_number (0);
-                }
-            }
-          else
-            {
-              copy_and_push_string (buf);
-            }
-          call_callback (i, S_READ_FP, 2);
-          return;
+            if (got > 0)
+              {
+                /* everything read in this event goes to one callback */
+                push_number (i);
+                if (lpc_socks[i].flags & S_BINARY)
+                  {
+                    buffer_t *b;
+
+                    b = allocate_buffer (got);
+                    if (b)
+                      {
+                        memcpy (b->item, lpc_socks[i].rb_buf, got);
+                        push_refed_buffer (b);
+                      }
+                    else
+                      {
+                        push_number (0);
+                      }
+                  }
+                else
+                  {
+                    copy_and_push_string (lpc_socks[i].rb_buf);
+                  }
+                call_callback (i, S_READ_FP, 2);
+              }
+            /* the callback may have closed the socket */
+            if (!closed || lpc_socks[i].fd != fd || lpc_socks[i].state != DATA_XFER)
+              return;
+            cc = 0;
+          }
+          break;
         case STREAM_BINARY:
         case DATAGRAM_BINARY:
           break;
@@ -1601,17 +2259,21 @@ socket_read_select_handler (int i)
  * Handle LPC efun socket write select events
  */
 void socket_write_select_handler (int i) {
-  int cc;
+  long cc;
 
   if ((lpc_socks[i].flags & S_BLOCKED) == 0)
     return;
 
-  if (lpc_socks[i].w_buf != NULL)
+  if (lpc_socks[i].w_head != NULL)
     {
-      cc = SOCKET_SEND (lpc_socks[i].fd, lpc_socks[i].w_buf + lpc_socks[i].w_off, lpc_socks[i].w_len, 0);
+      cc = flush_send_queue (i);
       if (cc == -1)
         {
-          if (lpc_socks[i].state == FLUSHING && errno != EINTR)
+          if (lpc_socks[i].state == FLUSHING && errno != EINTR
+#ifndef WINSOCK
+              && errno != EWOULDBLOCK
+#endif
+              )
             {
               /* give up on errors writing to closing sockets */
               lpc_socks[i].flags &= ~S_BLOCKED;
@@ -1619,13 +2281,8 @@ void socket_write_select_handler (int i) {
             }
           return;
         }
-      lpc_socks[i].w_off += cc;
-      lpc_socks[i].w_len -= cc;
-      if (lpc_socks[i].w_len != 0)
+      if (lpc_socks[i].w_head != NULL)
         return;
-      FREE (lpc_socks[i].w_buf);
-      lpc_socks[i].w_buf = NULL;
-      lpc_socks[i].w_off = 0;
     }
   lpc_socks[i].flags &= ~S_BLOCKED;
 
@@ -1641,8 +2298,7 @@ void socket_write_select_handler (int i) {
       return;
     }
 
-  if (lpc_socks[i].w_buf == NULL)
-    complete_socket_operation (i, OP_COMPLETED);
+  complete_socket_operation (i, OP_COMPLETED);
 
   push_number (i);
   call_callback (i, S_WRITE_FP, 1);
@@ -1691,12 +2347,23 @@ int socket_close (int i, int flags) {
 
   while (SOCKET_CLOSE (lpc_socks[i].fd) == -1 && SOCKET_ERRNO == EINTR)
     ;				/* empty while */
+#ifdef HAVE_SYS_UN_H
+  /* the path was created by our bind */
+  if (lpc_socks[i].flags & S_UNLINK)
+    unlink (lpc_socks[i].l_addr.local.sun_path);
+#endif
+  lpc_socks[i].flags &= ~S_UNLINK;
   lpc_socks[i].fd = INVALID_SOCKET_FD;
   lpc_socks[i].state = CLOSED;
   if (lpc_socks[i].r_buf != NULL)
     FREE (lpc_socks[i].r_buf);
-  if (lpc_socks[i].w_buf != NULL)
-    FREE (lpc_socks[i].w_buf);
+  clear_send_queue (i);
+  if (lpc_socks[i].rb_buf != NULL)
+    {
+      FREE (lpc_socks[i].rb_buf);
+      lpc_socks[i].rb_buf = NULL;
+      lpc_socks[i].rb_size = 0;
+    }
 
   return EESUCCESS;
 }
@@ -1909,8 +2576,14 @@ int get_socket_address (int i, char *addr, int *port) {
       *port = 0;
       return EEFDRANGE;
     }
-  *port = (int) ntohs (lpc_socks[i].r_addr.sin_port);
-  inet_ntop (AF_INET, &lpc_socks[i].r_addr.sin_addr, addr, ADDR_BUF_SIZE);
+  if (lpc_socks[i].flags & S_LOCAL)
+    {
+      *port = 0;
+      socket_addr_to_name (&lpc_socks[i].r_addr, addr, ADDR_BUF_SIZE);
+      return EESUCCESS;
+    }
+  *port = (int) ntohs (lpc_socks[i].r_addr.sin.sin_port);
+  inet_ntop (AF_INET, &lpc_socks[i].r_addr.sin.sin_addr, addr, ADDR_BUF_SIZE);
   return EESUCCESS;
 }
 
@@ -1978,6 +2651,106 @@ static int socket_name_to_sin (const char *name, struct sockaddr_in *sin) {
   return 1;
 }
 
+/*
+ * Parse an address: "unix:<path>" for a local socket, otherwise a numeric
+ * IPv4 address and port.
+ * @return the length of the socket address, or 0 if the name is not valid
+ */
+static socklen_t
+socket_name_to_addr (const char *name, socket_addr_t *addr)
+{
+  if (name == NULL)
+    return 0;
+  memset (addr, 0, sizeof (*addr));
+  if (strncmp (name, LOCAL_ADDR_PREFIX, sizeof (LOCAL_ADDR_PREFIX) - 1) == 0)
+    {
+#ifdef HAVE_SYS_UN_H
+      const char *path = name + sizeof (LOCAL_ADDR_PREFIX) - 1;
+      size_t len = strlen (path);
+
+      if (len == 0 || len >= sizeof (addr->local.sun_path))
+        return 0;
+      addr->local.sun_family = AF_UNIX;
+      memcpy (addr->local.sun_path, path, len + 1);
+      return (socklen_t) (offsetof (struct sockaddr_un, sun_path) + len + 1);
+#else
+      return 0;
+#endif
+    }
+  return socket_name_to_sin (name, &addr->sin) ? (socklen_t) sizeof (addr->sin) : 0;
+}
+
+static socklen_t
+socket_addr_len (const socket_addr_t *addr)
+{
+#ifdef HAVE_SYS_UN_H
+  if (addr->sa.sa_family == AF_UNIX)
+    return (socklen_t) (offsetof (struct sockaddr_un, sun_path) + strlen (addr->local.sun_path) + 1);
+#endif
+  return (socklen_t) sizeof (addr->sin);
+}
+
+/*
+ * Format an address the way socket_name_to_addr() parses it. The port of
+ * an IPv4 address is left out.
+ */
+static void
+socket_addr_to_name (const socket_addr_t *addr, char *buf, size_t size)
+{
+#ifdef HAVE_SYS_UN_H
+  if (addr->sa.sa_family == AF_UNIX)
+    {
+      /* unnamed peers have an empty path */
+      snprintf (buf, size, LOCAL_ADDR_PREFIX "%.*s", (int) sizeof (addr->local.sun_path), addr->local.sun_path);
+      return;
+    }
+#endif
+  inet_ntop (AF_INET, &addr->sin.sin_addr, buf, (socklen_t) size);
+}
+
+/*
+ * Make sure socket i can use the address family of name. An unbound socket
+ * is turned into a local socket of the same type for a "unix:" address;
+ * otherwise the family cannot change.
+ */
+static int
+use_address_family (int i, const char *name)
+{
+  int local = strncmp (name, LOCAL_ADDR_PREFIX, sizeof (LOCAL_ADDR_PREFIX) - 1) == 0;
+#ifdef HAVE_SYS_UN_H
+  socket_fd_t fd;
+#endif
+
+  if (!local == !(lpc_socks[i].flags & S_LOCAL))
+    return EESUCCESS;
+  if (!local || lpc_socks[i].state != UNBOUND)
+    return EEBADADDR;
+
+#ifdef HAVE_SYS_UN_H
+  fd = socket (AF_UNIX, lpc_socks[i].mode == DATAGRAM ? SOCK_DGRAM : SOCK_STREAM, 0);
+  if (fd == INVALID_SOCKET_FD)
+    {
+      debug_error ("socket() failed: %d", SOCKET_ERRNO);
+      return EESOCKET;
+    }
+  if (set_socket_nonblocking (fd, 1) == SOCKET_ERROR)
+    {
+      debug_error ("set_socket_nonblocking() failed: %d", SOCKET_ERRNO);
+      SOCKET_CLOSE (fd);
+      return EENONBLOCK;
+    }
+  remove_socket_runtime (i);
+  SOCKET_CLOSE (lpc_socks[i].fd);
+  lpc_socks[i].fd = fd;
+  lpc_socks[i].flags |= S_LOCAL;
+  if (!register_socket_runtime (i))
+    return EESOCKET;
+  return EESUCCESS;
+#else
+  return EEBADADDR;
+#endif
+}
+
 static void
 clear_dns_pending_resolution (int socket_id)
 {
@@ -2022,9 +2795,9 @@ apply_dns_result_to_socket (int socket_id, const socket_dns_apply_result_t *resu
       return;
     }
 
-  lpc_socks[socket_id].r_addr.sin_family = AF_INET;
-  lpc_socks[socket_id].r_addr.sin_addr = result->resolved_addr;
-  lpc_socks[socket_id].r_addr.sin_port = htons (result->port);
+  lpc_socks[socket_id].r_addr.sin.sin_family = AF_INET;
+  lpc_socks[socket_id].r_addr.sin.sin_addr = result->resolved_addr;
+  lpc_socks[socket_id].r_addr.sin.sin_port = htons (result->port);
 
   if (!set_socket_operation_phase (socket_id, OP_CONNECTING))
     {
@@ -2033,8 +2806,8 @@ apply_dns_result_to_socket (int socket_id, const socket_dns_apply_result_t *resu
     }
 
   if (connect (lpc_socks[socket_id].fd,
-               (struct sockaddr *) &lpc_socks[socket_id].r_addr,
-               sizeof (struct sockaddr_in)) == SOCKET_ERROR)
+               &lpc_socks[socket_id].r_addr.sa,
+               sizeof (lpc_socks[socket_id].r_addr.sin)) == SOCKET_ERROR)
     {
       switch (SOCKET_ERRNO)
         {
@@ -2295,9 +3068,15 @@ void close_referencing_sockets (object_t * ob) {
 /**
  * Return the string representation of a sockaddr_in
  */
-static char* inet_address (struct sockaddr_in *sin) {
-  static char addr[23], port[7];
+static char* inet_address (socket_addr_t *sa) {
+  static char addr[ADDR_BUF_SIZE], port[7];
+  struct sockaddr_in *sin = &sa->sin;
 
+  if (sa->sa.sa_family != AF_INET && sa->sa.sa_family != 0)
+    {
+      socket_addr_to_name (sa, addr, sizeof (addr));
+      return (addr);
+    }
   if (ntohl (sin->sin_addr.s_addr) == INADDR_ANY)
     strcpy (addr, "*");
   else
@@ -2319,8 +3098,8 @@ static char* inet_address (struct sockaddr_in *sin) {
 void dump_socket_status (outbuffer_t * out) {
   int i;
 
-  outbuf_add (out, "Fd    State      Mode       Local Address          Remote Address\n");
-  outbuf_add (out, "--  ---------  --------  ---------------------  ---------------------\n");
+  outbuf_add (out, "Fd    State      Mode       Local Address          Remote Address       SendQ  SendBytes\n");
+  outbuf_add (out, "--  ---------  --------  ---------------------  ---------------------  -----  ---------\n");
 
   for (i = 0; i < max_lpc_socks; i++)
     {
@@ -2370,7 +3149,8 @@ void dump_socket_status (outbuffer_t * out) {
       outbuf_add (out, "  ");
 
       outbuf_addv (out, "%-21s  ", inet_address (&lpc_socks[i].l_addr));
-      outbuf_addv (out, "%-21s\n", inet_address (&lpc_socks[i].r_addr));
+      outbuf_addv (out, "%-21s  ", inet_address (&lpc_socks[i].r_addr));
+      outbuf_addv (out, "%5d  %9lu\n", lpc_socks[i].w_count, (unsigned long) lpc_socks[i].w_queued);
     }
 
   outbuf_add (out, "\nSocket Runtime Diagnostics\n");
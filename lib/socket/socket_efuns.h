@@ -13,6 +13,10 @@
 #include "port/socket_comm.h"
 #include "src/addr_resolver.h"
 
+#ifdef HAVE_SYS_UN_H
+#include <sys/un.h>
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -36,7 +40,36 @@ enum socket_operation_phase {
 };
 
 #define	BUF_SIZE	2048	/* max reliable packet size	   */
-#define ADDR_BUF_SIZE	64	/* max length of address string    */
+#define ADDR_BUF_SIZE	128	/* max length of address string    */
+#define SOCKET_MAX_IOV	16	/* max queued messages per send    */
+#define SOCKET_MAX_DGRAM_BATCH	64	/* max datagrams per batch	   */
+
+#define LOCAL_ADDR_PREFIX	"unix:"	/* address prefix of local sockets */
+
+/*
+ * The address of an LPC socket: IPv4, or a path for a local (AF_UNIX)
+ * socket.
+ */
+typedef union {
+    struct sockaddr sa;
+    struct sockaddr_in sin;
+#ifdef HAVE_SYS_UN_H
+    struct sockaddr_un local;
+#endif
+} socket_addr_t;
+
+/*
+ * A message waiting in the send queue of a stream socket. Strings are kept
+ * by reference; other messages are copied into buf.
+ */
+typedef struct socket_wbuf_s {
+    struct socket_wbuf_s *next;
+    svalue_t ref;		/* referenced T_STRING, or T_NUMBER */
+    char *buf;			/* owned copy, or NULL */
+    const char *data;		/* the message bytes */
+    size_t len;
+    size_t off;			/* bytes already sent */
+} socket_wbuf_t;
 
 typedef struct {
     socket_fd_t fd;
@@ -46,8 +79,8 @@ typedef struct {
     short flags;
     enum socket_mode mode;
     enum socket_state state;
-    struct sockaddr_in l_addr;
-    struct sockaddr_in r_addr;
+    socket_addr_t l_addr;
+    socket_addr_t r_addr;
     char name[ADDR_BUF_SIZE];
     object_t *owner_ob;
     object_t *release_ob;
@@ -57,9 +90,15 @@ typedef struct {
     char *r_buf;
     int r_off;
     long r_len;
-    char *w_buf;
-    int w_off;
-    int w_len;
+    socket_wbuf_t *w_head;	/* send queue, oldest message first */
+    socket_wbuf_t *w_tail;
+    size_t w_queued;		/* unsent bytes in the send queue */
+    int w_count;		/* messages in the send queue */
+    char *rb_buf;		/* STREAM: read buffer, grown on demand */
+    size_t rb_size;
+    long r_budget;		/* bytes read per event, -1: SocketReadBudget */
+    long w_limit;		/* send queue limit, -1: SocketSendQueueLimit */
+    int r_batch;		/* DATAGRAM: datagrams per read callback, 0: one */
 } lpc_socket_t;
 
 typedef void (*socket_release_test_hook_t)(int, object_t *);
@@ -77,6 +116,8 @@ extern int max_lpc_socks;
 #define S_WRITE_FP      0x40
 #define S_CLOSE_FP      0x80
 #define S_EXTERNAL	0x100
+#define S_LOCAL		0x200	/* AF_UNIX socket */
+#define S_UNLINK	0x400	/* remove the bound path on close */
 
 int check_valid_socket(char *, socket_fd_t, object_t *, char *, int);
 void socket_read_select_handler(int);
@@ -87,11 +128,14 @@ void dump_socket_status(outbuffer_t *);
 void close_referencing_sockets(object_t *);
 int get_socket_address(int, char *, int *);
 int socket_bind(int, int);
+int socket_bind_address(int, const char *);
 int socket_create(enum socket_mode, svalue_t *, svalue_t *);
 int socket_listen(int, svalue_t *);
 int socket_accept(int, svalue_t *, svalue_t *);
 int socket_connect(int, const char *, svalue_t *, svalue_t *);
 int socket_write(int, svalue_t *, const char *);
+int socket_write_batch(int, array_t *);
+int socket_set_option(int, int, int64_t);
 int socket_close(int, int);
 int socket_release(int, object_t *, svalue_t *);
 int socket_acquire(int, svalue_t *, svalue_t *, svalue_t *);
@@ -103,6 +147,7 @@ char *socket_error(int);
 void handle_dns_completions(void);
 int handle_socket_dns_resolver_result(const resolver_result_t *result);
 void deinit_dns_system(void);
+void clear_socket_address_cache(void);
 int get_socket_operation_info(int, int *, int *, int *, int *);
 int get_socket_runtime_info(int, int *, int *, socket_fd_t *);
 int get_socket_runtime_registration_count(void);
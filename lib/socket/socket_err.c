@@ -43,5 +43,6 @@ char *error_strings[ERROR_STRINGS] = {
   "Socket already released",
   "Socket not released",
   "Data nested too deeply",
-  "Name resolver busy (admission control at capacity)"
+  "Name resolver busy (admission control at capacity)",
+  "Send queue is full"
 };
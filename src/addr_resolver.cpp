@@ -40,6 +40,7 @@ namespace {
 
 /** Maximum queue depth shared by both the task and result queues. */
 static const int AR_QUEUE_SIZE = 256;
+static const int AR_RESULT_BATCH_SIZE = 16;
 static const int AR_GLOBAL_ADMISSION_CAP = 64;
 
 /** Task sent from main thread to the worker. */
@@ -57,6 +58,11 @@ typedef struct {
  */
 static async_queue_t   *s_task_queue   = nullptr;
 static async_queue_t   *s_result_queue = nullptr;
+/* main thread: results dequeued together, handed out one at a time */
+static resolver_result_t s_result_batch_items[AR_RESULT_BATCH_SIZE];
+static size_t s_result_batch_sizes[AR_RESULT_BATCH_SIZE];
+static async_queue_batch_t s_result_batch =
+  ASYNC_QUEUE_BATCH_INIT(s_result_batch_items, s_result_batch_sizes, AR_RESULT_BATCH_SIZE);
 static async_worker_t  *s_workers[RESOLVER_FALLBACK_WORKER_COUNT] = {};
 static async_runtime_t *s_runtime      = nullptr;
 static resolver_lookup_test_hook_t s_lookup_test_hook = nullptr;
@@ -749,8 +755,9 @@ addr_resolver_init(struct async_runtime_s *runtime,
   if (s_task_queue == nullptr)
     return 0;
 
+  /* every resolver worker produces results, only the main thread consumes */
   s_result_queue = async_queue_create(AR_QUEUE_SIZE, sizeof(resolver_result_t),
-                                      static_cast<async_queue_flags_t>(0));
+                                      ASYNC_QUEUE_MPSC);
   if (s_result_queue == nullptr)
     {
       async_queue_destroy(s_task_queue);
@@ -814,6 +821,7 @@ addr_resolver_deinit(void)
       async_queue_destroy(s_result_queue);
       s_result_queue = nullptr;
     }
+  async_queue_batch_reset(&s_result_batch);
 
   if (s_task_queue != nullptr)
     {
@@ -935,9 +943,13 @@ addr_resolver_dequeue_result(resolver_result_t *out)
   if (s_result_queue == nullptr || out == nullptr)
     return 0;
 
+  void *msg = nullptr;
   size_t result_size = 0;
-  return (async_queue_dequeue(s_result_queue, out, sizeof(*out), &result_size) &&
-          result_size == sizeof(*out)) ? 1 : 0;
+  if (!async_queue_batch_next(s_result_queue, &s_result_batch, &msg, &result_size) ||
+      result_size != sizeof(*out))
+    return 0;
+  std::memcpy(out, msg, sizeof(*out));
+  return 1;
 }
 
 void
@@ -31,6 +31,7 @@ extern "C" {
 #define APPLY_NET_DEAD                      "net_dead"
 #define APPLY_INPUT_PROMPT                  "input_prompt"
 #define APPLY_OBJECT_NAME                   "object_name"
+#define APPLY_OUTPUT_PRESSURE               "output_pressure"
 #define APPLY_PARSER_ERROR_MESSAGE	        "parser_error_message"
 #define APPLY_PRELOAD                       "preload"
 #define APPLY_PRIVS_FILE                    "privs_file"
@@ -45,6 +46,7 @@ extern "C" {
 #define APPLY_TERMINAL_TYPE                 "set_terminal_type"
 #define APPLY_VALID_ASM                     "valid_asm"
 #define APPLY_VALID_BIND                    "valid_bind"
+#define APPLY_VALID_CHECKPOINT              "valid_checkpoint"
 #define APPLY_VALID_COMPILE_TO_C	        "valid_compile_to_c"
 #define APPLY_VALID_HIDE                    "valid_hide"
 #define APPLY_VALID_LINK                    "valid_link"
@@ -18,6 +18,7 @@
 #include "simul_efun.h"
 #include "call_out.h"
 #include "async/async_runtime.h"
+#include "port/sync.h"
 #include "async/console_mode.h"
 
 #include <math.h>
@@ -29,7 +30,9 @@
 /* The 'current_time' is updated at every heart beat. */
 time_t current_time = 0;
 
-bool heart_beat_flag = false;
+/* raised by the heart beat timer, which may run on a thread of its own when
+ * the platform has no timer descriptors; cleared by call_heart_beat() */
+static platform_atomic_t heart_beat_flag;
 
 object_t *current_heart_beat;
 
@@ -246,6 +249,33 @@ static int num_hb_to_do = 0;
 static int num_hb_calls = 0;	/* starts */
 static float perc_hb_probes = 100.0;	/* decaying avge of how many complete */
 
+/**
+ * @brief Check whether a heart beat is due.
+ */
+bool query_heart_beat_flag (void) {
+  return platform_atomic_load (&heart_beat_flag) != 0;
+}
+
+/**
+ * @brief Mark a heart beat as due. Safe to call from any thread.
+ * @return true if the previous heart beat had not been serviced yet.
+ */
+bool raise_heart_beat_flag (void) {
+  size_t expected = 0;
+
+  while (!platform_atomic_cas (&heart_beat_flag, &expected, 1))
+    if (expected)
+      return true;
+  return false;
+}
+
+/**
+ * @brief Mark the due heart beat as serviced.
+ */
+void clear_heart_beat_flag (void) {
+  platform_atomic_store (&heart_beat_flag, 0);
+}
+
 /**
  * @brief Call all heart_beat() functions in all objects.
  * This function is also responsible for updating the current_time, which makes
@@ -256,7 +286,7 @@ static float perc_hb_probes = 100.0;	/* decaying avge of how many complete */
 void call_heart_beat () {
 
   object_t *ob;
-  heart_beat_flag = false;
+  clear_heart_beat_flag ();
   time (&current_time);
   opt_trace (TT_BACKEND|1, "tick: current_time=%u", current_time);
   current_interactive = 0;
@@ -267,7 +297,7 @@ void call_heart_beat () {
       heart_beat_t *curr_hb;
       num_hb_calls++;
       heart_beat_index = 0;
-      while (!heart_beat_flag)
+      while (!query_heart_beat_flag ())
         {
           ob = (curr_hb = &heart_beats[heart_beat_index])->ob;
           /* is it time to do a heart beat ? */
@@ -10,7 +10,6 @@ extern "C" {
 #endif
 
 extern time_t current_time;
-extern bool heart_beat_flag;
 extern object_t *current_heart_beat;
 extern int64_t eval_cost;
 
@@ -26,6 +25,9 @@ object_t* mudlib_connect(int port, const char* address);
 void mudlib_logon(object_t *);
 
 /* Heart beat related functions */
+bool query_heart_beat_flag(void);
+bool raise_heart_beat_flag(void);
+void clear_heart_beat_flag(void);
 int set_heart_beat(object_t *, int);
 int query_heart_beat(object_t *);
 int heart_beat_status(outbuffer_t *, bool);
@@ -1,3 +1,7 @@
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE	/* accept4() */
+#endif
+
 #ifdef	HAVE_CONFIG_H
 #include <config.h>
 #endif /* HAVE_CONFIG_H */
@@ -9,14 +13,17 @@
 #include "lpc/include/origin.h"
 #include "comm.h"
 #include "command.h"
+#include "driver_stats.h"
 #include "rc/rc.h"
 #include "simul_efun.h"
 #include "interpret.h"
 #include "addr_resolver.h"
 #include "async/async_queue.h"
 #include "async/console_mode.h"
+#include "async/net_worker.h"
 #include "socket/socket_efuns.h"
 #include "ed.h"
+#include "efuns/file_async.h"
 #ifdef HAVE_CURL
 #include "curl/curl_efuns.h"
 #endif
@@ -28,6 +35,14 @@
 #include "port/telnet.h"
 #endif	/* HAVE_ARPA_TELNET_H */
 
+#ifndef TELOPT_COMPRESS2
+#define TELOPT_COMPRESS2 86	/* MCCP v2 */
+#endif
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
 #ifdef HAVE_STDARG_H
 #include <stdarg.h>
 #endif /* HAVE_STDARG_H */
@@ -41,6 +56,8 @@
 #define INT_CHAR(x)	(x)
 #endif
 
+#define CONSOLE_LINE_BATCH	8	/* console lines dequeued at once */
+
 int total_users = 0;
 
 /*
@@ -50,11 +67,14 @@ int total_users = 0;
 static void sigpipe_handler (int);
 #endif
 static void get_user_data (interactive_t *, io_event_t *);
+static void process_user_input (interactive_t *, char *, size_t);
+static void init_net_workers (int);
 static void query_addr_name (object_t *);
 static void process_addr_resolver_completions (void);
 static void add_ip_entry (unsigned long, const char *);
 static void setup_accepted_connection (port_def_t *, socket_fd_t, struct sockaddr_in *);
-static void new_user_handler (port_def_t *);
+static void queue_accepted_connection (port_def_t *, socket_fd_t, struct sockaddr_in *);
+int accept_connections (port_def_t *);
 static void receive_snoop (const char *, object_t * ob);
 
 /* global variables */
@@ -71,8 +91,52 @@ int inet_volume = 0;
 interactive_t **all_users = 0;
 int max_users = 0;
 
+/* Dense list of connected users, so that per-iteration work in the backend
+ * is proportional to the number of users actually connected rather than
+ * the historical peak in max_users.
+ */
+interactive_t **active_users = 0;
+int num_active_users = 0;
+
+/* Users that have a complete command buffered (CMD_IN_BUF). Maintained by
+ * update_cmd_in_buf() whenever an input buffer changes.
+ */
+interactive_t **cmd_ready_users = 0;
+int num_cmd_ready_users = 0;
+
+/* Users that received output since the last flush_dirty_users(). Each of
+ * them is flushed once at the end of the backend iteration.
+ */
+interactive_t **dirty_users = 0;
+int num_dirty_users = 0;
+
+/* Connections accepted but not yet handed to the mudlib, in arrival order.
+ * At most ConnectionsPerCycle of them are connected per backend cycle, so
+ * a burst of reconnecting clients cannot starve the users already logged in.
+ * Connections accepted while MAX_PENDING_CONNECTIONS are waiting are closed.
+ */
+typedef struct {
+  port_def_t *port;
+  socket_fd_t fd;
+  struct sockaddr_in addr;
+} pending_connection_t;
+
+static pending_connection_t *pending_connections = 0;
+static int pending_head = 0;
+static int max_pending_connections = 0;
+int num_pending_connections = 0;
+
 /* static declarations */
 
+static int max_active_users = 0;
+static int max_cmd_ready_users = 0;
+static int max_dirty_users = 0;
+
+/* Network I/O threads, see NetworkIoThreads */
+static net_worker_t **net_workers = 0;
+static int num_net_workers = 0;
+static int next_net_worker = 0;
+
 static io_event_t g_io_events[512];  /* Event buffer for async_runtime_wait() */
 static int g_num_io_events = 0;
 
@@ -85,17 +149,131 @@ static inline int is_listening_port (void *context) {
 }
 
 static inline int is_interactive_user (void *context) {
-  if (!all_users || !context)
+  if (!context)
     return 0;
-  
-  /* Check if pointer is in all_users array range */
-  for (int i = 0; i < max_users; i++) {
-    if (all_users[i] == context)
+
+  for (int i = 0; i < num_active_users; i++) {
+    if (active_users[i] == context)
       return 1;
   }
   return 0;
 }
 
+/**
+ * @brief Append an interactive to a dense user list, growing the list as needed.
+ * @return The index of the new entry.
+ */
+static int user_list_append (interactive_t ***list, int *count, int *capacity, interactive_t *ip) {
+  if (*count >= *capacity)
+    {
+      int new_capacity = *capacity ? *capacity * 2 : 50;
+      if (*list)
+        *list = RESIZE (*list, new_capacity, interactive_t *, TAG_USERS, "user_list_append");
+      else
+        *list = CALLOCATE (new_capacity, interactive_t *, TAG_USERS, "user_list_append");
+      *capacity = new_capacity;
+    }
+  (*list)[*count] = ip;
+  return (*count)++;
+}
+
+/**
+ * @brief Remove entry @p idx from a dense user list by moving the last entry into its place.
+ * @return The interactive that was moved into @p idx, or NULL if none was moved.
+ */
+static interactive_t *user_list_remove (interactive_t **list, int *count, int idx) {
+  interactive_t *moved;
+
+  moved = list[--(*count)];
+  list[idx] = moved;
+  list[*count] = NULL;
+  return (idx < *count) ? moved : NULL;
+}
+
+static void activate_user (interactive_t *ip) {
+  ip->active_index = user_list_append (&active_users, &num_active_users, &max_active_users, ip);
+  ip->cmd_ready_index = -1;
+  ip->dirty_index = -1;
+  ip->cmd_deficit = 0;
+  ip->cmd_ready_since = 0;
+  ip->cmd_count = 0;
+  ip->cmd_wait_total = 0;
+  ip->cmd_wait_max = 0;
+}
+
+static void deactivate_user (interactive_t *ip) {
+  int idx = ip->active_index;
+  interactive_t *moved;
+
+  if (idx < 0 || idx >= num_active_users || active_users[idx] != ip)
+    return;
+  if ((moved = user_list_remove (active_users, &num_active_users, idx)))
+    moved->active_index = idx;
+  ip->active_index = -1;
+}
+
+static inline int is_cmd_ready_listed (const interactive_t *ip) {
+  int idx = ip->cmd_ready_index;
+  return idx >= 0 && idx < num_cmd_ready_users && cmd_ready_users[idx] == ip;
+}
+
+static void unlist_cmd_ready (interactive_t *ip) {
+  interactive_t *moved;
+
+  if (!is_cmd_ready_listed (ip))
+    return;
+  if ((moved = user_list_remove (cmd_ready_users, &num_cmd_ready_users, ip->cmd_ready_index)))
+    moved->cmd_ready_index = ip->cmd_ready_index;
+  ip->cmd_ready_index = -1;
+}
+
+static inline int is_dirty_listed (const interactive_t *ip) {
+  int idx = ip->dirty_index;
+  return idx >= 0 && idx < num_dirty_users && dirty_users[idx] == ip;
+}
+
+static void list_dirty (interactive_t *ip) {
+  if (!is_dirty_listed (ip))
+    ip->dirty_index = user_list_append (&dirty_users, &num_dirty_users, &max_dirty_users, ip);
+}
+
+static void unlist_dirty (interactive_t *ip) {
+  interactive_t *moved;
+
+  if (!is_dirty_listed (ip))
+    return;
+  if ((moved = user_list_remove (dirty_users, &num_dirty_users, ip->dirty_index)))
+    moved->dirty_index = ip->dirty_index;
+  ip->dirty_index = -1;
+}
+
+/**
+ *  @brief Synchronize the CMD_IN_BUF flag and the command-ready list with
+ *  the content of a user's input buffer.
+ *
+ *  Must be called whenever the input buffer or SINGLE_CHAR mode changes, so
+ *  the backend can find users with pending commands without scanning.
+ */
+void update_cmd_in_buf (interactive_t *ip) {
+  if (!ip)
+    return;
+
+  if (!(ip->iflags & CLOSING) && cmd_in_buf (ip))
+    {
+      ip->iflags |= CMD_IN_BUF;
+      if (!is_cmd_ready_listed (ip))
+        {
+          ip->cmd_ready_index = user_list_append (&cmd_ready_users, &num_cmd_ready_users, &max_cmd_ready_users, ip);
+          ip->cmd_ready_since = driver_stats_now ();
+        }
+    }
+  else
+    {
+      ip->iflags &= ~CMD_IN_BUF;
+      unlist_cmd_ready (ip);
+    }
+}
+
 int is_console_user (void *context) {
   return context && all_users && ((object_t*)context)->interactive == all_users[0];
 }
@@ -196,7 +374,7 @@ void init_user_conn () {
         continue;
       
       if (async_runtime_add (g_runtime, external_port[i].fd,
-                            EVENT_READ, &external_port[i]) != 0)
+                            EVENT_READ | EVENT_ACCEPT, &external_port[i]) != 0)
         {
           debug_fatal ("Failed to register listening socket for port %d with async runtime\n",
                        external_port[i].port);
@@ -247,6 +425,9 @@ void init_user_conn () {
   init_curl_subsystem ();
 #endif
 
+  init_net_workers (CONFIG_INT (__NETWORK_IO_THREADS__));
+  init_file_async (CONFIG_INT (__FILE_IO_THREADS__));
+
 #ifndef _WIN32
   /* register signal handler for SIGPIPE. */
   if (signal (SIGPIPE, sigpipe_handler) == SIG_ERR)
@@ -277,13 +458,18 @@ void ipc_remove () {
       if (SOCKET_CLOSE (external_port[i].fd) == SOCKET_ERROR)
         debug_error ("SOCKET_CLOSE() failed: %d", SOCKET_ERRNO);
     }
+  discard_pending_connections ();
 
   addr_resolver_cache_reset ();
   addr_resolver_deinit ();
+  deinit_file_async ();
 
 #ifdef HAVE_CURL
   deinit_curl_subsystem ();
 #endif
+
+  /* blocks still queued on connections are freed with them */
+  output_pool_trim ();
 }
 
 int do_comm_polling (struct timeval *timeout) {
@@ -300,13 +486,221 @@ int do_comm_polling (struct timeval *timeout) {
   return g_num_io_events;
 }
 
+/**
+ * @brief Register or drop EVENT_WRITE interest for a user connection.
+ *
+ * The registered state is remembered in WRITE_ARMED, so the async runtime is
+ * only asked to modify the connection when the interest actually changes.
+ * The console user is flushed synchronously and never registered.
+ */
+static void set_write_interest (interactive_t *ip, bool armed) {
+  if (ip == all_users[0])
+    return;
+  if (armed == !!(ip->iflags & WRITE_ARMED))
+    return;
+  async_runtime_modify (g_runtime, ip->fd, armed ? (EVENT_READ | EVENT_WRITE) : EVENT_READ, ip);
+  if (armed)
+    ip->iflags |= WRITE_ARMED;
+  else
+    ip->iflags &= ~WRITE_ARMED;
+}
+
+#ifdef HAVE_ZLIB
+/* MCCP v2 state of a connection. Output is compressed when it is flushed:
+ * everything pending in ip->output is deflated into the wire chain, which is
+ * what actually goes to the socket.
+ */
+struct mccp_s {
+  z_stream zs;
+  output_chain_t wire;      /* compressed output waiting to be sent */
+  uint64_t bytes_in;        /* uncompressed bytes */
+  uint64_t bytes_out;       /* compressed bytes */
+  int64_t usec;             /* time spent in deflate() */
+};
+#endif
+
+/**
+ * @brief Number of output bytes a connection has not sent yet.
+ */
+static size_t pending_output (const interactive_t *ip) {
+#ifdef HAVE_ZLIB
+  if (ip->mccp)
+    return ip->output.length + ip->mccp->wire.length + ip->net_inflight;
+#endif
+  return ip->output.length + ip->net_inflight;
+}
+
+#ifdef HAVE_ZLIB
+/**
+ * @brief Run deflate() on the current input of a compression stream,
+ * appending everything it produces to the wire chain.
+ */
+static void mccp_deflate (struct mccp_s *mccp, int flush) {
+  char buf[OUTPUT_BLOCK_SIZE];
+
+  do
+    {
+      mccp->zs.next_out = (Bytef *) buf;
+      mccp->zs.avail_out = sizeof (buf);
+      deflate (&mccp->zs, flush);
+      output_chain_append (&mccp->wire, buf, sizeof (buf) - mccp->zs.avail_out);
+    }
+  while (mccp->zs.avail_out == 0);
+}
+
+/**
+ * @brief Deflate all pending output of a compressed connection into its
+ * wire chain, ending with a sync flush so the client can decode it at once.
+ */
+static void mccp_compress (interactive_t *ip) {
+  struct mccp_s *mccp = ip->mccp;
+  socket_iovec_t iov[OUTPUT_MAX_IOV];
+  size_t wire_before = mccp->wire.length;
+  int64_t start;
+  int i, n;
+
+  if (ip->output.length == 0)
+    return;
+
+  start = driver_stats_now ();
+  while (ip->output.length > 0)
+    {
+      size_t consumed = 0;
+
+      n = output_chain_iov (&ip->output, iov, OUTPUT_MAX_IOV);
+      for (i = 0; i < n; i++)
+        {
+          mccp->zs.next_in = (Bytef *) SOCKET_IOV_BASE (iov[i]);
+          mccp->zs.avail_in = (uInt) SOCKET_IOV_LEN (iov[i]);
+          mccp_deflate (mccp, Z_NO_FLUSH);
+          consumed += SOCKET_IOV_LEN (iov[i]);
+        }
+      mccp->bytes_in += consumed;
+      output_chain_consume (&ip->output, consumed);
+    }
+  mccp_deflate (mccp, Z_SYNC_FLUSH);
+  mccp->bytes_out += mccp->wire.length - wire_before;
+  mccp->usec += driver_stats_now () - start;
+}
+
+static void mccp_free (interactive_t *ip) {
+  if (!ip->mccp)
+    return;
+  deflateEnd (&ip->mccp->zs);
+  output_chain_clear (&ip->mccp->wire);
+  FREE (ip->mccp);
+  ip->mccp = NULL;
+}
+
+/**
+ * @brief End the MCCP v2 stream of a connection.
+ *
+ * Pending output is compressed and the stream finished with Z_FINISH, so the
+ * client sees its end; the compressed bytes are put back as pending output,
+ * and everything added after them is sent uncompressed.
+ */
+static void mccp_finish (interactive_t *ip) {
+  struct mccp_s *mccp = ip->mccp;
+
+  if (!mccp)
+    return;
+  mccp_compress (ip);
+  mccp->zs.next_in = NULL;
+  mccp->zs.avail_in = 0;
+  mccp_deflate (mccp, Z_FINISH);
+  output_chain_clear (&ip->output);
+  ip->output = mccp->wire;
+  output_chain_init (&mccp->wire);
+  mccp_free (ip);
+  opt_trace (TT_COMM|2, "MCCP v2 compression ended.\n");
+}
+#endif /* HAVE_ZLIB */
+
+static int num_output_pressure_changed = 0;
+
+/**
+ * @brief Update the OUTPUT_BLOCKED state of a connection against the
+ * OutputHighWater and OutputLowWater marks.
+ *
+ * A change is only recorded here; output_pressure() is called later from
+ * deliver_output_pressure(), outside of the output path.
+ */
+static void update_output_pressure (interactive_t *ip) {
+  size_t pending = pending_output (ip);
+
+  if (ip->iflags & OUTPUT_BLOCKED)
+    {
+      if (pending > (size_t) CONFIG_INT (__OUTPUT_LOW_WATER__))
+        return;
+      ip->iflags &= ~OUTPUT_BLOCKED;
+    }
+  else
+    {
+      if (CONFIG_INT (__OUTPUT_HIGH_WATER__) <= 0 ||
+          pending < (size_t) CONFIG_INT (__OUTPUT_HIGH_WATER__))
+        return;
+      ip->iflags |= OUTPUT_BLOCKED;
+    }
+  if (!(ip->iflags & OUTPUT_PRESSURE_CHANGED))
+    {
+      ip->iflags |= OUTPUT_PRESSURE_CHANGED;
+      num_output_pressure_changed++;
+    }
+}
+
+/**
+ * @brief Append a message to the output chain, translating each newline
+ * into CR LF.
+ *
+ * Output is never dropped because the connection is slow. Only a message
+ * that would grow the pending output beyond OutputBufferLimit is discarded,
+ * and that is logged and counted.
+ * @param seg If not NULL, the already translated message to link instead of
+ *   copying @p data.
+ * @return false if the message was discarded, otherwise true.
+ */
+static bool append_message (interactive_t *ip, const char *data, size_t len, output_segment_t *seg) {
+  size_t limit = (size_t) CONFIG_INT (__OUTPUT_BUFFER_LIMIT__);
+
+  if (seg)
+    len = seg->length;
+  if (limit > 0 && pending_output (ip) + len > limit)
+    {
+      if (!ip->output_dropped)
+        debug_message ("Output buffer limit reached for /%s, discarding output.\n", ip->ob->name);
+      ip->output_dropped += len;
+      output_pool_count_dropped (len);
+      return false;
+    }
+  if (seg)
+    output_chain_append_segment (&ip->output, seg);
+  else
+    output_chain_append_crlf (&ip->output, data, len);
+  update_output_pressure (ip);
+  return true;
+}
+
 /**
  * @brief Send a message to an interactive object.
  */
 void add_message (object_t * who, const char *data) {
+  add_shared_message (who, data, NULL);
+}
+
+/**
+ * @brief Send a message that is broadcast to many interactive objects.
+ *
+ * The message is translated into an output segment on first use and every
+ * further recipient links the same segment into its output chain, so the
+ * text is scanned and copied only once per broadcast.
+ * @param who The recipient.
+ * @param data The message text.
+ * @param seg Holds the segment of the broadcast. Initialize it to NULL
+ *   before the first recipient; NULL itself sends a private copy.
+ */
+void add_shared_message (object_t * who, const char *data, output_segment_t ** seg) {
 
   interactive_t *ip;
-  const char *cp;
 
   /* check destination of message */
   if (!who || (who->flags & O_DESTRUCTED) || !who->interactive ||
@@ -319,43 +713,13 @@ void add_message (object_t * who, const char *data) {
 
   ip = who->interactive;
 
-  /* write message into ip->message_buf. */
-  for (cp = data; *cp; cp++)
+  if (!seg)
+    append_message (ip, data, strlen (data), NULL);
+  else
     {
-      /* if message buffer is full, flush it */
-      if (ip->message_length == MESSAGE_BUF_SIZE)
-        {
-          if (!flush_message (ip))
-            {
-              debug_message ("Broken connection during add_message.\n");
-              return;
-            }
-          if (ip->message_length == MESSAGE_BUF_SIZE)
-            break;
-        }
-
-      /* write CR LF for every newline, to make some crappy terminal happy */
-      if (*cp == '\n')
-        {
-          if (ip->message_length == (MESSAGE_BUF_SIZE - 1))
-            {
-              if (!flush_message (ip))
-                {
-                  debug_message ("Broken connection during add_message.\n");
-                  return;
-                }
-              if (ip->message_length == (MESSAGE_BUF_SIZE - 1))
-                break;
-            }
-          ip->message_buf[ip->message_producer] = '\r';
-          ip->message_producer = (ip->message_producer + 1) % MESSAGE_BUF_SIZE;
-          ip->message_length++;
-        }
-
-      /* write the actual character */
-      ip->message_buf[ip->message_producer] = *cp;
-      ip->message_producer = (ip->message_producer + 1) % MESSAGE_BUF_SIZE;
-      ip->message_length++;
+      if (!*seg)
+        *seg = output_segment_new_crlf (data, strlen (data));
+      append_message (ip, data, 0, *seg);
     }
 
   /* snoop handling: use receive_snoop which now uses APPLY_SAFE_CALL */
@@ -369,15 +733,15 @@ void add_message (object_t * who, const char *data) {
     {
       flush_message (ip);
     }
-  else
+  else if (ip->output.length)
     {
-      /* Request write notification from async runtime */
-      async_runtime_modify (g_runtime, ip->fd, EVENT_READ | EVENT_WRITE, ip);
+      /* sent by flush_dirty_users() at the end of this backend iteration */
+      list_dirty (ip);
     }
 #endif
 
   add_message_calls++;
-}				/* add_message() */
+}				/* add_shared_message() */
 
 
 /**
@@ -386,7 +750,7 @@ void add_message (object_t * who, const char *data) {
 void add_vmessage (object_t * who, char *format, ...) {
   int ret = -1;
   interactive_t *ip;
-  char *cp, *str = NULL;
+  char *str = NULL;
   va_list args;
 
   va_start (args, format);
@@ -411,43 +775,10 @@ void add_vmessage (object_t * who, char *format, ...) {
       return;
     }
 
-  /* write message into ip->message_buf. */
   ip = who->interactive;
-  for (cp = str; *cp; cp++)
-    {
-      if (ip->message_length == MESSAGE_BUF_SIZE)
-        {
-          if (!flush_message (ip))
-            {
-              debug_message ("Broken connection during add_message.\n");
-              break;
-            }
-          if (ip->message_length == MESSAGE_BUF_SIZE)
-            break;
-        }
-      if (*cp == '\n')
-        {
-          if (ip->message_length == (MESSAGE_BUF_SIZE - 1))
-            {
-              if (!flush_message (ip))
-                {
-                  debug_message ("Broken connection during add_message.\n");
-                  break;
-                }
-              if (ip->message_length == (MESSAGE_BUF_SIZE - 1))
-                break;
-            }
-          /* write CR LF for every newline, to make some crappy terminal happy */
-          ip->message_buf[ip->message_producer] = '\r';
-          ip->message_producer = (ip->message_producer + 1) % MESSAGE_BUF_SIZE;
-          ip->message_length++;
-        }
-      ip->message_buf[ip->message_producer] = *cp;
-      ip->message_producer = (ip->message_producer + 1) % MESSAGE_BUF_SIZE;
-      ip->message_length++;
-    }
+  append_message (ip, str, strlen (str), NULL);
 
-  if ((ip->message_length != 0) && !flush_message (ip))
+  if (ip->output.length && !flush_message (ip))
     debug_message ("Broken connection during add_message.\n");
 
   /* snoop handling. */
@@ -468,41 +799,69 @@ void add_vmessage (object_t * who, char *format, ...) {
  * Flush outgoing message buffer of current interactive object.
  */
 bool flush_message (interactive_t * ip) {
-  int length, num_bytes;
+  socket_iovec_t iov[OUTPUT_MAX_IOV];
+  output_chain_t *out;
+  long num_bytes;
+  int n;
 
   /* if ip is not valid, do nothing. */
   if (!ip || (ip->iflags & (CLOSING | NET_DEAD)))
     return false;
 
-  /*
-   * write ip->message_buf[] to socket.
-   */
-  while (ip->message_length != 0)
+  out = &ip->output;
+#ifdef HAVE_ZLIB
+  if (ip->mccp)
     {
-      if (ip->message_consumer < ip->message_producer)
-        {
-          length = ip->message_producer - ip->message_consumer;
-        }
-      else
+      mccp_compress (ip);
+      out = &ip->mccp->wire;
+    }
+#endif
+
+  if (ip->net_conn)
+    {
+      /* the I/O thread sends it; pending_output() counts it until then */
+      while (out->length != 0)
         {
-          length = MESSAGE_BUF_SIZE - ip->message_consumer;
+          size_t len = 0;
+          int i;
+
+          n = output_chain_iov (out, iov, OUTPUT_MAX_IOV);
+          for (i = 0; i < n; i++)
+            len += SOCKET_IOV_LEN (iov[i]);
+          if (net_worker_sendv (ip->net_conn, iov, n, ip->out_of_band) != 0)
+            {
+              debug_message ("flush_message: out of memory for /%s\n", ip->ob->name);
+              ip->iflags |= NET_DEAD;
+              return false;
+            }
+          output_chain_consume (out, len);
+          ip->net_inflight += len;
+          ip->out_of_band = false;
+          inet_packets++;
+          inet_volume += len;
         }
+      return true;
+    }
+
+  /*
+   * write the pending output chain to socket, as many blocks per system
+   * call as the I/O vector holds.
+   */
+  while (out->length != 0)
+    {
+      n = output_chain_iov (out, iov, OUTPUT_MAX_IOV);
       /* Need to use send to get Out-Of-Band data
-       * num_bytes = write(ip->fd,ip->message_buf + ip->message_consumer,length);
        * [NEOLITH-EXTENSION] if ip is the console user, use write to STDOUT_FILENO
        */
       num_bytes = (ip == all_users[0]) ?
-        FILE_WRITE (STDOUT_FILENO, ip->message_buf + ip->message_consumer, length) :
-        SOCKET_SEND (ip->fd, ip->message_buf + ip->message_consumer, length, ip->out_of_band ? MSG_OOB : 0);
+        FILE_WRITE (STDOUT_FILENO, SOCKET_IOV_BASE (iov[0]), SOCKET_IOV_LEN (iov[0])) :
+        socket_sendv (ip->fd, iov, n, ip->out_of_band ? MSG_OOB : 0);
       if (num_bytes == -1)
         {
           if (SOCKET_ERRNO == EWOULDBLOCK || SOCKET_ERRNO == EINTR)
             {
               /* Socket would block - request write notification from async runtime */
-              if (ip != all_users[0])
-                {
-                  async_runtime_modify (g_runtime, ip->fd, EVENT_READ | EVENT_WRITE, ip);
-                }
+              set_write_interest (ip, true);
               return true;
             }
 
@@ -511,22 +870,92 @@ bool flush_message (interactive_t * ip) {
           ip->iflags |= NET_DEAD;
           return false;
         }
-      ip->message_consumer = (ip->message_consumer + num_bytes) % MESSAGE_BUF_SIZE;
-      ip->message_length -= num_bytes;
+      output_chain_consume (out, (size_t) num_bytes);
       ip->out_of_band = false;
       inet_packets++;
       inet_volume += num_bytes;
+      update_output_pressure (ip);
     }
   
   /* All data sent - remove write notification if it was set */
-  if (ip != all_users[0])
-    {
-      async_runtime_modify (g_runtime, ip->fd, EVENT_READ, ip);
-    }
+  set_write_interest (ip, false);
   
   return true;
 }				/* flush_message() */
 
+/**
+ * @brief Start MCCP v2 compression of a connection's output.
+ *
+ * Output that is already pending, followed by the IAC SB COMPRESS2 IAC SE
+ * marker, is still sent uncompressed; everything after it is compressed.
+ * @param ip The connection.
+ * @param level zlib compression level, 1 (fastest) to 9 (smallest).
+ * @return 1 if compression was started, 0 if it is unavailable or already on.
+ */
+int start_output_compression (interactive_t *ip, int level) {
+#ifdef HAVE_ZLIB
+  static char telnet_sb_compress2[] = { INT_CHAR(IAC), INT_CHAR(SB), TELOPT_COMPRESS2, INT_CHAR(IAC), INT_CHAR(SE), 0 };
+  struct mccp_s *mccp;
+
+  if (!ip || ip->mccp || ip == all_users[0] || (ip->iflags & (CLOSING | NET_DEAD)))
+    return 0;
+
+  mccp = (struct mccp_s *) DXALLOC (sizeof (struct mccp_s), TAG_INTERACTIVE, "start_output_compression");
+  memset (mccp, 0, sizeof (struct mccp_s));
+  if (deflateInit (&mccp->zs, level) != Z_OK)
+    {
+      debug_message ("MCCP: deflateInit() failed for /%s\n", ip->ob->name);
+      FREE (mccp);
+      return 0;
+    }
+
+  /* the marker and all output before it go to the wire as they are */
+  output_chain_append (&ip->output, telnet_sb_compress2, sizeof (telnet_sb_compress2) - 1);
+  mccp->wire = ip->output;
+  output_chain_init (&ip->output);
+  ip->mccp = mccp;
+  opt_trace (TT_COMM|2, "MCCP v2 compression started (level %d).\n", level);
+  flush_message (ip);
+  return 1;
+#else
+  (void) ip;
+  (void) level;
+  return 0;
+#endif
+}
+
+/**
+ * Dump the output state of every connected user.
+ */
+void dump_user_status (outbuffer_t * out) {
+  int i;
+
+  outbuf_add (out, "Fd   Pending  Dropped  MCCP    Raw Bytes  Comp Bytes  Ratio  CPU(ms)  Object\n");
+  outbuf_add (out, "---  -------  -------  ----  ----------  ----------  -----  -------  ------\n");
+
+  for (i = 0; i < num_active_users; i++)
+    {
+      interactive_t *ip = active_users[i];
+
+      outbuf_addv (out, "%3d  %7lu  %7lu  ", (int) ip->fd,
+                   (unsigned long) pending_output (ip), (unsigned long) ip->output_dropped);
+#ifdef HAVE_ZLIB
+      if (ip->mccp)
+        {
+          struct mccp_s *mccp = ip->mccp;
+
+          outbuf_addv (out, " on   %10lu  %10lu  %5.2f  %7.1f  ",
+                       (unsigned long) mccp->bytes_in, (unsigned long) mccp->bytes_out,
+                       mccp->bytes_out ? (double) mccp->bytes_in / mccp->bytes_out : 0.0,
+                       mccp->usec / 1000.0);
+        }
+      else
+#endif
+        outbuf_add (out, " off           -           -      -        -  ");
+      outbuf_addv (out, "/%s\n", ip->ob ? ip->ob->name : "-");
+    }
+}
+
 
 #define TS_DATA         0
 #define TS_IAC          1
@@ -549,6 +978,9 @@ static char telnet_wont_sga[] = { INT_CHAR(IAC), INT_CHAR(WONT), TELOPT_SGA, 0 }
 static char telnet_do_naws[] = { INT_CHAR(IAC), INT_CHAR(DO), TELOPT_NAWS, 0 };
 static char telnet_do_ttype[] = { INT_CHAR(IAC), INT_CHAR(DO), TELOPT_TTYPE, 0 };
 static char telnet_do_linemode[] = { INT_CHAR(IAC), INT_CHAR(DO), TELOPT_LINEMODE, 0 };
+#ifdef HAVE_ZLIB
+static char telnet_will_compress2[] = { INT_CHAR(IAC), INT_CHAR(WILL), TELOPT_COMPRESS2, 0 };
+#endif
 static char telnet_term_query[] = { INT_CHAR(IAC), INT_CHAR(SB), TELOPT_TTYPE, TELQUAL_SEND, INT_CHAR(IAC), INT_CHAR(SE), 0 };
 static char telnet_no_echo[] = { INT_CHAR(IAC), INT_CHAR(WONT), TELOPT_ECHO, 0 };
 static char telnet_yes_echo[] = { INT_CHAR(IAC), INT_CHAR(WILL), TELOPT_ECHO, 0 };
@@ -559,6 +991,21 @@ static char telnet_se[] = { INT_CHAR(IAC), INT_CHAR(SE), 0 };
 static char telnet_ga[] = { INT_CHAR(IAC), INT_CHAR(GA), 0 };
 #endif
 
+/**
+ * @brief Length of the plain data at the start of @p from, up to the first
+ * IAC or CR.
+ */
+static size_t plain_data_len (const UCHAR *from, size_t count) {
+  const UCHAR *end = from + count;
+  const UCHAR *p;
+
+  if ((p = (const UCHAR *) memchr (from, IAC, count)))
+    end = p;
+  if ((p = (const UCHAR *) memchr (from, '\r', end - from)))
+    end = p;
+  return end - from;
+}
+
 /**
  * @brief Copy input characters from socket read buffer to the interactive command buffer.
  * Replace newlines with '\0'. Also add an extra space and back space for every newline.
@@ -568,6 +1015,11 @@ static char telnet_ga[] = { INT_CHAR(IAC), INT_CHAR(GA), 0 };
  * Also handles TELNET negotiations and remove them from the input stream.
  * (Original by Pinkfish@MudOS)
  *
+ * Runs of plain data, which contain no IAC and no CR, are found with memchr()
+ * and copied in bulk; only the bytes around them go through the state machine.
+ * The caller must reserve room for 3/2 of @p count plus 2 bytes, the expansion
+ * of CR LF sequences.
+ *
  * @param from Source buffer.
  * @param to Destination buffer.
  * @param count Number of characters to copy.
@@ -585,6 +1037,18 @@ static size_t copy_chars (UCHAR* from, UCHAR* to, size_t count, interactive_t* i
       switch (ip->state & TS_STATE_MASK)
         {
         case TS_DATA:		/* data transmission */
+          if (!(ip->state & TS_CR_SEEN))
+            {
+              size_t run = plain_data_len (from + i, count - i);
+
+              if (run > 0)
+                {
+                  memcpy (to, from + i, run);
+                  to += run;
+                  i += run - 1;
+                  break;
+                }
+            }
           switch (from[i])
             {
             case IAC:
@@ -809,6 +1273,10 @@ static size_t copy_chars (UCHAR* from, UCHAR* to, size_t count, interactive_t* i
               add_message (ip->ob, telnet_do_tm_response);
               flush_message (ip);
               break;
+            case TELOPT_COMPRESS2:
+              if (CONFIG_INT (__MCCP_COMPRESSION_LEVEL__) > 0)
+                start_output_compression (ip, CONFIG_INT (__MCCP_COMPRESSION_LEVEL__));
+              break;
             }
           ip->state = TS_DATA;
           break;
@@ -868,6 +1336,16 @@ static size_t copy_chars (UCHAR* from, UCHAR* to, size_t count, interactive_t* i
               add_message (ip->ob, telnet_wont_sga); /* acknowledged, won't send go ahead */
               flush_message (ip);
               break;
+#ifdef HAVE_ZLIB
+            case TELOPT_COMPRESS2:
+              /* the client wants uncompressed output from now on */
+              if (ip->mccp)
+                {
+                  mccp_finish (ip);
+                  flush_message (ip);
+                }
+              break;
+#endif
             }
           ip->state = TS_DATA;
           break;
@@ -942,8 +1420,67 @@ static void clear_interactive_input_buffer (interactive_t *ip) {
 
   ip->text_start = 0;
   ip->text_end = 0;
-  ip->text[0] = '\0';
-  ip->iflags &= ~CMD_IN_BUF;
+  ip->text_scan = 0;
+  if (ip->text)
+    ip->text[0] = '\0';
+  update_cmd_in_buf (ip);
+}
+
+/**
+ * @brief Make room for @p len more bytes, including a terminating null, at
+ * the end of the input buffer.
+ *
+ * Input before text_start has been processed and is shifted out first. If
+ * that is not enough, the buffer grows by doubling, up to InputBufferLimit.
+ * @return 1 if there is room, 0 if the unprocessed input would exceed the limit.
+ */
+int reserve_input_space (interactive_t *ip, size_t len) {
+  size_t limit = (size_t) CONFIG_INT (__INPUT_BUFFER_LIMIT__);
+  size_t used, size;
+
+  if (ip->text && (size_t) ip->text_end + len <= ip->text_size)
+    return 1;
+
+  if (ip->text_start > 0)
+    {
+      used = ip->text_end - ip->text_start;
+      memmove (ip->text, ip->text + ip->text_start, used);
+      ip->text_scan = (ip->text_scan > ip->text_start) ? ip->text_scan - ip->text_start : 0;
+      ip->text_start = 0;
+      ip->text_end = used;
+      ip->text[used] = '\0';
+      if (used + len <= ip->text_size)
+        return 1;
+    }
+
+  if (limit < MIN_INPUT_BUFFER_LIMIT)
+    limit = MIN_INPUT_BUFFER_LIMIT;
+  used = ip->text_end;
+  if (used + len > limit)
+    return 0;
+
+  size = ip->text_size ? ip->text_size : MAX_TEXT;
+  while (size < used + len)
+    size *= 2;
+  if (size > limit)
+    size = limit;
+  if (ip->text)
+    ip->text = RESIZE (ip->text, size, char, TAG_INTERACTIVE, "reserve_input_space");
+  else
+    ip->text = (char *) DXALLOC (size, TAG_INTERACTIVE, "reserve_input_space");
+  ip->text_size = size;
+  return 1;
+}
+
+/**
+ * @brief Release the input buffer of an interactive.
+ */
+void free_input_buffer (interactive_t *ip) {
+  if (ip->text)
+    FREE (ip->text);
+  ip->text = NULL;
+  ip->text_size = 0;
+  ip->text_start = ip->text_end = ip->text_scan = 0;
 }
 
 /**
@@ -954,6 +1491,11 @@ void set_input_single_char (interactive_t * ip, bool single) {
     {
       clear_interactive_input_buffer (ip);
     }
+  else
+    {
+      /* buffered partial input is no longer a complete command */
+      update_cmd_in_buf (ip);
+    }
 
   if (ip == all_users[0]) /* console user */
     {
@@ -1015,7 +1557,7 @@ static void add_console_line (interactive_t *ip, const char *line_buffer, size_t
     return;
 
   int len = (int)(line_length > 0 ? line_length - 1 : 0); /* Exclude null terminator */
-  if (len <= 0 || ip->text_end + len >= MAX_TEXT)
+  if (len <= 0 || !reserve_input_space (ip, len + 1))
     return;
 
   /* Convert newlines to null terminators for command parsing (line mode only)
@@ -1047,11 +1589,9 @@ static void add_console_line (interactive_t *ip, const char *line_buffer, size_t
   ip->text[ip->text_end] = '\0';
   
   /* Set flag if new data completes command */
-  if (cmd_in_buf(ip))
-    {
-      opt_trace(TT_COMM|1, "Console command available in buffer\n");
-      ip->iflags |= CMD_IN_BUF;
-    }
+  update_cmd_in_buf (ip);
+  if (ip->iflags & CMD_IN_BUF)
+    opt_trace(TT_COMM|1, "Console command available in buffer\n");
 }
 
 /**
@@ -1086,12 +1626,194 @@ static void drain_console_queue_lines (void) {
         return;
     }
 
-  char line_buffer[CONSOLE_MAX_LINE];
-  size_t line_length;
+  /* add_console_line() only buffers, so a whole batch is handled at once */
+  static char lines[CONSOLE_LINE_BATCH][CONSOLE_MAX_LINE];
+  size_t sizes[CONSOLE_LINE_BATCH];
+  size_t i, n;
+
+  while ((n = async_queue_dequeue_batch (g_console_queue, lines, CONSOLE_MAX_LINE, CONSOLE_LINE_BATCH, sizes)) > 0)
+    {
+      for (i = 0; i < n; i++)
+        add_console_line (console_ip, lines[i], sizes[i]);
+    }
+}
+
+/**
+ * @brief Start the network I/O threads.
+ *
+ * New connections are assigned to them in turn. If a thread cannot be
+ * started, the connections go to the threads that did start, or stay on the
+ * backend thread if none did.
+ */
+static void init_net_workers (int count) {
+  int i;
+
+  if (count <= 0)
+    return;
+  net_workers = CALLOCATE (count, net_worker_t *, TAG_USERS, "init_net_workers");
+  for (i = 0; i < count; i++)
+    {
+      net_worker_t *worker = net_worker_create (g_runtime, NET_WORKER_COMPLETION_KEY);
+
+      if (!worker)
+        {
+          debug_message ("Warning: failed to start network I/O thread #%d\n", i);
+          continue;
+        }
+      net_workers[num_net_workers++] = worker;
+    }
+  opt_trace (TT_BACKEND|1, "started %d network I/O threads\n", num_net_workers);
+}
+
+/**
+ * @brief Stop the network I/O threads, after they have sent the output and
+ * closed the sockets handed to them.
+ */
+void stop_net_workers (void) {
+  int i;
+
+  for (i = 0; i < num_net_workers; i++)
+    net_worker_destroy (net_workers[i]);
+  num_net_workers = 0;
+  if (net_workers)
+    FREE (net_workers);
+  net_workers = NULL;
+}
+
+/**
+ * @brief Close the socket of a user connection, through its network I/O
+ * thread if it has one.
+ */
+void close_user_socket (interactive_t *ip) {
+  if (ip->net_conn)
+    {
+      net_worker_close (ip->net_conn);
+      ip->net_conn = NULL;
+      ip->net_inflight = 0;
+      return;
+    }
+  if (SOCKET_CLOSE (ip->fd) == SOCKET_ERROR)
+    {
+      debug_message ("remove_interactive: close failed on fd %d\n", ip->fd);
+      debug_perror ("remove_interactive: close", 0);
+    }
+}
+
+/**
+ * @brief Handle the events of the network I/O threads: received input,
+ * output written to the socket, and connections closed by the peer.
+ *
+ * Like the console queue, the event queues are drained on every backend
+ * iteration, whether or not a completion was seen. Input arrives as raw
+ * bytes; the telnet state machine and line assembly in process_user_input()
+ * stay on this thread, since they reply through add_message(), call LPC
+ * applies and depend on modes that LPC code changes.
+ */
+static void drain_net_worker_events (void) {
+  net_event_t evt;
+  int w;
+
+  for (w = 0; w < num_net_workers; w++)
+    while (net_worker_next_event (net_workers[w], &evt))
+      {
+        intptr_t slot = (intptr_t) evt.context;
+        interactive_t *ip = (slot > 0 && slot < max_users) ? all_users[slot] : NULL;
+
+        /* the connection may be gone, and the slot taken by another one */
+        if (!ip || !ip->net_conn || net_conn_serial (ip->net_conn) != evt.serial)
+          continue;
+        if (!ip->ob || (ip->ob->flags & O_DESTRUCTED) || ip->ob->interactive != ip)
+          continue;
+
+        switch (evt.type)
+          {
+          case NET_EVENT_INPUT:
+            process_user_input (ip, evt.data, evt.length);
+            break;
+
+          case NET_EVENT_SENT:
+            ip->net_inflight -= (evt.length < ip->net_inflight) ? evt.length : ip->net_inflight;
+            update_output_pressure (ip);
+            break;
+
+          case NET_EVENT_CLOSED:
+            switch (evt.error)
+              {
+              case 0:
+              case EPIPE:
+              case ECONNRESET:
+              case ETIMEDOUT:
+                break;
+              default:
+                debug_message ("network I/O thread: (fd %d): %s\n", ip->fd, strerror (evt.error));
+                break;
+              }
+            opt_trace (TT_COMM|1, "Connection closed on fd %d\n", ip->fd);
+            ip->iflags |= NET_DEAD;
+            remove_interactive (ip->ob, false);
+            break;
+          }
+      }
+}
+
+/**
+ * @brief Send the pending output of every user that received output during
+ * this backend iteration.
+ *
+ * Each dirty connection is flushed once, so all messages generated in one
+ * iteration leave in a single send. EVENT_WRITE is only armed by
+ * flush_message() when the send comes up short; connections already waiting
+ * for it are left to the write event.
+ */
+void flush_dirty_users (void) {
+  int i;
+
+  for (i = 0; i < num_dirty_users; i++)
+    {
+      interactive_t *ip = dirty_users[i];
+
+      ip->dirty_index = -1;
+      if (ip->iflags & WRITE_ARMED)
+        continue;
+      flush_message (ip);
+    }
+  num_dirty_users = 0;
+}
+
+/**
+ * @brief Call output_pressure() in users whose OUTPUT_BLOCKED state changed.
+ *
+ * Called once per backend cycle after process_io(). The apply receives 1
+ * when pending output has reached OutputHighWater and 0 when it has drained
+ * to OutputLowWater, together with the number of bytes still pending. If the
+ * state flipped back before the user could be told, nothing is called.
+ */
+void deliver_output_pressure (void) {
+  int i;
 
-  while (async_queue_dequeue (g_console_queue, line_buffer, sizeof(line_buffer), &line_length))
+  for (i = 0; i < max_users && num_output_pressure_changed > 0; i++)
     {
-      add_console_line (console_ip, line_buffer, line_length);
+      interactive_t *ip = all_users[i];
+      int blocked;
+
+      if (!ip || !(ip->iflags & OUTPUT_PRESSURE_CHANGED))
+        continue;
+      ip->iflags &= ~OUTPUT_PRESSURE_CHANGED;
+      num_output_pressure_changed--;
+
+      blocked = !!(ip->iflags & OUTPUT_BLOCKED);
+      if (blocked == !!(ip->iflags & OUTPUT_PRESSURE_REPORTED))
+        continue;
+      if (blocked)
+        ip->iflags |= OUTPUT_PRESSURE_REPORTED;
+      else
+        ip->iflags &= ~OUTPUT_PRESSURE_REPORTED;
+      if (ip->iflags & (CLOSING | NET_DEAD))
+        continue;
+
+      push_number (blocked);
+      push_number ((int64_t) pending_output (ip));
+      APPLY_SAFE_CALL (APPLY_OUTPUT_PRESSURE, ip->ob, 2, ORIGIN_DRIVER);
     }
 }
 
@@ -1119,7 +1841,11 @@ void process_io () {
                  i, evt->context, evt->event_type, (int)evt->fd, (unsigned long)evt->completion_key);
       
       /* Identify event source by context pointer */
-      if (is_listening_port (evt->context))
+      if (is_heart_beat_timer (evt->context))
+        {
+          handle_heart_beat_timer ();
+        }
+      else if (is_listening_port (evt->context))
         {
           /* Listening socket event */
           port_def_t *port = (port_def_t*)evt->context;
@@ -1130,6 +1856,12 @@ void process_io () {
               /* On Windows, accept worker has already called accept() and posted
                * the accepted socket FD. The FD is in evt->fd. */
               if (evt->fd != INVALID_SOCKET)
+#else
+              /* With io_uring, the multishot accept has already accepted the
+               * connection (EVENT_ACCEPTED). Otherwise the listening socket is
+               * ready and we call accept() ourselves. */
+              if (evt->event_type & EVENT_ACCEPTED)
+#endif
                 {
                   opt_trace (TT_COMM|1, "incoming connection on port %d (accepted fd=%d)\n", port->port, (int)evt->fd);
                   
@@ -1138,7 +1870,7 @@ void process_io () {
                   socklen_t addr_len = sizeof(addr);
                   if (getpeername(evt->fd, (struct sockaddr*)&addr, &addr_len) == 0)
                     {
-                      setup_accepted_connection(port, evt->fd, &addr);
+                      queue_accepted_connection (port, evt->fd, &addr);
                     }
                   else
                     {
@@ -1148,17 +1880,9 @@ void process_io () {
                 }
               else
                 {
-                  /* Fallback: call accept() synchronously (shouldn't happen with accept worker) */
                   opt_trace (TT_COMM|1, "incoming connection on port %d\n", port->port);
-                  new_user_handler (port);
+                  accept_connections (port);
                 }
-#else
-              /* On POSIX, listening socket is ready - call accept()
-               * TODO: do asynchronous accept() in worker thread to avoid blocking here?
-               */
-              opt_trace (TT_COMM|1, "incoming connection on port %d\n", port->port);
-              new_user_handler (port);
-#endif
             }
           
           if (evt->event_type & EVENT_ERROR)
@@ -1166,6 +1890,10 @@ void process_io () {
               debug_message ("Error on listening port %d\n", port->port);
             }
         }
+      else if (evt->completion_key == NET_WORKER_COMPLETION_KEY)
+        {
+          /* drained below */
+        }
       else if (evt->completion_key == RESOLVER_COMPLETION_KEY)
         {
           process_addr_resolver_completions ();
@@ -1176,6 +1904,10 @@ void process_io () {
           drain_curl_completions ();
         }
 #endif
+      else if (evt->completion_key == FILE_ASYNC_COMPLETION_KEY)
+        {
+          /* drained below */
+        }
       else if (is_interactive_user (evt->context))
         {
           /* Interactive user socket */
@@ -1229,8 +1961,10 @@ void process_io () {
 
   /* Console completions are wake-only signals. We always drain the queue
    * here so queued lines are consumed even when completion edges are
-   * coalesced or missed.
+   * coalesced or missed. The same goes for the network and file I/O threads.
    */
+  drain_net_worker_events ();
+  drain_file_async_completions ();
   drain_console_queue_lines ();
   
   /* Flush console user output if connected (console is always writable) */
@@ -1304,22 +2038,27 @@ void new_interactive (socket_fd_t socket_fd) {
   master_ob->interactive->ob = master_ob;
   master_ob->interactive->input_to = 0;
   master_ob->interactive->iflags = 0;
-  master_ob->interactive->text[0] = '\0';
+  master_ob->interactive->text = NULL;
+  master_ob->interactive->text_size = 0;
   master_ob->interactive->text_end = 0;
   master_ob->interactive->text_start = 0;
+  master_ob->interactive->text_scan = 0;
   master_ob->interactive->snoop_on = 0;
   master_ob->interactive->snoop_by = 0;
   master_ob->interactive->last_time = current_time;
 #ifdef OLD_ED
   master_ob->interactive->ed_buffer = 0;
 #endif
-  master_ob->interactive->message_producer = 0;
-  master_ob->interactive->message_consumer = 0;
-  master_ob->interactive->message_length = 0;
+  output_chain_init (&master_ob->interactive->output);
+  master_ob->interactive->mccp = NULL;
+  master_ob->interactive->output_dropped = 0;
+  master_ob->interactive->net_conn = NULL;
+  master_ob->interactive->net_inflight = 0;
   master_ob->interactive->state = TS_DATA; /* initial telnet state when connection is established */
   master_ob->interactive->out_of_band = false;
   all_users[i] = master_ob->interactive;
   all_users[i]->fd = socket_fd;
+  activate_user (all_users[i]);
   set_prompt ("> ");
 
   /* Register interactive socket with async runtime.
@@ -1329,13 +2068,33 @@ void new_interactive (socket_fd_t socket_fd) {
    * 
    * Note: On Windows IOCP, async_runtime_add() does NOT post an initial read for connected sockets.
    * The initial read is posted later in setup_accepted_connection() after user object setup completes.
+   *
+   * With network I/O threads, the socket is handed to one of them instead. Its
+   * events carry the all_users slot, which stays with the connection.
    */
-  if (i > 0)
+  if (i > 0 && num_net_workers > 0)
     {
-      if (async_runtime_add (g_runtime, socket_fd, EVENT_READ, master_ob->interactive) != 0)
+      net_worker_t *worker = net_workers[next_net_worker++ % num_net_workers];
+
+      master_ob->interactive->net_conn = net_worker_add (worker, socket_fd, (void *)(intptr_t) i);
+      if (!master_ob->interactive->net_conn)
+        {
+          debug_message ("Failed to hand user socket to a network I/O thread\n");
+          SOCKET_CLOSE (socket_fd);
+          deactivate_user (master_ob->interactive);
+          FREE (master_ob->interactive);
+          master_ob->interactive = 0;
+          all_users[i] = 0;
+          return;
+        }
+    }
+  else if (i > 0)
+    {
+      if (async_runtime_add (g_runtime, socket_fd, EVENT_READ | EVENT_RECV_DATA, master_ob->interactive) != 0)
         {
           debug_message ("Failed to register user socket with async runtime\n");
           SOCKET_CLOSE (socket_fd);
+          deactivate_user (master_ob->interactive);
           FREE (master_ob->interactive);
           master_ob->interactive = 0;
           all_users[i] = 0;
@@ -1383,17 +2142,23 @@ interactive_t* create_test_interactive (object_t *ob) {
   ip->input_to = NULL;
   ip->fd = STDIN_FILENO; /* Mark as console-like to avoid network operations */
   ip->iflags = 0;
+  /* tests fill the input buffer directly, so allocate it up front */
+  ip->text = (char *) DXALLOC (MAX_TEXT, TAG_INTERACTIVE, "create_test_interactive");
+  ip->text_size = MAX_TEXT;
   ip->text_end = 0;
   ip->text_start = 0;
+  ip->text_scan = 0;
   ip->text[0] = '\0';
   ip->prompt = NULL;
   ip->snoop_on = NULL;
   ip->snoop_by = NULL;
   ip->last_time = current_time;
   ip->default_err_message.s = NULL;
-  ip->message_producer = 0;
-  ip->message_consumer = 0;
-  ip->message_length = 0;
+  output_chain_init (&ip->output);
+  ip->mccp = NULL;
+  ip->output_dropped = 0;
+  ip->net_conn = NULL;
+  ip->net_inflight = 0;
   ip->state = TS_DATA;
   ip->out_of_band = false;
   ip->sb_pos = 0;
@@ -1414,6 +2179,7 @@ interactive_t* create_test_interactive (object_t *ob) {
   /* Store in all_users[0] for console-like behavior  
    * This makes code that checks all_users[] work without crashing */
   all_users[0] = ip;
+  activate_user (ip);
   
   /* Note: total_users is NOT incremented - this is a test-only interactive */
   
@@ -1453,6 +2219,16 @@ void remove_test_interactive (interactive_t *ip) {
   if (all_users && all_users[0] == ip) {
     all_users[0] = NULL;
   }
+  unlist_cmd_ready (ip);
+  unlist_dirty (ip);
+  deactivate_user (ip);
+  if (ip->iflags & OUTPUT_PRESSURE_CHANGED)
+    num_output_pressure_changed--;
+  output_chain_clear (&ip->output);
+#ifdef HAVE_ZLIB
+  mccp_free (ip);
+#endif
+  free_input_buffer (ip);
   
   /* Free the structure */
   FREE (ip);
@@ -1462,8 +2238,9 @@ void remove_test_interactive (interactive_t *ip) {
 
 /**
  *  @brief Setup a newly accepted connection.
- *  This helper function is called after accept() has been performed (either by new_user_handler
- *  on POSIX, or by the accept worker thread on Windows). It performs initial socket configuration
+ *  This helper function is called by process_pending_connections() for connections accepted
+ *  by accept_connections(), by the accept worker thread on Windows, or by the io_uring
+ *  multishot accept. It performs initial socket configuration
  *  and delegates to backend's mudlib_connect/mudlib_logon pattern.
  *  @param port The port definition for the listening socket
  *  @param new_socket_fd The accepted socket file descriptor
@@ -1519,6 +2296,10 @@ static void setup_accepted_connection (port_def_t *port, socket_fd_t new_socket_
       add_message (user_ob, telnet_do_ttype);
       add_message (user_ob, telnet_do_naws);
       add_message (user_ob, telnet_do_linemode);
+#ifdef HAVE_ZLIB
+      if (CONFIG_INT (__MCCP_COMPRESSION_LEVEL__) > 0)
+        add_message (user_ob, telnet_will_compress2);
+#endif
       flush_message (user_ob->interactive);
     }
 
@@ -1534,7 +2315,11 @@ static void setup_accepted_connection (port_def_t *port, socket_fd_t new_socket_
   /* On Windows IOCP, async_runtime_add() does NOT post an initial read for connected sockets.
    * We must post the first read here after mudlib_connect() transfers the interactive
    * and user object setup completes. This avoids race conditions. */
-  if (user_ob->interactive)
+  if (user_ob->interactive && user_ob->interactive->net_conn)
+    {
+      /* the network I/O thread reads on its own */
+    }
+  else if (user_ob->interactive)
     {
       opt_trace (TT_COMM|3, "Posting initial async read for user socket (fd=%d, ob=%s)",
                  user_ob->interactive->fd, user_ob->name);
@@ -1556,44 +2341,188 @@ static void setup_accepted_connection (port_def_t *port, socket_fd_t new_socket_
 #endif
 }
 
+/**
+ *  @brief Queue an accepted connection until process_pending_connections()
+ *  hands it to the mudlib.
+ *  The connection is closed if MAX_PENDING_CONNECTIONS are already waiting.
+ */
+static void queue_accepted_connection (port_def_t *port, socket_fd_t fd, struct sockaddr_in *addr) {
+  pending_connection_t *pc;
+
+  if (num_pending_connections >= MAX_PENDING_CONNECTIONS)
+    {
+      opt_trace (TT_COMM|1, "too many pending connections, closing fd=%d\n", (int)fd);
+      SOCKET_CLOSE (fd);
+      return;
+    }
+  if (num_pending_connections >= max_pending_connections)
+    {
+      int new_capacity = max_pending_connections ? max_pending_connections * 2 : 64;
+      pending_connection_t *list;
+      int i;
+
+      /* unwrap the ring into the new array */
+      list = CALLOCATE (new_capacity, pending_connection_t, TAG_USERS, "queue_accepted_connection");
+      for (i = 0; i < num_pending_connections; i++)
+        list[i] = pending_connections[(pending_head + i) % max_pending_connections];
+      if (pending_connections)
+        FREE (pending_connections);
+      pending_connections = list;
+      max_pending_connections = new_capacity;
+      pending_head = 0;
+    }
+
+  pc = &pending_connections[(pending_head + num_pending_connections) % max_pending_connections];
+  pc->port = port;
+  pc->fd = fd;
+  pc->addr = *addr;
+  num_pending_connections++;
+}
+
 /**
  *  @brief This is the new user connection handler.
- *  This function is called by the event handler when data is pending on a listening port.
- *  A new connection is established by using \c accept() on the listening socket.
- *  An interactive data structure is allocated and initialized to represent the user just connected.
- *  The master object is set as the command giver object for this new interactive in \c new_interactive().
- *  The \c mudlib_connect() function is called to allow the mudlib to create a user object for the new connection.
- *  If the mudlib returns an object, the connection is successful and \c mudlib_logon() is called to start
- *  the logon process (after initial TELNET negotiation).
- *  If the mudlib returns NULL, the connection is closed and the interactive structure is removed.
+ *  This function is called by the event handler when connections are pending on a listening port.
+ *  Connections are accepted with \c accept() (\c accept4() where available) until the listening
+ *  socket has no more of them, or MAX_ACCEPTS_PER_EVENT connections were accepted; the rest are
+ *  left for the next event.
+ *  The accepted connections are queued, and process_pending_connections() hands them to the mudlib.
  *  @param port The port definition structure representing the listening port.
+ *  @return The number of connections accepted.
  */
-static void new_user_handler (port_def_t *port) {
+int accept_connections (port_def_t *port) {
 
   socket_fd_t new_socket_fd;
   struct sockaddr_in addr;
   socklen_t length;
+  int n;
 
   if (!port || !port->port)
     {
-      debug_message ("new_user_handler: invalid port\n");
-      return;
+      debug_message ("accept_connections: invalid port\n");
+      return 0;
     }
 
-  length = sizeof (addr);
-  new_socket_fd = accept (port->fd, (struct sockaddr *) &addr, &length);
-  if (INVALID_SOCKET_FD == new_socket_fd)
+  for (n = 0; n < MAX_ACCEPTS_PER_EVENT; )
     {
-      if (SOCKET_ERRNO != EWOULDBLOCK)
+      length = sizeof (addr);
+#ifdef HAVE_ACCEPT4
+      new_socket_fd = accept4 (port->fd, (struct sockaddr *) &addr, &length, SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
+      new_socket_fd = accept (port->fd, (struct sockaddr *) &addr, &length);
+#endif
+      if (INVALID_SOCKET_FD == new_socket_fd)
         {
-          debug_error ("accept() failed: %d", SOCKET_ERRNO);
+          int err = SOCKET_ERRNO;
+
+          /* the client gave up before we got to it */
+          if (err == ECONNABORTED || err == EINTR)
+            continue;
+          if (err != EWOULDBLOCK && err != EAGAIN)
+            debug_error ("accept() failed: %d", err);
+          break;
         }
-      return;
+      queue_accepted_connection (port, new_socket_fd, &addr);
+      n++;
+    }
+  if (n > 0)
+    opt_trace (TT_COMM|2, "accepted %d connections on port %d (%d pending)\n",
+               n, port->port, num_pending_connections);
+  return n;
+}
+
+/**
+ *  @brief Hand queued connections to the mudlib.
+ *  Called once per backend cycle after process_io(). At most ConnectionsPerCycle connections
+ *  (all of them if it is 0) go through master::connect() and logon() in arrival order; the rest
+ *  wait for the next cycle.
+ *  @return The number of connections handed to the mudlib.
+ */
+int process_pending_connections (void) {
+  int budget = CONFIG_INT (__CONNECTIONS_PER_CYCLE__);
+  int n = 0;
+
+  while (num_pending_connections > 0 && (budget <= 0 || n < budget))
+    {
+      pending_connection_t pc = pending_connections[pending_head];
+
+      pending_head = (pending_head + 1) % max_pending_connections;
+      num_pending_connections--;
+      /* Note: according to Amylaar, 'accepted' sockets in Linux 0.99p6 don't
+       * properly inherit the nonblocking property from the listening socket. */
+      setup_accepted_connection (pc.port, pc.fd, &pc.addr);
+      n++;
     }
+  return n;
+}
 
-  /* Note: according to Amylaar, 'accepted' sockets in Linux 0.99p6 don't
-   * properly inherit the nonblocking property from the listening socket. */
-  setup_accepted_connection(port, new_socket_fd, &addr);
+/**
+ *  @brief Close the connections that were accepted but never handed to the mudlib.
+ */
+void discard_pending_connections (void) {
+  while (num_pending_connections > 0)
+    {
+      SOCKET_CLOSE (pending_connections[pending_head].fd);
+      pending_head = (pending_head + 1) % max_pending_connections;
+      num_pending_connections--;
+    }
+  if (pending_connections)
+    FREE (pending_connections);
+  pending_connections = 0;
+  max_pending_connections = 0;
+  pending_head = 0;
+}
+
+/**
+ * @brief Append data received from a telnet connection to its input buffer.
+ *
+ * Process TELNET protocol: replace newlines with nulls, handle IAC sequences,
+ * process suboption negotiations (TTYPE, NAWS, LINEMODE), etc.
+ * copy_chars() implements the TELNET state machine.
+ *
+ * A line that does not fit in InputBufferLimit is discarded, up to and
+ * including its line end, to prevent DoS from extremely long lines.
+ */
+void receive_telnet_input (interactive_t *ip, const char *data, size_t len) {
+  size_t reserve = len + len / 2 + 3;
+  ptrdiff_t start;
+
+  if (!reserve_input_space (ip, reserve))
+    {
+      opt_trace (TT_COMM|1, "Input buffer limit reached, discarding input for fd %d\n", ip->fd);
+      ip->text_start = ip->text_end = ip->text_scan = 0;
+      ip->iflags |= INPUT_OVERFLOW;
+      reserve_input_space (ip, reserve);
+    }
+  start = ip->text_end;
+  ip->text_end += copy_chars ((UCHAR *) data, (UCHAR *) ip->text + ip->text_end, len, ip);
+
+  if (ip->iflags & INPUT_OVERFLOW)
+    {
+      char *p = ip->text + start;
+      char *nul = (char *) memchr (p, '\0', ip->text_end - start);
+
+      if (nul)
+        {
+          memmove (p, nul + 1, ip->text_end - (nul + 1 - ip->text));
+          ip->text_end -= nul + 1 - p;
+          ip->iflags &= ~INPUT_OVERFLOW;
+        }
+      else
+        ip->text_end = start;
+    }
+  opt_trace (TT_COMM|3, "Command buffer contains %d characters\n", ip->text_end - ip->text_start);
+  /*
+   * now, ip->text_end is just after the last character read. If the last character
+   * is a newline, the character before ip->text_end will be null.
+   */
+  ip->text[ip->text_end] = '\0';
+
+  /*
+   * set flag if new data completes command.
+   */
+  update_cmd_in_buf (ip);
+  if (ip->iflags & CMD_IN_BUF)
+    opt_trace (TT_COMM|3, "Command available in buffer for fd %d\n", ip->fd);
 }
 
 /**
@@ -1602,16 +2531,16 @@ static void new_user_handler (port_def_t *port) {
  *
  * Supports both I/O notification models:
  * - Readiness notification (POSIX): evt is NULL, perform synchronous read
- * - Completion notification (Windows IOCP): evt contains data already read,
- *   post next async read operation
+ * - Completion notification (Windows IOCP, io_uring): evt contains data
+ *   already read, post next async read operation
  *
  * @param ip The interactive data structure for the user.
  * @param evt Event structure from async_runtime_wait (NULL for POSIX).
  */
 static void get_user_data (interactive_t* ip, io_event_t* evt) {
 
-  char buf[MAX_TEXT];
-  size_t text_space, num_bytes;
+  char buf[MAX_TEXT + 1];	/* a completion buffer holds up to MAX_TEXT bytes */
+  size_t num_bytes;
   int err = 0;
 
   /* Console users should never reach this function - they use completion queue.
@@ -1622,44 +2551,6 @@ static void get_user_data (interactive_t* ip, io_event_t* evt) {
       return;
     }
 
-  switch (ip->connection_type)
-    {
-    case PORT_TELNET:
-      /* NOTE: The /3 size calculation is because copy_chars() expands TELNET
-       * escape sequences. Worst case: every byte could become IAC IAC (2 bytes)
-       * plus the null terminator expansion for newlines adds another byte.
-       */
-      text_space = (MAX_TEXT - (int)ip->text_end - 1) / 3;
-
-      /* shift out processed text from the buffer */
-      if (text_space < MAX_TEXT / 16)
-        {
-          size_t len = ip->text_end - ip->text_start;
-
-          memmove (ip->text, ip->text + ip->text_start, len + 1);
-          ip->text_start = 0;
-          ip->text_end = len;
-          text_space = (MAX_TEXT - ip->text_end - 1) / 3;
-          if (text_space < MAX_TEXT / 16)
-            {
-              /* We've got almost 2k of data without a newline.
-               * Discard buffer to prevent DoS from extremely long lines.
-               */
-              ip->text_start = 0;
-              ip->text_end = 0;
-              text_space = MAX_TEXT / 3;
-            }
-        }
-      break;
-
-    case PORT_ASCII:
-    case PORT_BINARY:
-    default:
-      /* No protocol overhead - use full buffer */
-      text_space = MAX_TEXT - ip->text_end - 1;
-      break;
-    }
-
   /*
    * Read user data using appropriate I/O model:
    *
@@ -1668,19 +2559,20 @@ static void get_user_data (interactive_t* ip, io_event_t* evt) {
    *   - Socket is ready to read, perform synchronous recv()/read()
    *   - Used on Linux, BSD, macOS
    *
-   * Completion notification (Windows IOCP):
+   * Completion notification (Windows IOCP, io_uring):
    *   - evt->buffer contains data already read asynchronously
    *   - evt->bytes_transferred indicates how many bytes were read
    *   - Must post next async read operation to continue receiving data
-   *   - Used on Windows
+   *     (a no-op for the io_uring multishot recv)
+   *   - Used on Windows, and on Linux with NEOLITH_USE_IO_URING
    */
   if (evt && evt->buffer && evt->bytes_transferred > 0)
     {
       /* Completion notification: use data already in event buffer (Windows IOCP) */
       num_bytes = evt->bytes_transferred;
-      if (num_bytes > text_space)
+      if (num_bytes > sizeof (buf) - 1)
         {
-          num_bytes = text_space;  /* Truncate if buffer overflow */
+          num_bytes = sizeof (buf) - 1;  /* Truncate if buffer overflow */
         }
       memcpy(buf, evt->buffer, num_bytes);
 
@@ -1705,7 +2597,7 @@ static void get_user_data (interactive_t* ip, io_event_t* evt) {
        * process_io() under CONSOLE_COMPLETION_KEY. This function handles only
        * network socket I/O (TELNET, ASCII, BINARY protocols).
        */
-      num_bytes = SOCKET_RECV(ip->fd, buf, text_space, 0);
+      num_bytes = SOCKET_RECV(ip->fd, buf, sizeof (buf) - 1, 0);
       err = SOCKET_ERRNO;
     }
 
@@ -1739,81 +2631,85 @@ static void get_user_data (interactive_t* ip, io_event_t* evt) {
 
     default:
       buf[num_bytes] = '\0';
-      switch (ip->connection_type)
-        {
-        case PORT_TELNET:
-          /*
-           * Process TELNET protocol: replace newlines with nulls, handle IAC sequences,
-           * process suboption negotiations (TTYPE, NAWS, LINEMODE), etc.
-           * copy_chars() implements the TELNET state machine.
-           */
-          ip->text_end += copy_chars ((UCHAR *) buf, (UCHAR *) ip->text + ip->text_end, num_bytes, ip);
-          opt_trace (TT_COMM|3, "Command buffer contains %d characters\n", ip->text_end - ip->text_start);
-          /*
-           * now, ip->text_end is just after the last character read. If the last character
-           * is a newline, the character before ip->text_end will be null.
-           */
-          ip->text[ip->text_end] = '\0';
-          /*
-           * handle snooping - snooper does not see type-ahead. seems like
-           * that would be very inefficient, for little functional gain.
-           */
-          if (ip->snoop_by && !(ip->iflags & NOECHO))
-            receive_snoop (buf, ip->snoop_by->ob);
+      process_user_input (ip, buf, num_bytes);
+      break;
+    }
+}
 
-          /*
-           * set flag if new data completes command.
-           */
-          if (cmd_in_buf (ip))
-            {
-              opt_trace (TT_COMM|3, "Command available in buffer for fd %d\n", ip->fd);
-              ip->iflags |= CMD_IN_BUF;
-            }
-          break;
+/**
+ * @brief Hand received data to the input processing of the connection type.
+ *
+ * @param ip The interactive data structure for the user.
+ * @param buf The data, followed by a NUL byte.
+ * @param num_bytes Number of bytes in @p buf.
+ */
+static void process_user_input (interactive_t *ip, char *buf, size_t num_bytes) {
+
+  switch (ip->connection_type)
+    {
+    case PORT_TELNET:
+      receive_telnet_input (ip, buf, num_bytes);
+      /*
+       * handle snooping - snooper does not see type-ahead. seems like
+       * that would be very inefficient, for little functional gain.
+       */
+      if (ip->snoop_by && !(ip->iflags & NOECHO))
+        receive_snoop (buf, ip->snoop_by->ob);
+
+      break;
 
-        case PORT_ASCII:
+    case PORT_ASCII:
+      {
+        char *nl, *str, *p;
+
+        if (!reserve_input_space (ip, num_bytes + 1))
           {
-            char *nl, *str;
-            char *p = ip->text + ip->text_start;
+            opt_trace (TT_COMM|1, "Input buffer limit reached, discarding input for fd %d\n", ip->fd);
+            ip->text_start = ip->text_end = ip->text_scan = 0;
+            reserve_input_space (ip, num_bytes + 1);
+          }
+        p = ip->text + ip->text_end;
+        memcpy (p, buf, num_bytes);
+        ip->text_end += num_bytes;
+        /* a partial line already buffered holds no newline */
+        nl = memchr (p, '\n', num_bytes);
+        p = ip->text + ip->text_start;
+        while (nl)
+          {
+            ip->text_start = (nl + 1) - ip->text;
 
-            memcpy (p, buf, num_bytes);
-            ip->text_end = ip->text_start + num_bytes;
-            while ((nl = memchr (p, '\n', ip->text_end - ip->text_start)))
+            *nl = 0;
+            str = new_string (nl - p, "PORT_ASCII");
+            memcpy (str, p, nl - p + 1);
+            if (!(ip->ob->flags & O_DESTRUCTED))
               {
-                ip->text_start = (nl + 1) - ip->text;
-
-                *nl = 0;
-                str = new_string (nl - p, "PORT_ASCII");
-                memcpy (str, p, nl - p + 1);
-                if (!(ip->ob->flags & O_DESTRUCTED))
-                  {
-                    push_malloced_string (str);
-                    APPLY_CALL (APPLY_PROCESS_INPUT, ip->ob, 1, ORIGIN_DRIVER);
-                  }
-                if (ip->text_start == ip->text_end)
-                  {
-                    ip->text_start = 0;
-                    ip->text_end = 0;
-                    break;
-                  }
-                else
-                  {
-                    p = nl + 1;
-                  }
+                push_malloced_string (str);
+                APPLY_CALL (APPLY_PROCESS_INPUT, ip->ob, 1, ORIGIN_DRIVER);
+              }
+            if (ip->text_start == ip->text_end)
+              {
+                ip->text_start = 0;
+                ip->text_end = 0;
+                break;
+              }
+            else
+              {
+                p = nl + 1;
+                nl = memchr (p, '\n', ip->text_end - ip->text_start);
               }
-            break;
           }
+        break;
+      }
 
-        case PORT_BINARY:
-          {
-            buffer_t *buffer;
-            buffer = allocate_buffer (num_bytes);
-            memcpy (buffer->item, buf, num_bytes);
-            push_refed_buffer (buffer);
-            APPLY_CALL (APPLY_PROCESS_INPUT, ip->ob, 1, ORIGIN_DRIVER);
-            break;
-          }
-        }
+    case PORT_BINARY:
+      {
+        buffer_t *buffer;
+        buffer = allocate_buffer (num_bytes);
+        memcpy (buffer->item, buf, num_bytes);
+        push_refed_buffer (buffer);
+        APPLY_CALL (APPLY_PROCESS_INPUT, ip->ob, 1, ORIGIN_DRIVER);
+        break;
+      }
     }
 }
 
@@ -1841,6 +2737,11 @@ void remove_interactive (object_t * ob, bool dested) {
       return;
     }
 
+#ifdef HAVE_ZLIB
+  /* an orderly close ends the compressed stream, too */
+  if (!(ip->iflags & NET_DEAD))
+    mccp_finish (ip);
+#endif
   flush_message (ip);
   ip->iflags |= CLOSING;
 
@@ -1871,7 +2772,7 @@ void remove_interactive (object_t * ob, bool dested) {
     }
 
   /* Unregister from async runtime (except console on POSIX) */
-  if (ip != all_users[0])
+  if (ip != all_users[0] && !ip->net_conn)
     {
       async_runtime_remove (g_runtime, ip->fd);
     }
@@ -1898,13 +2799,7 @@ void remove_interactive (object_t * ob, bool dested) {
       }
     }
   else
-    {
-      if (SOCKET_CLOSE (ip->fd) == SOCKET_ERROR)
-        {
-          debug_message ("remove_interactive: close failed on fd %d\n", ip->fd);
-          debug_perror ("remove_interactive: close", 0);
-        }
-    }
+    close_user_socket (ip);
   if (ob->flags & O_HIDDEN)
     num_hidden--;
   num_user--;
@@ -1914,6 +2809,16 @@ void remove_interactive (object_t * ob, bool dested) {
       free_sentence (ip->input_to);
       ip->input_to = 0;
     }
+  unlist_cmd_ready (ip);
+  unlist_dirty (ip);
+  deactivate_user (ip);
+  if (ip->iflags & OUTPUT_PRESSURE_CHANGED)
+    num_output_pressure_changed--;
+  output_chain_clear (&ip->output);
+#ifdef HAVE_ZLIB
+  mccp_free (ip);
+#endif
+  free_input_buffer (ip);
   for (idx = 0; idx < max_users; idx++)
     if (all_users[idx] == ip)
       break;
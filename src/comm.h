@@ -2,15 +2,18 @@
 
 #include "port/socket_comm.h"
 #include "lpc/functional.h"
+#include "output_chain.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 #define MAX_TEXT                   2048
+#define MIN_INPUT_BUFFER_LIMIT     (2 * MAX_TEXT)
+#define MAX_ACCEPTS_PER_EVENT      64	/* connections accepted per listening port event */
+#define MAX_PENDING_CONNECTIONS    1024	/* accepted connections waiting for the mudlib */
 #define MAX_SOCKET_PACKET_SIZE     1024
 #define DESIRED_SOCKET_PACKET_SIZE 800
-#define MESSAGE_BUF_SIZE           MESSAGE_BUFFER_SIZE	/* from options.h */
 #define OUT_BUF_SIZE               2048
 #define DFAULT_PROTO               0	/* use the appropriate protocol */
 #define I_NOECHO                   0x1	/* input_to flag */
@@ -38,6 +41,11 @@ enum msgtypes {
 #define	USING_LINEMODE      0x0800
 #define HAS_CMD_TURN        0x1000	/* user has command processing turn this cycle */
 #define HAS_INPUT_PROMPT    0x2000	/* interactive object has input_prompt()   */
+#define WRITE_ARMED         0x4000	/* EVENT_WRITE interest is registered      */
+#define OUTPUT_BLOCKED      0x8000	/* pending output reached the high water mark */
+#define OUTPUT_PRESSURE_CHANGED 0x10000	/* OUTPUT_BLOCKED changed since last output_pressure() */
+#define OUTPUT_PRESSURE_REPORTED 0x20000	/* last output_pressure() reported blocked */
+#define INPUT_OVERFLOW      0x40000	/* discarding a line beyond InputBufferLimit */
 
 typedef struct interactive_s interactive_t;
 
@@ -51,9 +59,11 @@ struct interactive_s {
     int local_port;             /* which of our ports they connected to    */
 #endif
     const char *prompt;         /* prompt string for interactive object    */
-    char text[MAX_TEXT];        /* input buffer for interactive object     */
+    char *text;                 /* input buffer, allocated on first input  */
+    size_t text_size;           /* allocated size of text                  */
     ptrdiff_t text_end;         /* first free char in buffer               */
     ptrdiff_t text_start;       /* where we are up to in user command buffer */
+    ptrdiff_t text_scan;        /* no command ends between text_start and here */
     interactive_t *snoop_on;
     interactive_t *snoop_by;
     time_t last_time;           /* time of last command executed           */
@@ -61,15 +71,24 @@ struct interactive_s {
 #ifdef OLD_ED
     struct ed_buffer_s *ed_buffer;  /* local ed                        */
 #endif
-    int message_producer;       /* message buffer producer index */
-    int message_consumer;       /* message buffer consumer index */
-    int message_length;         /* message buffer length */
-    char message_buf[MESSAGE_BUF_SIZE]; /* message buffer */
+    output_chain_t output;      /* pending output, in pooled blocks        */
+    struct mccp_s *mccp;        /* MCCP v2 compression state, or NULL      */
+    uint64_t output_dropped;    /* output discarded at OutputBufferLimit   */
+    struct net_conn_s *net_conn; /* socket I/O on a network I/O thread, or NULL */
+    size_t net_inflight;        /* output handed to the I/O thread, not sent yet */
     int iflags;                 /* interactive flags */
     bool out_of_band;           /* Send a telnet sync operation            */
     int state;                  /* Current telnet state.  Bingly wop       */
     int sb_pos;                 /* Telnet suboption negotiation stuff      */
     BYTE sb_buf[SB_SIZE];
+    int active_index;           /* position in active_users, or -1         */
+    int cmd_ready_index;        /* position in cmd_ready_users, or -1      */
+    int dirty_index;            /* position in dirty_users, or -1          */
+    int64_t cmd_deficit;        /* command scheduling credit (eval cost)   */
+    int64_t cmd_ready_since;    /* when the next command became ready (usec) */
+    int64_t cmd_count;          /* user commands processed                 */
+    int64_t cmd_wait_total;     /* total queue wait of commands (usec)     */
+    int64_t cmd_wait_max;       /* longest queue wait of a command (usec)  */
 };
 
 
@@ -85,6 +104,13 @@ extern int add_message_calls;
 
 extern interactive_t **all_users;
 extern int max_users;
+extern interactive_t **active_users;
+extern int num_active_users;
+extern interactive_t **cmd_ready_users;
+extern int num_cmd_ready_users;
+extern interactive_t **dirty_users;
+extern int num_dirty_users;
+extern int num_pending_connections;
 
 void new_interactive (socket_fd_t socket_fd);
 
@@ -107,18 +133,31 @@ int is_console_user (void *context);
 
 void add_vmessage (object_t *, char *, ...);
 void add_message (object_t *, const char *);
+void add_shared_message (object_t *, const char *, output_segment_t **);
 
 void init_user_conn (void);
 void ipc_remove (void);
 void process_io (void);
+void flush_dirty_users (void);
+int process_pending_connections (void);
+void discard_pending_connections (void);
+void deliver_output_pressure (void);
+void stop_net_workers (void);
+void close_user_socket (interactive_t *);
 
 void telnet_neg (char *, char *);
 void set_input_echo (object_t*, bool echo);
 void set_input_single_char (interactive_t *, bool single);
+void update_cmd_in_buf (interactive_t *);
 
 int replace_interactive (object_t *, object_t *);
 void remove_interactive (object_t *ob, bool dested);
 bool flush_message (interactive_t *);
+int start_output_compression (interactive_t *, int level);
+void dump_user_status (outbuffer_t *);
+int reserve_input_space (interactive_t *, size_t);
+void free_input_buffer (interactive_t *);
+void receive_telnet_input (interactive_t *, const char *, size_t);
 int query_addr_number (const char *, const char *);
 char *query_ip_name (object_t *);
 char *query_ip_number (object_t *);
@@ -10,11 +10,35 @@
 #include "lpc/program.h"
 #include "comm.h"
 #include "command.h"
+#include "driver_stats.h"
+#include "interpret.h"
 #include "rc/rc.h"
 #include "ed.h"
 
 static int illegal_sentence_action;
 
+/*
+ * Deficit round-robin (DRR) user command scheduling.
+ *
+ * Every connected user holds a command credit (cmd_deficit) in eval cost
+ * units. At the start of each backend cycle users with queued input receive
+ * one quantum of credit (capped at one quantum, so credit is not hoarded),
+ * while idle users only pay back debt. A user may run a queued command while
+ * the user's credit is positive, and the eval cost the command actually consumed is
+ * charged against it afterwards.
+ *
+ * HAS_CMD_TURN still entitles every user to one command per cycle. Beyond
+ * that the scheduler is work-conserving: until CommandCycleBudget
+ * milliseconds have passed, ready users with credit keep being served in
+ * rotation, and when every eligible user is out of credit they are all
+ * advanced by the same number of quanta.
+ */
+#define CMD_MIN_CHARGE 1
+
+static int64_t s_cycle_deadline = 0;       /* end of the extra-command budget (usec) */
+static interactive_t *s_charge_ip = NULL;  /* user whose command is running */
+static int64_t s_charge_eval_start = 0;    /* eval_cost when that command started */
+
  /*
   * This macro is for testing whether ip is still valid, since many
   * functions call LPC code, which could otherwise use
@@ -403,15 +427,102 @@ int call_function_interactive (interactive_t * i, char *str) {
 }				/* call_function_interactive() */
 
 
+static int64_t command_quantum (void) {
+  int quantum = CONFIG_INT (__COMMAND_QUANTUM__);
+  return quantum > 0 ? quantum : 1;
+}
+
+/**
+ * @brief Start a new user command scheduling cycle.
+ *
+ * Grants every connected user a command turn, replenishes command credit,
+ * and sets the deadline for running additional queued commands. Called by
+ * the backend once per loop iteration after polling and I/O processing,
+ * right before process_user_command(), so the wait for events does not use
+ * up the budget.
+ */
+void begin_user_command_cycle (void) {
+  int64_t quantum = command_quantum ();
+  int budget = CONFIG_INT (__COMMAND_CYCLE_BUDGET__);
+
+  for (int i = 0; i < num_active_users; i++)
+    {
+      interactive_t *ip = active_users[i];
+
+      ip->iflags |= HAS_CMD_TURN;
+      ip->cmd_deficit += quantum;
+      if (ip->iflags & CMD_IN_BUF)
+        {
+          if (ip->cmd_deficit > quantum)
+            ip->cmd_deficit = quantum;
+        }
+      else if (ip->cmd_deficit > 0)
+        {
+          ip->cmd_deficit = 0;
+        }
+    }
+  s_cycle_deadline = driver_stats_now () + (int64_t) (budget > 0 ? budget : 0) * 1000;
+}
+
+/**
+ * @brief Charge the eval cost of the running user command against the user's credit.
+ */
+static void charge_user_command (interactive_t *ip, int64_t used) {
+  if (used < CMD_MIN_CHARGE)
+    used = CMD_MIN_CHARGE;
+  ip->cmd_deficit -= used;
+  /* the next queued command is now at the head of the queue */
+  if (ip->iflags & CMD_IN_BUF)
+    ip->cmd_ready_since = driver_stats_now ();
+}
+
+/**
+ * @brief Settle the charge of a user command that was aborted by an error
+ * escaping to the backend loop.
+ *
+ * A command aborted for exceeding the eval cost limit is charged the whole limit.
+ */
+void abort_user_command (void) {
+  interactive_t *ip = s_charge_ip;
+  int64_t used;
+
+  if (!ip)
+    return;
+  s_charge_ip = NULL;
+
+  for (int i = 0; i < num_active_users; i++)
+    {
+      if (active_users[i] != ip)
+        continue;
+      if (get_error_state (ES_MAX_EVAL_COST))
+        used = CONFIG_INT (__MAX_EVAL_COST__);
+      else
+        used = s_charge_eval_start - eval_cost;
+      charge_user_command (ip, used);
+      break;
+    }
+}
+
+/**
+ * @brief Check whether a ready user may run a command now, credit permitting.
+ */
+static inline int may_run_command (const interactive_t *ip, int64_t now) {
+  return (ip->iflags & HAS_CMD_TURN) || now < s_cycle_deadline;
+}
+
 /** @brief Return the next user command to be processed in sequence.
  * The order of user command being processed is "rotated" so that no one
- * user can monopolize the command processing. The \c s_next_user
- * static variable keeps track of which user should be checked next.
- * This function scans through all connected users starting from
- * s_next_user and looks for a user with a complete command
- * in his input buffer. It also calls \c flush_message() to ensure
- * that any outgoing messages are sent to the user before processing
- * his input.
+ * user can monopolize the command processing. Only users on the
+ * \c cmd_ready_users list (those with a complete command buffered) are
+ * visited, so the cost is proportional to the number of ready users rather
+ * than \c max_users. The \c s_next_ready static variable keeps track of
+ * which ready user should be checked next. Output produced by the commands
+ * is sent once per backend cycle by \c flush_dirty_users().
+ *
+ * A user is selected only if the user may run a command (see may_run_command())
+ * and has positive command credit. If every such user is out of credit, all
+ * ready users are advanced by the same number of quanta and the search is
+ * repeated once.
  * 
  * This should also return a value if there is something in the
  * buffer and we are supposed to be in single character mode.
@@ -421,71 +532,79 @@ int call_function_interactive (interactive_t * i, char *str) {
  */
 static char* get_user_command () {
 
-  /* A static counter that iterates between all users in sequence.
+  /* A static cursor that iterates between ready users in sequence.
    * This ensures fair processing of user commands.
    */
-  static int s_next_user = 0;
+  static int s_next_ready = 0;
 
-  int i;
+  int tries, pass;
+  int64_t now = driver_stats_now ();
   interactive_t *ip = NULL;
   char *user_command = NULL;
-  static char buf[MAX_TEXT];
+  static char *buf = NULL;	/* grows to the longest command seen */
+  static size_t buf_size = 0;
+  size_t len;
 
   /*
    * find and return a user command.
+   *
+   * Each try either advances the cursor past a distinct user or removes one
+   * user from the ready list (moving the last entry into the cursor slot),
+   * so the initial list size bounds a full pass.
    */
-  for (i = 0; i < max_users; i++)
+  for (pass = 0; pass < 2 && !user_command; pass++)
     {
-      ip = all_users[s_next_user];
-      if (ip && ip->message_length)
-        {
-          object_t *ob = ip->ob;
-          flush_message (ip);
-          if (!IP_VALID (ip, ob))
-            ip = 0;
-        }
+      int64_t best_deficit = INT64_MIN;
 
-      if (ip)
+      for (tries = num_cmd_ready_users; tries > 0 && num_cmd_ready_users > 0; tries--)
         {
-          /* Keep readiness flag in sync with actual buffered command state. */
-          if (cmd_in_buf (ip))
-            ip->iflags |= CMD_IN_BUF;
-          else
-            ip->iflags &= ~CMD_IN_BUF;
+          if (s_next_ready >= num_cmd_ready_users)
+            s_next_ready = 0;
+          ip = cmd_ready_users[s_next_ready];
 
+          /* Keep readiness in sync with actual buffered command state. */
+          update_cmd_in_buf (ip);
           if (!(ip->iflags & CMD_IN_BUF))
             {
-              if (s_next_user-- == 0)
-                s_next_user = max_users - 1; /* wrap around */
+              ip = 0;
+              continue; /* unlisted; another user now occupies this slot */
+            }
+
+          /* User has command but no turn, budget or credit - skip and continue searching */
+          if (!may_run_command (ip, now) || ip->cmd_deficit <= 0)
+            {
+              if (may_run_command (ip, now) && ip->cmd_deficit > best_deficit)
+                best_deficit = ip->cmd_deficit;
+              s_next_ready++;
+              ip = 0;
               continue;
             }
 
           user_command = first_cmd_in_buf (ip);
           if (user_command)
             {
-              /* Check if user has their turn */
-              if (ip->iflags & HAS_CMD_TURN)
-                {
-                  ip->iflags &= ~HAS_CMD_TURN;  /* Consume turn */
-                  break;  /* Process this command */
-                }
-              else
-                {
-                  /* User has command but no turn - skip and continue searching */
-                  user_command = NULL;
-                }
-            }
-          else
-            {
-              if (cmd_in_buf (ip))
-                ip->iflags |= CMD_IN_BUF;
-              else
-                ip->iflags &= ~CMD_IN_BUF;
+              ip->iflags &= ~HAS_CMD_TURN;  /* Consume turn */
+              s_next_ready++;
+              break;  /* Process this command */
             }
+
+          update_cmd_in_buf (ip);
+          if (ip->iflags & CMD_IN_BUF)
+            s_next_ready++;
+          ip = 0;
         }
 
-      if (s_next_user-- == 0)
-        s_next_user = max_users - 1; /* wrap around */
+      if (!user_command && best_deficit != INT64_MIN)
+        {
+          /* work-conserving: eligible users are all out of credit */
+          int64_t quantum = command_quantum ();
+          int64_t rounds = (quantum - best_deficit) / quantum;
+
+          for (int i = 0; i < num_cmd_ready_users; i++)
+            cmd_ready_users[i]->cmd_deficit += rounds * quantum;
+        }
+      else
+        break;
     }
 
   /*
@@ -501,6 +620,22 @@ static char* get_user_command () {
    */
   command_giver = ip->ob;
 
+  /* a command may be as long as the input buffer; first_cmd_in_buf() left
+   * text_scan at its end.
+   */
+  len = (ip->iflags & SINGLE_CHAR) ? MAX_TEXT : (size_t) (ip->text_scan - ip->text_start) + 1;
+  if (len > buf_size)
+    {
+      if (buf_size < MAX_TEXT)
+        buf_size = MAX_TEXT;
+      while (buf_size < len)
+        buf_size *= 2;
+      if (buf)
+        buf = RESIZE (buf, buf_size, char, TAG_INTERACTIVE, "get_user_command");
+      else
+        buf = (char *) DXALLOC (buf_size, TAG_INTERACTIVE, "get_user_command");
+    }
+
   /*
    * telnet option parsing and negotiation.
    */
@@ -510,8 +645,7 @@ static char* get_user_command () {
 
       if (!token_len || token_len >= MAX_TEXT)
         {
-          if (!cmd_in_buf (ip))
-            ip->iflags &= ~CMD_IN_BUF;
+          update_cmd_in_buf (ip);
           return 0;
         }
 
@@ -535,10 +669,20 @@ static char* get_user_command () {
       next_cmd_in_buf (ip);
     }
 
-  if (!cmd_in_buf (ip))
-    ip->iflags &= ~CMD_IN_BUF;
+  update_cmd_in_buf (ip);
+
+  /* queue wait metrics */
+  {
+    int64_t wait = now - ip->cmd_ready_since;
 
-  s_next_user = (s_next_user - 1 + max_users) % max_users; /* wrap around */
+    if (wait < 0)
+      wait = 0;
+    ip->cmd_count++;
+    ip->cmd_wait_total += wait;
+    if (wait > ip->cmd_wait_max)
+      ip->cmd_wait_max = wait;
+    driver_stats_record (DS_COMMAND_WAIT, wait);
+  }
 
   if (ip->iflags & NOECHO)
     {
@@ -554,6 +698,46 @@ static char* get_user_command () {
 }
 
 
+/*
+ * skip null input (as occurs between <cr> and <lf>) at the start of the
+ * buffer. Clear the buffer and return 0 if nothing else is left.
+ */
+static int skip_null_input (interactive_t * ip) {
+  char *p, *end;
+
+  if (ip->text_start < ip->text_end)
+    {
+      p = ip->text + ip->text_start;
+      end = ip->text + ip->text_end;
+      while (p < end && !*p)
+        p++;
+      ip->text_start = p - ip->text;
+    }
+  if (ip->text_start >= ip->text_end)
+    {
+      ip->text_start = ip->text_end = ip->text_scan = 0;
+      if (ip->text)
+        ip->text[0] = '\0';
+      return 0;
+    }
+  return 1;
+}
+
+/*
+ * find the null ending the cmd at text_start, or 0 if the cmd is partial.
+ * No null lies between text_start and text_scan, so the search resumes
+ * there and a long line arriving in pieces is scanned only once.
+ */
+static char *find_cmd_end (interactive_t * ip) {
+  char *p;
+
+  if (ip->text_scan < ip->text_start || ip->text_scan > ip->text_end)
+    ip->text_scan = ip->text_start;
+  p = (char *) memchr (ip->text + ip->text_scan, '\0', ip->text_end - ip->text_scan);
+  ip->text_scan = p ? p - ip->text : ip->text_end;
+  return p;
+}
+
 /*
  * find the first character of the next complete cmd in a buffer, 0 if no
  * completed cmd.  There is a completed cmd if there is a null between
@@ -564,24 +748,10 @@ static char* get_user_command () {
  * Anything at all in the buffer.
  */
 static char* first_cmd_in_buf (interactive_t * ip) {
-  char *p, *q;
-
-  p = ip->text + ip->text_start;
 
-  /*
-   * skip null input.
-   */
-  while ((p < (ip->text + ip->text_end)) && !*p)
-    p++;
-
-  ip->text_start = p - ip->text;
+  if (!skip_null_input (ip))
+    return 0;
 
-  if (ip->text_start >= ip->text_end)
-    {
-      ip->text_start = ip->text_end = 0;
-      ip->text[0] = '\0';
-      return 0;
-    }
   /* If we got here, must have something in the array */
   if (ip->iflags & SINGLE_CHAR)
     {
@@ -589,38 +759,14 @@ static char* first_cmd_in_buf (interactive_t * ip) {
         return 0;
       return (ip->text + ip->text_start);
     }
+
   /*
-   * find end of cmd.
-   */
-  while ((p < (ip->text + ip->text_end)) && *p)
-    p++;
-  /*
-   * null terminated; was command.
-   */
-  if (p < ip->text + ip->text_end)
-    return (ip->text + ip->text_start);
-  /*
-   * have a partial command at end of buffer; move it to start, return
-   * null. if it can't move down, truncate it and return it as cmd.
-   */
-  p = ip->text + ip->text_start;
-  q = ip->text;
-  while (p < (ip->text + ip->text_end))
-    *(q++) = *(p++);
-
-  ip->text_end -= ip->text_start;
-  ip->text_start = 0;
-  if (ip->text_end > MAX_TEXT - 2)
-    {
-      ip->text[ip->text_end - 2] = '\0';	/* nulls to truncate */
-      ip->text[ip->text_end - 1] = '\0';	/* nulls to truncate */
-      ip->text_end--;
-      return (ip->text);
-    }
-  /*
-   * buffer not full and no newline - no cmd.
+   * a partial command stays where it is until more input arrives;
+   * reserve_input_space() shifts it down when the buffer fills up.
    */
-  return 0;
+  if (!find_cmd_end (ip))
+    return 0;
+  return (ip->text + ip->text_start);
 }				/* first_command_in_buf() */
 
 /**
@@ -632,16 +778,8 @@ static char* first_cmd_in_buf (interactive_t * ip) {
  */
 int cmd_in_buf (interactive_t * ip) {
 
-  const char *p;
-
-  p = ip->text + ip->text_start;
-
-  /* skip empty lines */
-  while ((p < (ip->text + ip->text_end)) && !*p)
-    p++;
-
-   /* end of user command buffer? */
-  if ((p - ip->text) >= ip->text_end)
+  /* skip empty lines; end of user command buffer? */
+  if (!skip_null_input (ip))
     return 0;
 
   /* expecting single character input? */
@@ -649,9 +787,7 @@ int cmd_in_buf (interactive_t * ip) {
     return (single_char_token_len (ip) > 0);
 
   /* find end of command */
-  while ((p < (ip->text + ip->text_end)) && *p)
-    p++;
-  if (p < ip->text + ip->text_end)
+  if (find_cmd_end (ip))
     return 1;
 
   /* user command buffer is empty or only partial command received. */
@@ -662,22 +798,19 @@ int cmd_in_buf (interactive_t * ip) {
  * move pointers to next cmd, or clear buf.
  */
 static void next_cmd_in_buf (interactive_t * ip) {
-  char *p = ip->text + ip->text_start;
+  char *p = find_cmd_end (ip);	/* already found by first_cmd_in_buf() */
 
-  while (*p && p < ip->text + ip->text_end)
-    p++;
-  /*
-   * skip past any nulls at the end.
-   */
-  while (!*p && p < ip->text + ip->text_end)
-    p++;
-  if (p < ip->text + ip->text_end)
-    ip->text_start = p - ip->text;
-  else
+  if (!p)
     {
-      ip->text_start = ip->text_end = 0;
+      ip->text_start = ip->text_end = ip->text_scan = 0;
       ip->text[0] = '\0';
+      return;
     }
+  /*
+   * skip past any nulls at the end.
+   */
+  ip->text_start = (p + 1) - ip->text;
+  skip_null_input (ip);
 }				/* next_cmd_in_buf() */
 
 const char *last_verb = 0;
@@ -786,6 +919,10 @@ void f_query_verb (void) {
  * 
  * The function also handles sentence flags such as V_NOSPACE and V_SHORT to determine how to match
  * the verb and what part of the input to pass as arguments.
+ *
+ * Only candidate sentences are visited: those whose plain verb equals the command verb, found
+ * through the command giver's verb index, and those matched by prefix. They are visited in the
+ * same newest-first order as the sent list.
  * 
  * FIXME: There are dangling problem if the sentence function called by this function destructs
  * or moves the command_giver object. We currently rely on reference counting to keep the memory
@@ -799,7 +936,7 @@ void f_query_verb (void) {
 static int user_parser (const char *buff) {
   char verb_buff[MAX_TEXT];
   const char *save_last_verb = last_verb;
-  sentence_t *s;
+  sentence_t *s, *exact, *prefix;
   const char *space;
   ptrdiff_t length;
   object_t *save_command_giver = command_giver; /* save command giver on entry */
@@ -834,13 +971,33 @@ static int user_parser (const char *buff) {
   save_illegal_sentence_action = illegal_sentence_action;
   illegal_sentence_action = 0;
 
-  /* iterate all sentences */
-  for (s = save_command_giver->sent; s; s = s->next)
+  /* Visit candidate sentences in sent list order (newest first) by merging
+   * the plain verbs equal to user_verb with the prefix-matched sentences.
+   * A plain verb can only match if user_verb is a shared string.
+   */
+  exact = (user_verb != buff) ? find_verb_sentence (save_command_giver, user_verb) : NULL;
+  prefix = save_command_giver->sent_index ? save_command_giver->sent_index->prefix : NULL;
+  for (;;)
     {
       svalue_t *ret;
       int ret_is_nonzero;
       int ret_is_missing;
 
+      while (exact && exact->verb != user_verb)
+        exact = exact->next_verb;  /* hash collision */
+      if (exact && (!prefix || exact->seq > prefix->seq))
+        {
+          s = exact;
+          exact = exact->next_verb;
+        }
+      else if (prefix)
+        {
+          s = prefix;
+          prefix = prefix->next_verb;
+        }
+      else
+        break;
+
       /* skip sentences from destructed objects (ref counting keeps memory valid) */
       if (s->ob->flags & O_DESTRUCTED)
         continue;
@@ -1102,7 +1259,9 @@ int64_t command_for_object (const char *str, object_t *ob) {
  *  object as appropriate.
  *  
  *  User commands are processed in sequence (round-robin) that one user command is processed
- *  per execution of this function.
+ *  per execution of this function. The backend calls it repeatedly after
+ *  \c begin_user_command_cycle() until it returns 0; the deficit round-robin scheduler
+ *  in \c get_user_command() bounds how many commands each user may run per cycle.
  * 
  *  @return Returns 1 if a user command was processed, 0 if no more user commands are pending.
  */
@@ -1114,6 +1273,7 @@ int process_user_command () {
   const char *save_last_verb = last_verb;
   object_t *save_current_object = current_object;
   object_t *save_command_giver = command_giver;
+  object_t *charge_ob;
   interactive_t *ip;
   svalue_t *ret;
 
@@ -1122,6 +1282,13 @@ int process_user_command () {
   /* WARNING: get_user_command() sets command_giver */
   if ((user_command = get_user_command ()))
     {
+      /* each user command runs with a full eval budget, and the part it
+       * consumes is charged against the user's command credit.
+       */
+      charge_ob = command_giver;
+      s_charge_ip = command_giver->interactive;
+      s_charge_eval_start = eval_cost = CONFIG_INT (__MAX_EVAL_COST__);
+
 #if defined(NO_ANSI) && defined(STRIP_BEFORE_PROCESS_INPUT)
       char *p;
       for (p = user_command; *p; p++)
@@ -1140,6 +1307,7 @@ int process_user_command () {
 
       if (command_giver->flags & O_DESTRUCTED)
         {
+          s_charge_ip = NULL;
           command_giver = save_command_giver;
           current_object = save_current_object;
           last_verb = save_last_verb;
@@ -1148,6 +1316,7 @@ int process_user_command () {
       ip = command_giver->interactive;
       if (!ip)
         {
+          s_charge_ip = NULL;
           last_verb = save_last_verb;
           return 1;
         }
@@ -1271,6 +1440,9 @@ int process_user_command () {
        */
       print_prompt (ip);
     failure:
+      if (s_charge_ip && IP_VALID (s_charge_ip, charge_ob))
+        charge_user_command (s_charge_ip, s_charge_eval_start - eval_cost);
+      s_charge_ip = NULL;
       current_object = save_current_object;
       command_giver = save_command_giver;
       current_interactive = 0;
@@ -1340,6 +1512,7 @@ void add_action (svalue_t * str, const char *cmd, int flag, int num_carry, svalu
     }
   p->ob = ob;
   add_ref (ob, "add_action");
+  ob->flags |= O_HAS_ACTIONS;
   p->verb = make_shared_string(cmd, NULL);
 
   /* Store carryover args in sentence */
@@ -1356,8 +1529,7 @@ void add_action (svalue_t * str, const char *cmd, int flag, int num_carry, svalu
     }
 
   /* This is ok; adding to the top of the list doesn't harm anything */
-  p->next = command_giver->sent;
-  command_giver->sent = p;
+  link_sentence (command_giver, p);
 }
 
 
@@ -1386,7 +1558,7 @@ int remove_action (const char *act, const char *verb) {
               && !strcmp ((*s)->verb, verb))
             {
               tmp = *s;
-              *s = tmp->next;
+              unlink_sentence (ob, s);
               free_sentence (tmp);
               illegal_sentence_action = 1;
               return 1;
@@ -1410,7 +1582,33 @@ void remove_sent (object_t * ob, object_t * user) {
       if ((*s)->ob == ob)
         {
           tmp = *s;
-          *s = tmp->next;
+          unlink_sentence (user, s);
+          free_sentence (tmp);
+          illegal_sentence_action = 2;
+        }
+      else
+        s = &((*s)->next);
+    }
+}
+
+/**
+ * Remove all commands (sentences) that the environment of 'user' and the
+ * other objects in it defined in 'user'. Equivalent to calling remove_sent()
+ * for each of those objects, in a single pass over the sent list.
+ */
+void remove_env_sent (object_t * user) {
+  object_t *env = user->super;
+  sentence_t **s;
+
+  if (!env)
+    return;
+  for (s = &user->sent; *s;)
+    {
+      sentence_t *tmp = *s;
+
+      if (tmp->ob != user && (tmp->ob == env || tmp->ob->super == env))
+        {
+          unlink_sentence (user, s);
           free_sentence (tmp);
           illegal_sentence_action = 2;
         }
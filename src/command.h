@@ -23,6 +23,7 @@ int call_function_interactive (interactive_t *, char *);
 void add_action(svalue_t *action, const char *cmd, int flags, int num_carry, svalue_t *carry_args);
 int remove_action(const char *cmd, const char *verb);
 void remove_sent (object_t *, object_t *);
+void remove_env_sent (object_t *);
 
 /* command fail handling */
 void notify_no_command (void);
@@ -37,7 +38,9 @@ object_t *query_snooping (object_t *);
 
 /* user command handling */
 int cmd_in_buf (interactive_t *);
+void begin_user_command_cycle (void);
 int process_user_command (void);
+void abort_user_command (void);
 
 /* object command handling */
 int64_t command_for_object (const char *cmd, object_t *ob);
@@ -0,0 +1,230 @@
+/**
+ * @file driver_stats.cpp
+ * @brief Driver loop stage timing and tick-latency telemetry
+ *
+ * Samples are kept in a fixed-size ring per stage.  Percentiles are computed
+ * on demand by copying the window and selecting with std::nth_element, so
+ * recording a sample costs a handful of stores on the hot path.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "std.h"
+#include "driver_stats.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+
+namespace {
+
+struct stage_window_t {
+  int64_t samples[DRIVER_STATS_WINDOW];
+  uint64_t count;
+  int64_t last;
+};
+
+static stage_window_t s_stages[DS_NUM_STAGES];
+
+/* written by the timer thread, consumed by the main thread */
+static std::atomic<int64_t> s_heart_beat_fired_at{0};
+static std::atomic<uint64_t> s_heart_beat_overruns{0};
+
+static int64_t s_last_log_at = 0;
+
+static const char *const s_stage_names[DS_NUM_STAGES] = {
+  "remove_destructed",
+  "user_scan",
+  "polling",
+  "process_io",
+  "user_commands",
+  "heart_beat",
+  "tick",
+  "heart_beat_lag",
+  "command_wait",
+  "output_flush",
+};
+
+static int64_t percentile (int64_t *sorted_scratch, size_t n, int pct) {
+  size_t k;
+
+  if (n == 0)
+    return 0;
+  k = (n * pct) / 100;
+  if (k >= n)
+    k = n - 1;
+  std::nth_element (sorted_scratch, sorted_scratch + k, sorted_scratch + n);
+  return sorted_scratch[k];
+}
+
+} // namespace
+
+/**
+ * @brief Read the monotonic clock.
+ * @return Microseconds since an arbitrary, fixed point in time.
+ */
+extern "C"
+int64_t driver_stats_now (void) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * @brief Record one elapsed-time sample for a driver loop stage.
+ * @param stage The stage being measured.
+ * @param elapsed_usec Elapsed time in microseconds. Negative values are clamped to zero.
+ */
+extern "C"
+void driver_stats_record (driver_stage_t stage, int64_t elapsed_usec) {
+  stage_window_t *w;
+
+  if (stage < 0 || stage >= DS_NUM_STAGES)
+    return;
+  if (elapsed_usec < 0)
+    elapsed_usec = 0;
+
+  w = &s_stages[stage];
+  w->samples[w->count % DRIVER_STATS_WINDOW] = elapsed_usec;
+  w->last = elapsed_usec;
+  w->count++;
+}
+
+/**
+ * @brief Remember when the heart beat timer fired.
+ *
+ * Safe to call from the timer thread. If the driver loop has not yet serviced
+ * a previous fire, the earlier timestamp is kept so that the lag reflects the
+ * full delay.
+ */
+extern "C"
+void driver_stats_mark_heart_beat_fired (void) {
+  driver_stats_mark_heart_beat_fired_at (driver_stats_now ());
+}
+
+/**
+ * @brief Remember when the heart beat timer fired, given the firing time.
+ * @param fired_at Timestamp from driver_stats_now() of the expiration.
+ */
+extern "C"
+void driver_stats_mark_heart_beat_fired_at (int64_t fired_at) {
+  int64_t expected = 0;
+  s_heart_beat_fired_at.compare_exchange_strong (expected, fired_at);
+}
+
+/**
+ * @brief Count heart beat timer expirations that were never serviced.
+ *
+ * Safe to call from the timer thread.
+ * @param missed Number of expirations that passed while one was pending.
+ */
+extern "C"
+void driver_stats_heart_beat_overrun (uint64_t missed) {
+  s_heart_beat_overruns.fetch_add (missed);
+}
+
+/**
+ * @brief Total heart beat overruns since startup or the last reset.
+ */
+extern "C"
+uint64_t driver_stats_heart_beat_overruns (void) {
+  return s_heart_beat_overruns.load ();
+}
+
+/**
+ * @brief Record the heart beat lag sample when call_heart_beat() is about to start.
+ */
+extern "C"
+void driver_stats_heart_beat_started (void) {
+  int64_t fired_at = s_heart_beat_fired_at.exchange (0);
+
+  if (fired_at)
+    driver_stats_record (DS_HEART_BEAT_LAG, driver_stats_now () - fired_at);
+}
+
+/**
+ * @brief Compute the rolling summary of a stage.
+ * @param stage The stage to summarize.
+ * @param out Receives the summary. Zero-filled if the stage has no samples.
+ */
+extern "C"
+void driver_stats_summary (driver_stage_t stage, driver_stage_summary_t *out) {
+  static int64_t scratch[DRIVER_STATS_WINDOW];
+  const stage_window_t *w;
+  size_t n;
+
+  if (!out)
+    return;
+  memset (out, 0, sizeof (*out));
+  if (stage < 0 || stage >= DS_NUM_STAGES)
+    return;
+
+  w = &s_stages[stage];
+  n = (w->count < DRIVER_STATS_WINDOW) ? (size_t) w->count : DRIVER_STATS_WINDOW;
+  out->count = w->count;
+  out->last = w->last;
+  if (n == 0)
+    return;
+
+  std::copy (w->samples, w->samples + n, scratch);
+  out->max = *std::max_element (scratch, scratch + n);
+  out->p99 = percentile (scratch, n, 99);
+  out->p50 = percentile (scratch, n, 50);
+}
+
+/**
+ * @brief Get the name of a stage as reported by driver_stats().
+ */
+extern "C"
+const char *driver_stats_stage_name (driver_stage_t stage) {
+  if (stage < 0 || stage >= DS_NUM_STAGES)
+    return "unknown";
+  return s_stage_names[stage];
+}
+
+/**
+ * @brief Discard all recorded samples.
+ */
+extern "C"
+void driver_stats_reset (void) {
+  memset (s_stages, 0, sizeof (s_stages));
+  s_heart_beat_fired_at.store (0);
+  s_heart_beat_overruns.store (0);
+  s_last_log_at = 0;
+}
+
+/**
+ * @brief Emit a one-line summary to the debug log every @p interval_secs seconds.
+ * @param interval_secs Seconds between log lines. Zero or negative disables logging.
+ */
+extern "C"
+void driver_stats_periodic_log (int interval_secs) {
+  driver_stage_summary_t tick, lag, io, cmd, hb;
+  int64_t now;
+
+  if (interval_secs <= 0)
+    return;
+
+  now = driver_stats_now ();
+  if (s_last_log_at == 0)
+    {
+      s_last_log_at = now;
+      return;
+    }
+  if (now - s_last_log_at < (int64_t) interval_secs * 1000000)
+    return;
+  s_last_log_at = now;
+
+  driver_stats_summary (DS_TICK, &tick);
+  driver_stats_summary (DS_HEART_BEAT_LAG, &lag);
+  driver_stats_summary (DS_PROCESS_IO, &io);
+  driver_stats_summary (DS_USER_COMMANDS, &cmd);
+  driver_stats_summary (DS_HEART_BEAT, &hb);
+  LOG_NOTICE ("{}\tdriver_stats: tick p50=%" PRId64 " p99=%" PRId64 " max=%" PRId64
+              " | lag p50=%" PRId64 " p99=%" PRId64 " max=%" PRId64 " overruns=%" PRIu64
+              " | io p99=%" PRId64 " cmd p99=%" PRId64 " hb p99=%" PRId64 " (usec)",
+              tick.p50, tick.p99, tick.max, lag.p50, lag.p99, lag.max,
+              driver_stats_heart_beat_overruns (),
+              io.p99, cmd.p99, hb.p99);
+}
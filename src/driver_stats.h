@@ -0,0 +1,68 @@
+/**
+ * @file driver_stats.h
+ * @brief Driver loop stage timing and tick-latency telemetry — public C API
+ *
+ * The main driver loop samples a monotonic clock around each of its stages
+ * and records the elapsed time here.  Each stage keeps a rolling window of
+ * the most recent samples from which p50/p99/max are computed on demand.
+ *
+ * The heart beat lag is the delay between the heart beat timer firing and
+ * the driver loop starting call_heart_beat().  Timer expirations that pass
+ * while a previous one is still waiting are counted as overruns.
+ *
+ * Except for driver_stats_mark_heart_beat_fired() and
+ * driver_stats_heart_beat_overrun(), all functions must be called from the
+ * main (backend) thread only.
+ */
+
+#ifndef DRIVER_STATS_H
+#define DRIVER_STATS_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Number of most recent samples kept per stage for percentile estimation. */
+#define DRIVER_STATS_WINDOW 1024
+
+typedef enum {
+  DS_REMOVE_DESTRUCTED = 0, /**< remove_destructed_objects() */
+  DS_USER_SCAN,             /**< granting command turns to users */
+  DS_POLLING,               /**< do_comm_polling(), including idle wait */
+  DS_PROCESS_IO,            /**< process_io() */
+  DS_USER_COMMANDS,         /**< process_user_command() turns */
+  DS_HEART_BEAT,            /**< call_heart_beat() */
+  DS_TICK,                  /**< one driver loop iteration, excluding polling */
+  DS_HEART_BEAT_LAG,        /**< heart beat timer fire to call_heart_beat() start */
+  DS_COMMAND_WAIT,          /**< queue wait of a user command before it runs */
+  DS_OUTPUT_FLUSH,          /**< flush_dirty_users() at the end of an iteration */
+  DS_NUM_STAGES
+} driver_stage_t;
+
+typedef struct {
+  uint64_t count;   /**< total samples recorded since startup */
+  int64_t last;     /**< most recent sample (microseconds) */
+  int64_t p50;      /**< median over the rolling window (microseconds) */
+  int64_t p99;      /**< 99th percentile over the rolling window (microseconds) */
+  int64_t max;      /**< maximum over the rolling window (microseconds) */
+} driver_stage_summary_t;
+
+int64_t driver_stats_now (void);
+void driver_stats_record (driver_stage_t stage, int64_t elapsed_usec);
+void driver_stats_mark_heart_beat_fired (void);
+void driver_stats_mark_heart_beat_fired_at (int64_t fired_at);
+void driver_stats_heart_beat_overrun (uint64_t missed);
+uint64_t driver_stats_heart_beat_overruns (void);
+void driver_stats_heart_beat_started (void);
+void driver_stats_summary (driver_stage_t stage, driver_stage_summary_t *out);
+const char *driver_stats_stage_name (driver_stage_t stage);
+void driver_stats_reset (void);
+void driver_stats_periodic_log (int interval_secs);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DRIVER_STATS_H */
@@ -212,6 +212,7 @@ static void push_indexed_lvalue (int reverse) {
               ind = lv->u.arr->size - ind;
             if (ind >= lv->u.arr->size || ind < 0)
               error ("*Array index out of bounds.");
+            MARK_CHANGED (lv->u.arr);
             sp->type = T_LVALUE;
             sp->u.lvalue = lv->u.arr->item + ind;
             break;
@@ -275,6 +276,7 @@ static void push_indexed_lvalue (int reverse) {
               ind = sp->u.arr->size - ind;
             if (ind >= sp->u.arr->size || ind < 0)
               error ("*Array index out of bounds.");
+            MARK_CHANGED (sp->u.arr);
             sp->u.arr->ref--;
             (--sp)->type = T_LVALUE;
             sp->u.lvalue = (sp + 1)->u.arr->item + ind;
@@ -306,6 +308,7 @@ static void push_lvalue_range (int code) {
         {
         case T_ARRAY:
           size = lv->u.arr->size;
+          MARK_CHANGED (lv->u.arr);
           break;
         case T_STRING:
           {
@@ -1433,7 +1436,10 @@ void eval_instruction (const char *p) {
                 /* push lvalue for key */
                 (++sp)->type = T_LVALUE;
                 if (flags & 2)
-                  sp->u.lvalue = find_value ((int)(EXTRACT_UCHAR (pc++) + variable_index_offset));
+                  {
+                    MARK_CHANGED (current_object);
+                    sp->u.lvalue = find_value ((int)(EXTRACT_UCHAR (pc++) + variable_index_offset));
+                  }
                 else
                   sp->u.lvalue = fp + EXTRACT_UCHAR (pc++);
               }
@@ -1462,7 +1468,10 @@ void eval_instruction (const char *p) {
             /* push lvalue for mapping value, string character, or array element */
             (++sp)->type = T_LVALUE;
             if (flags & 1)
-              sp->u.lvalue = find_value ((int)(EXTRACT_UCHAR (pc++) + variable_index_offset));
+              {
+                MARK_CHANGED (current_object);
+                sp->u.lvalue = find_value ((int)(EXTRACT_UCHAR (pc++) + variable_index_offset));
+              }
             else
               sp->u.lvalue = fp + EXTRACT_UCHAR (pc++);
             break;
@@ -2020,6 +2029,7 @@ void eval_instruction (const char *p) {
             arr = sp->u.arr;
             if (i >= arr->size)
               error ("*Class has no corresponding member.");
+            MARK_CHANGED (arr);
             sp->type = T_LVALUE;
             sp->u.lvalue = arr->item + i;
             free_class (arr);
@@ -2353,6 +2363,7 @@ void eval_instruction (const char *p) {
             }
           break;
         case F_GLOBAL_LVALUE:
+          MARK_CHANGED (current_object);
           (++sp)->type = T_LVALUE;
           sp->u.lvalue = find_value ((int) (EXTRACT_UCHAR (pc++) + variable_index_offset));
           break;
@@ -0,0 +1,331 @@
+#ifdef	HAVE_CONFIG_H
+#include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include "std.h"
+#include "output_chain.h"
+
+#include <stddef.h>
+
+/* A chain is made of pooled data blocks holding copied output, and of small
+ * reference blocks (allocated without the data array) pointing into a
+ * shared output segment.
+ */
+struct output_block_s {
+  output_block_t *next;
+  output_segment_t *segment;  /* shared segment, or NULL for a data block */
+  size_t start;             /* first unsent byte */
+  size_t end;               /* first free byte */
+  char data[OUTPUT_BLOCK_SIZE];
+};
+
+#define REF_BLOCK_SIZE          offsetof (output_block_t, data)
+
+static output_block_t *free_blocks = NULL;
+static output_segment_t *autorelease_segments = NULL;
+static output_pool_stats_t pool_stats;
+
+static output_block_t *get_block (void) {
+  output_block_t *blk = free_blocks;
+
+  if (blk)
+    {
+      free_blocks = blk->next;
+      pool_stats.blocks_free--;
+    }
+  else
+    {
+      blk = (output_block_t *) DXALLOC (sizeof (output_block_t), TAG_INTERACTIVE, "output_chain: block");
+      pool_stats.blocks_allocated++;
+      pool_stats.total_allocs++;
+    }
+  blk->next = NULL;
+  blk->segment = NULL;
+  blk->start = blk->end = 0;
+  if (++pool_stats.blocks_in_use > pool_stats.peak_in_use)
+    pool_stats.peak_in_use = pool_stats.blocks_in_use;
+  return blk;
+}
+
+static void put_block (output_block_t *blk) {
+  if (blk->segment)
+    {
+      output_segment_release (blk->segment);
+      FREE (blk);
+      return;
+    }
+  pool_stats.blocks_in_use--;
+  if (pool_stats.blocks_free >= OUTPUT_POOL_MAX_FREE)
+    {
+      FREE (blk);
+      pool_stats.blocks_allocated--;
+      return;
+    }
+  blk->next = free_blocks;
+  free_blocks = blk;
+  pool_stats.blocks_free++;
+}
+
+/**
+ * @brief Initialize an empty output chain.
+ */
+void output_chain_init (output_chain_t *chain) {
+  chain->head = chain->tail = NULL;
+  chain->length = 0;
+}
+
+/**
+ * @brief Append bytes to the end of an output chain.
+ *
+ * New blocks are taken from the pool as the tail block fills up; the chain
+ * has no length limit of its own.
+ */
+void output_chain_append (output_chain_t *chain, const char *data, size_t len) {
+  while (len > 0)
+    {
+      output_block_t *tail = chain->tail;
+      size_t n;
+
+      if (!tail || tail->segment || tail->end == OUTPUT_BLOCK_SIZE)
+        {
+          output_block_t *blk = get_block ();
+
+          if (tail)
+            tail->next = blk;
+          else
+            chain->head = blk;
+          chain->tail = tail = blk;
+        }
+      n = OUTPUT_BLOCK_SIZE - tail->end;
+      if (n > len)
+        n = len;
+      memcpy (tail->data + tail->end, data, n);
+      tail->end += n;
+      chain->length += n;
+      data += n;
+      len -= n;
+    }
+}
+
+/**
+ * @brief Append text to an output chain, translating each newline into CR LF.
+ *
+ * The text between newlines is copied in bulk.
+ */
+void output_chain_append_crlf (output_chain_t *chain, const char *data, size_t len) {
+  const char *end = data + len;
+
+  while (data < end)
+    {
+      const char *nl = (const char *) memchr (data, '\n', end - data);
+
+      if (!nl)
+        {
+          output_chain_append (chain, data, end - data);
+          break;
+        }
+      output_chain_append (chain, data, nl - data);
+      output_chain_append (chain, "\r\n", 2);
+      data = nl + 1;
+    }
+}
+
+/**
+ * @brief Describe the pending bytes of an output chain as an I/O vector.
+ * @param chain The output chain.
+ * @param iov Receives one entry per non-empty block, oldest first.
+ * @param max Capacity of @p iov.
+ * @return The number of entries filled in.
+ */
+int output_chain_iov (const output_chain_t *chain, socket_iovec_t *iov, int max) {
+  const output_block_t *blk;
+  int n = 0;
+
+  for (blk = chain->head; blk && n < max; blk = blk->next)
+    {
+      if (blk->end == blk->start)
+        continue;
+      SOCKET_IOV_SET (iov[n], (blk->segment ? blk->segment->data : blk->data) + blk->start,
+                      blk->end - blk->start);
+      n++;
+    }
+  return n;
+}
+
+/**
+ * @brief Remove bytes that have been sent from the front of an output chain.
+ *
+ * Blocks that become empty are returned to the pool.
+ */
+void output_chain_consume (output_chain_t *chain, size_t len) {
+  if (len > chain->length)
+    len = chain->length;
+  chain->length -= len;
+
+  while (chain->head)
+    {
+      output_block_t *blk = chain->head;
+      size_t avail = blk->end - blk->start;
+
+      if (len < avail)
+        {
+          blk->start += len;
+          return;
+        }
+      len -= avail;
+      /* keep the tail block for appending if it is not full yet */
+      if (blk == chain->tail && !blk->segment && blk->end < OUTPUT_BLOCK_SIZE)
+        {
+          blk->start = blk->end = 0;
+          return;
+        }
+      chain->head = blk->next;
+      if (!chain->head)
+        chain->tail = NULL;
+      put_block (blk);
+    }
+}
+
+/**
+ * @brief Discard all pending output and return the blocks to the pool.
+ */
+void output_chain_clear (output_chain_t *chain) {
+  while (chain->head)
+    {
+      output_block_t *blk = chain->head;
+
+      chain->head = blk->next;
+      put_block (blk);
+    }
+  chain->tail = NULL;
+  chain->length = 0;
+}
+
+/**
+ * @brief Append a reference to a shared output segment to an output chain.
+ *
+ * A segment that fits in the free space of the tail block is copied there
+ * instead, which is cheaper to send than an extra I/O vector entry.
+ */
+void output_chain_append_segment (output_chain_t *chain, output_segment_t *seg) {
+  output_block_t *tail = chain->tail;
+  output_block_t *blk;
+
+  if (seg->length == 0)
+    return;
+  if (tail && !tail->segment && OUTPUT_BLOCK_SIZE - tail->end >= seg->length)
+    {
+      output_chain_append (chain, seg->data, seg->length);
+      return;
+    }
+
+  blk = (output_block_t *) DXALLOC (REF_BLOCK_SIZE, TAG_INTERACTIVE, "output_chain: segment ref");
+  blk->next = NULL;
+  blk->segment = seg;
+  blk->start = 0;
+  blk->end = seg->length;
+  seg->ref++;
+  pool_stats.segment_refs++;
+
+  if (tail)
+    tail->next = blk;
+  else
+    chain->head = blk;
+  chain->tail = blk;
+  chain->length += seg->length;
+}
+
+/**
+ * @brief Translate a message once for broadcasting, converting each newline
+ * into CR LF.
+ *
+ * The caller does not own the returned segment. It stays valid until
+ * output_segment_drain_autorelease() is called at the end of the backend
+ * iteration, and afterwards as long as an output chain references it, so
+ * an error raised in the middle of a broadcast cannot leak it.
+ */
+output_segment_t *output_segment_new_crlf (const char *data, size_t len) {
+  const char *end = data + len, *p;
+  output_segment_t *seg;
+  size_t newlines = 0;
+  char *out;
+
+  for (p = data; (p = (const char *) memchr (p, '\n', end - p)); p++)
+    newlines++;
+
+  seg = (output_segment_t *) DXALLOC (sizeof (output_segment_t) + len + newlines,
+                                      TAG_INTERACTIVE, "output_segment_new_crlf");
+  seg->ref = 1;
+  seg->length = len + newlines;
+  out = seg->data;
+  while (data < end)
+    {
+      const char *nl = (const char *) memchr (data, '\n', end - data);
+      size_t span = (nl ? nl : end) - data;
+
+      memcpy (out, data, span);
+      out += span;
+      if (!nl)
+        break;
+      *out++ = '\r';
+      *out++ = '\n';
+      data = nl + 1;
+    }
+
+  seg->next_autorelease = autorelease_segments;
+  autorelease_segments = seg;
+  pool_stats.segments++;
+  return seg;
+}
+
+/**
+ * @brief Drop one reference to an output segment, freeing it with the last.
+ */
+void output_segment_release (output_segment_t *seg) {
+  if (--seg->ref == 0)
+    FREE (seg);
+}
+
+/**
+ * @brief Drop the creation reference of every segment made since the last call.
+ */
+void output_segment_drain_autorelease (void) {
+  while (autorelease_segments)
+    {
+      output_segment_t *seg = autorelease_segments;
+
+      autorelease_segments = seg->next_autorelease;
+      output_segment_release (seg);
+    }
+}
+
+/**
+ * @brief Count output that was discarded instead of being queued.
+ */
+void output_pool_count_dropped (size_t len) {
+  pool_stats.bytes_dropped += len;
+}
+
+/**
+ * @brief Get the output block pool statistics.
+ */
+void output_pool_get_stats (output_pool_stats_t *out) {
+  *out = pool_stats;
+}
+
+/**
+ * @brief Release all cached free blocks back to the memory allocator.
+ *
+ * Called by ipc_remove() when the driver shuts down.
+ */
+void output_pool_trim (void) {
+  while (free_blocks)
+    {
+      output_block_t *blk = free_blocks;
+
+      free_blocks = blk->next;
+      FREE (blk);
+      pool_stats.blocks_allocated--;
+      pool_stats.blocks_free--;
+    }
+}
@@ -0,0 +1,85 @@
+/**
+ * @file output_chain.h
+ * @brief Chained output buffers built from pooled fixed-size blocks
+ *
+ * Each interactive connection queues its pending output in an output chain.
+ * A chain is a list of fixed-size blocks taken from a process-wide pool, so a
+ * connection only holds as much memory as it has unsent output, and a slow
+ * client makes its chain grow instead of losing output.  The pending bytes
+ * of a chain are handed to the socket in a single socket_sendv() call.
+ *
+ * A message broadcast to many connections is translated once into an
+ * immutable, reference counted output segment. Each chain then links a
+ * reference to the segment instead of a copy of the text.
+ *
+ * All functions must be called from the main (backend) thread only.
+ */
+
+#ifndef OUTPUT_CHAIN_H
+#define OUTPUT_CHAIN_H
+
+#include "port/socket_comm.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Payload bytes of one pooled output block. */
+#define OUTPUT_BLOCK_SIZE       MESSAGE_BUFFER_SIZE	/* from options.h */
+
+/** Maximum number of unused blocks kept in the pool for reuse. */
+#define OUTPUT_POOL_MAX_FREE    256
+
+/** Maximum number of buffers passed to one socket_sendv() call. */
+#define OUTPUT_MAX_IOV          16
+
+typedef struct output_block_s output_block_t;
+typedef struct output_segment_s output_segment_t;
+
+struct output_segment_s {
+  int ref;
+  output_segment_t *next_autorelease;
+  size_t length;
+  char data[1];
+};
+
+typedef struct output_chain_s {
+  output_block_t *head;     /* oldest block, being sent */
+  output_block_t *tail;     /* newest block, being filled */
+  size_t length;            /* pending bytes in the chain */
+} output_chain_t;
+
+typedef struct {
+  uint64_t blocks_allocated;  /**< blocks currently allocated (in use + free) */
+  uint64_t blocks_in_use;     /**< blocks linked into output chains */
+  uint64_t blocks_free;       /**< unused blocks cached for reuse */
+  uint64_t peak_in_use;       /**< highest blocks_in_use since startup */
+  uint64_t total_allocs;      /**< blocks obtained from the memory allocator */
+  uint64_t bytes_dropped;     /**< output discarded at OutputBufferLimit */
+  uint64_t segments;          /**< broadcast segments created */
+  uint64_t segment_refs;      /**< segment references linked into chains */
+} output_pool_stats_t;
+
+void output_chain_init (output_chain_t *);
+void output_chain_append (output_chain_t *, const char *, size_t);
+void output_chain_append_crlf (output_chain_t *, const char *, size_t);
+int output_chain_iov (const output_chain_t *, socket_iovec_t *, int);
+void output_chain_consume (output_chain_t *, size_t);
+void output_chain_clear (output_chain_t *);
+void output_chain_append_segment (output_chain_t *, output_segment_t *);
+
+output_segment_t *output_segment_new_crlf (const char *, size_t);
+void output_segment_release (output_segment_t *);
+void output_segment_drain_autorelease (void);
+
+void output_pool_count_dropped (size_t);
+void output_pool_get_stats (output_pool_stats_t *);
+void output_pool_trim (void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* OUTPUT_CHAIN_H */
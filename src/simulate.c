@@ -53,7 +53,8 @@ static int give_uid_to_object (object_t *);
 static int init_object (object_t *);
 static object_t *load_virtual_object (const char *);
 static char *make_new_name (const char *);
-static void send_say (object_t *, const char *, array_t *);
+static void send_say (object_t *, const char *, array_t *, output_segment_t **);
+static void tell_object_shared (object_t *, const char *, output_segment_t **);
 
 /*********************************************************************/
 
@@ -904,6 +905,48 @@ static void fix_object_names (void) {
 
 static object_t *restrict_destruct;
 
+/**
+ * @brief Unlink an object from its environment's inventory list in O(1).
+ */
+static void unlink_inventory (object_t *ob) {
+  if (ob->prev_inv)
+    ob->prev_inv->next_inv = ob->next_inv;
+  else
+    ob->super->contains = ob->next_inv;
+  if (ob->next_inv)
+    ob->next_inv->prev_inv = ob->prev_inv;
+  ob->next_inv = 0;
+  ob->prev_inv = 0;
+}
+
+/**
+ * @brief Link an object at the head of @p dest's inventory list.
+ */
+static void link_inventory (object_t *ob, object_t *dest) {
+  ob->prev_inv = 0;
+  ob->next_inv = dest->contains;
+  if (dest->contains)
+    dest->contains->prev_inv = ob;
+  dest->contains = ob;
+}
+
+/**
+ * @brief Remove the actions an object defined in the other command-enabled
+ * objects of its environment.
+ *
+ * Objects that never called add_action() have no sentences to remove, so
+ * the inventory of the environment is not scanned for them.
+ */
+static void remove_sent_from_env (object_t *ob) {
+  object_t *other;
+
+  if (!(ob->flags & O_HAS_ACTIONS))
+    return;
+  for (other = ob->super->contains; other; other = other->next_inv)
+    if (other != ob && (other->flags & O_ENABLE_COMMANDS))
+      remove_sent (ob, other);
+}
+
 void reset_destruct_object_limits() {
   restrict_destruct = NULL;
 }
@@ -1046,17 +1089,9 @@ void destruct_object (object_t * ob) {
       if (ob->super->flags & O_ENABLE_COMMANDS)
         remove_sent (ob, ob->super);
 
-      for (pp = &ob->super->contains; *pp;)
-        {
-          /* remove our sentences from objects in the same environment */
-          if ((*pp)->flags & O_ENABLE_COMMANDS)
-            remove_sent (ob, *pp);
-
-          if (*pp != ob)
-            pp = &(*pp)->next_inv;
-          else
-            *pp = (*pp)->next_inv;
-        }
+      /* remove our sentences from objects in the same environment */
+      remove_sent_from_env (ob);
+      unlink_inventory (ob);
       opt_trace (TT_EVAL|1, "moved /%s out of environment", ob->name);
     }
 
@@ -1193,17 +1228,18 @@ void destruct_object (object_t * ob) {
         }
       ob->sent = NULL;
     }
+  free_sentence_index (ob);
 
   /*
    * Clean input_to/get_char callback references pointing at this object.
    * Otherwise dormant interactives can retain a dead object indefinitely.
    */
-  if (all_users)
+  if (active_users)
     {
-      for (int i = 0; i < max_users; i++)
+      for (int i = 0; i < num_active_users; i++)
         {
-          interactive_t *ip = all_users[i];
-          if (ip && ip->input_to && ip->input_to->ob == ob)
+          interactive_t *ip = active_users[i];
+          if (ip->input_to && ip->input_to->ob == ob)
             {
               opt_trace (TT_EVAL|1, "clearing input_to for /%s from user /%s",
                          ob->name, ip->ob->name);
@@ -1218,6 +1254,7 @@ void destruct_object (object_t * ob) {
                    * 1. It's static in comm.c and would require API changes
                    * 2. The flag will be properly reset on next input_to/get_char call
                    * 3. User will revert to line mode on next input naturally */
+                  update_cmd_in_buf (ip);
                 }
             }
         }
@@ -1230,6 +1267,7 @@ void destruct_object (object_t * ob) {
   ob->flags &= ~O_ENABLE_COMMANDS;
   ob->super = 0;
   ob->next_inv = 0;
+  ob->prev_inv = 0;
   ob->contains = 0;
   ob->next_all = obj_list_destruct;
   obj_list_destruct = ob;
@@ -1336,7 +1374,7 @@ void remove_destructed_objects () {
  * rewritten, bobf@metronet.com (Blackthorn) 9/6/93
  */
 
-static void send_say (object_t * ob, const char *text, array_t * avoid) {
+static void send_say (object_t * ob, const char *text, array_t * avoid, output_segment_t ** seg) {
   int valid, j;
 
   for (valid = 1, j = 0; j < avoid->size; j++)
@@ -1353,11 +1391,12 @@ static void send_say (object_t * ob, const char *text, array_t * avoid) {
   if (!valid)
     return;
 
-  tell_object (ob, text);
+  tell_object_shared (ob, text, seg);
 }
 
 void say (svalue_t * v, array_t * avoid) {
   object_t *ob, *origin, *save_command_giver = command_giver;
+  output_segment_t *seg = NULL;
   const char *buff;
 
   check_legal_string (SVALUE_STRPTR(v));
@@ -1374,14 +1413,14 @@ void say (svalue_t * v, array_t * avoid) {
   if ((ob = origin->super))
     {
       if (ob->flags & O_LISTENER || ob->interactive)
-        send_say (ob, buff, avoid);
+        send_say (ob, buff, avoid, &seg);
 
       /* And its inventory... */
       for (ob = origin->super->contains; ob; ob = ob->next_inv)
         {
           if (ob != origin && (ob->flags & O_LISTENER || ob->interactive))
             {
-              send_say (ob, buff, avoid);
+              send_say (ob, buff, avoid, &seg);
               if (ob->flags & O_DESTRUCTED)
                 break;
             }
@@ -1392,7 +1431,7 @@ void say (svalue_t * v, array_t * avoid) {
     {
       if (ob->flags & O_LISTENER || ob->interactive)
         {
-          send_say (ob, buff, avoid);
+          send_say (ob, buff, avoid, &seg);
           if (ob->flags & O_DESTRUCTED)
             break;
         }
@@ -1420,6 +1459,16 @@ static void tell_npc (object_t * ob, const char *str) {
  * and is the current_object in which case it is written via add_message().
  */
 void tell_object (object_t * ob, const char *str) {
+  tell_object_shared (ob, str, NULL);
+}
+
+/**
+ * @brief tell_object() for one recipient of a broadcast.
+ *
+ * Interactive recipients share the output segment in @p seg (see
+ * add_shared_message()); catch_tell() still receives the string.
+ */
+static void tell_object_shared (object_t * ob, const char *str, output_segment_t ** seg) {
   if (!ob || (ob->flags & O_DESTRUCTED))
     {
       opt_warn (2, "*%s", str);
@@ -1436,7 +1485,7 @@ void tell_object (object_t * ob, const char *str) {
   /* if this is on, EVERYTHING goes through catch_tell() */
 #ifndef INTERACTIVE_CATCH_TELL
   if (ob->interactive)
-    add_message (ob, str);
+    add_shared_message (ob, str, seg);
   else
 #endif
     tell_npc (ob, str);
@@ -1449,6 +1498,7 @@ void tell_object (object_t * ob, const char *str) {
  */
 void tell_room (object_t * room, svalue_t * v, array_t * avoid) {
   object_t *ob;
+  output_segment_t *seg = NULL;
   const char *buff;
   size_t num_targets = 0;
   char txt_buf[LARGEST_PRINTABLE_STRING];
@@ -1512,13 +1562,14 @@ void tell_room (object_t * room, svalue_t * v, array_t * avoid) {
   while (num_targets-- > 0)
     {
       if (sp->type == T_OBJECT)
-        tell_object (sp->u.ob, buff);
+        tell_object_shared (sp->u.ob, buff, &seg);
       pop_stack();
     }
 }
 #endif /* F_TELL_ROOM */
 
 void shout_string (const char *str) {
+  output_segment_t *seg = NULL;
   object_t *ob;
 
   check_legal_string (str);
@@ -1527,7 +1578,7 @@ void shout_string (const char *str) {
     {
       if (!(ob->flags & O_LISTENER) || (ob == command_giver) || !ob->super)
         continue;
-      tell_object (ob, str);
+      tell_object_shared (ob, str, &seg);
     }
 }
 
@@ -1846,7 +1897,7 @@ object_t *find_object_by_name (const char *str) {
  *    properly to avoid crashes or inconsistent states.
  */
 void move_object (object_t * item, object_t * dest) {
-  object_t **pp, *ob;
+  object_t *ob;
   object_t *next_ob;
   object_t *save_cmd = command_giver;
 
@@ -1866,40 +1917,23 @@ void move_object (object_t * item, object_t * dest) {
   if (item->super)
     {
       if (item->flags & O_ENABLE_COMMANDS)
-        remove_sent (item->super, item);
+        remove_env_sent (item);
 
       if (item->super->flags & O_ENABLE_COMMANDS)
         remove_sent (item, item->super);
 
-      for (pp = &item->super->contains; *pp;)
-        {
-          if (*pp != item)
-            {
-              if ((*pp)->flags & O_ENABLE_COMMANDS)
-                remove_sent (item, *pp);
-              if (item->flags & O_ENABLE_COMMANDS)
-                remove_sent (*pp, item);
-              pp = &(*pp)->next_inv;
-              continue;
-            }
+      remove_sent_from_env (item);
 
-          /* unlink object from original inventory list */
-          *pp = item->next_inv;
-        }
+      /* unlink object from original inventory list */
+      unlink_inventory (item);
     }
 
   /* link object into target's inventory list */
   item->super = dest;
   if (dest)
-    {
-      item->next_inv = dest->contains;
-      dest->contains = item;
-    }
+    link_inventory (item, dest);
   else
-    {
-      item->next_inv = 0;
-      return;
-    }
+    return;
 
   /*
    * Setup the new commands. The order is very important, as commands in
@@ -2054,9 +2088,10 @@ void do_shutdown () {
       if (!(all_users[i]->iflags & CLOSING))
         {
           flush_message (all_users[i]); /* flush any pending output before closing */
-          (void) SOCKET_CLOSE (all_users[i]->fd);
+          close_user_socket (all_users[i]);
         }
     }
+  stop_net_workers ();
 
   /* shutdown console worker if active */
   if (g_console_worker)
@@ -2317,6 +2352,7 @@ void tear_down_simulate() {
 
 #ifdef PACKAGE_SOCKETS
   deinit_dns_system();
+  clear_socket_address_cache();
 #endif
   addr_resolver_deinit();
 
@@ -8,6 +8,7 @@
 #include "backend.h"
 #include "comm.h"
 #include "command.h"
+#include "driver_stats.h"
 #include "error_context.h"
 #include "lpc/array.h"
 #include "lpc/object.h"
@@ -435,22 +436,65 @@ void smart_log (const char *error_file, int line, const char *what, bool warning
 
 /**
  * @brief Heart beat timer callback.
- * Sets the heart_beat_flag to trigger heart beat processing.
+ * Raises the heart beat flag to trigger heart beat processing. Runs on the
+ * timer thread, so the flag is only touched through its atomic accessors.
  * Wakes up the async runtime blocking wait to run timer-related tasks.
  */
 static void heartbeat_timer_callback(void) {
   async_runtime_t *reactor = get_async_runtime();
-  heart_beat_flag = true;
+  driver_stats_mark_heart_beat_fired();
+  if (raise_heart_beat_flag())
+    driver_stats_heart_beat_overrun (1);
   if (reactor)
     async_runtime_wakeup(reactor);
 }
 
 static platform_timer_t heartbeat_timer = {0}; /* cross-platform heart beat timer */
+static int heartbeat_timer_fd = -1;   /* registered with the async runtime, or -1 */
+
+/**
+ * @brief Check whether an I/O event context belongs to the heart beat timer.
+ * @param context The context pointer of an I/O event.
+ * @return Non-zero if the event is a heart beat timer expiration.
+ */
+extern "C"
+int is_heart_beat_timer (void *context) {
+  return heartbeat_timer_fd != -1 && context == &heartbeat_timer;
+}
+
+/**
+ * @brief Handle the heart beat timer descriptor becoming readable.
+ *
+ * Runs on the main thread from process_io(). When the driver loop fell
+ * behind by more than one interval, the extra expirations are counted as
+ * overruns and the lag is measured from the oldest missed expiration.
+ */
+extern "C"
+void handle_heart_beat_timer (void) {
+  unsigned long late_us = 0;
+  unsigned long long ticks;
+
+  ticks = platform_timer_read (&heartbeat_timer, &late_us);
+  if (ticks == 0)
+    return;
+
+#ifdef HEARTBEAT_INTERVAL
+  driver_stats_mark_heart_beat_fired_at (driver_stats_now () - (int64_t) late_us
+                                         - (int64_t) (ticks - 1) * HEARTBEAT_INTERVAL);
+#endif
+  if (raise_heart_beat_flag ())
+    ticks++;    /* the previous expiration has not been serviced either */
+  if (ticks > 1)
+    driver_stats_heart_beat_overrun (ticks - 1);
+}
 
 /**
  * @brief Start the heart beat timer if enabled in the configuration.
  *
- * The timer will trigger the heartbeat_timer_callback at the configured interval.
+ * Where the platform supports timer descriptors, the timer is registered with the
+ * async runtime as an ordinary event source and serviced by handle_heart_beat_timer()
+ * on the main thread. Otherwise a timer thread calls heartbeat_timer_callback at the
+ * configured interval.
  * The HEARTBEAT_INTERVAL defines the "tick" duration for heart beats, which is the minimum
  * time resolution for all other timers in the MUD.
  *
@@ -471,6 +515,20 @@ void start_timers (unsigned int timer_flags) {
         }
       else
         {
+          async_runtime_t *reactor = get_async_runtime();
+          int fd = -1;
+
+          if (reactor && platform_timer_start_fd(&heartbeat_timer, HEARTBEAT_INTERVAL, &fd) == TIMER_OK)
+            {
+              if (async_runtime_add (reactor, fd, EVENT_READ, &heartbeat_timer) == 0)
+                {
+                  heartbeat_timer_fd = fd;
+                  LOG_NOTICE ("{}\ttimer started on fd %d (0x%x)\n", fd, timer_flags);
+                  return;
+                }
+              platform_timer_stop(&heartbeat_timer);
+            }
+
           timer_err = platform_timer_start(&heartbeat_timer, HEARTBEAT_INTERVAL, heartbeat_timer_callback);
           if (timer_err != TIMER_OK)
             {
@@ -546,8 +604,8 @@ static void driver_loop(void) {
       try
         {
           bool has_pending_commands = false;
-          int connected_users = 0;
           int nb;
+          int64_t t_start, t_mark, t_now, t_busy;
 
           current_interactive = 0;
           eval_cost = CONFIG_INT(__MAX_EVAL_COST__);
@@ -558,7 +616,11 @@ static void driver_loop(void) {
               return;
             }
 
+          t_start = t_mark = driver_stats_now();
           remove_destructed_objects();
+          t_now = driver_stats_now();
+          driver_stats_record (DS_REMOVE_DESTRUCTED, t_now - t_mark);
+          t_mark = t_now;
 
           if (slow_shutdown_to_do)
             {
@@ -567,46 +629,73 @@ static void driver_loop(void) {
               initiate_slow_shutdown (tmp);
             }
 
-          /* grant command turn to all users; detect pending commands */
-          for (int i = 0; i < max_users; i++)
-            {
-              if (all_users[i])
-                {
-                  all_users[i]->iflags |= HAS_CMD_TURN;
-                  connected_users++;
-
-                  if (cmd_in_buf (all_users[i]))
-                    {
-                      all_users[i]->iflags |= CMD_IN_BUF;
-                      has_pending_commands = true;
-                    }
-                  else
-                    {
-                      all_users[i]->iflags &= ~CMD_IN_BUF;
-                    }
-                }
-            }
+          /* pending commands are tracked by the command-ready list as input arrives */
+          has_pending_commands = (num_cmd_ready_users > 0);
+          t_now = driver_stats_now();
+          t_busy = t_now - t_start;
+          t_mark = t_now;
 
           /* poll for events from asynchronous runtime */
-          nb = do_comm_polling ((heart_beat_flag || has_pending_commands) ? NULL : &timeout);
+          nb = do_comm_polling ((query_heart_beat_flag() || has_pending_commands || num_dirty_users > 0
+                                 || num_pending_connections > 0) ? NULL : &timeout);
           if (nb == -1)
             {
               debug_perror ("backend: do_comm_polling", 0);
               fatal ("backend: do_comm_polling failed.\n");
             }
+          t_now = driver_stats_now();
+          driver_stats_record (DS_POLLING, t_now - t_mark);
+          t_start = t_mark = t_now;
 
           /* process I/O events (and opportunistic queue drains) */
           process_io();
+          process_pending_connections();
+          deliver_output_pressure();
+          t_now = driver_stats_now();
+          driver_stats_record (DS_PROCESS_IO, t_now - t_mark);
+          t_mark = t_now;
+
+          /* grant command turn and credit to all connected users; the cycle
+           * budget starts now, after the polling wait and I/O processing.
+           */
+          begin_user_command_cycle();
+          t_now = driver_stats_now();
+          driver_stats_record (DS_USER_SCAN, t_now - t_mark);
+          t_mark = t_now;
+
+          /* consume user command turns (and spare cycle budget) */
+          while (process_user_command())
+            ;
+          t_now = driver_stats_now();
+          driver_stats_record (DS_USER_COMMANDS, t_now - t_mark);
+          t_mark = t_now;
+
+          /* call heart beat if raised */
+          if (query_heart_beat_flag())
+            {
+              driver_stats_heart_beat_started();
+              call_heart_beat();
+              t_now = driver_stats_now();
+              driver_stats_record (DS_HEART_BEAT, t_now - t_mark);
+              t_mark = t_now;
+            }
 
-          /* consume user command turns */
-          for (int i = 0; process_user_command() && i < connected_users; i++);
+          /* send the output generated during this iteration, once per user */
+          if (num_dirty_users > 0)
+            {
+              flush_dirty_users();
+              t_now = driver_stats_now();
+              driver_stats_record (DS_OUTPUT_FLUSH, t_now - t_mark);
+            }
+          output_segment_drain_autorelease();
 
-          /* call heart beat if raised. (TODO: use atomic heart_beat_flag) */
-          if (heart_beat_flag)
-            call_heart_beat();
+          /* tick latency: busy time of this iteration, excluding the polling wait */
+          driver_stats_record (DS_TICK, t_busy + (t_now - t_start));
+          driver_stats_periodic_log (CONFIG_INT(__DRIVER_STATS_LOG_INTERVAL__));
         }
       catch (const neolith::driver_runtime_error &)
         {
+          abort_user_command();
           boundary.restore();
         }
     }
@@ -674,6 +763,11 @@ void stem_run () {
   driver_loop();  /* main driver loop */
 
 #ifdef HEARTBEAT_INTERVAL
+  if (heartbeat_timer_fd != -1)
+    {
+      async_runtime_remove (get_async_runtime(), heartbeat_timer_fd);
+      heartbeat_timer_fd = -1;
+    }
   platform_timer_cleanup(&heartbeat_timer);
 #endif
   do_shutdown ();
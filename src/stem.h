@@ -66,6 +66,8 @@ int init_stem(
 void preload_objects(int eflag);
 void look_for_objects_to_swap (void);
 void start_timers (unsigned int timer_flags);
+int is_heart_beat_timer (void *context);
+void handle_heart_beat_timer (void);
 #ifdef LAZY_RESETS
 void try_reset(object_t *);
 #endif
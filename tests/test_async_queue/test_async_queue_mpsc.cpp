@@ -0,0 +1,206 @@
+/**
+ * @file test_async_queue_mpsc.cpp
+ * @brief Tests for the lock-free multi-producer single-consumer queue
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include "fixtures.hpp"
+
+#include <cstring>
+#include <thread>
+#include <vector>
+
+TEST_F(AsyncQueueTest, MpscRejectsBlockingFlags) {
+    EXPECT_EQ(async_queue_create(16, 64, (async_queue_flags_t)(ASYNC_QUEUE_MPSC | ASYNC_QUEUE_DROP_OLDEST)), nullptr);
+    EXPECT_EQ(async_queue_create(16, 64, (async_queue_flags_t)(ASYNC_QUEUE_MPSC | ASYNC_QUEUE_BLOCK_WRITER)), nullptr);
+}
+
+TEST_F(AsyncQueueTest, MpscCapacityIsPowerOfTwo) {
+    queue = async_queue_create(10, 16, ASYNC_QUEUE_MPSC);
+    ASSERT_NE(queue, nullptr);
+
+    int value = 0;
+    int accepted = 0;
+    while (async_queue_enqueue(queue, &value, sizeof(value)))
+        accepted++;
+    EXPECT_EQ(accepted, 16);
+    EXPECT_TRUE(async_queue_is_full(queue));
+
+    async_queue_stats_t stats;
+    async_queue_get_stats(queue, &stats);
+    EXPECT_EQ(stats.capacity, 16u);
+    EXPECT_EQ(stats.current_size, 16u);
+    EXPECT_EQ(stats.full_count, 1u);
+}
+
+TEST_F(AsyncQueueTest, MpscInlineAndOutOfLineMessages) {
+    queue = async_queue_create(8, 1024, ASYNC_QUEUE_MPSC);
+    ASSERT_NE(queue, nullptr);
+
+    std::string small = "hello";
+    std::string large(700, 'x');
+    large[699] = 'y';
+    ASSERT_TRUE(async_queue_enqueue(queue, small.c_str(), small.size()));
+    ASSERT_TRUE(async_queue_enqueue(queue, large.c_str(), large.size()));
+
+    char buffer[1024];
+    size_t size;
+    ASSERT_TRUE(async_queue_dequeue(queue, buffer, sizeof(buffer), &size));
+    EXPECT_EQ(std::string(buffer, size), small);
+
+    /* too small a buffer leaves the message queued */
+    EXPECT_FALSE(async_queue_dequeue(queue, buffer, 100, &size));
+    ASSERT_TRUE(async_queue_dequeue(queue, buffer, sizeof(buffer), &size));
+    EXPECT_EQ(std::string(buffer, size), large);
+    EXPECT_TRUE(async_queue_is_empty(queue));
+}
+
+TEST_F(AsyncQueueTest, MpscWrapsAround) {
+    queue = async_queue_create(4, sizeof(int), ASYNC_QUEUE_MPSC);
+    ASSERT_NE(queue, nullptr);
+
+    for (int i = 0; i < 100; i++) {
+        int out = -1;
+        ASSERT_TRUE(async_queue_enqueue(queue, &i, sizeof(i)));
+        ASSERT_TRUE(async_queue_dequeue(queue, &out, sizeof(out), nullptr));
+        EXPECT_EQ(out, i);
+    }
+}
+
+TEST_F(AsyncQueueTest, MpscClearFreesPayloads) {
+    queue = async_queue_create(8, 256, ASYNC_QUEUE_MPSC);
+    ASSERT_NE(queue, nullptr);
+
+    char msg[200] = "payload";
+    for (int i = 0; i < 5; i++)
+        ASSERT_TRUE(async_queue_enqueue(queue, msg, sizeof(msg)));
+    async_queue_clear(queue);
+    EXPECT_TRUE(async_queue_is_empty(queue));
+    EXPECT_TRUE(async_queue_enqueue(queue, msg, sizeof(msg)));
+    /* the last message is released by async_queue_destroy() */
+}
+
+TEST_F(AsyncQueueTest, DequeueBatch) {
+    for (int mpsc = 0; mpsc < 2; mpsc++) {
+        queue = async_queue_create(16, sizeof(int), mpsc ? ASYNC_QUEUE_MPSC : (async_queue_flags_t)0);
+        ASSERT_NE(queue, nullptr);
+
+        for (int i = 0; i < 10; i++)
+            ASSERT_TRUE(async_queue_enqueue(queue, &i, sizeof(i)));
+
+        int values[4];
+        size_t sizes[4];
+        EXPECT_EQ(async_queue_dequeue_batch(queue, values, sizeof(int), 4, sizes), 4u);
+        for (int i = 0; i < 4; i++) {
+            EXPECT_EQ(values[i], i);
+            EXPECT_EQ(sizes[i], sizeof(int));
+        }
+        EXPECT_EQ(async_queue_dequeue_batch(queue, values, sizeof(int), 4, sizes), 4u);
+        EXPECT_EQ(values[0], 4);
+        EXPECT_EQ(async_queue_dequeue_batch(queue, values, sizeof(int), 4, sizes), 2u);
+        EXPECT_EQ(values[1], 9);
+        EXPECT_EQ(async_queue_dequeue_batch(queue, values, sizeof(int), 4, sizes), 0u);
+
+        async_queue_stats_t stats;
+        async_queue_get_stats(queue, &stats);
+        EXPECT_EQ(stats.enqueue_count, 10u);
+        EXPECT_EQ(stats.dequeue_count, 10u);
+
+        async_queue_destroy(queue);
+        queue = nullptr;
+    }
+}
+
+TEST_F(AsyncQueueTest, BatchCursorHandsOutMessagesInOrder) {
+    queue = async_queue_create(16, sizeof(int), ASYNC_QUEUE_MPSC);
+    ASSERT_NE(queue, nullptr);
+
+    int items[4];
+    size_t sizes[4];
+    async_queue_batch_t batch = ASYNC_QUEUE_BATCH_INIT(items, sizes, 4);
+    void* msg;
+    size_t size;
+
+    for (int i = 0; i < 6; i++)
+        ASSERT_TRUE(async_queue_enqueue(queue, &i, sizeof(i)));
+    for (int i = 0; i < 3; i++) {
+        ASSERT_TRUE(async_queue_batch_next(queue, &batch, &msg, &size));
+        EXPECT_EQ(*(int*)msg, i);
+        EXPECT_EQ(size, sizeof(int));
+    }
+    /* the fourth message was dequeued with the first batch */
+    EXPECT_EQ(batch.count - batch.next, 1u);
+
+    /* messages queued later come after those already in the cursor */
+    for (int i = 6; i < 8; i++)
+        ASSERT_TRUE(async_queue_enqueue(queue, &i, sizeof(i)));
+    for (int i = 3; i < 8; i++) {
+        ASSERT_TRUE(async_queue_batch_next(queue, &batch, &msg, nullptr));
+        EXPECT_EQ(*(int*)msg, i);
+    }
+    EXPECT_FALSE(async_queue_batch_next(queue, &batch, &msg, nullptr));
+
+    int last = 8;
+    ASSERT_TRUE(async_queue_enqueue(queue, &last, sizeof(last)));
+    ASSERT_TRUE(async_queue_enqueue(queue, &last, sizeof(last)));
+    ASSERT_TRUE(async_queue_batch_next(queue, &batch, &msg, nullptr));
+    async_queue_batch_reset(&batch);
+    EXPECT_FALSE(async_queue_batch_next(queue, &batch, &msg, nullptr));
+}
+
+TEST_F(AsyncQueueTest, MpscStressManyProducers) {
+    queue = async_queue_create(64, 128, ASYNC_QUEUE_MPSC);
+    ASSERT_NE(queue, nullptr);
+
+    const int NUM_PRODUCERS = 8;
+    const int MESSAGES_PER_PRODUCER = 20000;
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < NUM_PRODUCERS; p++) {
+        producers.emplace_back([this, p]() {
+            for (int i = 0; i < MESSAGES_PER_PRODUCER; i++) {
+                /* every other message is stored out of line */
+                char msg[128] = {};
+                int header[2] = { p, i };
+                size_t len = (i & 1) ? sizeof(msg) : sizeof(header);
+                memcpy(msg, header, sizeof(header));
+                while (!async_queue_enqueue(queue, msg, len))
+                    std::this_thread::yield();
+            }
+        });
+    }
+
+    /* each producer's messages arrive complete and in order */
+    std::vector<int> next(NUM_PRODUCERS, 0);
+    int received = 0;
+    while (received < NUM_PRODUCERS * MESSAGES_PER_PRODUCER) {
+        char msgs[8][128];
+        size_t sizes[8];
+        size_t n = async_queue_dequeue_batch(queue, msgs, sizeof(msgs[0]), 8, sizes);
+        if (n == 0) {
+            std::this_thread::yield();
+            continue;
+        }
+        for (size_t k = 0; k < n; k++) {
+            int header[2];
+            memcpy(header, msgs[k], sizeof(header));
+            ASSERT_GE(header[0], 0);
+            ASSERT_LT(header[0], NUM_PRODUCERS);
+            ASSERT_EQ(header[1], next[header[0]]);
+            ASSERT_EQ(sizes[k], (header[1] & 1) ? 128u : sizeof(header));
+            next[header[0]]++;
+            received++;
+        }
+    }
+    for (auto& t : producers)
+        t.join();
+
+    EXPECT_TRUE(async_queue_is_empty(queue));
+    async_queue_stats_t stats;
+    async_queue_get_stats(queue, &stats);
+    EXPECT_EQ(stats.enqueue_count, (uint64_t)(NUM_PRODUCERS * MESSAGES_PER_PRODUCER));
+    EXPECT_EQ(stats.dequeue_count, stats.enqueue_count);
+    EXPECT_GE(stats.latency_max_usec * stats.dequeue_count, stats.latency_total_usec);
+}
@@ -0,0 +1,130 @@
+/**
+ * @file test_async_pool.cpp
+ * @brief Worker pool tests
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include "src/std.h"
+#include "async/async_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+
+#define TEST_POOL_KEY 0x504F4F4C
+
+class AsyncPoolTest : public ::testing::Test {
+protected:
+    async_runtime_t* runtime = nullptr;
+
+    void SetUp() override {
+        runtime = async_runtime_init();
+        ASSERT_NE(runtime, nullptr);
+    }
+
+    void TearDown() override {
+        async_runtime_deinit(runtime);
+    }
+
+    /* wait for completions and collect finished jobs until count are done */
+    std::vector<void*> Collect(async_pool_t* pool, size_t count) {
+        std::vector<void*> done;
+        for (int rounds = 0; done.size() < count && rounds < 500; rounds++) {
+            io_event_t events[16];
+            struct timeval tv = {0, 10000};
+            void* arg;
+            async_runtime_wait(runtime, events, 16, &tv);
+            while (async_pool_next_done(pool, &arg))
+                done.push_back(arg);
+        }
+        return done;
+    }
+};
+
+struct ordered_job {
+    int key;
+    int seq;
+    std::thread::id ran_on;
+};
+
+static std::mutex order_mutex;
+static std::vector<std::pair<int, int>> run_order;
+
+static void record_job(void* arg) {
+    ordered_job* job = (ordered_job*)arg;
+    job->ran_on = std::this_thread::get_id();
+    std::lock_guard<std::mutex> lock(order_mutex);
+    run_order.push_back({job->key, job->seq});
+}
+
+TEST_F(AsyncPoolTest, RunsJobsAndHandsBackArguments) {
+    async_pool_t* pool = async_pool_create(3, 64, runtime, TEST_POOL_KEY);
+    ASSERT_NE(pool, nullptr);
+    EXPECT_EQ(async_pool_size(pool), 3);
+
+    run_order.clear();
+    std::vector<ordered_job> jobs(30);
+    for (int i = 0; i < 30; i++) {
+        jobs[i].key = i % 4;
+        jobs[i].seq = i;
+        ASSERT_TRUE(async_pool_submit(pool, jobs[i].key, record_job, &jobs[i]));
+    }
+    EXPECT_EQ(async_pool_pending(pool), 30u);
+
+    std::vector<void*> done = Collect(pool, 30);
+    ASSERT_EQ(done.size(), 30u);
+    EXPECT_EQ(async_pool_pending(pool), 0u);
+    for (auto& job : jobs)
+        EXPECT_NE(std::find(done.begin(), done.end(), &job), done.end());
+
+    // Jobs with the same key ran in submission order on one thread
+    for (int key = 0; key < 4; key++) {
+        int last = -1;
+        for (auto& entry : run_order) {
+            if (entry.first != key)
+                continue;
+            EXPECT_GT(entry.second, last);
+            last = entry.second;
+            EXPECT_EQ(jobs[entry.second].ran_on, jobs[key].ran_on);
+        }
+    }
+
+    async_pool_destroy(pool);
+}
+
+static std::atomic<bool> release_blocker;
+
+static void blocking_job(void*) {
+    while (!release_blocker.load())
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
+
+TEST_F(AsyncPoolTest, SubmitFailsWhenWorkerQueueIsFull) {
+    async_pool_t* pool = async_pool_create(1, 2, runtime, TEST_POOL_KEY);
+    ASSERT_NE(pool, nullptr);
+
+    release_blocker = false;
+    int args[4];
+    ASSERT_TRUE(async_pool_submit(pool, 0, blocking_job, &args[0]));
+    // Wait until the worker has taken the first job off its queue
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_TRUE(async_pool_submit(pool, 0, blocking_job, &args[1]));
+    EXPECT_TRUE(async_pool_submit(pool, 0, blocking_job, &args[2]));
+    EXPECT_FALSE(async_pool_submit(pool, 0, blocking_job, &args[3]));
+
+    release_blocker = true;
+    EXPECT_EQ(Collect(pool, 3).size(), 3u);
+    async_pool_destroy(pool);
+}
+
+TEST_F(AsyncPoolTest, CreateRejectsInvalidArguments) {
+    EXPECT_EQ(async_pool_create(0, 8, runtime, TEST_POOL_KEY), nullptr);
+    EXPECT_EQ(async_pool_create(1, 0, runtime, TEST_POOL_KEY), nullptr);
+    EXPECT_EQ(async_pool_create(1, 8, nullptr, TEST_POOL_KEY), nullptr);
+}
@@ -0,0 +1,174 @@
+/**
+ * @file test_accept_connections.cpp
+ * @brief Tests for the batched accept loop and the per-cycle connection budget
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include "std.h"
+#include "rc/rc.h"
+#include "src/backend.h"
+#include "src/comm.h"
+#include "lpc/compiler.h"
+#include "lpc/object.h"
+
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <vector>
+
+#ifndef _WIN32
+#include <netinet/in.h>
+#endif
+
+using namespace testing;
+
+/* defined in comm.c, which keeps port_def_t out of comm.h */
+extern "C" int accept_connections(port_def_t *);
+
+namespace {
+
+class AcceptConnectionsTest : public Test {
+private:
+  std::filesystem::path previous_cwd;
+
+protected:
+  port_def_t port = {};
+  std::vector<socket_fd_t> clients;
+  async_runtime_t *saved_runtime = nullptr;
+  int saved_budget = 0;
+
+  void SetUp() override {
+    namespace fs = std::filesystem;
+    previous_cwd = fs::current_path();
+    setlocale(LC_ALL, PLATFORM_UTF8_LOCALE);
+    debug_set_log_with_date(false);
+
+    fs::path config_dir = fs::current_path();
+    if (!fs::exists(config_dir / "m3.conf"))
+      fs::current_path(config_dir.parent_path());
+
+    init_stem(3, (unsigned long)-1, "m3.conf");
+    MAIN_OPTION(pedantic) = true;
+    MAIN_OPTION(trace_flags) = 0;
+
+    init_config(MAIN_OPTION(config_file));
+    init_strings(8192, 1000000);
+    init_lpc_compiler(CONFIG_INT(__MAX_LOCAL_VARIABLES__), CONFIG_STR(__INCLUDE_DIRS__));
+    setup_simulate();
+
+    init_master("/master.c", NULL);
+    ASSERT_NE(master_ob, nullptr);
+
+    saved_runtime = g_runtime;
+    g_runtime = async_runtime_init();
+    ASSERT_NE(g_runtime, nullptr);
+    saved_budget = CONFIG_INT(__CONNECTIONS_PER_CYCLE__);
+
+    /* a listening port the mudlib sees as an ascii port */
+    struct sockaddr_in addr = {};
+    socklen_t len = sizeof(addr);
+    port.kind = PORT_ASCII;
+    port.fd = socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_NE(port.fd, INVALID_SOCKET_FD);
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ASSERT_EQ(bind(port.fd, (struct sockaddr *)&addr, sizeof(addr)), 0);
+    ASSERT_EQ(listen(port.fd, SOMAXCONN), 0);
+    ASSERT_EQ(getsockname(port.fd, (struct sockaddr *)&addr, &len), 0);
+    ASSERT_NE(set_socket_nonblocking(port.fd, 1), -1);
+    port.port = ntohs(addr.sin_port);
+  }
+
+  void TearDown() override {
+    for (int i = 1; i < max_users; i++)
+      if (all_users[i] && all_users[i]->ob)
+        {
+          object_t *ob = all_users[i]->ob;
+          remove_interactive(ob, false);
+          if (ob != master_ob && !(ob->flags & O_DESTRUCTED))
+            destruct_object(ob);
+        }
+    discard_pending_connections();
+    for (socket_fd_t fd : clients)
+      SOCKET_CLOSE(fd);
+    if (port.fd != INVALID_SOCKET_FD)
+      SOCKET_CLOSE(port.fd);
+    async_runtime_deinit(g_runtime);
+    g_runtime = saved_runtime;
+    CONFIG_INT(__CONNECTIONS_PER_CYCLE__) = saved_budget;
+
+    if (master_ob && !(master_ob->flags & O_DESTRUCTED))
+      destruct_object(master_ob);
+    tear_down_simulate();
+    deinit_lpc_compiler();
+    deinit_strings();
+    deinit_config();
+
+    namespace fs = std::filesystem;
+    fs::current_path(previous_cwd);
+  }
+
+  void connect_clients(int n) {
+    struct sockaddr_in addr = {};
+
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port.port);
+    for (int i = 0; i < n; i++)
+      {
+        socket_fd_t fd = socket(AF_INET, SOCK_STREAM, 0);
+        ASSERT_NE(fd, INVALID_SOCKET_FD);
+        ASSERT_EQ(connect(fd, (struct sockaddr *)&addr, sizeof(addr)), 0);
+        clients.push_back(fd);
+      }
+  }
+};
+
+TEST_F(AcceptConnectionsTest, BurstIsAcceptedInOneCall) {
+  connect_clients(5);
+
+  EXPECT_EQ(accept_connections(&port), 5);
+  EXPECT_EQ(num_pending_connections, 5);
+  /* nothing left on the listening socket */
+  EXPECT_EQ(accept_connections(&port), 0);
+}
+
+TEST_F(AcceptConnectionsTest, AcceptStopsAtPerEventLimit) {
+  connect_clients(MAX_ACCEPTS_PER_EVENT + 3);
+
+  EXPECT_EQ(accept_connections(&port), MAX_ACCEPTS_PER_EVENT);
+  EXPECT_EQ(accept_connections(&port), 3);
+  EXPECT_EQ(num_pending_connections, MAX_ACCEPTS_PER_EVENT + 3);
+}
+
+TEST_F(AcceptConnectionsTest, LogonsAreSpreadOverCycles) {
+  int users = num_user;
+
+  CONFIG_INT(__CONNECTIONS_PER_CYCLE__) = 2;
+  connect_clients(5);
+  ASSERT_EQ(accept_connections(&port), 5);
+
+  EXPECT_EQ(process_pending_connections(), 2);
+  EXPECT_EQ(num_user, users + 2);
+  EXPECT_EQ(num_pending_connections, 3);
+  EXPECT_EQ(process_pending_connections(), 2);
+  EXPECT_EQ(process_pending_connections(), 1);
+  EXPECT_EQ(process_pending_connections(), 0);
+  EXPECT_EQ(num_user, users + 5);
+}
+
+TEST_F(AcceptConnectionsTest, ZeroBudgetConnectsEveryone) {
+  int users = num_user;
+
+  CONFIG_INT(__CONNECTIONS_PER_CYCLE__) = 0;
+  connect_clients(4);
+  ASSERT_EQ(accept_connections(&port), 4);
+
+  EXPECT_EQ(process_pending_connections(), 4);
+  EXPECT_EQ(num_user, users + 4);
+  EXPECT_EQ(num_pending_connections, 0);
+}
+
+} // namespace
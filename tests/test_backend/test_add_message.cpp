@@ -0,0 +1,340 @@
+/**
+ * @file test_add_message.cpp
+ * @brief Tests for the output chain filled by add_message()
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include "std.h"
+#include "src/main.h"
+#include "rc/rc.h"
+#include "src/comm.h"
+#include "lpc/object.h"
+
+#include <gtest/gtest.h>
+#include <string>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+using namespace testing;
+
+namespace {
+
+/* A network user whose output is never flushed unless a test asks for it. */
+class AddMessageTest : public Test {
+protected:
+  interactive_t console = {};
+  interactive_t ip = {};
+  interactive_t *user_slots[2] = { &console, &ip };
+  interactive_t **saved_all_users = nullptr;
+  int saved_max_users = 0;
+  object_t ob = {};
+  char name[5] = "user";
+  int saved_config[3] = {};
+
+  void SetUp() override {
+    saved_all_users = all_users;
+    saved_max_users = max_users;
+    all_users = user_slots;
+    max_users = 2;
+    saved_config[0] = CONFIG_INT(__OUTPUT_HIGH_WATER__);
+    saved_config[1] = CONFIG_INT(__OUTPUT_LOW_WATER__);
+    saved_config[2] = CONFIG_INT(__OUTPUT_BUFFER_LIMIT__);
+    CONFIG_INT(__OUTPUT_HIGH_WATER__) = 0;
+    CONFIG_INT(__OUTPUT_LOW_WATER__) = 0;
+    CONFIG_INT(__OUTPUT_BUFFER_LIMIT__) = 0;
+    ip.fd = -1;
+    ip.dirty_index = -1;
+    ip.ob = &ob;
+    ob.name = name;
+    ob.interactive = &ip;
+  }
+
+  void TearDown() override {
+    output_chain_clear(&ip.output);
+    num_dirty_users = 0;
+    all_users = saved_all_users;
+    max_users = saved_max_users;
+    CONFIG_INT(__OUTPUT_HIGH_WATER__) = saved_config[0];
+    CONFIG_INT(__OUTPUT_LOW_WATER__) = saved_config[1];
+    CONFIG_INT(__OUTPUT_BUFFER_LIMIT__) = saved_config[2];
+  }
+
+  std::string pending() {
+    socket_iovec_t iov[64];
+    std::string out;
+    int n = output_chain_iov(&ip.output, iov, 64);
+
+    for (int i = 0; i < n; i++)
+      out.append(SOCKET_IOV_BASE(iov[i]), SOCKET_IOV_LEN(iov[i]));
+    EXPECT_EQ(out.size(), ip.output.length);
+    return out;
+  }
+};
+
+TEST_F(AddMessageTest, TranslatesNewlines) {
+  add_message(&ob, "hello\nworld\n\nbye");
+  EXPECT_EQ(pending(), "hello\r\nworld\r\n\r\nbye");
+}
+
+TEST_F(AddMessageTest, KeepsOutputBeyondOneBlock) {
+  std::string line(OUTPUT_BLOCK_SIZE - 1, 'x');
+  std::string expected;
+
+  /* the CR LF of each line straddles a block boundary */
+  line += "\n";
+  for (int i = 0; i < 10; i++)
+    {
+      add_message(&ob, line.c_str());
+      expected += line.substr(0, line.size() - 1) + "\r\n";
+    }
+  EXPECT_EQ(pending(), expected);
+  EXPECT_EQ(ip.output_dropped, 0u);
+}
+
+TEST_F(AddMessageTest, ListsDirtyConnectionOnce) {
+  add_message(&ob, "one\n");
+  add_message(&ob, "two\n");
+  EXPECT_EQ(num_dirty_users, 1);
+  EXPECT_EQ(dirty_users[0], &ip);
+  EXPECT_FALSE(ip.iflags & WRITE_ARMED);
+  EXPECT_EQ(pending(), "one\r\ntwo\r\n");
+}
+
+TEST_F(AddMessageTest, DirtyFlushSendsOnceAndArmsOnShortSend) {
+  socket_fd_t fds[2];
+  char buf[64];
+
+  ASSERT_EQ(create_test_socket_pair(fds), 0);
+  ASSERT_NE(set_socket_nonblocking(fds[0], 1), -1);
+  ip.fd = fds[0];
+
+  add_message(&ob, "one\n");
+  add_message(&ob, "two\n");
+  flush_dirty_users();
+  EXPECT_EQ(num_dirty_users, 0);
+  EXPECT_EQ(ip.dirty_index, -1);
+  EXPECT_EQ(ip.output.length, 0u);
+  EXPECT_FALSE(ip.iflags & WRITE_ARMED);
+  EXPECT_EQ(SOCKET_RECV(fds[1], buf, sizeof(buf), 0), 10);
+
+  /* more than the socket can take: the rest waits for EVENT_WRITE */
+  std::string big(8 * 1024 * 1024, 'x');
+  add_message(&ob, big.c_str());
+  flush_dirty_users();
+  EXPECT_GT(ip.output.length, 0u);
+  EXPECT_TRUE(ip.iflags & WRITE_ARMED);
+
+  /* an armed connection is left to its write event */
+  size_t left = ip.output.length;
+  add_message(&ob, "more");
+  flush_dirty_users();
+  EXPECT_EQ(ip.output.length, left + 4);
+
+  SOCKET_CLOSE(fds[0]);
+  SOCKET_CLOSE(fds[1]);
+}
+
+TEST_F(AddMessageTest, SharedMessageIsTranslatedOnce) {
+  interactive_t ip2 = {};
+  object_t ob2 = {};
+  output_segment_t *seg = nullptr;
+  output_pool_stats_t before, after;
+
+  ip2.fd = -1;
+  ip2.dirty_index = -1;
+  ip2.ob = &ob2;
+  ob2.name = name;
+  ob2.interactive = &ip2;
+
+  output_pool_get_stats(&before);
+  add_shared_message(&ob, "hi\nall\n", &seg);
+  add_shared_message(&ob2, "hi\nall\n", &seg);
+  output_pool_get_stats(&after);
+
+  ASSERT_NE(seg, nullptr);
+  EXPECT_EQ(seg->ref, 3);
+  EXPECT_EQ(after.segments - before.segments, 1u);
+  EXPECT_EQ(after.segment_refs - before.segment_refs, 2u);
+  EXPECT_EQ(pending(), "hi\r\nall\r\n");
+  EXPECT_EQ(ip2.output.length, 9u);
+
+  /* the broadcast reference goes away at the end of the iteration */
+  output_segment_drain_autorelease();
+  EXPECT_EQ(seg->ref, 2);
+  output_chain_clear(&ip2.output);
+  EXPECT_EQ(seg->ref, 1);
+}
+
+TEST_F(AddMessageTest, DeadConnectionIsIgnored) {
+  ip.iflags = NET_DEAD;
+  add_message(&ob, "lost\n");
+  EXPECT_EQ(ip.output.length, 0u);
+  EXPECT_FALSE(ip.iflags & WRITE_ARMED);
+}
+
+TEST_F(AddMessageTest, BufferLimitDropsAndCountsWholeMessages) {
+  output_pool_stats_t before, after;
+
+  CONFIG_INT(__OUTPUT_BUFFER_LIMIT__) = 10;
+  output_pool_get_stats(&before);
+  add_message(&ob, "12345678");
+  add_message(&ob, "abcd");
+  add_message(&ob, "90");
+  output_pool_get_stats(&after);
+
+  EXPECT_EQ(pending(), "1234567890");
+  EXPECT_EQ(ip.output_dropped, 4u);
+  EXPECT_EQ(after.bytes_dropped - before.bytes_dropped, 4u);
+}
+
+TEST_F(AddMessageTest, WaterMarksTrackBlockedState) {
+  socket_fd_t fds[2];
+  char buf[64];
+
+  ASSERT_EQ(create_test_socket_pair(fds), 0);
+  ip.fd = fds[0];
+  CONFIG_INT(__OUTPUT_HIGH_WATER__) = 10;
+  CONFIG_INT(__OUTPUT_LOW_WATER__) = 4;
+
+  add_message(&ob, "12345");
+  EXPECT_FALSE(ip.iflags & OUTPUT_BLOCKED);
+  add_message(&ob, "67890");
+  EXPECT_TRUE(ip.iflags & OUTPUT_BLOCKED);
+  EXPECT_TRUE(ip.iflags & OUTPUT_PRESSURE_CHANGED);
+
+  /* all blocks go out in one send */
+  EXPECT_TRUE(flush_message(&ip));
+  EXPECT_EQ(ip.output.length, 0u);
+  EXPECT_FALSE(ip.iflags & OUTPUT_BLOCKED);
+  EXPECT_EQ(SOCKET_RECV(fds[1], buf, sizeof(buf), 0), 10);
+
+  /* blocked and released before the user was told: output_pressure() is skipped */
+  deliver_output_pressure();
+  EXPECT_FALSE(ip.iflags & (OUTPUT_PRESSURE_CHANGED | OUTPUT_PRESSURE_REPORTED));
+
+  SOCKET_CLOSE(fds[0]);
+  SOCKET_CLOSE(fds[1]);
+}
+
+#ifdef HAVE_ZLIB
+TEST_F(AddMessageTest, CompressionStartsAfterMarker) {
+  socket_fd_t fds[2];
+  main_options_t opts = {};
+  main_options_t *saved_opts = g_main_options;
+  object_t zob = {};
+  interactive_t *zip;
+  std::string text, wire;
+  char buf[4096];
+  long n;
+
+  g_main_options = &opts;  /* start_output_compression() traces */
+  zob.name = name;
+  zip = create_test_interactive(&zob);
+  ASSERT_NE(zip, nullptr);
+  user_slots[0] = &console;  /* not the console user */
+  ASSERT_EQ(create_test_socket_pair(fds), 0);
+  ASSERT_NE(set_socket_nonblocking(fds[1], 1), -1);
+  zip->fd = fds[0];
+
+  add_message(&zob, "plain\n");
+  ASSERT_EQ(start_output_compression(zip, 6), 1);
+  EXPECT_EQ(start_output_compression(zip, 6), 0);
+  for (int i = 0; i < 200; i++)
+    text += "A long corridor stretches north and south.\n";
+  add_message(&zob, text.c_str());
+  EXPECT_TRUE(flush_message(zip));
+  while ((n = SOCKET_RECV(fds[1], buf, sizeof(buf), 0)) > 0)
+    wire.append(buf, n);
+
+  const std::string marker = "plain\r\n\xff\xfa\x56\xff\xf0";
+  ASSERT_GT(wire.size(), marker.size());
+  EXPECT_EQ(wire.substr(0, marker.size()), marker);
+
+  std::string expected, inflated(2 * text.size() + 64, '\0');
+  for (char c : text)
+    expected += (c == '\n') ? std::string("\r\n") : std::string(1, c);
+  z_stream zs = {};
+  ASSERT_EQ(inflateInit(&zs), Z_OK);
+  zs.next_in = (Bytef *)wire.data() + marker.size();
+  zs.avail_in = (uInt)(wire.size() - marker.size());
+  zs.next_out = (Bytef *)inflated.data();
+  zs.avail_out = (uInt)inflated.size();
+  EXPECT_EQ(inflate(&zs, Z_SYNC_FLUSH), Z_OK);
+  inflated.resize(zs.total_out);
+  inflateEnd(&zs);
+  EXPECT_EQ(inflated, expected);
+  EXPECT_LT(wire.size() - marker.size(), expected.size() / 4);
+
+  outbuffer_t out;
+  outbuf_zero(&out);
+  dump_user_status(&out);
+  ASSERT_NE(out.buffer, nullptr);
+  EXPECT_NE(std::string(out.buffer).find(" on "), std::string::npos);
+  FREE_MSTR(out.buffer);
+
+  remove_test_interactive(zip);
+  SOCKET_CLOSE(fds[0]);
+  SOCKET_CLOSE(fds[1]);
+  g_main_options = saved_opts;
+}
+
+TEST_F(AddMessageTest, DontCompress2FinishesStream) {
+  socket_fd_t fds[2];
+  main_options_t opts = {};
+  main_options_t *saved_opts = g_main_options;
+  object_t zob = {};
+  interactive_t *zip;
+  std::string wire;
+  char buf[4096];
+  long n;
+
+  g_main_options = &opts;
+  zob.name = name;
+  zip = create_test_interactive(&zob);
+  ASSERT_NE(zip, nullptr);
+  user_slots[0] = &console;
+  zip->connection_type = PORT_TELNET;
+  ASSERT_EQ(create_test_socket_pair(fds), 0);
+  ASSERT_NE(set_socket_nonblocking(fds[1], 1), -1);
+  zip->fd = fds[0];
+
+  ASSERT_EQ(start_output_compression(zip, 6), 1);
+  add_message(&zob, "compressed\n");
+  /* IAC DONT COMPRESS2 from the client */
+  receive_telnet_input(zip, "\xff\xfe\x56", 3);
+  EXPECT_EQ(zip->mccp, nullptr);
+  add_message(&zob, "plain\n");
+  EXPECT_TRUE(flush_message(zip));
+  while ((n = SOCKET_RECV(fds[1], buf, sizeof(buf), 0)) > 0)
+    wire.append(buf, n);
+
+  const std::string marker = "\xff\xfa\x56\xff\xf0";
+  ASSERT_GT(wire.size(), marker.size());
+  EXPECT_EQ(wire.substr(0, marker.size()), marker);
+
+  /* the stream ends, and what follows it is not compressed */
+  std::string inflated(256, '\0');
+  z_stream zs = {};
+  ASSERT_EQ(inflateInit(&zs), Z_OK);
+  zs.next_in = (Bytef *)wire.data() + marker.size();
+  zs.avail_in = (uInt)(wire.size() - marker.size());
+  zs.next_out = (Bytef *)inflated.data();
+  zs.avail_out = (uInt)inflated.size();
+  EXPECT_EQ(inflate(&zs, Z_FINISH), Z_STREAM_END);
+  inflated.resize(zs.total_out);
+  EXPECT_EQ(inflated, "compressed\r\n");
+  EXPECT_EQ(wire.substr(wire.size() - zs.avail_in), "plain\r\n");
+  inflateEnd(&zs);
+
+  remove_test_interactive(zip);
+  SOCKET_CLOSE(fds[0]);
+  SOCKET_CLOSE(fds[1]);
+  g_main_options = saved_opts;
+}
+#endif /* HAVE_ZLIB */
+
+} // namespace
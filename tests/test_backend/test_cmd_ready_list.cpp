@@ -0,0 +1,98 @@
+/**
+ * @file test_cmd_ready_list.cpp
+ * @brief Tests for the command-ready list maintained by update_cmd_in_buf()
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include "std.h"
+#include "src/comm.h"
+#include "src/command.h"
+
+#include <gtest/gtest.h>
+#include <cstring>
+
+using namespace testing;
+
+namespace {
+
+void set_input(interactive_t *ip, const char *text, size_t len) {
+  ip->text_start = ip->text_end = ip->text_scan = 0;
+  ASSERT_TRUE(reserve_input_space(ip, len + 1));
+  memcpy(ip->text, text, len);
+  ip->text_end = (ptrdiff_t)len;
+  ip->text[len] = '\0';
+}
+
+}  // namespace
+
+TEST(CmdReadyListTest, CompleteCommandIsListedOnce) {
+  interactive_t a = {};
+
+  set_input(&a, "look\0", 5);
+  update_cmd_in_buf(&a);
+  update_cmd_in_buf(&a);
+
+  ASSERT_EQ(num_cmd_ready_users, 1);
+  EXPECT_EQ(cmd_ready_users[0], &a);
+  EXPECT_TRUE(a.iflags & CMD_IN_BUF);
+
+  set_input(&a, "", 0);
+  update_cmd_in_buf(&a);
+  EXPECT_EQ(num_cmd_ready_users, 0);
+  EXPECT_FALSE(a.iflags & CMD_IN_BUF);
+  free_input_buffer(&a);
+}
+
+TEST(CmdReadyListTest, PartialCommandIsNotListed) {
+  interactive_t a = {};
+
+  set_input(&a, "loo", 3);
+  update_cmd_in_buf(&a);
+  EXPECT_EQ(num_cmd_ready_users, 0);
+  EXPECT_FALSE(a.iflags & CMD_IN_BUF);
+  free_input_buffer(&a);
+}
+
+TEST(CmdReadyListTest, RemovalKeepsOtherEntriesIndexed) {
+  interactive_t a = {}, b = {}, c = {};
+
+  set_input(&a, "n\0", 2);
+  set_input(&b, "s\0", 2);
+  set_input(&c, "e\0", 2);
+  update_cmd_in_buf(&a);
+  update_cmd_in_buf(&b);
+  update_cmd_in_buf(&c);
+  ASSERT_EQ(num_cmd_ready_users, 3);
+
+  /* removing the first entry moves the last one into its slot */
+  set_input(&a, "", 0);
+  update_cmd_in_buf(&a);
+  ASSERT_EQ(num_cmd_ready_users, 2);
+  EXPECT_EQ(cmd_ready_users[0], &c);
+  EXPECT_EQ(c.cmd_ready_index, 0);
+  EXPECT_EQ(cmd_ready_users[1], &b);
+  EXPECT_EQ(b.cmd_ready_index, 1);
+
+  set_input(&b, "", 0);
+  update_cmd_in_buf(&b);
+  set_input(&c, "", 0);
+  update_cmd_in_buf(&c);
+  EXPECT_EQ(num_cmd_ready_users, 0);
+  free_input_buffer(&a);
+  free_input_buffer(&b);
+  free_input_buffer(&c);
+}
+
+TEST(CmdReadyListTest, ClosingUserIsNeverListed) {
+  interactive_t a = {};
+
+  a.iflags = CLOSING;
+  set_input(&a, "quit\0", 5);
+  update_cmd_in_buf(&a);
+  EXPECT_EQ(num_cmd_ready_users, 0);
+  EXPECT_FALSE(a.iflags & CMD_IN_BUF);
+  free_input_buffer(&a);
+}
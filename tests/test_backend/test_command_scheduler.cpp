@@ -0,0 +1,199 @@
+/**
+ * @file test_command_scheduler.cpp
+ * @brief Tests for the deficit round-robin user command scheduler
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include "std.h"
+#include "rc/rc.h"
+#include "src/apply.h"
+#include "src/comm.h"
+#include "src/command.h"
+#include "lpc/include/origin.h"
+#include "lpc/compiler.h"
+#include "lpc/object.h"
+
+#include <gtest/gtest.h>
+#include <cstring>
+#include <filesystem>
+
+using namespace testing;
+
+namespace {
+
+class CommandSchedulerTest : public Test {
+private:
+  std::filesystem::path previous_cwd;
+
+protected:
+  object_t *user = nullptr;
+  interactive_t *ip = nullptr;
+
+  void SetUp() override {
+    namespace fs = std::filesystem;
+    previous_cwd = fs::current_path();
+    setlocale(LC_ALL, PLATFORM_UTF8_LOCALE);
+    debug_set_log_with_date(false);
+
+    fs::path config_dir = fs::current_path();
+    if (!fs::exists(config_dir / "m3.conf"))
+      fs::current_path(config_dir.parent_path());
+
+    init_stem(3, (unsigned long)-1, "m3.conf");
+    MAIN_OPTION(pedantic) = true;
+    MAIN_OPTION(trace_flags) = 0;
+
+    init_config(MAIN_OPTION(config_file));
+    init_strings(8192, 1000000);
+    init_lpc_compiler(CONFIG_INT(__MAX_LOCAL_VARIABLES__), CONFIG_STR(__INCLUDE_DIRS__));
+    setup_simulate();
+
+    init_master("/master.c", NULL);
+    ASSERT_NE(master_ob, nullptr);
+
+    constexpr const char *kLpcCode = R"(
+      int calls;
+
+      void register_actions() {
+        add_action("act_cheap", "n");
+        add_action("act_heavy", "heavy");
+      }
+
+      int act_cheap(string arg) {
+        calls++;
+        return 1;
+      }
+
+      int act_heavy(string arg) {
+        int i, x;
+        for (i = 0; i < 1000; i++)
+          x += i;
+        calls++;
+        return 1;
+      }
+
+      int query_calls() { return calls; }
+    )";
+
+    current_object = master_ob;
+    user = load_object("/tests/backend/test_command_scheduler_user", kLpcCode);
+    ASSERT_NE(user, nullptr);
+
+    object_t *saved_cg = command_giver;
+    command_giver = user;
+    ASSERT_NE(APPLY_SLOT_CALL("register_actions", user, 0, ORIGIN_DRIVER), nullptr);
+    APPLY_SLOT_FINISH_CALL();
+    command_giver = saved_cg;
+    user->flags |= O_ENABLE_COMMANDS;
+
+    ip = create_test_interactive(user);
+    ASSERT_NE(ip, nullptr);
+    ip->prompt = "> ";
+  }
+
+  void TearDown() override {
+    if (ip)
+      remove_test_interactive(ip);
+    if (user && !(user->flags & O_DESTRUCTED))
+      destruct_object(user);
+    if (master_ob && !(master_ob->flags & O_DESTRUCTED))
+      destruct_object(master_ob);
+
+    tear_down_simulate();
+    deinit_lpc_compiler();
+    deinit_strings();
+    deinit_config();
+
+    namespace fs = std::filesystem;
+    fs::current_path(previous_cwd);
+  }
+
+  void queue_input(const char *text, size_t len) {
+    memcpy(ip->text, text, len);
+    ip->text_start = 0;
+    ip->text_end = (ptrdiff_t)len;
+    ip->text_scan = 0;
+    ip->text[len] = '\0';
+    update_cmd_in_buf(ip);
+  }
+
+  int run_cycle() {
+    int n = 0;
+    begin_user_command_cycle();
+    while (process_user_command())
+      n++;
+    return n;
+  }
+
+  int64_t query_calls() {
+    svalue_t *ret = APPLY_SLOT_CALL("query_calls", user, 0, ORIGIN_DRIVER);
+    EXPECT_NE(ret, nullptr);
+    int64_t calls = ret ? ret->u.number : -1;
+    APPLY_SLOT_FINISH_CALL();
+    return calls;
+  }
+};
+
+TEST_F(CommandSchedulerTest, ZeroBudgetRunsOneCommandPerCycle) {
+  CONFIG_INT(__COMMAND_CYCLE_BUDGET__) = 0;
+  queue_input("n\0n\0n\0", 6);
+
+  EXPECT_EQ(run_cycle(), 1);
+  EXPECT_EQ(query_calls(), 1);
+  EXPECT_EQ(run_cycle(), 1);
+  EXPECT_EQ(run_cycle(), 1);
+  EXPECT_EQ(run_cycle(), 0);
+  EXPECT_EQ(query_calls(), 3);
+  EXPECT_EQ(ip->cmd_count, 3);
+}
+
+TEST_F(CommandSchedulerTest, BudgetIsWorkConserving) {
+  CONFIG_INT(__COMMAND_CYCLE_BUDGET__) = 10000;
+  queue_input("n\0n\0n\0", 6);
+
+  /* a lone user is never held back while the cycle budget lasts */
+  EXPECT_EQ(run_cycle(), 3);
+  EXPECT_EQ(query_calls(), 3);
+  EXPECT_EQ(num_cmd_ready_users, 0);
+}
+
+TEST_F(CommandSchedulerTest, EvalCostIsChargedAgainstCredit) {
+  CONFIG_INT(__COMMAND_CYCLE_BUDGET__) = 0;
+  CONFIG_INT(__COMMAND_QUANTUM__) = 100;
+
+  queue_input("n\0", 2);
+  EXPECT_EQ(run_cycle(), 1);
+  int64_t cheap_credit = ip->cmd_deficit;
+  EXPECT_LT(cheap_credit, 100);
+
+  queue_input("heavy\0", 6);
+  EXPECT_EQ(run_cycle(), 1);
+  /* the loop costs far more than one quantum, leaving the user in debt */
+  EXPECT_LT(ip->cmd_deficit, 0);
+  EXPECT_LT(ip->cmd_deficit, cheap_credit);
+
+  /* idle cycles pay back the debt without accumulating credit */
+  for (int i = 0; i < 100; i++)
+    run_cycle();
+  EXPECT_EQ(ip->cmd_deficit, 0);
+}
+
+TEST_F(CommandSchedulerTest, CommandTurnIsGrantedDespiteDebt) {
+  CONFIG_INT(__COMMAND_CYCLE_BUDGET__) = 0;
+  CONFIG_INT(__COMMAND_QUANTUM__) = 100;
+
+  queue_input("heavy\0n\0", 8);
+  EXPECT_EQ(run_cycle(), 1);
+  ASSERT_LT(ip->cmd_deficit, 0);
+
+  /* the command turn is still granted every cycle */
+  EXPECT_EQ(run_cycle(), 1);
+  EXPECT_EQ(query_calls(), 2);
+  EXPECT_EQ(ip->cmd_count, 2);
+  EXPECT_GE(ip->cmd_wait_max, 0);
+}
+
+} // namespace
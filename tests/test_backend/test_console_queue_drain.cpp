@@ -76,6 +76,14 @@ TEST_F(ConsoleQueueDrainIntegrationTest, ProcessIoDrainsQueueAndMarksCommandRead
   EXPECT_TRUE(console_ip.iflags & CMD_IN_BUF);
   EXPECT_STREQ(console_ip.text, "ping");
   EXPECT_EQ(cmd_in_buf(&console_ip), 1);
+  ASSERT_EQ(num_cmd_ready_users, 1);
+  EXPECT_EQ(cmd_ready_users[0], &console_ip);
+
+  /* drop the stack interactive from the command-ready list */
+  console_ip.text_start = console_ip.text_end = 0;
+  update_cmd_in_buf(&console_ip);
+  EXPECT_EQ(num_cmd_ready_users, 0);
+  free_input_buffer(&console_ip);
 
   async_queue_destroy(g_console_queue);
   g_console_queue = saved_queue;
@@ -0,0 +1,187 @@
+/**
+ * @file test_move_object.cpp
+ * @brief Tests and benchmark for the doubly-linked inventory lists used by move_object()
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include "std.h"
+#include "rc/rc.h"
+#include "src/simulate.h"
+#include "lpc/compiler.h"
+#include "lpc/object.h"
+#include "lpc/array.h"
+
+#include <gtest/gtest.h>
+#include <chrono>
+#include <filesystem>
+#include <vector>
+
+using namespace testing;
+
+namespace {
+
+class MoveObjectTest : public Test {
+private:
+  std::filesystem::path previous_cwd;
+
+protected:
+  std::vector<object_t *> objects;
+
+  void SetUp() override {
+    namespace fs = std::filesystem;
+    previous_cwd = fs::current_path();
+    setlocale(LC_ALL, PLATFORM_UTF8_LOCALE);
+    debug_set_log_with_date(false);
+
+    fs::path config_dir = fs::current_path();
+    if (!fs::exists(config_dir / "m3.conf"))
+      fs::current_path(config_dir.parent_path());
+
+    init_stem(3, (unsigned long)-1, "m3.conf");
+    MAIN_OPTION(pedantic) = true;
+    MAIN_OPTION(trace_flags) = 0;
+
+    init_config(MAIN_OPTION(config_file));
+    init_strings(8192, 1000000);
+    init_lpc_compiler(CONFIG_INT(__MAX_LOCAL_VARIABLES__), CONFIG_STR(__INCLUDE_DIRS__));
+    setup_simulate();
+
+    init_master("/master.c", NULL);
+    ASSERT_NE(master_ob, nullptr);
+    current_object = master_ob;
+  }
+
+  void TearDown() override {
+    for (auto it = objects.rbegin(); it != objects.rend(); ++it)
+      if (!((*it)->flags & O_DESTRUCTED))
+        destruct_object(*it);
+    objects.clear();
+    if (master_ob && !(master_ob->flags & O_DESTRUCTED))
+      destruct_object(master_ob);
+
+    tear_down_simulate();
+    deinit_lpc_compiler();
+    deinit_strings();
+    deinit_config();
+
+    namespace fs = std::filesystem;
+    fs::current_path(previous_cwd);
+  }
+
+  object_t *load(const char *name) {
+    object_t *ob = load_object(name, "void create() {}");
+    EXPECT_NE(ob, nullptr);
+    if (ob)
+      objects.push_back(ob);
+    return ob;
+  }
+
+  object_t *clone(const char *name) {
+    object_t *ob = clone_object(name, 0);
+    EXPECT_NE(ob, nullptr);
+    if (ob)
+      objects.push_back(ob);
+    return ob;
+  }
+
+  static void expect_consistent(object_t *container, size_t expected) {
+    size_t n = 0;
+    object_t *prev = nullptr;
+
+    for (object_t *cur = container->contains; cur; cur = cur->next_inv)
+      {
+        EXPECT_EQ(cur->super, container);
+        EXPECT_EQ(cur->prev_inv, prev);
+        prev = cur;
+        n++;
+      }
+    EXPECT_EQ(n, expected);
+  }
+};
+
+TEST_F(MoveObjectTest, InventoryLinksStayConsistent) {
+  object_t *room1 = load("/tests/backend/test_move_object_room1");
+  object_t *room2 = load("/tests/backend/test_move_object_room2");
+  object_t *a = load("/tests/backend/test_move_object_a");
+  object_t *b = load("/tests/backend/test_move_object_b");
+  object_t *c = load("/tests/backend/test_move_object_c");
+  ASSERT_TRUE(room1 && room2 && a && b && c);
+
+  move_object(a, room1);
+  move_object(b, room1);
+  move_object(c, room1);
+  expect_consistent(room1, 3);
+  EXPECT_EQ(room1->contains, c);
+
+  /* middle, head and tail removal */
+  move_object(b, room2);
+  expect_consistent(room1, 2);
+  move_object(c, room2);
+  expect_consistent(room1, 1);
+  EXPECT_EQ(room1->contains, a);
+  move_object(a, nullptr);
+  EXPECT_EQ(room1->contains, nullptr);
+  EXPECT_EQ(a->super, nullptr);
+  EXPECT_EQ(a->prev_inv, nullptr);
+  expect_consistent(room2, 2);
+
+  array_t *inv = all_inventory(room2, 1);
+  ASSERT_EQ(inv->size, 2);
+  EXPECT_EQ(inv->item[0].u.ob, c);
+  EXPECT_EQ(inv->item[1].u.ob, b);
+  free_array(inv);
+
+  /* destruct unlinks from the environment */
+  move_object(a, room2);
+  destruct_object(c);
+  expect_consistent(room2, 2);
+  EXPECT_EQ(room2->contains, a);
+  EXPECT_EQ(a->next_inv, b);
+  EXPECT_EQ(b->prev_inv, a);
+}
+
+TEST_F(MoveObjectTest, BenchmarkMoveOutOf10kContainer) {
+  constexpr int kItems = 10000;
+  object_t *store = load("/tests/backend/test_move_object_store");
+  object_t *dest = load("/tests/backend/test_move_object_dest");
+  ASSERT_TRUE(load("/tests/backend/test_move_object_item"));
+  ASSERT_TRUE(store && dest);
+  /* the destination picks items up like a player would */
+  dest->flags |= O_ENABLE_COMMANDS;
+
+  std::vector<object_t *> items;
+  items.reserve(kItems);
+  for (int i = 0; i < kItems; i++)
+    {
+      object_t *ob = clone("/tests/backend/test_move_object_item");
+      ASSERT_NE(ob, nullptr);
+      move_object(ob, store);
+      items.push_back(ob);
+    }
+  expect_consistent(store, kItems);
+
+  /* the first items moved in are at the tail of the inventory list,
+   * which is the worst case for a singly-linked unlink scan. Each item is
+   * handed to the destination and dropped from there again, so that the
+   * destination stays small and only the removal from the store grows.
+   */
+  auto start = std::chrono::steady_clock::now();
+  for (object_t *ob : items)
+    {
+      move_object(ob, dest);
+      move_object(ob, nullptr);
+    }
+  auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - start).count();
+
+  EXPECT_EQ(store->contains, nullptr);
+  EXPECT_EQ(dest->contains, nullptr);
+  RecordProperty("move_out_of_10k_usec", (int)elapsed);
+  debug_message("[ BENCH    ] moved %d items out of a %d-item container in %lld usec (%.3f usec/move)\n",
+                kItems, kItems, (long long)elapsed, (double)elapsed / kItems);
+}
+
+} // namespace
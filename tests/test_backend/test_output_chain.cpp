@@ -0,0 +1,128 @@
+/**
+ * @file test_output_chain.cpp
+ * @brief Tests for the pooled output block chains
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include "std.h"
+#include "src/output_chain.h"
+
+#include <gtest/gtest.h>
+#include <string>
+
+using namespace testing;
+
+namespace {
+
+class OutputChainTest : public Test {
+protected:
+  output_chain_t chain;
+
+  void SetUp() override {
+    output_chain_init(&chain);
+  }
+
+  void TearDown() override {
+    output_chain_clear(&chain);
+  }
+
+  std::string contents() {
+    socket_iovec_t iov[64];
+    std::string out;
+    int n = output_chain_iov(&chain, iov, 64);
+
+    for (int i = 0; i < n; i++)
+      out.append(SOCKET_IOV_BASE(iov[i]), SOCKET_IOV_LEN(iov[i]));
+    return out;
+  }
+};
+
+TEST_F(OutputChainTest, ConsumeAcrossBlocks) {
+  std::string data;
+
+  for (size_t i = 0; i < 3 * OUTPUT_BLOCK_SIZE + 10; i++)
+    data += (char)('a' + i % 26);
+  output_chain_append(&chain, data.data(), data.size());
+  EXPECT_EQ(chain.length, data.size());
+
+  socket_iovec_t iov[8];
+  EXPECT_EQ(output_chain_iov(&chain, iov, 8), 4);
+  EXPECT_EQ(output_chain_iov(&chain, iov, 2), 2);
+
+  /* a partial send ends in the middle of the second block */
+  output_chain_consume(&chain, OUTPUT_BLOCK_SIZE + 5);
+  EXPECT_EQ(contents(), data.substr(OUTPUT_BLOCK_SIZE + 5));
+  EXPECT_EQ(output_chain_iov(&chain, iov, 8), 3);
+
+  output_chain_consume(&chain, chain.length);
+  EXPECT_EQ(chain.length, 0u);
+  EXPECT_EQ(output_chain_iov(&chain, iov, 8), 0);
+
+  /* the chain is reusable after draining */
+  output_chain_append(&chain, "xyz", 3);
+  EXPECT_EQ(contents(), "xyz");
+}
+
+TEST_F(OutputChainTest, BlocksAreReturnedToThePool) {
+  output_pool_stats_t base, stats;
+  std::string data(2 * OUTPUT_BLOCK_SIZE, 'x');
+
+  output_pool_get_stats(&base);
+  output_chain_append(&chain, data.data(), data.size());
+  output_pool_get_stats(&stats);
+  EXPECT_EQ(stats.blocks_in_use, base.blocks_in_use + 2);
+  EXPECT_GE(stats.peak_in_use, stats.blocks_in_use);
+
+  output_chain_consume(&chain, data.size());
+  output_pool_get_stats(&stats);
+  EXPECT_EQ(stats.blocks_in_use, base.blocks_in_use);
+  EXPECT_GE(stats.blocks_free, 2u);
+
+  /* refilling takes cached blocks instead of allocating */
+  uint64_t allocs = stats.total_allocs;
+  output_chain_append(&chain, data.data(), data.size());
+  output_pool_get_stats(&stats);
+  EXPECT_EQ(stats.total_allocs, allocs);
+
+  output_chain_clear(&chain);
+  output_pool_trim();
+  output_pool_get_stats(&stats);
+  EXPECT_EQ(stats.blocks_free, 0u);
+  EXPECT_EQ(stats.blocks_allocated, stats.blocks_in_use);
+}
+
+TEST_F(OutputChainTest, SegmentsAreLinkedOrCopied) {
+  output_segment_t *seg = output_segment_new_crlf("a\nb", 3);
+
+  EXPECT_EQ(seg->length, 4u);
+  EXPECT_EQ(std::string(seg->data, seg->length), "a\r\nb");
+
+  /* linked into an empty chain, copied into a tail block with room */
+  output_chain_append_segment(&chain, seg);
+  EXPECT_EQ(seg->ref, 2);
+  output_chain_append(&chain, "-", 1);
+  output_chain_append_segment(&chain, seg);
+  EXPECT_EQ(seg->ref, 2);
+  EXPECT_EQ(contents(), "a\r\nb-a\r\nb");
+
+  /* a partial send inside the segment, then the rest */
+  output_chain_consume(&chain, 2);
+  EXPECT_EQ(contents(), "\nb-a\r\nb");
+  output_chain_consume(&chain, 2);
+  EXPECT_EQ(seg->ref, 1);
+  EXPECT_EQ(contents(), "-a\r\nb");
+
+  output_chain_clear(&chain);
+  output_segment_drain_autorelease();
+}
+
+TEST_F(OutputChainTest, AppendCrlfTranslatesNewlines) {
+  output_chain_append_crlf(&chain, "a\n\nb\n", 5);
+  EXPECT_EQ(contents(), "a\r\n\r\nb\r\n");
+  EXPECT_EQ(chain.length, 8u);
+}
+
+} // namespace
@@ -14,6 +14,9 @@
 #include <gtest/gtest.h>
 #include <thread>
 #include <chrono>
+#ifdef HAVE_SYS_TIMERFD_H
+#include <poll.h>
+#endif
 
 using namespace testing;
 
@@ -25,7 +28,7 @@ protected:
 
     void TearDown() override {
         // Ensure heart_beat_flag is reset
-        heart_beat_flag = false;
+        clear_heart_beat_flag();
     }
 };
 
@@ -37,14 +40,14 @@ TEST_F(PlatformTimerTest, HeartBeatFlagSetByTimer) {
     memset(&test_timer, 0, sizeof(test_timer));
 
     auto test_callback = +[]() {
-        heart_beat_flag = true;
+        raise_heart_beat_flag();
     };
 
     // Initialize timer
     ASSERT_EQ(platform_timer_init(&test_timer), TIMER_OK) << "Failed to initialize timer";
 
     // Start timer with 100ms interval (100,000 microseconds)
-    heart_beat_flag = false;
+    clear_heart_beat_flag();
     ASSERT_EQ(platform_timer_start(&test_timer, 100000, test_callback), TIMER_OK)
         << "Failed to start timer";
 
@@ -52,7 +55,7 @@ TEST_F(PlatformTimerTest, HeartBeatFlagSetByTimer) {
     std::this_thread::sleep_for(std::chrono::milliseconds(150));
 
     // Verify heart_beat_flag was set
-    EXPECT_EQ(heart_beat_flag, true) << "heart_beat_flag should be set by timer callback";
+    EXPECT_TRUE(query_heart_beat_flag()) << "heart_beat_flag should be set by timer callback";
 
     // Stop timer
     ASSERT_EQ(platform_timer_stop(&test_timer), TIMER_OK) << "Failed to stop timer";
@@ -275,6 +278,43 @@ TEST_F(PlatformTimerTest, StopDoesNotStallOnLostNotifyRegression) {
     }
 }
 
+#ifdef HAVE_SYS_TIMERFD_H
+/**
+ * @brief Test a descriptor timer becomes readable on expiration and counts missed ticks
+ */
+TEST_F(PlatformTimerTest, DescriptorTimerCountsExpirations) {
+    platform_timer_t test_timer;
+    memset(&test_timer, 0, sizeof(test_timer));
+    int fd = -1;
+
+    ASSERT_EQ(platform_timer_init(&test_timer), TIMER_OK);
+    ASSERT_EQ(platform_timer_start_fd(&test_timer, 50000, &fd), TIMER_OK);
+    ASSERT_GE(fd, 0);
+    EXPECT_EQ(platform_timer_is_active(&test_timer), 1);
+
+    // Nothing to read before the first expiration
+    EXPECT_EQ(platform_timer_read(&test_timer, NULL), 0u);
+
+    struct pollfd pfd = { fd, POLLIN, 0 };
+    ASSERT_EQ(poll(&pfd, 1, 1000), 1) << "timer descriptor should become readable";
+    unsigned long late_us = 0;
+    EXPECT_GE(platform_timer_read(&test_timer, &late_us), 1u);
+    EXPECT_LT(late_us, 50000u);
+
+    // Not serviced for ~4 intervals: the expirations accumulate
+    std::this_thread::sleep_for(std::chrono::milliseconds(220));
+    unsigned long long ticks = platform_timer_read(&test_timer, &late_us);
+    EXPECT_GE(ticks, 3u);
+    EXPECT_LE(ticks, 5u);
+
+    ASSERT_EQ(platform_timer_stop(&test_timer), TIMER_OK);
+    EXPECT_EQ(platform_timer_is_active(&test_timer), 0);
+    EXPECT_EQ(platform_timer_read(&test_timer, NULL), 0u);
+
+    platform_timer_cleanup(&test_timer);
+}
+#endif /* HAVE_SYS_TIMERFD_H */
+
 /**
  * @brief Test query_heart_beat integration with timer
  */
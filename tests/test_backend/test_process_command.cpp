@@ -14,6 +14,7 @@
 
 #include <gtest/gtest.h>
 #include <filesystem>
+#include <string>
 
 using namespace testing;
 
@@ -191,6 +192,48 @@ protected:
     free_array(state);
   }
 
+  object_t *load_dispatch_order_object(const char *name) {
+    constexpr const char *kLpcCode = R"(
+      string *seen = ({});
+
+      void register_actions() {
+        add_action("act_oldest", "look");
+        add_action("act_short", "l", 1);
+        add_action("act_newer", "look");
+        add_action("act_empty", "");
+        for (int i = 0; i < 40; i++)
+          add_action("act_numbered", "verb" + i);
+      }
+
+      int act_oldest(string arg) { seen += ({ "oldest" }); return 1; }
+      int act_short(string arg) { seen += ({ "short" }); return 0; }
+      int act_newer(string arg) { seen += ({ "newer" }); return 0; }
+      int act_empty(string arg) { seen += ({ "empty" }); return 0; }
+      int act_numbered(string arg) { seen += ({ query_verb() }); return 1; }
+
+      int drop_newer() { return remove_action("act_newer", "look"); }
+
+      string state() {
+        string r = implode(seen, ",");
+        seen = ({});
+        return r;
+      }
+    )";
+
+    current_object = master_ob;
+    object_t *obj = load_object(name, kLpcCode);
+    EXPECT_NE(obj, nullptr);
+    return obj;
+  }
+
+  std::string fetch_dispatch_order(object_t *obj) {
+    svalue_t *ret = APPLY_SLOT_CALL("state", obj, 0, ORIGIN_DRIVER);
+    EXPECT_NE(ret, nullptr);
+    std::string order = (ret && ret->type == T_STRING) ? SVALUE_STRPTR(ret) : "";
+    APPLY_SLOT_FINISH_CALL();
+    return order;
+  }
+
   object_t *load_query_verb_case_object(const char *name) {
     constexpr const char *kLpcCode = R"(
       string seen_in_command;
@@ -327,4 +370,76 @@ TEST_F(ProcessCommandTest, QueryVerbReturnsZeroOutsideCommandAndDoesNotLeak) {
   destruct_object(obj);
 }
 
+TEST_F(ProcessCommandTest, VerbIndexPreservesAddActionOrder) {
+  object_t *obj = load_dispatch_order_object("/tests/backend/test_process_command_dispatch_order");
+  ASSERT_NE(obj, nullptr);
+  register_actions(obj);
+  ASSERT_NE(obj->sent_index, nullptr);
+
+  /* newest first, across plain, short and empty verbs */
+  char input1[] = "look up";
+  EXPECT_EQ(process_command(input1, obj), 1);
+  EXPECT_EQ(fetch_dispatch_order(obj), "empty,newer,short,oldest");
+
+  /* the bucket table grew past its initial size without losing verbs */
+  char input2[] = "verb37";
+  EXPECT_EQ(process_command(input2, obj), 1);
+  EXPECT_EQ(fetch_dispatch_order(obj), "verb37");
+
+  char input3[] = "verb";
+  EXPECT_EQ(process_command(input3, obj), 0);
+  EXPECT_EQ(fetch_dispatch_order(obj), "empty");
+
+  object_t *saved_cg = command_giver;
+  command_giver = obj;
+  svalue_t *ret = APPLY_SLOT_CALL("drop_newer", obj, 0, ORIGIN_DRIVER);
+  ASSERT_NE(ret, nullptr);
+  EXPECT_EQ(ret->u.number, 1);
+  APPLY_SLOT_FINISH_CALL();
+  command_giver = saved_cg;
+
+  char input4[] = "look";
+  EXPECT_EQ(process_command(input4, obj), 1);
+  EXPECT_EQ(fetch_dispatch_order(obj), "empty,short,oldest");
+
+  destruct_object(obj);
+}
+
+TEST_F(ProcessCommandTest, MoveObjectDropsActionsOfOldEnvironment) {
+  current_object = master_ob;
+  object_t *room1 = load_object("/tests/backend/test_process_command_room1", "void create() {}");
+  object_t *room2 = load_object("/tests/backend/test_process_command_room2", "void create() {}");
+  object_t *thing = load_object("/tests/backend/test_process_command_thing", R"(
+      void init() { add_action("act_poke", "poke"); }
+      int act_poke(string arg) { return 1; }
+    )");
+  object_t *user = load_object("/tests/backend/test_process_command_mover", R"(
+      void init() { add_action("act_wave", "wave"); }
+      int act_wave(string arg) { return 1; }
+    )");
+  ASSERT_NE(room1, nullptr);
+  ASSERT_NE(room2, nullptr);
+  ASSERT_NE(thing, nullptr);
+  ASSERT_NE(user, nullptr);
+
+  user->flags |= O_ENABLE_COMMANDS;
+  move_object(thing, room1);
+  move_object(user, room1);
+
+  char poke[] = "poke";
+  EXPECT_EQ(process_command(poke, user), 1);
+
+  move_object(user, room2);
+  EXPECT_EQ(user->sent, nullptr);
+  EXPECT_EQ(user->sent_index->prefix, nullptr);
+  EXPECT_EQ(user->sent_index->count, 0u);
+  char poke_again[] = "poke";
+  EXPECT_EQ(process_command(poke_again, user), 0);
+
+  destruct_object(user);
+  destruct_object(thing);
+  destruct_object(room2);
+  destruct_object(room1);
+}
+
 } // namespace
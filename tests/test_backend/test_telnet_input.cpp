@@ -0,0 +1,134 @@
+/**
+ * @file test_telnet_input.cpp
+ * @brief Tests for the telnet input parser and the growable input buffer
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include "std.h"
+#include "src/main.h"
+#include "rc/rc.h"
+#include "src/comm.h"
+#include "src/command.h"
+#include "lpc/object.h"
+
+#include <gtest/gtest.h>
+#include <string>
+
+using namespace testing;
+
+namespace {
+
+/* A telnet user that is not the console, so echoed line ends stay queued. */
+class TelnetInputTest : public Test {
+protected:
+  interactive_t console = {};
+  interactive_t ip = {};
+  interactive_t *user_slots[2] = { &console, &ip };
+  interactive_t **saved_all_users = nullptr;
+  int saved_max_users = 0;
+  int saved_limit = 0;
+  main_options_t opts = {};
+  main_options_t *saved_opts = nullptr;
+  object_t ob = {};
+  char name[5] = "user";
+
+  void SetUp() override {
+    saved_all_users = all_users;
+    saved_max_users = max_users;
+    all_users = user_slots;
+    max_users = 2;
+    saved_limit = CONFIG_INT(__INPUT_BUFFER_LIMIT__);
+    CONFIG_INT(__INPUT_BUFFER_LIMIT__) = 65536;
+    saved_opts = g_main_options;
+    g_main_options = &opts;
+    ip.fd = -1;
+    ip.dirty_index = -1;
+    ip.cmd_ready_index = -1;
+    ip.connection_type = PORT_TELNET;
+    ip.ob = &ob;
+    ob.name = name;
+    ob.interactive = &ip;
+  }
+
+  void TearDown() override {
+    free_input_buffer(&ip);
+    update_cmd_in_buf(&ip);
+    output_chain_clear(&ip.output);
+    num_dirty_users = 0;
+    g_main_options = saved_opts;
+    CONFIG_INT(__INPUT_BUFFER_LIMIT__) = saved_limit;
+    all_users = saved_all_users;
+    max_users = saved_max_users;
+  }
+
+  void receive(const std::string &data) {
+    receive_telnet_input(&ip, data.data(), data.size());
+  }
+
+  std::string buffered() {
+    return std::string(ip.text + ip.text_start, ip.text_end - ip.text_start);
+  }
+};
+
+TEST_F(TelnetInputTest, CopiesPlainRunsAroundTelnetSequences) {
+  /* IAC IAC is a literal 0xff; IAC WONT ECHO is negotiation */
+  receive("look\r\nsay a\xff\xff" "b\xff\xfc\x01" "c\r\n");
+  EXPECT_EQ(buffered(), std::string("look \b\0say a\xff" "bc \b\0", 18));
+  EXPECT_TRUE(ip.iflags & USING_TELNET);
+  EXPECT_TRUE(ip.iflags & CMD_IN_BUF);
+  EXPECT_EQ(ip.state, 0);
+}
+
+TEST_F(TelnetInputTest, LineEndSplitAcrossReads) {
+  receive("north\r");
+  EXPECT_FALSE(ip.iflags & CMD_IN_BUF);
+  receive("\nsouth\r");
+  receive(std::string("\0", 1));
+  EXPECT_EQ(buffered(), std::string("north \b\0south \b\0", 16));
+}
+
+TEST_F(TelnetInputTest, LongLineGrowsBufferAndIsScannedOnce) {
+  std::string chunk(1000, 'x');
+
+  for (int i = 0; i < 20; i++)
+    {
+      receive(chunk);
+      EXPECT_FALSE(ip.iflags & CMD_IN_BUF);
+      /* the partial line is known to hold no line end */
+      EXPECT_EQ(ip.text_scan, ip.text_end);
+    }
+  EXPECT_GT(ip.text_size, (size_t)20000);
+
+  receive("\r\n");
+  EXPECT_TRUE(ip.iflags & CMD_IN_BUF);
+  EXPECT_EQ(cmd_in_buf(&ip), 1);
+  EXPECT_EQ(strlen(ip.text + ip.text_start), 20002u);
+}
+
+TEST_F(TelnetInputTest, LineBeyondLimitIsDiscardedUpToItsEnd) {
+  std::string chunk(1000, 'x');
+
+  CONFIG_INT(__INPUT_BUFFER_LIMIT__) = MIN_INPUT_BUFFER_LIMIT;
+  for (int i = 0; i < 10; i++)
+    receive(chunk);
+  EXPECT_TRUE(ip.iflags & INPUT_OVERFLOW);
+  EXPECT_LE(ip.text_size, (size_t)MIN_INPUT_BUFFER_LIMIT);
+
+  /* the tail of the overlong line is dropped, the next line is kept */
+  receive("yyy\r\nlook\r\n");
+  EXPECT_FALSE(ip.iflags & INPUT_OVERFLOW);
+  EXPECT_EQ(buffered(), std::string("look \b\0", 7));
+}
+
+TEST_F(TelnetInputTest, ProcessedInputIsShiftedOut) {
+  receive("one\r\ntwo");
+  ip.text_start = 6;  /* "one" was processed */
+  ASSERT_TRUE(reserve_input_space(&ip, ip.text_size));
+  EXPECT_EQ(ip.text_start, 0);
+  EXPECT_EQ(buffered(), "two");
+}
+
+} // namespace
@@ -0,0 +1,242 @@
+/**
+ * @file test_async_runtime_sockets.cpp
+ * @brief Tests for socket events of the async runtime
+ *
+ * The tests accept both I/O notification models: with readiness
+ * notification the test reads or accepts by itself, with completion
+ * notification (EVENT_RECV_DATA, EVENT_ACCEPT) the runtime has done it.
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include "std.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "async/async_runtime.h"
+
+#ifndef _WIN32
+#include <netinet/in.h>
+#endif
+
+namespace {
+
+class AsyncRuntimeSocketTest : public ::testing::Test {
+protected:
+    async_runtime_t* runtime = nullptr;
+    socket_fd_t fds[2] = { INVALID_SOCKET_FD, INVALID_SOCKET_FD };
+    int tag = 0;
+
+    void SetUp() override {
+        runtime = async_runtime_init();
+        ASSERT_NE(runtime, nullptr);
+        ASSERT_EQ(create_test_socket_pair(fds), 0);
+        ASSERT_NE(set_socket_nonblocking(fds[0], 1), -1);
+    }
+
+    void TearDown() override {
+        if (fds[0] != INVALID_SOCKET_FD) SOCKET_CLOSE(fds[0]);
+        if (fds[1] != INVALID_SOCKET_FD) SOCKET_CLOSE(fds[1]);
+        async_runtime_deinit(runtime);
+    }
+
+    int wait(io_event_t* events, int max_events, long usec) {
+        struct timeval tv = { usec / 1000000, usec % 1000000 };
+        return async_runtime_wait(runtime, events, max_events, &tv);
+    }
+
+    /* Data of a read event, whichever model delivered it */
+    std::string read_data(const io_event_t& evt) {
+        char buf[4096];
+        long n;
+
+        if (evt.buffer)
+            return std::string((const char*)evt.buffer, evt.bytes_transferred);
+        n = SOCKET_RECV(fds[0], buf, sizeof(buf), 0);
+        return n > 0 ? std::string(buf, n) : std::string();
+    }
+};
+
+TEST_F(AsyncRuntimeSocketTest, ReadReadinessRepeatsUntilDrained) {
+    io_event_t events[8];
+    char buf[16];
+
+    ASSERT_EQ(async_runtime_add(runtime, fds[0], EVENT_READ, &tag), 0);
+    ASSERT_EQ(SOCKET_SEND(fds[1], "hello", 5, 0), 5);
+
+    ASSERT_EQ(wait(events, 8, 1000000), 1);
+    EXPECT_EQ(events[0].context, &tag);
+    EXPECT_TRUE(events[0].event_type & EVENT_READ);
+    EXPECT_EQ(events[0].buffer, nullptr);
+
+    /* not read yet: reported again */
+    ASSERT_EQ(wait(events, 8, 1000000), 1);
+    EXPECT_EQ(events[0].context, &tag);
+    EXPECT_EQ(SOCKET_RECV(fds[0], buf, sizeof(buf), 0), 5);
+
+    EXPECT_EQ(wait(events, 8, 50000), 0);
+    EXPECT_EQ(async_runtime_remove(runtime, fds[0]), 0);
+}
+
+TEST_F(AsyncRuntimeSocketTest, ReceivedDataAndEndOfStream) {
+    io_event_t events[8];
+    std::string got;
+    int n;
+
+    ASSERT_EQ(async_runtime_add(runtime, fds[0], EVENT_READ | EVENT_RECV_DATA, &tag), 0);
+    ASSERT_EQ(SOCKET_SEND(fds[1], "hello", 5, 0), 5);
+    while (got.size() < 5 && (n = wait(events, 8, 1000000)) > 0)
+        for (int i = 0; i < n; i++)
+            {
+                EXPECT_EQ(events[i].context, &tag);
+                got += read_data(events[i]);
+            }
+    EXPECT_EQ(got, "hello");
+
+    /* the end of stream is left to the caller's own recv() */
+    SOCKET_CLOSE(fds[1]);
+    fds[1] = INVALID_SOCKET_FD;
+    ASSERT_GE(wait(events, 8, 1000000), 1);
+    EXPECT_EQ(events[0].context, &tag);
+    EXPECT_EQ(events[0].buffer, nullptr);
+    EXPECT_EQ(SOCKET_RECV(fds[0], (char*)&n, 1, 0), 0);
+    EXPECT_EQ(async_runtime_remove(runtime, fds[0]), 0);
+}
+
+TEST_F(AsyncRuntimeSocketTest, WriteInterestFollowsModify) {
+    io_event_t events[8];
+
+    ASSERT_EQ(async_runtime_add(runtime, fds[0], EVENT_READ, &tag), 0);
+    EXPECT_EQ(wait(events, 8, 50000), 0);
+
+    ASSERT_EQ(async_runtime_modify(runtime, fds[0], EVENT_READ | EVENT_WRITE, &tag), 0);
+    ASSERT_EQ(wait(events, 8, 1000000), 1);
+    EXPECT_EQ(events[0].event_type, (uint32_t)EVENT_WRITE);
+
+    ASSERT_EQ(async_runtime_modify(runtime, fds[0], EVENT_READ, &tag), 0);
+    EXPECT_EQ(wait(events, 8, 50000), 0);
+    EXPECT_EQ(async_runtime_remove(runtime, fds[0]), 0);
+}
+
+TEST_F(AsyncRuntimeSocketTest, RemovedSocketIsSilent) {
+    io_event_t events[8];
+
+    ASSERT_EQ(async_runtime_add(runtime, fds[0], EVENT_READ | EVENT_RECV_DATA, &tag), 0);
+    EXPECT_EQ(wait(events, 8, 0), 0);
+    ASSERT_EQ(async_runtime_remove(runtime, fds[0]), 0);
+    ASSERT_EQ(SOCKET_SEND(fds[1], "hello", 5, 0), 5);
+    EXPECT_EQ(wait(events, 8, 50000), 0);
+
+    /* worker completions still get through */
+    ASSERT_EQ(async_runtime_post_completion(runtime, 7, 3), 0);
+    ASSERT_EQ(wait(events, 8, 1000000), 1);
+    EXPECT_EQ(events[0].completion_key, 7u);
+    EXPECT_EQ(events[0].bytes_transferred, 3u);
+}
+
+#ifndef _WIN32
+TEST_F(AsyncRuntimeSocketTest, ListeningSocketAccepts) {
+    struct sockaddr_in addr = {};
+    socklen_t len = sizeof(addr);
+    socket_fd_t lfd, cfd, afd = INVALID_SOCKET_FD;
+    io_event_t events[8];
+    char buf[8];
+
+    lfd = socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_NE(lfd, INVALID_SOCKET_FD);
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ASSERT_EQ(bind(lfd, (struct sockaddr*)&addr, sizeof(addr)), 0);
+    ASSERT_EQ(listen(lfd, 8), 0);
+    ASSERT_EQ(getsockname(lfd, (struct sockaddr*)&addr, &len), 0);
+    ASSERT_NE(set_socket_nonblocking(lfd, 1), -1);
+    ASSERT_EQ(async_runtime_add(runtime, lfd, EVENT_READ | EVENT_ACCEPT, &tag), 0);
+
+    cfd = socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_EQ(connect(cfd, (struct sockaddr*)&addr, sizeof(addr)), 0);
+    ASSERT_EQ(wait(events, 8, 1000000), 1);
+    EXPECT_EQ(events[0].context, &tag);
+    ASSERT_TRUE(events[0].event_type & EVENT_READ);
+    if (events[0].event_type & EVENT_ACCEPTED)
+        afd = events[0].fd;
+    else
+        afd = accept(lfd, NULL, NULL);
+    ASSERT_NE(afd, INVALID_SOCKET_FD);
+    EXPECT_EQ(SOCKET_SEND(afd, "hi", 2, 0), 2);
+    EXPECT_EQ(SOCKET_RECV(cfd, buf, sizeof(buf), 0), 2);
+
+    EXPECT_EQ(async_runtime_remove(runtime, lfd), 0);
+    SOCKET_CLOSE(afd);
+    SOCKET_CLOSE(cfd);
+    SOCKET_CLOSE(lfd);
+}
+#endif
+
+/* Many connections streaming small writes: the shape of telnet input. */
+TEST_F(AsyncRuntimeSocketTest, ReceiveThroughput) {
+    const int num_pairs = 64;
+    const int rounds = 2000;
+    const std::string msg(512, 'x');
+    std::vector<socket_fd_t> local(num_pairs), remote(num_pairs);
+    std::vector<int> tags(num_pairs);
+    io_event_t events[64];
+    char buf[4096];
+    size_t total = 0, expected = (size_t)num_pairs * rounds * msg.size();
+    long waits = 0;
+
+    for (int i = 0; i < num_pairs; i++)
+        {
+            socket_fd_t pair[2];
+            ASSERT_EQ(create_test_socket_pair(pair), 0);
+            ASSERT_NE(set_socket_nonblocking(pair[0], 1), -1);
+            local[i] = pair[0];
+            remote[i] = pair[1];
+            tags[i] = i;
+            ASSERT_EQ(async_runtime_add(runtime, local[i], EVENT_READ | EVENT_RECV_DATA, &tags[i]), 0);
+        }
+
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++)
+        {
+            size_t target = (size_t)num_pairs * (r + 1) * msg.size();
+
+            for (int i = 0; i < num_pairs; i++)
+                ASSERT_EQ(SOCKET_SEND(remote[i], msg.data(), (int)msg.size(), 0), (long)msg.size());
+            while (total < target)
+                {
+                    int n = wait(events, 64, 1000000);
+                    ASSERT_GT(n, 0);
+                    waits++;
+                    for (int k = 0; k < n; k++)
+                        {
+                            int i = *(int*)events[k].context;
+                            long got;
+
+                            if (events[k].buffer)
+                                got = (long)events[k].bytes_transferred;
+                            else
+                                got = SOCKET_RECV(local[i], buf, sizeof(buf), 0);
+                            if (got > 0)
+                                total += got;
+                        }
+                }
+        }
+    auto usec = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count();
+
+    EXPECT_EQ(total, expected);
+    debug_message("[ BENCH    ] received %zu bytes on %d sockets in %lld usec (%.1f MB/s, %ld waits)\n",
+                  total, num_pairs, (long long)usec, usec ? (double)total / usec : 0.0, waits);
+
+    for (int i = 0; i < num_pairs; i++)
+        {
+            async_runtime_remove(runtime, local[i]);
+            SOCKET_CLOSE(local[i]);
+            SOCKET_CLOSE(remote[i]);
+        }
+}
+
+} // namespace
@@ -58,4 +58,5 @@ TEST(ConsoleWorkerQueueDrain, DrainsQueuedLineWithoutCompletionEvent) {
   /* No completion event is staged. process_io() should still drain queue. */
   process_io();
   EXPECT_TRUE(async_queue_is_empty(g_console_queue));
+  free_input_buffer(&console_ip);
 }
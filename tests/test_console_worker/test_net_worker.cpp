@@ -0,0 +1,265 @@
+/**
+ * @file test_net_worker.cpp
+ * @brief Tests for the network I/O thread
+ */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include "std.h"
+#include <gtest/gtest.h>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include "async/net_worker.h"
+
+#ifndef _WIN32
+#include <netinet/in.h>
+#include <sys/socket.h>
+#endif
+
+namespace {
+
+class NetWorkerTest : public ::testing::Test {
+protected:
+    async_runtime_t* runtime = nullptr;
+    net_worker_t* worker = nullptr;
+    socket_fd_t fds[2] = { INVALID_SOCKET_FD, INVALID_SOCKET_FD };
+    net_conn_t* conn = nullptr;
+    int tag = 0;
+
+    void SetUp() override {
+        runtime = async_runtime_init();
+        ASSERT_NE(runtime, nullptr);
+        worker = net_worker_create(runtime, NET_WORKER_COMPLETION_KEY);
+        ASSERT_NE(worker, nullptr);
+        ASSERT_EQ(create_test_socket_pair(fds), 0);
+        ASSERT_NE(set_socket_nonblocking(fds[0], 1), -1);
+        conn = net_worker_add(worker, fds[0], &tag);
+        ASSERT_NE(conn, nullptr);
+    }
+
+    void TearDown() override {
+        /* closes the socket of a connection that is still open */
+        net_worker_destroy(worker);
+        if (fds[1] != INVALID_SOCKET_FD) SOCKET_CLOSE(fds[1]);
+        async_runtime_deinit(runtime);
+    }
+
+    /* Wait for the worker's completion, then take one event. */
+    bool next_event(net_event_t* evt) {
+        io_event_t events[8];
+        struct timeval tv = { 1, 0 };
+
+        for (int tries = 0; tries < 5; tries++) {
+            if (net_worker_next_event(worker, evt))
+                return true;
+            async_runtime_wait(runtime, events, 8, &tv);
+        }
+        return false;
+    }
+
+    int send_text(const std::string& text, bool oob = false) {
+        socket_iovec_t iov[1];
+        SOCKET_IOV_SET(iov[0], text.data(), text.size());
+        return net_worker_sendv(conn, iov, 1, oob);
+    }
+};
+
+TEST_F(NetWorkerTest, InputArrivesAsEvents) {
+    net_event_t evt;
+    std::string got;
+
+    ASSERT_EQ(SOCKET_SEND(fds[1], "look\r\n", 6, 0), 6);
+    while (got.size() < 6 && next_event(&evt)) {
+        EXPECT_EQ(evt.type, NET_EVENT_INPUT);
+        EXPECT_EQ(evt.context, &tag);
+        EXPECT_EQ(evt.serial, net_conn_serial(conn));
+        EXPECT_EQ(evt.data[evt.length], '\0');
+        got.append(evt.data, evt.length);
+    }
+    EXPECT_EQ(got, "look\r\n");
+}
+
+TEST_F(NetWorkerTest, OutputIsSentAndReported) {
+    net_event_t evt;
+    char buf[64];
+    size_t sent = 0;
+
+    ASSERT_EQ(send_text("hello "), 0);
+    ASSERT_EQ(send_text("world"), 0);
+    while (sent < 11 && next_event(&evt)) {
+        EXPECT_EQ(evt.type, NET_EVENT_SENT);
+        sent += evt.length;
+    }
+    EXPECT_EQ(sent, 11u);
+    EXPECT_EQ(SOCKET_RECV(fds[1], buf, sizeof(buf), 0), 11);
+    EXPECT_EQ(std::string(buf, 11), "hello world");
+}
+
+TEST_F(NetWorkerTest, OutputBeyondSocketBufferWaitsForWrite) {
+    std::string big(4 * 1024 * 1024, 'x');
+    std::string received;
+    net_event_t evt;
+    char buf[65536];
+    size_t sent = 0;
+
+    ASSERT_NE(set_socket_nonblocking(fds[1], 1), -1);
+    ASSERT_EQ(send_text(big), 0);
+    while (received.size() < big.size()) {
+        long n = SOCKET_RECV(fds[1], buf, sizeof(buf), 0);
+        if (n > 0)
+            received.append(buf, n);
+        while (net_worker_next_event(worker, &evt)) {
+            EXPECT_EQ(evt.type, NET_EVENT_SENT);
+            sent += evt.length;
+        }
+    }
+    EXPECT_EQ(received, big);
+    while (sent < big.size() && next_event(&evt))
+        sent += evt.length;
+    EXPECT_EQ(sent, big.size());
+}
+
+TEST_F(NetWorkerTest, BurstOfSendsKeepsOrder) {
+    std::string expected, received;
+    char buf[65536];
+
+    /* more commands than the queue holds at once */
+    ASSERT_NE(set_socket_nonblocking(fds[1], 1), -1);
+    for (int i = 0; i < 20000; i++) {
+        std::string piece = std::to_string(i) + ",";
+        expected += piece;
+        ASSERT_EQ(send_text(piece), 0);
+    }
+    for (int tries = 0; received.size() < expected.size() && tries < 2000; tries++) {
+        net_event_t evt;
+        long n = SOCKET_RECV(fds[1], buf, sizeof(buf), 0);
+        if (n > 0)
+            received.append(buf, n);
+        else
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        while (net_worker_next_event(worker, &evt))
+            ;
+    }
+    EXPECT_EQ(received, expected);
+}
+
+#ifndef _WIN32
+/* MSG_OOB needs TCP, the test socket pair is a Unix one */
+static int create_tcp_pair(socket_fd_t fds[2]) {
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+    socket_fd_t listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+
+    fds[0] = fds[1] = INVALID_SOCKET_FD;
+    if (listener == INVALID_SOCKET_FD)
+        return -1;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(listener, (struct sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR
+        || getsockname(listener, (struct sockaddr*)&addr, &addr_len) == SOCKET_ERROR
+        || listen(listener, 1) == SOCKET_ERROR
+        || (fds[1] = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP)) == INVALID_SOCKET_FD
+        || connect(fds[1], (struct sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR
+        || (fds[0] = accept(listener, NULL, NULL)) == INVALID_SOCKET_FD) {
+        if (fds[1] != INVALID_SOCKET_FD)
+            SOCKET_CLOSE(fds[1]);
+        SOCKET_CLOSE(listener);
+        return -1;
+    }
+    SOCKET_CLOSE(listener);
+    return 0;
+}
+
+TEST_F(NetWorkerTest, OutOfBandAfterPendingOutputStaysUrgent) {
+    std::string big(4 * 1024 * 1024, 'x');
+    std::string received;
+    socket_fd_t pair[2];
+    net_conn_t* tcp;
+    char buf[65536], urgent = 0;
+    int sndbuf = 65536;
+    long n;
+
+    ASSERT_EQ(create_tcp_pair(pair), 0);
+    /* small enough that the socket does not take all of the output at once */
+    ASSERT_EQ(setsockopt(pair[0], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf)), 0);
+    ASSERT_NE(set_socket_nonblocking(pair[0], 1), -1);
+    ASSERT_NE(set_socket_nonblocking(pair[1], 1), -1);
+    tcp = net_worker_add(worker, pair[0], &tag);
+    ASSERT_NE(tcp, nullptr);
+
+    /* the urgent byte is queued behind output the socket did not take */
+    socket_iovec_t iov[1];
+    SOCKET_IOV_SET(iov[0], big.data(), big.size());
+    ASSERT_EQ(net_worker_sendv(tcp, iov, 1, false), 0);
+    SOCKET_IOV_SET(iov[0], "!", 1);
+    ASSERT_EQ(net_worker_sendv(tcp, iov, 1, true), 0);
+
+    for (int tries = 0; (received.size() < big.size() || !urgent) && tries < 20000; tries++) {
+        net_event_t evt;
+        /* the urgent byte is lost once the normal reads pass the mark */
+        if (sockatmark(pair[1]) == 1)
+            n = SOCKET_RECV(pair[1], &urgent, 1, MSG_OOB);
+        else if ((n = SOCKET_RECV(pair[1], buf, sizeof(buf), 0)) > 0)
+            received.append(buf, n);
+        if (n <= 0)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        while (net_worker_next_event(worker, &evt))
+            ;
+    }
+    EXPECT_EQ(received.size(), big.size());
+    EXPECT_EQ(received.find_first_not_of('x'), std::string::npos);
+    EXPECT_EQ(urgent, '!');
+
+    net_worker_close(tcp);
+    SOCKET_CLOSE(pair[1]);
+}
+#endif
+
+TEST_F(NetWorkerTest, PeerCloseIsReported) {
+    net_event_t evt;
+
+    SOCKET_CLOSE(fds[1]);
+    fds[1] = INVALID_SOCKET_FD;
+    ASSERT_TRUE(next_event(&evt));
+    EXPECT_EQ(evt.type, NET_EVENT_CLOSED);
+    EXPECT_EQ(evt.error, 0);
+    EXPECT_EQ(evt.context, &tag);
+
+    /* output to a dead connection is discarded */
+    EXPECT_EQ(send_text("lost"), 0);
+    net_worker_close(conn);
+}
+
+TEST_F(NetWorkerTest, CloseSendsQueuedOutputFirst) {
+    char buf[64];
+    std::string got;
+    long n;
+
+    ASSERT_NE(set_socket_nonblocking(fds[1], 0), -1);
+    ASSERT_EQ(send_text("bye\r\n"), 0);
+    net_worker_close(conn);
+    while ((n = SOCKET_RECV(fds[1], buf, sizeof(buf), 0)) > 0)
+        got.append(buf, n);
+    EXPECT_EQ(n, 0);
+    EXPECT_EQ(got, "bye\r\n");
+}
+
+TEST_F(NetWorkerTest, SerialsAreUnique) {
+    socket_fd_t pair[2];
+    net_conn_t* other;
+
+    ASSERT_EQ(create_test_socket_pair(pair), 0);
+    ASSERT_NE(set_socket_nonblocking(pair[0], 1), -1);
+    other = net_worker_add(worker, pair[0], &tag);
+    ASSERT_NE(other, nullptr);
+    EXPECT_NE(net_conn_serial(other), net_conn_serial(conn));
+    net_worker_close(other);
+    SOCKET_CLOSE(pair[1]);
+}
+
+} // namespace
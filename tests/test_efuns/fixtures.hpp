@@ -8,9 +8,16 @@
 #include "lpc/array.h"
 #include "lpc/object.h"
 #include "lpc/otable.h"
+#include "src/apply.h"
+#include "src/backend.h"
 
 #include <gtest/gtest.h>
 #include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <system_error>
+#include <vector>
 
 using namespace testing;
 
@@ -54,3 +61,92 @@ protected:
         fs::current_path(previous_cwd);
     }
 };
+
+/*
+ * Tests working on one file in the mudlib directory, named after the test.
+ * ctest runs the tests in parallel, so each test uses its own file, removed
+ * before and after it. The file name is passed to LPC without the ".o".
+ */
+class SaveFileTest: public EfunsTest {
+protected:
+    explicit SaveFileTest(const char *prefix): file_prefix(prefix) {}
+
+    void SetUp() override {
+        EfunsTest::SetUp();
+        file_name = file_prefix + UnitTest::GetInstance()->current_test_info()->name();
+        file_path = std::filesystem::path(MAIN_OPTION(mudlib_dir_absolute)) / (file_name + ".o");
+        std::error_code ec;
+        std::filesystem::remove(file_path, ec);
+    }
+
+    void TearDown() override {
+        std::error_code ec;
+        std::filesystem::remove(file_path, ec);
+        EfunsTest::TearDown();
+    }
+
+    /* call a method taking the file name and a number */
+    int Call(object_t *obj, const char *method, int number = 0) {
+        eval_cost = CONFIG_INT(__MAX_EVAL_COST__);
+        current_object = obj;
+        copy_and_push_string(file_name.c_str());
+        push_number(number);
+        svalue_t *ret = APPLY_SLOT_CALL(method, obj, 2, ORIGIN_DRIVER);
+        auto view = lpc::svalue_view::from(ret);
+        EXPECT_TRUE(view.is_number());
+        int result = view.is_number() ? static_cast<int>(view.number()) : -1;
+        APPLY_SLOT_FINISH_CALL();
+        return result;
+    }
+
+    std::string ReadSaveFile() {
+        std::ifstream in(file_path.string(), std::ios::binary);
+        return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    }
+
+    void WriteSaveFile(const std::string &data) {
+        std::ofstream(file_path.string(), std::ios::binary | std::ios::trunc) << data;
+    }
+
+    std::string file_name;
+    std::filesystem::path file_path;
+
+private:
+    std::string file_prefix;
+};
+
+/*
+ * Settings of a benchmark, put back when it ends, even by a failed assertion:
+ * trace messages are off since they would dominate the time, and files given
+ * to RemoveOnExit() are removed. Benchmarks are named DISABLED_... to keep
+ * them out of the default ctest run; run them with
+ * --gtest_also_run_disabled_tests.
+ */
+class BenchmarkGuard {
+public:
+    BenchmarkGuard():
+        trace_flags(MAIN_OPTION(trace_flags)),
+        fsync_saves(CONFIG_INT(__ENABLE_SAVE_OBJECT_FSYNC__)) {
+        MAIN_OPTION(trace_flags) = 0;
+    }
+
+    ~BenchmarkGuard() {
+        std::error_code ec;
+        for (const auto &file : files)
+            std::filesystem::remove(file, ec);
+        CONFIG_INT(__ENABLE_SAVE_OBJECT_FSYNC__) = fsync_saves;
+        MAIN_OPTION(trace_flags) = trace_flags;
+    }
+
+    BenchmarkGuard(const BenchmarkGuard &) = delete;
+    BenchmarkGuard &operator=(const BenchmarkGuard &) = delete;
+
+    void RemoveOnExit(const std::filesystem::path &file) {
+        files.push_back(file);
+    }
+
+private:
+    unsigned long trace_flags;
+    int fsync_saves;
+    std::vector<std::filesystem::path> files;
+};
@@ -0,0 +1,232 @@
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include "fixtures.hpp"
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace {
+
+class CheckpointTest : public SaveFileTest {
+protected:
+  CheckpointTest() : SaveFileTest("test_checkpoint_") {}
+
+  void SetUp() override {
+    SaveFileTest::SetUp();
+    init_master("/master.c", NULL); // for valid_checkpoint()
+    ASSERT_NE(master_ob, nullptr);
+  }
+
+  /* loaded by the master object, which has an effective uid */
+  object_t *Load(const char *name, const char *code) {
+    current_object = master_ob;
+    return load_object(name, code);
+  }
+
+  object_t *LoadPlayer(int n) {
+    return Load(("/tests/efuns/test_checkpoint_player" + std::to_string(n)).c_str(), kPlayerCode);
+  }
+
+  /* the master object only lets /secure/ objects write checkpoint logs */
+  object_t *LoadKeeper(const char *name = "/secure/test_checkpoint_keeper") {
+    return Load(name, kKeeperCode);
+  }
+
+  static const char kPlayerCode[];
+  static const char kKeeperCode[];
+};
+
+const char CheckpointTest::kPlayerCode[] = R"(
+  int hp;
+  mixed *inventory;
+  int set_hp(string log, int n) { hp = n; inventory = ({ "sword", n, ([ "gold": n * 10 ]) }); return 1; }
+  int query_hp(string log, int unused) { return inventory[1] == hp && inventory[2]["gold"] == hp * 10 ? hp : -2; }
+  int restore_from(string log, int unused) { hp = -1; inventory = ({ 0, -1, ([ "gold": -10 ]) }); return restore_object(log); }
+  int restore_key(string log, int n) { hp = -1; inventory = ({ 0, -1, ([ "gold": -10 ]) }); return restore_object(log, 0, "player" + n); }
+  int save_to(string log, int n) { return save_object(log + "_" + n); }
+)";
+
+const char CheckpointTest::kKeeperCode[] = R"(
+  object *players(int n) {
+    object *obs = ({});
+    for (int i = 0; i < n; i++)
+      obs += ({ find_object("/tests/efuns/test_checkpoint_player" + i) });
+    return obs;
+  }
+  int checkpoint(string log, int n) { return checkpoint_objects(players(n), log); }
+  int checkpoint_keyed(string log, int n) {
+    string *keys = ({});
+    for (int i = 0; i < n; i++)
+      keys += ({ "player" + i });
+    return checkpoint_objects(players(n), log, keys);
+  }
+  int compact(string log, int unused) { return compact_checkpoint_log(log); }
+  int try_compact(string log, int unused) { return catch(compact_checkpoint_log(log)) ? -1 : 1; }
+  int try_checkpoint(string log, int n) { return catch(checkpoint_objects(players(n), log)) ? -1 : 1; }
+)";
+
+} // namespace
+
+TEST_F(CheckpointTest, RestoreFindsNewestRecord) {
+  object_t *keeper = LoadKeeper();
+  ASSERT_NE(keeper, nullptr);
+  object_t *players[3];
+  for (int i = 0; i < 3; i++) {
+    players[i] = LoadPlayer(i);
+    ASSERT_NE(players[i], nullptr);
+    Call(players[i], "set_hp", 10 + i);
+  }
+
+  ASSERT_EQ(Call(keeper, "checkpoint", 3), 3);
+  EXPECT_EQ(ReadSaveFile().substr(0, 4), "\177NCK");
+  for (int i = 0; i < 3; i++)
+    Call(players[i], "set_hp", 20 + i);
+  ASSERT_EQ(Call(keeper, "checkpoint", 2), 2);
+
+  // restored by object name
+  EXPECT_EQ(Call(players[0], "restore_from"), 1);
+  EXPECT_EQ(Call(players[0], "query_hp"), 20);
+  EXPECT_EQ(Call(players[1], "restore_from"), 1);
+  EXPECT_EQ(Call(players[1], "query_hp"), 21);
+  EXPECT_EQ(Call(players[2], "restore_from"), 1);
+  EXPECT_EQ(Call(players[2], "query_hp"), 12);
+
+  // restored by the key given to checkpoint_objects()
+  Call(players[2], "set_hp", 32);
+  ASSERT_EQ(Call(keeper, "checkpoint_keyed", 3), 3);
+  EXPECT_EQ(Call(players[0], "restore_key", 2), 1);
+  EXPECT_EQ(Call(players[0], "query_hp"), 32);
+  EXPECT_EQ(Call(players[0], "restore_key", 7), 0);
+
+  for (object_t *player : players)
+    destruct_object(player);
+  destruct_object(keeper);
+}
+
+TEST_F(CheckpointTest, DamagedRecordsAreSkipped) {
+  object_t *keeper = LoadKeeper();
+  ASSERT_NE(keeper, nullptr);
+  object_t *player = LoadPlayer(0);
+  ASSERT_NE(player, nullptr);
+
+  Call(player, "set_hp", 10);
+  ASSERT_EQ(Call(keeper, "checkpoint", 1), 1);
+  size_t first_size = ReadSaveFile().size();
+  Call(player, "set_hp", 20);
+  ASSERT_EQ(Call(keeper, "checkpoint", 1), 1);
+
+  // a flipped byte in the newest record falls back to the one before
+  std::string log = ReadSaveFile();
+  log[first_size + (log.size() - first_size) / 2] ^= 0x55;
+  WriteSaveFile(log);
+  EXPECT_EQ(Call(player, "restore_from"), 1);
+  EXPECT_EQ(Call(player, "query_hp"), 10);
+
+  // records appended after a torn one are found
+  WriteSaveFile(log.substr(0, log.size() - 3));
+  Call(player, "set_hp", 30);
+  ASSERT_EQ(Call(keeper, "checkpoint", 1), 1);
+  EXPECT_EQ(Call(player, "restore_from"), 1);
+  EXPECT_EQ(Call(player, "query_hp"), 30);
+
+  // compaction drops the damaged records
+  EXPECT_EQ(Call(keeper, "compact"), 1);
+  EXPECT_EQ(ReadSaveFile().size(), first_size);
+  EXPECT_EQ(Call(player, "restore_from"), 1);
+  EXPECT_EQ(Call(player, "query_hp"), 30);
+
+  destruct_object(player);
+  destruct_object(keeper);
+}
+
+TEST_F(CheckpointTest, CompactionKeepsNewestRecordPerKey) {
+  object_t *keeper = LoadKeeper();
+  ASSERT_NE(keeper, nullptr);
+  object_t *players[3];
+  for (int i = 0; i < 3; i++) {
+    players[i] = LoadPlayer(i);
+    ASSERT_NE(players[i], nullptr);
+  }
+
+  for (int round = 0; round < 5; round++) {
+    for (int i = 0; i < 3; i++)
+      Call(players[i], "set_hp", round * 10 + i);
+    ASSERT_EQ(Call(keeper, "checkpoint", round == 4 ? 2 : 3), round == 4 ? 2 : 3);
+  }
+  size_t before = ReadSaveFile().size();
+
+  EXPECT_EQ(Call(keeper, "compact"), 3);
+  EXPECT_LT(ReadSaveFile().size(), before / 4);
+  EXPECT_FALSE(std::filesystem::exists(file_path.string() + ".tmp"));
+  int expected[3] = {40, 41, 32};
+  for (int i = 0; i < 3; i++) {
+    EXPECT_EQ(Call(players[i], "restore_from"), 1);
+    EXPECT_EQ(Call(players[i], "query_hp"), expected[i]);
+  }
+
+  // a save file is not a checkpoint log
+  ASSERT_EQ(Call(players[0], "save_to"), 1);
+  std::filesystem::path save_file = file_path.parent_path() / (file_name + "_0.o");
+  std::filesystem::rename(save_file, file_path);
+  EXPECT_EQ(Call(keeper, "try_compact"), -1);
+
+  for (object_t *player : players)
+    destruct_object(player);
+  destruct_object(keeper);
+}
+
+TEST_F(CheckpointTest, MasterObjectMustApprove) {
+  object_t *spy = LoadKeeper("/tests/efuns/test_checkpoint_spy");
+  ASSERT_NE(spy, nullptr);
+  object_t *player = LoadPlayer(0);
+  ASSERT_NE(player, nullptr);
+
+  Call(player, "set_hp", 10);
+  EXPECT_EQ(Call(spy, "try_checkpoint", 1), -1);
+  EXPECT_FALSE(std::filesystem::exists(file_path));
+
+  destruct_object(player);
+  destruct_object(spy);
+}
+
+TEST_F(CheckpointTest, DISABLED_BenchmarkCheckpointVersusSaveObject) {
+  constexpr int kPlayers = 200;
+  BenchmarkGuard guard;
+  CONFIG_INT(__ENABLE_SAVE_OBJECT_FSYNC__) = 1;
+  for (int i = 0; i < kPlayers; i++)
+    guard.RemoveOnExit(file_path.parent_path() / (file_name + "_" + std::to_string(i) + ".o"));
+
+  object_t *keeper = LoadKeeper();
+  ASSERT_NE(keeper, nullptr);
+  std::vector<object_t *> players;
+  for (int i = 0; i < kPlayers; i++) {
+    players.push_back(LoadPlayer(i));
+    ASSERT_NE(players.back(), nullptr);
+    Call(players.back(), "set_hp", i);
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kPlayers; i++)
+    EXPECT_EQ(Call(players[i], "save_to", i), 1);
+  auto save_usec = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - start).count();
+
+  start = std::chrono::steady_clock::now();
+  EXPECT_EQ(Call(keeper, "checkpoint", kPlayers), kPlayers);
+  auto checkpoint_usec = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - start).count();
+
+  EXPECT_EQ(Call(players[kPlayers - 1], "restore_from"), 1);
+  EXPECT_EQ(Call(players[kPlayers - 1], "query_hp"), kPlayers - 1);
+  RecordProperty("save_object_usec", (int)save_usec);
+  RecordProperty("checkpoint_usec", (int)checkpoint_usec);
+  debug_message("[ BENCH    ] %d players: save_object() %lld usec, checkpoint_objects() %lld usec\n",
+                kPlayers, (long long)save_usec, (long long)checkpoint_usec);
+
+  for (object_t *player : players)
+    destruct_object(player);
+  destruct_object(keeper);
+}
@@ -0,0 +1,413 @@
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include "fixtures.hpp"
+
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <string>
+#include <system_error>
+
+#include "src/apply.h"
+#include "src/backend.h"
+#include "src/comm.h"
+#include "src/simulate.h"
+#include "efuns/file_async.h"
+#include "lpc/include/runtime_config.h"
+
+namespace {
+
+class FileAsyncTest : public EfunsTest {
+protected:
+  void SetUp() override {
+    EfunsTest::SetUp();
+
+    if (g_runtime == nullptr) {
+      g_runtime = async_runtime_init();
+    }
+    ASSERT_NE(g_runtime, nullptr) << "Failed to initialize async runtime";
+
+    init_master("/master.c", NULL);
+    ASSERT_NE(master_ob, nullptr) << "master_ob is null after init_master().";
+
+    init_file_async(2);
+
+    std::error_code ec;
+    // ctest runs the tests in parallel, so each gets its own directory
+    lpc_dir = std::string("/tmp_file_async_") + UnitTest::GetInstance()->current_test_info()->name();
+    temp_dir = std::filesystem::path(MAIN_OPTION(mudlib_dir_absolute)) / lpc_dir.substr(1);
+    std::filesystem::remove_all(temp_dir, ec);
+    std::filesystem::create_directories(temp_dir, ec);
+    ASSERT_FALSE(ec) << "Failed to create temp dir: " << ec.message();
+  }
+
+  void TearDown() override {
+    std::error_code ec;
+
+    deinit_file_async();
+    std::filesystem::remove_all(temp_dir, ec);
+
+    if (g_runtime != nullptr) {
+      async_runtime_deinit(g_runtime);
+      g_runtime = nullptr;
+    }
+
+    EfunsTest::TearDown();
+  }
+
+  object_t *LoadInlineObject(const char *name, const char *code) {
+    object_t *saved_current = current_object;
+    object_t *obj;
+
+    current_object = master_ob;
+    obj = load_object(name, code);
+    current_object = saved_current;
+    return obj;
+  }
+
+  bool PumpUntil(const std::function<bool()> &predicate, int timeout_ms = 3000) {
+    int elapsed = 0;
+    const int step_ms = 10;
+
+    while (elapsed < timeout_ms) {
+      struct timeval timeout;
+
+      if (predicate()) {
+        return true;
+      }
+
+      timeout.tv_sec = 0;
+      timeout.tv_usec = step_ms * 1000;
+      (void)do_comm_polling(&timeout);
+      process_io();
+      elapsed += step_ms;
+    }
+
+    return predicate();
+  }
+
+  int CallInt(object_t *owner, const char *method) {
+    svalue_t *ret = APPLY_SLOT_CALL(method, owner, 0, ORIGIN_DRIVER);
+    auto view = lpc::svalue_view::from(ret);
+    EXPECT_TRUE(view.is_number());
+    int result = view.is_number() ? static_cast<int>(view.number()) : -1;
+    APPLY_SLOT_FINISH_CALL();
+    return result;
+  }
+
+  /* start requests on files in this test's directory */
+  int Start(object_t *owner, const char *method) {
+    copy_and_push_string(lpc_dir.c_str());
+    svalue_t *ret = APPLY_SLOT_CALL(method, owner, 1, ORIGIN_DRIVER);
+    auto view = lpc::svalue_view::from(ret);
+    EXPECT_TRUE(view.is_number());
+    int result = view.is_number() ? static_cast<int>(view.number()) : -1;
+    APPLY_SLOT_FINISH_CALL();
+    return result;
+  }
+
+  /* events recorded by the test object, one array per callback */
+  array_t *QueryEvents(object_t *owner) {
+    svalue_t *ret = APPLY_SLOT_CALL("query_events", owner, 0, ORIGIN_DRIVER);
+    EXPECT_TRUE(lpc::svalue_view::from(ret).is_array());
+    return ret->u.arr;
+  }
+
+  std::string lpc_dir;
+  std::filesystem::path temp_dir;
+};
+
+static const char kFileAsyncCode[] = R"(
+  mixed *events = ({});
+  void create() { events = ({}); }
+  varargs void done(mixed result, mixed a, mixed b) { events += ({ ({ result, a, b }) }); }
+  int query_event_count() { return sizeof(events); }
+  mixed *query_events() { return events; }
+  int start_write_then_read(string dir) {
+    if (!write_file_async(dir + "/log.txt", "first\n", 1, "done", "w1"))
+      return 0;
+    if (!write_file_async(dir + "/log.txt", "second\n", 0, "done", "w2"))
+      return 0;
+    return read_file_async(dir + "/log.txt", "done", "r", 7);
+  }
+  int start_size_and_dir(string dir) {
+    if (!file_size_async(dir + "/log.txt", (: done :), "size"))
+      return 0;
+    if (!file_size_async(dir, "done", "dir size"))
+      return 0;
+    if (!file_size_async(dir + "/missing", "done", "missing"))
+      return 0;
+    return get_dir_async(dir + "/", 0, "done", "dir");
+  }
+  int start_read_missing(string dir) {
+    return read_file_async(dir + "/missing", "done", "missing");
+  }
+)";
+
+static const char kSaveAsyncCode[] = R"(
+  static mixed *events = ({});
+  int value;
+  void create() { events = ({}); }
+  varargs void done(mixed result, mixed a) { events += ({ ({ result, a }) }); }
+  int query_event_count() { return sizeof(events); }
+  mixed *query_events() { return events; }
+  int save_twice(string dir) {
+    value = 1;
+    if (!save_object(dir + "/saved", 0, "done", "first"))
+      return 0;
+    value = 2;
+    return save_object(dir + "/saved", 0, (: done :), "second");
+  }
+  int save_then_restore(string dir) {
+    value = 5;
+    if (!save_object(dir + "/saved"))
+      return 0;
+    value = 0;
+    if (!restore_object(dir + "/saved"))
+      return 0;
+    return value;
+  }
+  int save_then_rm(string dir) {
+    value = 3;
+    if (!save_object(dir + "/saved", 0, "done", "removed"))
+      return 0;
+    return rm(dir + "/saved.o");
+  }
+  int save_then_write(string dir) {
+    value = 6;
+    if (!save_object(dir + "/saved"))
+      return 0;
+    if (!write_file(dir + "/saved.o", "overwritten\n", 1))
+      return 0;
+    return write_file(dir + "/saved.o", "appended\n");
+  }
+  int save_then_read(string dir) {
+    value = 4;
+    if (!save_object(dir + "/saved"))
+      return 0;
+    return strsrch(read_file(dir + "/saved.o"), "value 4\n") >= 0 && file_size(dir + "/saved.o") > 0;
+  }
+  int save_then_convert(string dir) {
+    value = 7;
+    if (!save_object(dir + "/saved"))
+      return 0;
+    return convert_save_file(dir + "/saved", 2);
+  }
+)";
+
+} // namespace
+
+TEST_F(FileAsyncTest, WritesAndReadsInRequestOrder) {
+  object_t *obj = LoadInlineObject("/tests/efuns/test_file_async", kFileAsyncCode);
+  ASSERT_NE(obj, nullptr);
+
+  current_object = obj;
+  EXPECT_GT(Start(obj, "start_write_then_read"), 0);
+  ASSERT_TRUE(PumpUntil([&]() { return CallInt(obj, "query_event_count") == 3; }));
+
+  array_t *events = QueryEvents(obj);
+  ASSERT_EQ(events->size, 3);
+  // callbacks come in the order the requests were made on the same file
+  array_t *w1 = events->item[0].u.arr;
+  EXPECT_EQ(w1->item[0].u.number, 1);
+  EXPECT_STREQ(lpc::svalue_view::from(&w1->item[1]).c_str(), "w1");
+  array_t *w2 = events->item[1].u.arr;
+  EXPECT_EQ(w2->item[0].u.number, 1);
+  EXPECT_STREQ(lpc::svalue_view::from(&w2->item[1]).c_str(), "w2");
+  array_t *r = events->item[2].u.arr;
+  ASSERT_TRUE(lpc::svalue_view::from(&r->item[0]).is_string());
+  EXPECT_STREQ(lpc::svalue_view::from(&r->item[0]).c_str(), "first\nsecond\n");
+  EXPECT_STREQ(lpc::svalue_view::from(&r->item[1]).c_str(), "r");
+  EXPECT_EQ(r->item[2].u.number, 7);
+  APPLY_SLOT_FINISH_CALL();
+
+  destruct_object(obj);
+}
+
+TEST_F(FileAsyncTest, FileSizeAndGetDirMatchSyncEfuns) {
+  std::error_code ec;
+  ASSERT_TRUE(std::ofstream((temp_dir / "log.txt").string()) << "12345");
+
+  object_t *obj = LoadInlineObject("/tests/efuns/test_file_async", kFileAsyncCode);
+  ASSERT_NE(obj, nullptr);
+
+  current_object = obj;
+  EXPECT_GT(Start(obj, "start_size_and_dir"), 0);
+  ASSERT_TRUE(PumpUntil([&]() { return CallInt(obj, "query_event_count") == 4; }));
+
+  array_t *events = QueryEvents(obj);
+  ASSERT_EQ(events->size, 4);
+  bool saw_size = false, saw_dir_size = false, saw_missing = false, saw_dir = false;
+  for (int i = 0; i < events->size; i++) {
+    array_t *ev = events->item[i].u.arr;
+    std::string tag = lpc::svalue_view::from(&ev->item[1]).c_str();
+    if (tag == "size") {
+      saw_size = true;
+      EXPECT_EQ(ev->item[0].u.number, 5);
+    }
+    else if (tag == "dir size") {
+      saw_dir_size = true;
+      EXPECT_EQ(ev->item[0].u.number, -2);
+    }
+    else if (tag == "missing") {
+      saw_missing = true;
+      EXPECT_EQ(ev->item[0].u.number, -1);
+    }
+    else if (tag == "dir") {
+      saw_dir = true;
+      ASSERT_TRUE(lpc::svalue_view::from(&ev->item[0]).is_array());
+      array_t *list = ev->item[0].u.arr;
+      ASSERT_EQ(list->size, 1);
+      EXPECT_STREQ(lpc::svalue_view::from(&list->item[0]).c_str(), "log.txt");
+    }
+  }
+  EXPECT_TRUE(saw_size && saw_dir_size && saw_missing && saw_dir);
+  APPLY_SLOT_FINISH_CALL();
+
+  destruct_object(obj);
+}
+
+TEST_F(FileAsyncTest, ReadOfMissingFileGivesZero) {
+  object_t *obj = LoadInlineObject("/tests/efuns/test_file_async", kFileAsyncCode);
+  ASSERT_NE(obj, nullptr);
+
+  current_object = obj;
+  EXPECT_GT(Start(obj, "start_read_missing"), 0);
+  ASSERT_TRUE(PumpUntil([&]() { return CallInt(obj, "query_event_count") == 1; }));
+
+  array_t *events = QueryEvents(obj);
+  array_t *ev = events->item[0].u.arr;
+  EXPECT_TRUE(lpc::svalue_view::from(&ev->item[0]).is_number());
+  EXPECT_EQ(ev->item[0].u.number, 0);
+  APPLY_SLOT_FINISH_CALL();
+
+  destruct_object(obj);
+}
+
+TEST_F(FileAsyncTest, CallbacksOfDestructedOwnerAreDropped) {
+  object_t *obj = LoadInlineObject("/tests/efuns/test_file_async", kFileAsyncCode);
+  ASSERT_NE(obj, nullptr);
+
+  current_object = obj;
+  EXPECT_GT(Start(obj, "start_write_then_read"), 0);
+  destruct_object(obj);
+  current_object = master_ob;
+
+  // the requests still run and are collected; the callbacks are not called
+  EXPECT_TRUE(PumpUntil([&]() { return std::ifstream((temp_dir / "log.txt").string()).good(); }));
+  deinit_file_async();
+  std::ifstream in((temp_dir / "log.txt").string());
+  std::string contents((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  EXPECT_EQ(contents, "first\nsecond\n");
+}
+
+TEST_F(FileAsyncTest, RestoreSeesQueuedSaveObject) {
+  int saved_async = CONFIG_INT(__ENABLE_ASYNC_SAVE_OBJECT__);
+  CONFIG_INT(__ENABLE_ASYNC_SAVE_OBJECT__) = 1;
+
+  object_t *obj = LoadInlineObject("/tests/efuns/test_save_async", kSaveAsyncCode);
+  ASSERT_NE(obj, nullptr);
+
+  current_object = obj;
+  // restored right after the save, whether or not the file is written yet
+  EXPECT_EQ(Start(obj, "save_then_restore"), 5);
+  deinit_file_async();
+  EXPECT_TRUE(std::filesystem::exists(temp_dir / "saved.o"));
+
+  destruct_object(obj);
+  CONFIG_INT(__ENABLE_ASYNC_SAVE_OBJECT__) = saved_async;
+}
+
+TEST_F(FileAsyncTest, RepeatedSaveObjectKeepsNewestData) {
+  int saved_async = CONFIG_INT(__ENABLE_ASYNC_SAVE_OBJECT__);
+  CONFIG_INT(__ENABLE_ASYNC_SAVE_OBJECT__) = 1;
+
+  object_t *obj = LoadInlineObject("/tests/efuns/test_save_async", kSaveAsyncCode);
+  ASSERT_NE(obj, nullptr);
+
+  current_object = obj;
+  EXPECT_EQ(Start(obj, "save_twice"), 1);
+  ASSERT_TRUE(PumpUntil([&]() { return CallInt(obj, "query_event_count") == 2; }));
+
+  // both callbacks report success, whether or not the saves were coalesced
+  array_t *events = QueryEvents(obj);
+  ASSERT_EQ(events->size, 2);
+  for (int i = 0; i < events->size; i++) {
+    array_t *ev = events->item[i].u.arr;
+    EXPECT_EQ(ev->item[0].u.number, 1);
+  }
+  EXPECT_STREQ(lpc::svalue_view::from(&events->item[0].u.arr->item[1]).c_str(), "first");
+  EXPECT_STREQ(lpc::svalue_view::from(&events->item[1].u.arr->item[1]).c_str(), "second");
+  APPLY_SLOT_FINISH_CALL();
+
+  std::ifstream in((temp_dir / "saved.o").string());
+  std::string contents((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  EXPECT_NE(contents.find("value 2\n"), std::string::npos) << contents;
+  EXPECT_EQ(contents.find("value 1\n"), std::string::npos) << contents;
+  EXPECT_FALSE(std::filesystem::exists(temp_dir / "saved.o.tmp"));
+
+  destruct_object(obj);
+  CONFIG_INT(__ENABLE_ASYNC_SAVE_OBJECT__) = saved_async;
+}
+
+TEST_F(FileAsyncTest, RmAfterSaveObjectRemovesFile) {
+  int saved_async = CONFIG_INT(__ENABLE_ASYNC_SAVE_OBJECT__);
+  CONFIG_INT(__ENABLE_ASYNC_SAVE_OBJECT__) = 1;
+
+  object_t *obj = LoadInlineObject("/tests/efuns/test_save_async", kSaveAsyncCode);
+  ASSERT_NE(obj, nullptr);
+
+  current_object = obj;
+  // the other file efuns see the queued data on the disk
+  EXPECT_EQ(Start(obj, "save_then_read"), 1);
+
+  // a save not written yet when the file is removed does not bring it back
+  EXPECT_EQ(Start(obj, "save_then_rm"), 1);
+  ASSERT_TRUE(PumpUntil([&]() { return CallInt(obj, "query_event_count") == 1; }));
+  deinit_file_async();
+  EXPECT_FALSE(std::filesystem::exists(temp_dir / "saved.o"));
+  EXPECT_FALSE(std::filesystem::exists(temp_dir / "saved.o.tmp"));
+
+  destruct_object(obj);
+  CONFIG_INT(__ENABLE_ASYNC_SAVE_OBJECT__) = saved_async;
+}
+
+TEST_F(FileAsyncTest, WriteFileAfterSaveObjectIsKept) {
+  int saved_async = CONFIG_INT(__ENABLE_ASYNC_SAVE_OBJECT__);
+  CONFIG_INT(__ENABLE_ASYNC_SAVE_OBJECT__) = 1;
+
+  object_t *obj = LoadInlineObject("/tests/efuns/test_save_async", kSaveAsyncCode);
+  ASSERT_NE(obj, nullptr);
+
+  current_object = obj;
+  // a save not written yet does not replace the file written after it
+  EXPECT_EQ(Start(obj, "save_then_write"), 1);
+  deinit_file_async();
+  std::ifstream in((temp_dir / "saved.o").string());
+  std::string contents((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  EXPECT_EQ(contents, "overwritten\nappended\n");
+
+  destruct_object(obj);
+  CONFIG_INT(__ENABLE_ASYNC_SAVE_OBJECT__) = saved_async;
+}
+
+TEST_F(FileAsyncTest, ConvertSaveFileSeesQueuedSaveObject) {
+  int saved_async = CONFIG_INT(__ENABLE_ASYNC_SAVE_OBJECT__);
+  CONFIG_INT(__ENABLE_ASYNC_SAVE_OBJECT__) = 1;
+
+  object_t *obj = LoadInlineObject("/tests/efuns/test_save_async", kSaveAsyncCode);
+  ASSERT_NE(obj, nullptr);
+
+  current_object = obj;
+  // the queued save is converted, not replaced by its own text later
+  EXPECT_EQ(Start(obj, "save_then_convert"), 1);
+  deinit_file_async();
+  std::ifstream in((temp_dir / "saved.o").string(), std::ios::binary);
+  std::string contents((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  EXPECT_EQ(contents.substr(0, 4), "\177NSO");
+
+  destruct_object(obj);
+  CONFIG_INT(__ENABLE_ASYNC_SAVE_OBJECT__) = saved_async;
+}
@@ -0,0 +1,259 @@
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include "fixtures.hpp"
+
+#include <chrono>
+#include <string>
+#include <system_error>
+
+#include "lpc/include/save_object.h"
+
+namespace {
+
+class SaveFormatTest : public SaveFileTest {
+protected:
+  SaveFormatTest() : SaveFileTest("test_save_format_") {}
+};
+
+static const char kValuesCode[] = R"(
+  int i;
+  float f;
+  string s;
+  mixed *a;
+  mapping m;
+  int zero;
+  static int st;
+  varargs void setup(string file, int unused) {
+    i = -1234567890;
+    f = 1.0 / 3.0;
+    s = "a \"quoted\"\nline\\";
+    a = ({ 1, ({ "x", 2.5 }), ([ "k": 0 ]), 0 });
+    m = ([ "gold": 100, 7: ({ 1, 2 }), "nested": ([ "x": "y" ]) ]);
+    st = 5;
+  }
+  int save_as(string file, int flags) { setup(file, 0); return save_object(file, flags); }
+  int restore_from(string file, int unused) {
+    i = 1; f = 0.0; s = 0; a = 0; m = 0; zero = 7; st = 0;
+    return restore_object(file);
+  }
+  int try_restore(string file, int unused) {
+    return catch(restore_object(file)) ? -1 : 1;
+  }
+  int convert(string file, int flags) { return convert_save_file(file, flags); }
+  int check(string file, int exact_reals) {
+    return i == -1234567890 && (exact_reals ? f == 1.0 / 3.0 : f > 0.3333 && f < 0.3334) && s == "a \"quoted\"\nline\\" &&
+      sizeof(a) == 4 && a[0] == 1 && a[1][0] == "x" && a[1][1] == 2.5 && a[2]["k"] == 0 &&
+      sizeof(m) == 3 && m["gold"] == 100 && m[7][1] == 2 && m["nested"]["x"] == "y" &&
+      zero == 0 && st == 0;
+  }
+)";
+
+} // namespace
+
+TEST_F(SaveFormatTest, BinaryFormatRoundTrip) {
+  object_t *obj = load_object("/tests/efuns/test_save_format", kValuesCode);
+  ASSERT_NE(obj, nullptr);
+
+  ASSERT_EQ(Call(obj, "save_as", SAVE_BINARY), 1);
+  std::string data = ReadSaveFile();
+  ASSERT_GT(data.size(), 5u);
+  EXPECT_EQ(data.substr(0, 4), "\177NSO");
+
+  // restore_object() detects the format
+  EXPECT_EQ(Call(obj, "restore_from"), 1);
+  EXPECT_EQ(Call(obj, "check", 1), 1);
+  destruct_object(obj);
+}
+
+TEST_F(SaveFormatTest, ConvertSaveFileBetweenFormats) {
+  object_t *obj = load_object("/tests/efuns/test_save_format", kValuesCode);
+  ASSERT_NE(obj, nullptr);
+
+  ASSERT_EQ(Call(obj, "save_as", SAVE_TEXT | SAVE_ZEROS), 1);
+  std::string text = ReadSaveFile();
+  EXPECT_EQ(text.rfind("#/", 0), 0u) << text;
+  EXPECT_NE(text.find("\nzero 0\n"), std::string::npos) << text;
+
+  ASSERT_EQ(Call(obj, "convert", SAVE_BINARY), 1);
+  EXPECT_EQ(ReadSaveFile().substr(0, 4), "\177NSO");
+  EXPECT_EQ(Call(obj, "restore_from"), 1);
+  // the text format keeps reals with 6 digits
+  EXPECT_EQ(Call(obj, "check", 0), 1);
+
+  ASSERT_EQ(Call(obj, "convert", SAVE_TEXT), 1);
+  std::string back = ReadSaveFile();
+  EXPECT_EQ(back.rfind("#/tests/efuns/test_save_format", 0), 0u) << back;
+  EXPECT_NE(back.find("\nzero 0\n"), std::string::npos) << back;
+  EXPECT_EQ(Call(obj, "restore_from"), 1);
+  EXPECT_EQ(Call(obj, "check", 0), 1);
+  destruct_object(obj);
+}
+
+TEST_F(SaveFormatTest, TruncatedBinaryFileRaisesError) {
+  object_t *obj = load_object("/tests/efuns/test_save_format", kValuesCode);
+  ASSERT_NE(obj, nullptr);
+
+  ASSERT_EQ(Call(obj, "save_as", SAVE_BINARY), 1);
+  std::string data = ReadSaveFile();
+  for (size_t cut : {data.size() - 1, data.size() - 7, data.size() / 2}) {
+    WriteSaveFile(data.substr(0, cut));
+    EXPECT_EQ(Call(obj, "try_restore"), -1) << "cut at " << cut;
+  }
+  destruct_object(obj);
+}
+
+static const char kBankCode[] = R"(
+  mapping accounts = ([]);
+  mixed *guild = ({});
+  void fill(string file, int chunk) {
+    for (int n = chunk * 1000; n < (chunk + 1) * 1000; n++) {
+      int *history = allocate(10);
+      for (int h = 0; h < 10; h++)
+        history[h] = n * 10 + h;
+      accounts[sprintf("account%05d", n)] = ({ n * 1000 + 17, n / 7.0, "Deposit box in the vault of the guild hall, row " + n, history });
+      if (n % 2 == 0)
+        guild += ({ ([ "name": "member" + n, "rank": n % 12, "joined": 1700000000 + n ]) });
+    }
+  }
+  int save_as(string file, int flags) { return save_object(file, flags); }
+  int restore_from(string file, int unused) { accounts = 0; guild = 0; return restore_object(file); }
+  int count(string file, int unused) { return sizeof(accounts) + sizeof(guild); }
+)";
+
+TEST_F(SaveFormatTest, DISABLED_BenchmarkRestoreLargeSaveFile) {
+  constexpr int kChunks = 10;
+  constexpr int kRounds = 5;
+  BenchmarkGuard guard;
+  object_t *obj = load_object("/tests/efuns/test_save_format_bank", kBankCode);
+  ASSERT_NE(obj, nullptr);
+  for (int chunk = 0; chunk < kChunks; chunk++)
+    Call(obj, "fill", chunk);
+  ASSERT_EQ(Call(obj, "count"), kChunks * 1500);
+
+  for (int flags : {SAVE_TEXT, SAVE_BINARY}) {
+    const char *format = flags == SAVE_TEXT ? "text" : "binary";
+    ASSERT_EQ(Call(obj, "save_as", flags), 1);
+    size_t size = ReadSaveFile().size();
+
+    auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < kRounds; round++)
+      EXPECT_EQ(Call(obj, "restore_from"), 1);
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count();
+
+    EXPECT_EQ(Call(obj, "count"), kChunks * 1500);
+    RecordProperty(std::string("restore_") + format + "_usec", (int)(elapsed / kRounds));
+    debug_message("[ BENCH    ] restored a %zu byte %s save file in %lld usec\n",
+                  size, format, (long long)(elapsed / kRounds));
+  }
+  destruct_object(obj);
+}
+
+static const char kChangesCode[] = R"(
+  int i = 1;
+  mixed *a = ({ ({ 1, 2 }), 3 });
+  mapping m = ([ "k": ({ 1 }) ]);
+  static int st;
+  int save_if(string file, int flags) { return save_object(file, flags); }
+  int save_always(string file, int unused) { return save_object(file); }
+  int set_static(string file, int n) { st = n; return 1; }
+  int set_global(string file, int n) { i = n; return 1; }
+  int set_nested(string file, int n) { mixed *x = a[0]; x[1] = n; return 1; }
+  int set_mapped(string file, int n) { mapping y = m; mixed *x = y["k"]; x[0] = n; return 1; }
+  int add_key(string file, int n) { mapping y = m; y[n] = n; return 1; }
+  int delete_key(string file, int n) { mapping y = m; map_delete(y, n); return 1; }
+  int restore(string file, int unused) { return restore_object(file); }
+  int check(string file, int n) { return a[0][1] == n; }
+  int overwrite(string file, int unused) { return write_file(file + ".o", "foreign\n", 1); }
+  int patch(string file, int unused) { return write_bytes(file + ".o", 0, "X"); }
+)";
+
+TEST_F(SaveFormatTest, SaveIfChangedSkipsUnchangedObject) {
+  object_t *obj = load_object("/tests/efuns/test_save_format_changes", kChangesCode);
+  ASSERT_NE(obj, nullptr);
+  std::error_code ec;
+
+  // a save is skipped if it leaves the file missing and counts in saves_skipped
+  auto saved = [&](const char *method, int number = 0) {
+    std::filesystem::remove(file_path, ec);
+    int skipped = saves_skipped;
+    EXPECT_EQ(Call(obj, method, number), 1);
+    bool written = std::filesystem::exists(file_path);
+    EXPECT_EQ(saves_skipped - skipped, written ? 0 : 1);
+    return written;
+  };
+
+  EXPECT_TRUE(saved("save_if", SAVE_IF_CHANGED));
+  EXPECT_FALSE(saved("save_if", SAVE_IF_CHANGED));
+  // any variable store counts, even to a static variable
+  Call(obj, "set_static", 5);
+  EXPECT_TRUE(saved("save_if", SAVE_IF_CHANGED));
+  // save_object() without the flag always writes
+  EXPECT_TRUE(saved("save_always"));
+  EXPECT_FALSE(saved("save_if", SAVE_IF_CHANGED));
+
+  Call(obj, "set_global", 2);
+  EXPECT_TRUE(saved("save_if", SAVE_IF_CHANGED));
+  EXPECT_FALSE(saved("save_if", SAVE_IF_CHANGED));
+
+  // nested arrays and mappings changed through a local variable
+  Call(obj, "set_nested", 7);
+  EXPECT_TRUE(saved("save_if", SAVE_IF_CHANGED));
+  EXPECT_NE(ReadSaveFile().find("7"), std::string::npos) << ReadSaveFile();
+  EXPECT_FALSE(saved("save_if", SAVE_IF_CHANGED));
+  Call(obj, "set_mapped", 9);
+  EXPECT_TRUE(saved("save_if", SAVE_IF_CHANGED));
+  Call(obj, "add_key", 42);
+  EXPECT_TRUE(saved("save_if", SAVE_IF_CHANGED));
+  EXPECT_FALSE(saved("save_if", SAVE_IF_CHANGED));
+  Call(obj, "delete_key", 42);
+  EXPECT_TRUE(saved("save_if", SAVE_IF_CHANGED));
+
+  // another format is another file content
+  EXPECT_TRUE(saved("save_if", SAVE_IF_CHANGED | SAVE_BINARY));
+  EXPECT_FALSE(saved("save_if", SAVE_IF_CHANGED | SAVE_BINARY));
+
+  // restoring counts as a change
+  EXPECT_EQ(Call(obj, "set_nested", 3), 1);
+  ASSERT_EQ(Call(obj, "save_always"), 1);
+  EXPECT_EQ(Call(obj, "restore"), 1);
+  EXPECT_EQ(Call(obj, "check", 3), 1);
+  EXPECT_TRUE(saved("save_if", SAVE_IF_CHANGED));
+  destruct_object(obj);
+}
+
+TEST_F(SaveFormatTest, SaveIfChangedWritesAfterOtherWriters) {
+  object_t *obj = load_object("/tests/efuns/test_save_format_changes", kChangesCode);
+  ASSERT_NE(obj, nullptr);
+  object_t *other = load_object("/tests/efuns/test_save_format_other", kValuesCode);
+  ASSERT_NE(other, nullptr);
+
+  ASSERT_EQ(Call(obj, "save_if", SAVE_IF_CHANGED), 1);
+  std::string mine = ReadSaveFile();
+  int skipped = saves_skipped;
+
+  // another object saving to the same file
+  ASSERT_EQ(Call(other, "save_as", SAVE_TEXT), 1);
+  EXPECT_NE(ReadSaveFile(), mine);
+  ASSERT_EQ(Call(obj, "save_if", SAVE_IF_CHANGED), 1);
+  EXPECT_EQ(ReadSaveFile(), mine);
+
+  // convert_save_file() changing the format
+  ASSERT_EQ(Call(other, "convert", SAVE_BINARY), 1);
+  ASSERT_EQ(Call(obj, "save_if", SAVE_IF_CHANGED | SAVE_TEXT), 1);
+  EXPECT_EQ(ReadSaveFile(), mine);
+
+  // write_file() and write_bytes() of the save file
+  ASSERT_EQ(Call(obj, "overwrite"), 1);
+  ASSERT_EQ(Call(obj, "save_if", SAVE_IF_CHANGED | SAVE_TEXT), 1);
+  EXPECT_EQ(ReadSaveFile(), mine);
+  ASSERT_EQ(Call(obj, "patch"), 1);
+  EXPECT_NE(ReadSaveFile(), mine);
+  ASSERT_EQ(Call(obj, "save_if", SAVE_IF_CHANGED | SAVE_TEXT), 1);
+  EXPECT_EQ(ReadSaveFile(), mine);
+  EXPECT_EQ(saves_skipped, skipped);
+  destruct_object(other);
+  destruct_object(obj);
+}
@@ -11,6 +11,7 @@
 #include "lpc/object.h"
 #include "socket/socket_efuns.h"
 #include "lpc/include/socket_err.h"
+#include "lpc/include/socket_opt.h"
 
 #include <gtest/gtest.h>
 #include <filesystem>
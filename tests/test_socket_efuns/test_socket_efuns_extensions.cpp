@@ -901,3 +901,547 @@ TEST_F(SocketEfunsBehaviorTest, SOCK_RT_003_RuntimeRegistrationStress_NoLeaks) {
   }
 }
 
+
+namespace {
+
+/* Connect an LPC stream socket to a loopback peer that does not read yet. */
+int ConnectStreamPair(lpc::svalue &read_cb, lpc::svalue &write_cb,
+                           socket_fd_t *listener_fd, socket_fd_t *accepted_fd) {
+  int listener_port = 0;
+  int fd = socket_create(STREAM, read_cb.raw(), NULL);
+
+  if (fd < 0 || !CreateLoopbackListener(listener_fd, &listener_port))
+    return -1;
+  std::string endpoint = "127.0.0.1 " + std::to_string(listener_port);
+  if (socket_connect(fd, (char *)endpoint.c_str(), read_cb.raw(), write_cb.raw()) != EESUCCESS)
+    return -1;
+  if (!AcceptPendingConnection(*listener_fd, accepted_fd))
+    return -1;
+  set_socket_nonblocking(*accepted_fd, 1);
+
+  /* finish the connect */
+  for (int attempts = 0; attempts < 32 && (lpc_socks[fd].flags & S_BLOCKED); attempts++)
+    socket_write_select_handler(fd);
+  return fd;
+}
+
+/* Read from the peer and flush the LPC socket until its send queue is empty. */
+std::string DrainSendQueue(int fd, socket_fd_t peer) {
+  std::string received;
+  char buf[65536];
+
+  for (int idle = 0; idle < 200;) {
+    long n = SOCKET_RECV(peer, buf, sizeof(buf), 0);
+    if (n > 0) {
+      received.append(buf, (size_t)n);
+      idle = 0;
+    } else {
+      idle++;
+      usleep(1000);
+    }
+    if (lpc_socks[fd].flags & S_BLOCKED)
+      socket_write_select_handler(fd);
+    else if (n <= 0)
+      break;
+  }
+  return received;
+}
+
+} // namespace
+
+TEST_F(SocketEfunsBehaviorTest, SOCK_WQ_001_QueuedWritesDrainInOrder) {
+  ASSERT_TRUE(master_ob) << "Master object not initialized";
+
+  object_t* callback_owner = LoadCallbackOwner("test_socket_queue_owner.c");
+  ASSERT_NE(callback_owner, nullptr);
+  ScopedObjectContext ctx(this, callback_owner);
+
+  lpc::svalue read_cb, write_cb, big, tail1, tail2;
+  socket_fd_t listener_fd = INVALID_SOCKET_FD;
+  socket_fd_t accepted_fd = INVALID_SOCKET_FD;
+  std::string big_text(16 << 20, 'a');
+
+  lpc::svalue_view::from(read_cb.raw()).set_shared_string(make_shared_string("read_callback", NULL));
+  lpc::svalue_view::from(write_cb.raw()).set_shared_string(make_shared_string("write_callback", NULL));
+  lpc::svalue_view::from(big.raw()).set_malloc_string(std::string_view(big_text));
+  lpc::svalue_view::from(tail1.raw()).set_shared_string(make_shared_string("tail-1", NULL));
+  lpc::svalue_view::from(tail2.raw()).set_shared_string(make_shared_string("tail-2", NULL));
+
+  int saved_limit = CONFIG_INT(__SOCKET_SEND_QUEUE_LIMIT__);
+  CONFIG_INT(__SOCKET_SEND_QUEUE_LIMIT__) = 32 << 20;
+
+  int fd = ConnectStreamPair(read_cb, write_cb, &listener_fd, &accepted_fd);
+  ASSERT_GE(fd, 0);
+  ClearCallbackOwnerEvents(callback_owner);
+
+  ASSERT_EQ(socket_write(fd, big.raw(), nullptr), EECALLBACK) << "16 MB should not fit in the socket buffers";
+  EXPECT_EQ(socket_write(fd, tail1.raw(), nullptr), EECALLBACK);
+  EXPECT_EQ(socket_write(fd, tail2.raw(), nullptr), EECALLBACK);
+  EXPECT_EQ(lpc_socks[fd].w_count, 3);
+  EXPECT_GT(lpc_socks[fd].w_queued, (size_t)12);
+
+  CONFIG_INT(__SOCKET_SEND_QUEUE_LIMIT__) = saved_limit;
+
+  std::string received = DrainSendQueue(fd, accepted_fd);
+  ASSERT_EQ(received.size(), big_text.size() + 12);
+  EXPECT_TRUE(received.compare(0, big_text.size(), big_text) == 0);
+  EXPECT_EQ(received.substr(big_text.size()), "tail-1tail-2");
+  EXPECT_EQ(lpc_socks[fd].w_count, 0);
+  EXPECT_EQ(lpc_socks[fd].w_queued, (size_t)0);
+
+  /* one write callback, after the whole queue was sent */
+  CaptureCallbacksFromOwner(callback_owner);
+  ASSERT_EQ(callback_records.size(), (size_t)1);
+  EXPECT_TRUE(VerifyCallbackType(CallbackRecord::CB_WRITE, fd));
+
+  EXPECT_EQ(socket_close(fd, 1), EESUCCESS);
+  SOCKET_CLOSE(accepted_fd);
+  SOCKET_CLOSE(listener_fd);
+}
+
+TEST_F(SocketEfunsBehaviorTest, SOCK_WQ_002_QueueLimitRejectsOverflow) {
+  ASSERT_TRUE(master_ob) << "Master object not initialized";
+  ScopedObjectContext ctx(this, master_ob);
+
+  lpc::svalue read_cb, write_cb, chunk, huge;
+  socket_fd_t listener_fd = INVALID_SOCKET_FD;
+  socket_fd_t accepted_fd = INVALID_SOCKET_FD;
+
+  lpc::svalue_view::from(read_cb.raw()).set_shared_string(make_shared_string("read_callback", NULL));
+  lpc::svalue_view::from(write_cb.raw()).set_shared_string(make_shared_string("write_callback", NULL));
+  lpc::svalue_view::from(chunk.raw()).set_malloc_string(std::string_view(std::string(16 << 20, 'b')));
+  lpc::svalue_view::from(huge.raw()).set_malloc_string(std::string_view(std::string(40 << 20, 'c')));
+
+  int saved_limit = CONFIG_INT(__SOCKET_SEND_QUEUE_LIMIT__);
+  CONFIG_INT(__SOCKET_SEND_QUEUE_LIMIT__) = 64 << 20;
+
+  int fd = ConnectStreamPair(read_cb, write_cb, &listener_fd, &accepted_fd);
+  ASSERT_GE(fd, 0);
+
+  ASSERT_EQ(socket_write(fd, chunk.raw(), nullptr), EECALLBACK);
+  EXPECT_EQ(socket_write(fd, chunk.raw(), nullptr), EECALLBACK);
+  EXPECT_EQ(socket_write(fd, huge.raw(), nullptr), EEQUEUEFULL);
+  EXPECT_EQ(lpc_socks[fd].w_count, 2);
+
+  /* without a queue, pending output blocks further writes as before */
+  CONFIG_INT(__SOCKET_SEND_QUEUE_LIMIT__) = 0;
+  EXPECT_EQ(socket_write(fd, chunk.raw(), nullptr), EEALREADY);
+  CONFIG_INT(__SOCKET_SEND_QUEUE_LIMIT__) = saved_limit;
+
+  /* closing flushes the queue before the socket goes away */
+  EXPECT_EQ(socket_close(fd, 1), EESUCCESS);
+  EXPECT_EQ(lpc_socks[fd].state, FLUSHING);
+  std::string received = DrainSendQueue(fd, accepted_fd);
+  EXPECT_EQ(received.size(), (size_t)(32 << 20));
+  EXPECT_EQ(lpc_socks[fd].state, CLOSED);
+
+  SOCKET_CLOSE(accepted_fd);
+  SOCKET_CLOSE(listener_fd);
+}
+
+TEST_F(SocketEfunsBehaviorTest, SOCK_RD_001_ReadBudgetCoalescesBurst) {
+  ASSERT_TRUE(master_ob) << "Master object not initialized";
+
+  object_t* callback_owner = LoadCallbackOwner("test_socket_read_owner.c");
+  ASSERT_NE(callback_owner, nullptr);
+  ScopedObjectContext ctx(this, callback_owner);
+
+  lpc::svalue read_cb, write_cb;
+  socket_fd_t listener_fd = INVALID_SOCKET_FD;
+  socket_fd_t accepted_fd = INVALID_SOCKET_FD;
+
+  lpc::svalue_view::from(read_cb.raw()).set_shared_string(make_shared_string("read_callback", NULL));
+  lpc::svalue_view::from(write_cb.raw()).set_shared_string(make_shared_string("write_callback", NULL));
+
+  int fd = ConnectStreamPair(read_cb, write_cb, &listener_fd, &accepted_fd);
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ(socket_set_option(fd, SOCKOPT_READ_BUDGET, 1 << 20), EESUCCESS);
+
+  std::string burst(100000, 'x');
+  size_t sent = 0;
+  while (sent < burst.size()) {
+    long n = SOCKET_SEND(accepted_fd, burst.data() + sent, burst.size() - sent, 0);
+    ASSERT_GT(n, 0);
+    sent += (size_t)n;
+  }
+  ClearCallbackOwnerEvents(callback_owner);
+
+  /* the whole burst arrives in one callback */
+  socket_read_select_handler(fd);
+  CaptureCallbacksFromOwner(callback_owner);
+  ASSERT_EQ(callback_records.size(), (size_t)1);
+  EXPECT_TRUE(VerifyCallbackType(CallbackRecord::CB_READ, fd));
+  EXPECT_EQ(callback_records.front().data, burst);
+
+  EXPECT_EQ(socket_close(fd, 1), EESUCCESS);
+  SOCKET_CLOSE(accepted_fd);
+  SOCKET_CLOSE(listener_fd);
+}
+
+TEST_F(SocketEfunsBehaviorTest, SOCK_RD_002_ReadBudgetLimitsOneEvent) {
+  ASSERT_TRUE(master_ob) << "Master object not initialized";
+
+  object_t* callback_owner = LoadCallbackOwner("test_socket_budget_owner.c");
+  ASSERT_NE(callback_owner, nullptr);
+  ScopedObjectContext ctx(this, callback_owner);
+
+  lpc::svalue read_cb, write_cb;
+  socket_fd_t listener_fd = INVALID_SOCKET_FD;
+  socket_fd_t accepted_fd = INVALID_SOCKET_FD;
+
+  lpc::svalue_view::from(read_cb.raw()).set_shared_string(make_shared_string("read_callback", NULL));
+  lpc::svalue_view::from(write_cb.raw()).set_shared_string(make_shared_string("write_callback", NULL));
+
+  int fd = ConnectStreamPair(read_cb, write_cb, &listener_fd, &accepted_fd);
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ(socket_set_option(fd, SOCKOPT_READ_BUDGET, 4096), EESUCCESS);
+
+  std::string data(10000, 'y');
+  ASSERT_EQ(SOCKET_SEND(accepted_fd, data.data(), data.size(), 0), (long)data.size());
+  SOCKET_CLOSE(accepted_fd);
+  ClearCallbackOwnerEvents(callback_owner);
+
+  /* 4096 + 4096 + the rest, then the end of stream on the next event */
+  for (int event = 0; event < 4; event++)
+    socket_read_select_handler(fd);
+  CaptureCallbacksFromOwner(callback_owner);
+  ASSERT_EQ(callback_records.size(), (size_t)3);
+  EXPECT_EQ(PopCallback().data.size(), (size_t)4096);
+  EXPECT_EQ(PopCallback().data.size(), (size_t)4096);
+  EXPECT_EQ(PopCallback().data.size(), (size_t)(10000 - 8192));
+  EXPECT_EQ(lpc_socks[fd].state, CLOSED);
+
+  SOCKET_CLOSE(listener_fd);
+}
+
+TEST_F(SocketEfunsBehaviorTest, SOCK_RD_003_SetOptionValidatesCaller) {
+  ASSERT_TRUE(master_ob) << "Master object not initialized";
+
+  object_t* other = LoadCallbackOwner("test_socket_option_other.c");
+  ASSERT_NE(other, nullptr);
+  ScopedObjectContext ctx(this, master_ob);
+
+  lpc::svalue read_cb;
+  lpc::svalue_view::from(read_cb.raw()).set_shared_string(make_shared_string("read_callback", NULL));
+
+  int fd = socket_create(STREAM, read_cb.raw(), NULL);
+  ASSERT_GE(fd, 0);
+
+  EXPECT_EQ(socket_set_option(fd, 999, 1), EESETSOCKOPT);
+  EXPECT_EQ(socket_set_option(fd, SOCKOPT_SEND_QUEUE_LIMIT, 0), EESUCCESS);
+  EXPECT_EQ(lpc_socks[fd].w_limit, 0);
+  EXPECT_EQ(socket_set_option(fd, SOCKOPT_SEND_QUEUE_LIMIT, -1), EESUCCESS);
+  EXPECT_EQ(lpc_socks[fd].w_limit, -1);
+  EXPECT_EQ(socket_set_option(max_lpc_socks, SOCKOPT_READ_BUDGET, 1), EEFDRANGE);
+  {
+    ScopedObjectContext other_ctx(this, other);
+    EXPECT_EQ(socket_set_option(fd, SOCKOPT_READ_BUDGET, 8192), EESECURITY);
+  }
+
+  EXPECT_EQ(socket_close(fd, 1), EESUCCESS);
+  EXPECT_EQ(socket_set_option(fd, SOCKOPT_READ_BUDGET, 8192), EEBADF);
+}
+
+namespace {
+
+const char batch_owner_code[] =
+  "mixed *events = ({});\n"
+  "void create() { events = ({}); }\n"
+  "void clear_events() { events = ({}); }\n"
+  "void read_callback(int fd, mixed *packets) {\n"
+  "  string s = \"\";\n"
+  "  for (int k = 0; k < sizeof(packets); k++)\n"
+  "    s += (k ? \"|\" : \"\") + packets[k][0] + \"@\" + packets[k][1];\n"
+  "  events += ({ ({ \"read\", fd, s }) });\n"
+  "}\n"
+  "mixed *query_events() { return events; }\n";
+
+/* Open a non-blocking UDP socket bound to an ephemeral loopback port. */
+socket_fd_t OpenLoopbackDatagram(int *port) {
+  struct sockaddr_in sin;
+  socklen_t len = sizeof(sin);
+  socket_fd_t fd = socket(AF_INET, SOCK_DGRAM, 0);
+
+  if (fd == INVALID_SOCKET_FD)
+    return INVALID_SOCKET_FD;
+  memset(&sin, 0, sizeof(sin));
+  sin.sin_family = AF_INET;
+  sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (bind(fd, (struct sockaddr *)&sin, sizeof(sin)) == SOCKET_ERROR ||
+      getsockname(fd, (struct sockaddr *)&sin, &len) == SOCKET_ERROR) {
+    SOCKET_CLOSE(fd);
+    return INVALID_SOCKET_FD;
+  }
+  set_socket_nonblocking(fd, 1);
+  *port = ntohs(sin.sin_port);
+  return fd;
+}
+
+int BoundPort(socket_fd_t fd) {
+  struct sockaddr_in sin;
+  socklen_t len = sizeof(sin);
+
+  if (getsockname(fd, (struct sockaddr *)&sin, &len) == SOCKET_ERROR)
+    return -1;
+  return ntohs(sin.sin_port);
+}
+
+void SendDatagram(socket_fd_t from, int port, const std::string &payload) {
+  struct sockaddr_in to;
+
+  memset(&to, 0, sizeof(to));
+  to.sin_family = AF_INET;
+  to.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  to.sin_port = htons((u_short)port);
+  sendto(from, payload.data(), (int)payload.size(), 0, (struct sockaddr *)&to, sizeof(to));
+}
+
+/* Build ({ ({ message, address }), ... }) with string messages. */
+array_t *MakePackets(const std::vector<std::pair<std::string, std::string>> &pairs) {
+  array_t *packets = allocate_empty_array(pairs.size());
+
+  for (size_t k = 0; k < pairs.size(); k++) {
+    array_t *pair = allocate_empty_array(2);
+    SET_SVALUE_MALLOC_STRING(&pair->item[0], string_copy(pairs[k].first.c_str(), "MakePackets"));
+    SET_SVALUE_MALLOC_STRING(&pair->item[1], string_copy(pairs[k].second.c_str(), "MakePackets"));
+    packets->item[k].type = T_ARRAY;
+    packets->item[k].u.arr = pair;
+  }
+  return packets;
+}
+
+} // namespace
+
+TEST_F(SocketEfunsBehaviorTest, SOCK_DG_001_RecvBatchDeliversPairs) {
+  ASSERT_TRUE(master_ob) << "Master object not initialized";
+
+  object_t* callback_owner = nullptr;
+  {
+    ScopedObjectContext load_ctx(this, master_ob);
+    callback_owner = load_object("test_socket_batch_owner.c", batch_owner_code);
+  }
+  ASSERT_NE(callback_owner, nullptr);
+  ScopedObjectContext ctx(this, callback_owner);
+
+  lpc::svalue read_cb;
+  lpc::svalue_view::from(read_cb.raw()).set_shared_string(make_shared_string("read_callback", NULL));
+
+  int fd = socket_create(DATAGRAM, read_cb.raw(), NULL);
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ(socket_bind(fd, 0), EESUCCESS);
+  ASSERT_EQ(socket_set_option(fd, SOCKOPT_RECV_BATCH, 3), EESUCCESS);
+  int lpc_port = BoundPort(lpc_socks[fd].fd);
+  ASSERT_GT(lpc_port, 0);
+
+  int peer_port = 0;
+  socket_fd_t peer = OpenLoopbackDatagram(&peer_port);
+  ASSERT_NE(peer, INVALID_SOCKET_FD);
+  for (int k = 0; k < 5; k++)
+    SendDatagram(peer, lpc_port, "p" + std::to_string(k));
+  ClearCallbackOwnerEvents(callback_owner);
+
+  /* three datagrams in the first callback, the other two in the next */
+  socket_read_select_handler(fd);
+  socket_read_select_handler(fd);
+  CaptureCallbacksFromOwner(callback_owner);
+  ASSERT_EQ(callback_records.size(), (size_t)2);
+  std::string from = "@127.0.0.1 " + std::to_string(peer_port);
+  EXPECT_EQ(PopCallback().data, "p0" + from + "|p1" + from + "|p2" + from);
+  EXPECT_EQ(PopCallback().data, "p3" + from + "|p4" + from);
+
+  EXPECT_EQ(socket_close(fd, 1), EESUCCESS);
+  SOCKET_CLOSE(peer);
+}
+
+TEST_F(SocketEfunsBehaviorTest, SOCK_DG_002_WriteBatchSendsAll) {
+  ASSERT_TRUE(master_ob) << "Master object not initialized";
+  ScopedObjectContext ctx(this, master_ob);
+
+  lpc::svalue read_cb;
+  lpc::svalue_view::from(read_cb.raw()).set_shared_string(make_shared_string("read_callback", NULL));
+
+  int fd = socket_create(DATAGRAM, read_cb.raw(), NULL);
+  ASSERT_GE(fd, 0);
+  ASSERT_EQ(socket_bind(fd, 0), EESUCCESS);
+
+  int peer_port = 0;
+  socket_fd_t peer = OpenLoopbackDatagram(&peer_port);
+  ASSERT_NE(peer, INVALID_SOCKET_FD);
+  std::string to = "127.0.0.1 " + std::to_string(peer_port);
+
+  /* one bad address rejects the whole batch before anything is sent */
+  array_t *bad = MakePackets({{"a", to}, {"b", "not-an-address"}});
+  EXPECT_EQ(socket_write_batch(fd, bad), EEBADADDR);
+  free_array(bad);
+
+  array_t *packets = MakePackets({{"a", to}, {"bb", to}, {"ccc", to}});
+  EXPECT_EQ(socket_write_batch(fd, packets), 3);
+  free_array(packets);
+
+  /* strings go out with their NUL byte, like socket_write() */
+  const char *expected[] = {"a", "bb", "ccc"};
+  for (const char *want : expected) {
+    char buf[64];
+    long n = recv(peer, buf, sizeof(buf), 0);
+    ASSERT_EQ(n, (long)strlen(want) + 1);
+    EXPECT_STREQ(buf, want);
+  }
+  char extra[8];
+  EXPECT_EQ(recv(peer, extra, sizeof(extra), 0), -1) << "the rejected batch must not have been sent";
+
+  EXPECT_EQ(socket_close(fd, 1), EESUCCESS);
+  SOCKET_CLOSE(peer);
+}
+
+TEST_F(SocketEfunsBehaviorTest, SOCK_DG_003_BatchingNeedsDatagramSocket) {
+  ASSERT_TRUE(master_ob) << "Master object not initialized";
+  ScopedObjectContext ctx(this, master_ob);
+
+  lpc::svalue read_cb;
+  lpc::svalue_view::from(read_cb.raw()).set_shared_string(make_shared_string("read_callback", NULL));
+
+  int fd = socket_create(STREAM, read_cb.raw(), NULL);
+  ASSERT_GE(fd, 0);
+  EXPECT_EQ(socket_set_option(fd, SOCKOPT_RECV_BATCH, 8), EEMODENOTSUPP);
+  array_t *packets = MakePackets({{"a", "127.0.0.1 9"}});
+  EXPECT_EQ(socket_write_batch(fd, packets), EEMODENOTSUPP);
+  free_array(packets);
+  EXPECT_EQ(socket_close(fd, 1), EESUCCESS);
+}
+
+#ifdef HAVE_SYS_UN_H
+namespace {
+
+std::string LocalSocketPath(const char *tag) {
+  return std::string("/tmp/neolith_test_") + std::to_string((long)getpid()) + "_" + tag + ".sock";
+}
+
+} // namespace
+
+TEST_F(SocketEfunsBehaviorTest, SOCK_LOCAL_001_StreamConnectAndTransfer) {
+  ASSERT_TRUE(master_ob) << "Master object not initialized";
+
+  object_t* callback_owner = LoadCallbackOwner("test_socket_local_owner.c");
+  ASSERT_NE(callback_owner, nullptr);
+  ScopedObjectContext ctx(this, callback_owner);
+
+  lpc::svalue read_cb, write_cb, listen_cb;
+  lpc::svalue_view::from(read_cb.raw()).set_shared_string(make_shared_string("read_callback", NULL));
+  lpc::svalue_view::from(write_cb.raw()).set_shared_string(make_shared_string("write_callback", NULL));
+  lpc::svalue_view::from(listen_cb.raw()).set_shared_string(make_shared_string("read_callback", NULL));
+
+  std::string path = LocalSocketPath("stream");
+  std::string name = "unix:" + path;
+  unlink(path.c_str());
+
+  int listen_fd = socket_create(STREAM, read_cb.raw(), NULL);
+  ASSERT_GE(listen_fd, 0);
+  ASSERT_EQ(socket_bind_address(listen_fd, name.c_str()), EESUCCESS);
+  EXPECT_TRUE(lpc_socks[listen_fd].flags & S_LOCAL);
+  EXPECT_EQ(access(path.c_str(), F_OK), 0) << "bind should create the socket file";
+  ASSERT_EQ(socket_listen(listen_fd, listen_cb.raw()), EESUCCESS);
+
+  int client_fd = socket_create(STREAM, read_cb.raw(), NULL);
+  ASSERT_GE(client_fd, 0);
+  ASSERT_EQ(socket_connect(client_fd, name.c_str(), read_cb.raw(), write_cb.raw()), EESUCCESS);
+  EXPECT_TRUE(lpc_socks[client_fd].flags & S_LOCAL);
+  for (int attempts = 0; attempts < 32 && (lpc_socks[client_fd].flags & S_BLOCKED); attempts++)
+    socket_write_select_handler(client_fd);
+
+  socket_read_select_handler(listen_fd);
+  int accepted_fd = socket_accept(listen_fd, read_cb.raw(), write_cb.raw());
+  ASSERT_GE(accepted_fd, 0);
+  EXPECT_TRUE(lpc_socks[accepted_fd].flags & S_LOCAL);
+
+  char addr[ADDR_BUF_SIZE];
+  int port = -1;
+  get_socket_address(client_fd, addr, &port);
+  EXPECT_EQ(std::string(addr), name);
+  EXPECT_EQ(port, 0);
+
+  lpc::svalue message;
+  lpc::svalue_view::from(message.raw()).set_shared_string(make_shared_string("hello over unix", NULL));
+  ClearCallbackOwnerEvents(callback_owner);
+  ASSERT_EQ(socket_write(client_fd, message.raw(), nullptr), EESUCCESS);
+  socket_read_select_handler(accepted_fd);
+  CaptureCallbacksFromOwner(callback_owner);
+  ASSERT_EQ(callback_records.size(), (size_t)1);
+  EXPECT_EQ(PopCallback().data, "hello over unix");
+
+  EXPECT_EQ(socket_close(client_fd, 1), EESUCCESS);
+  EXPECT_EQ(socket_close(accepted_fd, 1), EESUCCESS);
+  EXPECT_EQ(access(path.c_str(), F_OK), 0) << "only the bound socket removes the path";
+  EXPECT_EQ(socket_close(listen_fd, 1), EESUCCESS);
+  EXPECT_NE(access(path.c_str(), F_OK), 0) << "closing the listener should remove the socket file";
+}
+
+TEST_F(SocketEfunsBehaviorTest, SOCK_LOCAL_002_DatagramReportsSenderPath) {
+  ASSERT_TRUE(master_ob) << "Master object not initialized";
+
+  object_t* callback_owner = nullptr;
+  {
+    ScopedObjectContext load_ctx(this, master_ob);
+    callback_owner = load_object("test_socket_local_batch_owner.c", batch_owner_code);
+  }
+  ASSERT_NE(callback_owner, nullptr);
+  ScopedObjectContext ctx(this, callback_owner);
+
+  lpc::svalue read_cb;
+  lpc::svalue_view::from(read_cb.raw()).set_shared_string(make_shared_string("read_callback", NULL));
+
+  std::string server_path = LocalSocketPath("dgram_srv");
+  std::string client_path = LocalSocketPath("dgram_cli");
+  unlink(server_path.c_str());
+  unlink(client_path.c_str());
+
+  int server_fd = socket_create(DATAGRAM, read_cb.raw(), NULL);
+  int client_fd = socket_create(DATAGRAM, read_cb.raw(), NULL);
+  ASSERT_GE(server_fd, 0);
+  ASSERT_GE(client_fd, 0);
+  ASSERT_EQ(socket_bind_address(server_fd, ("unix:" + server_path).c_str()), EESUCCESS);
+  ASSERT_EQ(socket_bind_address(client_fd, ("unix:" + client_path).c_str()), EESUCCESS);
+  ASSERT_EQ(socket_set_option(server_fd, SOCKOPT_RECV_BATCH, 4), EESUCCESS);
+
+  lpc::svalue message;
+  lpc::svalue_view::from(message.raw()).set_shared_string(make_shared_string("ping", NULL));
+  ASSERT_EQ(socket_write(client_fd, message.raw(), ("unix:" + server_path).c_str()), EESUCCESS);
+  array_t *packets = MakePackets({{"pong", "unix:" + server_path}});
+  EXPECT_EQ(socket_write_batch(client_fd, packets), 1);
+  free_array(packets);
+
+  ClearCallbackOwnerEvents(callback_owner);
+  socket_read_select_handler(server_fd);
+  CaptureCallbacksFromOwner(callback_owner);
+  ASSERT_EQ(callback_records.size(), (size_t)1);
+  EXPECT_EQ(PopCallback().data, "ping@unix:" + client_path + "|pong@unix:" + client_path);
+
+  EXPECT_EQ(socket_close(client_fd, 1), EESUCCESS);
+  EXPECT_EQ(socket_close(server_fd, 1), EESUCCESS);
+  EXPECT_NE(access(server_path.c_str(), F_OK), 0);
+  EXPECT_NE(access(client_path.c_str(), F_OK), 0);
+}
+
+TEST_F(SocketEfunsBehaviorTest, SOCK_LOCAL_003_AddressFamilyIsFixedOnceBound) {
+  ASSERT_TRUE(master_ob) << "Master object not initialized";
+  ScopedObjectContext ctx(this, master_ob);
+
+  lpc::svalue read_cb, write_cb;
+  lpc::svalue_view::from(read_cb.raw()).set_shared_string(make_shared_string("read_callback", NULL));
+  lpc::svalue_view::from(write_cb.raw()).set_shared_string(make_shared_string("write_callback", NULL));
+
+  int fd = socket_create(STREAM, read_cb.raw(), NULL);
+  ASSERT_GE(fd, 0);
+  EXPECT_EQ(socket_bind_address(fd, "unix:"), EEBADADDR) << "an empty path is not an address";
+  ASSERT_EQ(socket_bind(fd, 0), EESUCCESS);
+  EXPECT_EQ(socket_connect(fd, "unix:/nonexistent/neolith.sock", read_cb.raw(), write_cb.raw()), EEBADADDR);
+  EXPECT_FALSE(lpc_socks[fd].flags & S_LOCAL);
+  EXPECT_EQ(socket_close(fd, 1), EESUCCESS);
+
+  fd = socket_create(STREAM, read_cb.raw(), NULL);
+  ASSERT_GE(fd, 0);
+  EXPECT_EQ(socket_connect(fd, "unix:/nonexistent/neolith.sock", read_cb.raw(), write_cb.raw()), EECONNECT);
+  EXPECT_TRUE(lpc_socks[fd].flags & S_LOCAL);
+  EXPECT_EQ(socket_bind(fd, 0), EEBADADDR) << "a local socket cannot bind an IPv4 port";
+  EXPECT_EQ(socket_close(fd, 1), EESUCCESS);
+}
+#endif /* HAVE_SYS_UN_H */